@@ -94,6 +94,8 @@ typedef struct
                          * in memory if EOF is reached but an attempt to read
                          * is made later when new data is available. We need
                          * to know when to read it and when not to.  */
+    bool block_verified; /*< If the sync marker after the current datablock
+                          * has been read and verified */
     enum maxavro_error last_error; /*< Last error */
     uint8_t sync[SYNC_MARKER_SIZE];
 } MAXAVRO_FILE;
@@ -141,11 +143,13 @@ void maxavro_file_close(MAXAVRO_FILE *file);
 /** Reading records */
 json_t* maxavro_record_read_json(MAXAVRO_FILE *file);
 GWBUF* maxavro_record_read_binary(MAXAVRO_FILE *file);
+long maxavro_record_pass_blocks(MAXAVRO_FILE *file, long max_bytes, long *start);
 
 /** Navigation of the file */
 bool maxavro_record_seek(MAXAVRO_FILE *file, uint64_t offset);
 bool maxavro_record_set_pos(MAXAVRO_FILE *file, long pos);
 bool maxavro_next_block(MAXAVRO_FILE *file);
+void maxavro_record_skip_block(MAXAVRO_FILE *file);
 
 /** Get binary format header */
 GWBUF* maxavro_file_binary_header(MAXAVRO_FILE *file);
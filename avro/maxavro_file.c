@@ -168,6 +168,7 @@ bool maxavro_read_datablock_start(MAXAVRO_FILE* file)
     /** The actual start of the binary block */
     file->block_start_pos = ftell(file->file);
     file->metadata_read = false;
+    file->block_verified = false;
     uint64_t records, bytes;
     bool rval = maxavro_read_integer_from_file(file, &records) &&
                 maxavro_read_integer_from_file(file, &bytes);
@@ -196,7 +197,7 @@ bool maxavro_read_datablock_start(MAXAVRO_FILE* file)
                 file->data_start_pos = pos;
                 ss_dassert(file->data_start_pos > file->block_start_pos);
                 file->metadata_read = true;
-                rval = maxavro_verify_block(file);
+                rval = file->block_verified = maxavro_verify_block(file);
             }
         }
     }
@@ -225,6 +225,22 @@ bool maxavro_next_block(MAXAVRO_FILE *file)
     return false;
 }
 
+/**
+ * @brief Skip the unread records of the current data block
+ *
+ * The records are not decoded which makes this faster than seeking with
+ * maxavro_record_seek. The next read will start from the next data block.
+ *
+ * @param file File to skip records in
+ */
+void maxavro_record_skip_block(MAXAVRO_FILE *file)
+{
+    ss_dassert(file->metadata_read);
+    file->records_read += file->records_in_block - file->records_read_from_block;
+    file->records_read_from_block = file->records_in_block;
+    file->buffer_ptr = file->buffer_end;
+}
+
 /**
  * @brief Seek to a position in the Avro file
  *
@@ -346,3 +362,101 @@ GWBUF* maxavro_record_read_binary(MAXAVRO_FILE *file)
     }
     return rval;
 }
+
+/**
+ * @brief Pass a complete data block without reading its data
+ *
+ * Only the block header and the sync marker after the data are read.
+ *
+ * @param file File positioned at the start of a data block
+ * @return True if the block was complete and it was passed
+ */
+static bool pass_datablock(MAXAVRO_FILE *file)
+{
+    bool rval = false;
+    uint64_t records, bytes;
+    uint8_t sync[SYNC_MARKER_SIZE];
+
+    if (maxavro_read_integer_from_file(file, &records) &&
+        maxavro_read_integer_from_file(file, &bytes) &&
+        fseek(file->file, bytes, SEEK_CUR) == 0 &&
+        fread(sync, 1, SYNC_MARKER_SIZE, file->file) == SYNC_MARKER_SIZE)
+    {
+        if (memcmp(sync, file->sync, SYNC_MARKER_SIZE) == 0)
+        {
+            file->blocks_read++;
+            file->records_read += records;
+            rval = true;
+        }
+        else
+        {
+            MXS_ERROR("Sync marker mismatch in '%s' at file offset %ld.",
+                      file->filename, ftell(file->file));
+            file->last_error = MAXAVRO_ERR_IO;
+        }
+    }
+    else if (ferror(file->file))
+    {
+        MXS_ERROR("Failed to read file '%s': %d, %s", file->filename, errno,
+                  mxs_strerror(errno));
+        file->last_error = MAXAVRO_ERR_IO;
+    }
+
+    /** The last block can be only partially written */
+    clearerr(file->file);
+    return rval;
+}
+
+/**
+ * @brief Pass complete data blocks without decoding them
+ *
+ * This is used to send the data blocks to a client as they are stored in the
+ * file, e.g. with sendfile(). The blocks from the current data block onwards
+ * are passed until the first incomplete block or until at least @c max_bytes
+ * have been passed. Only the block headers and sync markers are read. The
+ * passed blocks are counted as read and the next read starts from the first
+ * block that was not passed.
+ *
+ * @param file      File to read from
+ * @param max_bytes Stop after this many bytes have been passed
+ * @param start     The file offset where the passed blocks start is stored here
+ * @return Number of bytes passed, zero if no complete blocks were found
+ */
+long maxavro_record_pass_blocks(MAXAVRO_FILE *file, long max_bytes, long *start)
+{
+    long end;
+
+    if (file->metadata_read && file->block_verified)
+    {
+        /** The current block has been read and its sync marker verified
+         * which means the file is positioned at the end of the block */
+        *start = file->block_start_pos;
+        end = ftell(file->file);
+        file->records_read += file->records_in_block - file->records_read_from_block;
+        file->records_read_from_block = file->records_in_block;
+        file->metadata_read = false;
+    }
+    else
+    {
+        if (file->metadata_read)
+        {
+            /** The sync marker of the current block was not completely
+             * written when the block was read, check the block again */
+            fseek(file->file, file->block_start_pos, SEEK_SET);
+            file->records_read -= file->records_read_from_block;
+            file->metadata_read = false;
+        }
+
+        *start = end = ftell(file->file);
+    }
+
+    while (file->last_error == MAXAVRO_ERR_NONE && end - *start < max_bytes &&
+           pass_datablock(file))
+    {
+        end = ftell(file->file);
+    }
+
+    /** Return to the start of the first block that was not passed */
+    fseek(file->file, end, SEEK_SET);
+    return end - *start;
+}
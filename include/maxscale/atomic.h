@@ -64,6 +64,43 @@ uint32_t atomic_load_uint32(const uint32_t *variable);
 uint64_t atomic_load_uint64(const uint64_t *variable);
 void* atomic_load_ptr(void * const *variable);
 
+/**
+ * Relaxed atomic loads.
+ *
+ * The load is atomic but imposes no ordering. Intended for reading values,
+ * such as statistics counters, that are updated by one thread without atomic
+ * operations and whose readers only need a value that is not torn.
+ *
+ * @param variable      Pointer the the variable to load from
+ * @return The stored value
+ */
+static inline int64_t atomic_load_int64_relaxed(const int64_t *variable)
+{
+#ifdef MXS_USE_ATOMIC_BUILTINS
+    return __atomic_load_n(variable, __ATOMIC_RELAXED);
+#else
+    return *(const volatile int64_t*)variable;
+#endif
+}
+
+static inline uint32_t atomic_load_uint32_relaxed(const uint32_t *variable)
+{
+#ifdef MXS_USE_ATOMIC_BUILTINS
+    return __atomic_load_n(variable, __ATOMIC_RELAXED);
+#else
+    return *(const volatile uint32_t*)variable;
+#endif
+}
+
+static inline uint64_t atomic_load_uint64_relaxed(const uint64_t *variable)
+{
+#ifdef MXS_USE_ATOMIC_BUILTINS
+    return __atomic_load_n(variable, __ATOMIC_RELAXED);
+#else
+    return *(const volatile uint64_t*)variable;
+#endif
+}
+
 /**
  * Implementation of an atomic store operation for the GCC environment.
  *
@@ -155,6 +155,16 @@ public:
      */
     void close(close_type type = CLOSE_NORMAL);
 
+    /**
+     * @brief Release the connection into the persistent connection pool
+     *
+     * The connection must be idle: it must not be waiting for results and it
+     * must not have pending session commands. The connection is put into the
+     * persistent pool of the server even if the session itself would not
+     * qualify for pooling. If the pool is full, the connection is closed.
+     */
+    void release();
+
     /**
      * @brief Get a pointer to the internal DCB
      *
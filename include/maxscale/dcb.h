@@ -24,6 +24,7 @@
 #include <maxscale/ssl.h>
 #include <maxscale/modinfo.h>
 #include <maxscale/poll_core.h>
+#include <maxscale/worker_timer.h>
 #include <netinet/in.h>
 
 MXS_BEGIN_DECLS
@@ -159,7 +160,13 @@ typedef struct dcb
     uint32_t        fake_event;     /**< Fake event to be delivered to handler */
 
     DCBSTATS        stats;          /**< DCB related statistics */
-    struct dcb      *nextpersistent;   /**< Next DCB in the persistent pool for SERVER */
+    struct
+    {
+        struct dcb *prev;  /**< Previous DCB with the same user, host and protocol */
+        struct dcb *next;  /**< Next DCB with the same user, host and protocol */
+        struct dcb *newer; /**< DCB added to the pool after this one */
+        struct dcb *older; /**< DCB added to the pool before this one */
+    } pool;                         /**< Links of the persistent pool of the SERVER */
     time_t          persistentstart;   /**<    0: Not in the persistent pool.
                                               -1: Evicted from the persistent pool and being closed.
                                            non-0: Time when placed in the persistent pool.
@@ -168,7 +175,8 @@ typedef struct dcb
     void            *data;          /**< Specific client data, shared between DCBs of this session */
     void            *authenticator_data; /**< The authenticator data for this DCB */
     DCB_CALLBACK    *callbacks;     /**< The list of callbacks for the DCB */
-    int64_t         last_read;      /*< Last time the DCB received data */
+    int64_t         last_read;      /*< Last time the DCB received data, see mxs_worker_timer_now() */
+    MXS_WORKER_TIMER idle_timer;    /*< For a client DCB, times out the DCB when it is idle */
     struct server   *server;        /**< The associated backend server */
     SSL*            ssl;            /*< SSL struct for connection */
     bool            ssl_read_want_read;    /*< Flag */
@@ -246,15 +254,21 @@ void dcb_hashtable_stats(DCB *, void *);     /**< Print statisitics */
 int dcb_add_callback(DCB *, DCB_REASON, int (*)(struct dcb *, DCB_REASON, void *), void *);
 int dcb_remove_callback(DCB *, DCB_REASON, int (*)(struct dcb *, DCB_REASON, void *), void *);
 int dcb_count_by_usage(DCB_USAGE);          /* Return counts of DCBs */
-int dcb_persistent_clean_count(DCB *, int, bool);      /* Clean persistent and return count */
+int dcb_persistent_clean_count(struct server *, int, bool); /* Clean persistent and return count */
 void dcb_hangup_foreach (struct server* server);
 uint64_t dcb_get_session_id(DCB* dcb);
 char *dcb_role_name(DCB *);                  /* Return the name of a role */
 int dcb_accept_SSL(DCB* dcb);
 int dcb_connect_SSL(DCB* dcb);
 int dcb_listen(DCB *listener, const char *config, const char *protocol_name);
-void dcb_enable_session_timeouts();
-void dcb_process_idle_sessions(int thr);
+
+/**
+ * Apply a changed connection timeout of a service to the existing client
+ * connections of the service.
+ *
+ * @param service  The service whose timeout was changed.
+ */
+void dcb_update_idle_timeouts(struct service *service);
 
 /**
  * @brief Append a buffer the DCB's readqueue
@@ -366,6 +380,25 @@ static inline void dcb_readq_set(DCB *dcb, GWBUF *buffer)
  */
 bool dcb_foreach(bool (*func)(DCB *dcb, void *data), void *data);
 
+/**
+ * @brief Call a function for each connected DCB, concurrently on all workers
+ *
+ * Each worker calls @c func for its own DCBs, so a worker specific partial
+ * result can be collected without locking and combined once the function
+ * has returned.
+ *
+ * @warning This must not be called from any other worker than the main one,
+ * otherwise deadlocks occur
+ *
+ * @param func Function to call. The function should return @c true to continue iteration
+ * and @c false to stop iteration earlier. The first parameter is a DCB and the second
+ * is the value in @c data for the worker the DCB belongs to.
+ * @param data Array with as many elements as there are workers. The element at the
+ * index of a worker's id is passed as the second parameter to @c func.
+ * @return True if all DCBs were iterated, false if the callback returned false
+ */
+bool dcb_foreach_parallel(bool (*func)(DCB *dcb, void *data), void **data);
+
 /**
  * @brief Call a function for each connected DCB on the current worker
  *
@@ -398,6 +431,7 @@ DCB* dcb_get_current();
  */
 #define DCBF_HUNG               0x0002  /*< Hangup has been dispatched */
 #define DCBF_REPLIED    0x0004  /*< DCB was written to */
+#define DCBF_POOLABLE   0x0008  /*< DCB is idle and can be pooled regardless of the session */
 
 #define DCB_REPLIED(d) ((d)->flags & DCBF_REPLIED)
 
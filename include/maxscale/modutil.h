@@ -84,6 +84,84 @@ typedef struct
  */
 int modutil_count_signal_packets(GWBUF *reply, int n_found, bool* more, modutil_state* state);
 
+/**
+ * The number of bytes from the start of a packet that are needed for finding
+ * out what kind of packet it is: the header, the command byte and, in the case
+ * of an OK packet, two length-encoded integers and the server status.
+ */
+#define MXS_REPLY_TRACKER_PREFIX_LEN (4 + 1 + 9 + 9 + 2)
+
+/** The states of a reply tracker */
+typedef enum mxs_reply_tracker_state
+{
+    MXS_REPLY_TRACKER_START,  /*< Waiting for the first packet of a result */
+    MXS_REPLY_TRACKER_COLDEF, /*< Waiting for the column definitions */
+    MXS_REPLY_TRACKER_ROWS,   /*< Waiting for the rows */
+    MXS_REPLY_TRACKER_DONE    /*< The complete response has been received */
+} mxs_reply_tracker_state_t;
+
+/**
+ * A reply tracker follows the progress of the response to a command as the
+ * response arrives. Each byte is inspected only once, irrespective of how
+ * the response is split into buffers and whether packets are split across
+ * buffers, so the cost of tracking a response is linear in its size.
+ *
+ * The tracker handles the responses to commands whose response is an OK
+ * packet, an ERR packet or one or more result sets, and the responses to
+ * COM_FIELD_LIST and COM_STMT_FETCH.
+ */
+typedef struct mxs_reply_tracker
+{
+    mxs_reply_tracker_state_t state;    /*< The state of the response */
+    uint8_t  command;                   /*< The command whose response is tracked */
+    bool     continuation;              /*< Whether the next packet continues a large packet */
+    bool     ps_out_params;             /*< Whether an EOF with SERVER_PS_OUT_PARAMS has been seen */
+    uint8_t  n_prefix;                  /*< The number of bytes in prefix */
+    uint8_t  prefix[MXS_REPLY_TRACKER_PREFIX_LEN]; /*< The beginning of the current packet */
+    uint32_t n_skip;                    /*< Bytes of the current packet that need not be inspected */
+    uint64_t n_columns;                 /*< The number of columns of the current result set */
+    uint64_t n_rows;                    /*< The number of rows received */
+    uint64_t n_results;                 /*< The number of complete results received */
+    uint64_t n_bytes;                   /*< The number of bytes consumed */
+} MXS_REPLY_TRACKER;
+
+/**
+ * Initialize a reply tracker for tracking the response to a command.
+ *
+ * @param tracker  The tracker to initialize
+ * @param command  The command whose response will be tracked
+ */
+void modutil_reply_tracker_init(MXS_REPLY_TRACKER* tracker, uint8_t command);
+
+/**
+ * Consume data of a response. The data need not consist of complete packets.
+ * Consumption stops at the end of the buffer or at the end of the response,
+ * whichever comes first.
+ *
+ * If the response is collected into a buffer as it arrives, the whole buffer
+ * can be provided each time, with @c tracker->n_bytes as the offset, so that
+ * only the newly arrived data is inspected.
+ *
+ * @param tracker  The tracker
+ * @param buffer   Buffer containing data of the response
+ * @param offset   The offset in @c buffer from where to start consuming
+ *
+ * @return The number of consumed bytes
+ */
+size_t modutil_reply_tracker_consume(MXS_REPLY_TRACKER* tracker, const GWBUF* buffer, size_t offset);
+
+/**
+ * Check whether the complete response has been consumed.
+ *
+ * @param tracker  The tracker
+ *
+ * @return True, if the complete response has been consumed
+ */
+static inline bool modutil_reply_tracker_is_complete(const MXS_REPLY_TRACKER* tracker)
+{
+    return tracker->state == MXS_REPLY_TRACKER_DONE;
+}
+
 mxs_pcre2_result_t modutil_mysql_wildcard_match(const char* pattern, const char* string);
 
 /**
@@ -120,6 +198,22 @@ bool is_mysql_statement_end(const char* start, int len);
 bool is_mysql_sp_end(const char* start, int len);
 char* modutil_get_canonical(GWBUF* querybuf);
 
+/**
+ * @brief Get the canonical form of a statement without copying it
+ *
+ * The canonical form is created into a thread specific buffer, so no memory is
+ * allocated once the buffer has grown large enough. The returned string is
+ * valid until the next call to this function, or to modutil_get_canonical(),
+ * made by the same thread.
+ *
+ * @param querybuf GWBUF with a COM_QUERY statement
+ * @param len      If not NULL, the length of the canonical statement is stored here
+ *
+ * @return The canonical statement or NULL if @c querybuf does not contain a
+ *         statement or if memory could not be allocated.
+ */
+const char* modutil_get_canonical_r(GWBUF* querybuf, size_t* len);
+
 // TODO: Move modutil out of the core
 const char* STRPACKETTYPE(int p);
 
@@ -84,3 +84,57 @@ private:
     MySQLProtocol           m_protocol;
     bool                    m_self_destruct;
 };
+
+/**
+ * A client which routes queries through a session of its own that is created
+ * directly on a service. Unlike with LocalClient, no network connection to a
+ * listener of the service is needed, so the queries are not written to and
+ * read back from a socket and no authentication takes place. Responses are
+ * ignored.
+ *
+ * The client must be created and used in the thread of the session whose
+ * data it copies.
+ */
+class InternalClient
+{
+    InternalClient(const InternalClient&);
+    InternalClient& operator=(const InternalClient&);
+
+public:
+    /**
+     * Destroy the client by closing its session
+     */
+    ~InternalClient();
+
+    /**
+     * Create an internal client for a service
+     *
+     * @param session Client session, whose user and protocol data is copied
+     * @param proto   Client protocol
+     * @param dcb     Client DCB, whose user and remote address are copied
+     * @param service Service to route the queries through
+     *
+     * @return New internal client or NULL on error
+     */
+    static InternalClient* create(MYSQL_session* session, MySQLProtocol* proto,
+                                  DCB* dcb, SERVICE* service);
+
+    /**
+     * Route a query through the session of the client
+     *
+     * @param buffer Buffer containing the query, the caller retains ownership
+     *
+     * @return True if query was successfully routed
+     */
+    bool queue_query(GWBUF* buffer);
+
+private:
+    InternalClient(DCB* dcb, MXS_SESSION* session);
+    static int32_t write(DCB* dcb, GWBUF* buffer);
+    static int32_t close(DCB* dcb);
+    static int32_t hangup(DCB* dcb);
+    static void    free_data(DCB* dcb);
+
+    DCB*         m_dcb;     /**< The internal client DCB */
+    MXS_SESSION* m_session; /**< The session of m_dcb, referenced by the client */
+};
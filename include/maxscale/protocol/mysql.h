@@ -38,6 +38,7 @@
 
 #include <maxscale/buffer.h>
 #include <maxscale/dcb.h>
+#include <maxscale/modutil.h>
 #include <maxscale/session.h>
 #include <maxscale/version.h>
 
@@ -341,6 +342,7 @@ typedef struct
     GWBUF*                 stored_query;                 /*< Temporarily stored queries */
     bool                   collect_result;               /*< Collect the next result set as one buffer */
     bool                   changing_user;
+    MXS_REPLY_TRACKER      reply_tracker;                /*< Tracks the result being collected */
 #if defined(SS_DEBUG)
     skygw_chk_t            protocol_chk_tail;
 #endif
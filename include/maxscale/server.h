@@ -52,6 +52,12 @@ typedef struct server_params
     struct server_params *next; /**< Next Paramter in the linked list */
 } SERVER_PARAM;
 
+/**
+ * The unused persistent connections of a thread to a server. The type is
+ * opaque; it is defined and only accessed by the core.
+ */
+typedef struct server_persistent_pool SERVER_PERSISTENT_POOL;
+
 /**
  * The server statistics structure
  */
@@ -61,9 +67,13 @@ typedef struct
     int n_current;        /**< Current connections */
     int n_current_ops;    /**< Current active operations */
     int n_persistent;     /**< Current persistent pool */
-    uint64_t n_new_conn;  /**< Times the current pool was empty */
+    uint64_t n_new_conn;  /**< Times no matching connection was available from the pool */
     uint64_t n_from_pool; /**< Times when a connection was available from the pool */
+    uint64_t n_pool_expired; /**< Times a connection was removed from the pool unused */
     uint64_t packets;     /**< Number of packets routed to this server */
+    uint64_t response_time; /**< Average response time in microseconds */
+    uint64_t response_time_sampled; /**< When response_time was last updated, in milliseconds
+                                     * of the monotonic clock */
 } SERVER_STATS;
 
 /**
@@ -129,7 +139,7 @@ typedef struct server
     int            depth;          /**< Replication level in the tree */
     long           slaves[MAX_NUM_SLAVES]; /**< Slaves of this node */
     bool           master_err_is_logged; /*< If node failed, this indicates whether it is logged */
-    DCB            **persistent;    /**< List of unused persistent connections to the server */
+    SERVER_PERSISTENT_POOL **persistent; /**< Unused persistent connections to the server, per thread */
     long           persistpoolmax; /**< Maximum size of persistent connections pool */
     long           persistmaxtime; /**< Maximum number of seconds connection can live */
     int            persistmax;     /**< Maximum pool size actually achieved since startup */
@@ -328,6 +338,20 @@ void server_update_parameter(SERVER *server, const char *name, const char *value
  */
 bool server_is_mxs_service(const SERVER *server);
 
+/**
+ * @brief Add a response time sample of a server
+ *
+ * The samples are combined into an exponential moving average that is
+ * stored in the @c response_time statistic of the server. The average
+ * is only updated by the modules that measure the response times, so the
+ * time of the latest sample is stored in @c response_time_sampled for
+ * telling how current the average is.
+ *
+ * @param server The server
+ * @param us     The time in microseconds it took the server to start replying
+ */
+void server_add_response_time(SERVER *server, uint64_t us);
+
 /**
  * @brief Convert a server to JSON format
  *
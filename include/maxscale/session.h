@@ -226,6 +226,20 @@ MXS_SESSION *session_alloc(struct service *, struct dcb *);
  */
 MXS_SESSION *session_alloc_with_id(struct service *, struct dcb *, uint64_t);
 
+/**
+ * Allocate a new session for an internal client of the specified service.
+ *
+ * Unlike session_alloc(), this creates the router session and the filters
+ * even though the client DCB is an internal one. Statements can thus be
+ * routed through the service without a network connection to any of its
+ * listeners. Replies are delivered to the write function of the DCB.
+ *
+ * @param service       The service the statements are routed through
+ * @param client_dcb    An internal DCB, with the client data set
+ * @return              The newly created session or NULL if an error occurred
+ */
+MXS_SESSION *session_alloc_internal(struct service *, struct dcb *);
+
 MXS_SESSION *session_set_dummy(struct dcb *);
 
 static inline bool session_is_dummy(MXS_SESSION* session)
@@ -407,6 +421,19 @@ uint64_t session_get_next_id();
  */
 void session_close(MXS_SESSION *session);
 
+/**
+ * @brief Get a session reference
+ *
+ * This creates an additional reference to a session which allows it to live
+ * as long as it is needed.
+ *
+ * @param session Session reference to get
+ * @return Reference to a MXS_SESSION
+ *
+ * @note The caller must free the session reference by calling session_put_ref
+ */
+MXS_SESSION* session_get_ref(MXS_SESSION *session);
+
 /**
  * @brief Release a session reference
  *
@@ -470,15 +497,6 @@ void session_clear_stmt(MXS_SESSION *session);
  */
 json_t* session_to_json(const MXS_SESSION *session, const char* host);
 
-/**
- * @brief Convert all sessions to JSON
- *
- * @param host Hostname of this server
- *
- * @return A JSON array with all sessions
- */
-json_t* session_list_to_json(const char* host);
-
 /**
  * Qualify the session for connection pooling
  *
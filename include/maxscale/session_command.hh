@@ -17,6 +17,7 @@
 #include <tr1/memory>
 #include <list>
 #include <string>
+#include <vector>
 
 #include <maxscale/buffer.hh>
 
@@ -53,6 +54,30 @@ public:
      */
     uint64_t get_position() const;
 
+    /**
+     * @brief Get the key of the session state this command overwrites
+     *
+     * Commands that replace exactly one piece of session state with a
+     * constant value, e.g. `SET @a = 1`, `SET NAMES utf8` or `USE test`, have
+     * a key that identifies the state. Once such a command has been executed,
+     * earlier commands with the same key are redundant.
+     *
+     * @return The state key or an empty string if the effects of the command
+     *         are not known
+     */
+    const std::string& get_state_key() const;
+
+    /**
+     * @brief Check if the assigned value contains a string literal
+     *
+     * The interpretation of string literals depends on the character set of
+     * the connection.
+     *
+     * @return True if the command has a state key and the value contains a
+     *         string literal
+     */
+    bool has_string_literal() const;
+
     /**
      * @brief Creates a deep copy of the internal buffer
      *
@@ -83,9 +108,29 @@ private:
     uint8_t     m_command;   /**< The command being executed */
     uint64_t    m_pos;       /**< Unique position identifier */
     bool        m_reply_sent; /**< Whether the session command reply has been sent */
+    std::string m_state_key; /**< The session state this command overwrites */
+    bool        m_has_string; /**< Whether the assigned value contains a string literal */
 };
 
 typedef std::tr1::shared_ptr<SessionCommand> SSessionCommand;
 typedef std::list<SSessionCommand> SessionCommandList;
 
+/**
+ * @brief Remove session commands made redundant by a later command
+ *
+ * Starting from @c sescmd, the history is walked backwards and all commands
+ * that overwrite the same session state as @c sescmd are removed. The walk
+ * stops at the first command whose effects are not known as it could depend
+ * on the state that is being removed.
+ *
+ * @param list    The session command history
+ * @param sescmd  A successfully executed command that is stored in @c list
+ * @param removed If not NULL, the positions of the removed commands are
+ *                appended to this vector
+ *
+ * @return Number of commands removed from @c list
+ */
+size_t compact_session_commands(SessionCommandList& list, const SSessionCommand& sescmd,
+                                std::vector<uint64_t>* removed = NULL);
+
 }
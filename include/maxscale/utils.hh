@@ -213,6 +213,7 @@ class Registry
 public:
     typedef typename RegistryTraits<EntryType>::id_type id_type;
     typedef typename RegistryTraits<EntryType>::entry_type entry_type;
+    typedef typename std::tr1::unordered_map<id_type, entry_type>::const_iterator const_iterator;
 
     Registry()
     {
@@ -263,6 +264,25 @@ public:
         return rval;
     }
 
+    /**
+     * The entries of the registry, in no particular order. The iterators
+     * are invalidated when entries are added or removed.
+     *
+     * @return Iterator to the first entry.
+     */
+    const_iterator begin() const
+    {
+        return m_registry.begin();
+    }
+
+    /**
+     * @return Iterator past the last entry.
+     */
+    const_iterator end() const
+    {
+        return m_registry.end();
+    }
+
 private:
     typedef typename std::tr1::unordered_map<id_type, entry_type> ContainerType;
     ContainerType m_registry;
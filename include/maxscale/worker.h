@@ -16,6 +16,7 @@
 #include <maxscale/poll.h>
 #include <maxscale/thread.h>
 #include <maxscale/jansson.h>
+#include <maxscale/worker_timer.h>
 
 MXS_BEGIN_DECLS
 
@@ -118,8 +119,9 @@ bool mxs_worker_post_message(MXS_WORKER* worker, uint32_t msg_id, intptr_t arg1,
 size_t mxs_worker_broadcast_message(uint32_t msg_id, intptr_t arg1, intptr_t arg2);
 
 /**
- * Add a session to the current worker's session container. Currently only
- * required for some special commands e.g. "KILL <process_id>" to work.
+ * Add a session to the current worker's session container. Client sessions
+ * are added by the core once their client DCB is handled by a worker, so
+ * this is only needed for sessions that the core does not know about.
  *
  * @param session Session to add.
  * @return true if successful, false if id already existed in map.
@@ -143,6 +145,17 @@ bool mxs_worker_deregister_session(uint64_t id);
  */
 MXS_SESSION* mxs_worker_find_session(uint64_t id);
 
+/**
+ * Find the worker whose session container contains a session. Only that
+ * worker may access the session, e.g. using @c mxs_worker_find_session.
+ *
+ * @param id Which id to find.
+ * @return The id of the worker or -1 if not found.
+ *
+ * @note This function can be called from any thread.
+ */
+int mxs_worker_find_session_owner(uint64_t id);
+
 /**
  * @brief Convert a worker to JSON format
  *
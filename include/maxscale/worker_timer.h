@@ -0,0 +1,99 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file include/maxscale/worker_timer.h  Timers of the workers
+ */
+
+#include <maxscale/cdefs.h>
+
+MXS_BEGIN_DECLS
+
+struct mxs_worker_timer;
+
+/**
+ * Pointer to function that is called when a timer expires. When it is
+ * called, the timer is no longer active and it may be added again.
+ *
+ * @param timer  The timer that expired.
+ */
+typedef void (*mxs_worker_timer_cb_t)(struct mxs_worker_timer* timer);
+
+/**
+ * A timer of a worker. The structure is embedded in the data it concerns,
+ * e.g. in a DCB, so that adding and cancelling a timer never allocates.
+ *
+ * A timer is always handled by the worker it was added on, and it must
+ * only be added and cancelled by that worker.
+ */
+typedef struct mxs_worker_timer
+{
+    mxs_worker_timer_cb_t     callback; /*< Called when the timer expires. */
+    void                     *data;     /*< Data for the callback. */
+    uint64_t                  expires;  /*< When the timer expires, in worker milliseconds. */
+    struct mxs_worker_timer  *prev;     /*< Previous timer in the same slot. */
+    struct mxs_worker_timer  *next;     /*< Next timer in the same slot. */
+    struct mxs_worker_timer **slot;     /*< The slot of the timer, NULL if not active. */
+} MXS_WORKER_TIMER;
+
+/**
+ * Initialize a timer.
+ *
+ * @param timer     The timer.
+ * @param callback  The function to call when the timer expires.
+ * @param data      Data for the callback.
+ */
+void mxs_worker_timer_init(MXS_WORKER_TIMER* timer, mxs_worker_timer_cb_t callback, void* data);
+
+/**
+ * Whether a timer is active, that is, has been added but has not expired
+ * or been cancelled.
+ *
+ * @param timer  The timer.
+ *
+ * @return True, if the timer is active.
+ */
+static inline bool mxs_worker_timer_is_active(const MXS_WORKER_TIMER* timer)
+{
+    return timer->slot != NULL;
+}
+
+/**
+ * Add a timer to the current worker. If the timer is already active, it
+ * is rescheduled.
+ *
+ * @param timer     The timer.
+ * @param delay_ms  After how many milliseconds the timer should expire.
+ *
+ * @attention Must be called from a worker thread.
+ */
+void mxs_worker_timer_add(MXS_WORKER_TIMER* timer, uint32_t delay_ms);
+
+/**
+ * Cancel a timer. Cancelling a timer that is not active has no effect.
+ *
+ * @param timer  The timer.
+ *
+ * @attention Must be called from the worker thread the timer was added on.
+ */
+void mxs_worker_timer_cancel(MXS_WORKER_TIMER* timer);
+
+/**
+ * The current time on the clock the timers are advanced by.
+ *
+ * @return Monotonic time in milliseconds.
+ */
+uint64_t mxs_worker_timer_now(void);
+
+MXS_END_DECLS
@@ -16,6 +16,7 @@
  */
 #include "internal/admin.hh"
 
+#include <algorithm>
 #include <climits>
 #include <new>
 #include <fstream>
@@ -90,6 +91,82 @@ static void send_auth_error(MHD_Connection *connection)
     MHD_destroy_response(resp);
 }
 
+/**
+ * The state of a response body that is sent one part at a time
+ */
+struct BodyReader
+{
+    BodyReader(SBodyParts parts):
+        parts(parts),
+        part(0),
+        offset(0)
+    {
+    }
+
+    SBodyParts parts;  /**< The parts of the body */
+    size_t     part;   /**< The part being sent */
+    size_t     offset; /**< How much of the part has been sent */
+};
+
+static ssize_t read_body(void *cls, uint64_t pos, char *buf, size_t max)
+{
+    BodyReader* reader = static_cast<BodyReader*>(cls);
+    const BodyParts& parts = *reader->parts;
+    size_t n = 0;
+
+    while (n < max && reader->part < parts.size())
+    {
+        const string& part = parts[reader->part];
+        size_t len = std::min(part.size() - reader->offset, max - n);
+
+        memcpy(buf + n, part.data() + reader->offset, len);
+        n += len;
+        reader->offset += len;
+
+        if (reader->offset == part.size())
+        {
+            ++reader->part;
+            reader->offset = 0;
+        }
+    }
+
+    return n ? n : MHD_CONTENT_READER_END_OF_STREAM;
+}
+
+static void free_body(void *cls)
+{
+    delete static_cast<BodyReader*>(cls);
+}
+
+/**
+ * Create a response whose body is copied to the connection directly from
+ * the parts, as the connection can take it.
+ *
+ * @param parts The parts of the response body
+ *
+ * @return The response
+ */
+static MHD_Response* create_streamed_response(SBodyParts parts)
+{
+    uint64_t size = 0;
+
+    for (BodyParts::const_iterator it = parts->begin(); it != parts->end(); it++)
+    {
+        size += it->size();
+    }
+
+    BodyReader* reader = new BodyReader(parts);
+    MHD_Response* response = MHD_create_response_from_callback(size, 32 * 1024, read_body,
+                                                                reader, free_body);
+
+    if (!response)
+    {
+        delete reader;
+    }
+
+    return response;
+}
+
 int Client::process(string url, string method, const char* upload_data, size_t *upload_size)
 {
     json_t* json = NULL;
@@ -136,20 +213,15 @@ int Client::process(string url, string method, const char* upload_data, size_t *
 
     if (js)
     {
-        int flags = 0;
-        string pretty = request.get_option("pretty");
-
-        if (pretty == "true" || pretty.length() == 0)
-        {
-            flags |= JSON_INDENT(4);
-        }
-
-        data = mxs::json_dump(js, flags);
+        data = mxs::json_dump(js, request.get_json_flags());
     }
 
-    MHD_Response *response =
-        MHD_create_response_from_buffer(data.size(), (void*)data.c_str(),
-                                        MHD_RESPMEM_MUST_COPY);
+    SBodyParts parts = reply.get_body_parts();
+
+    MHD_Response *response = parts ?
+                             create_streamed_response(parts) :
+                             MHD_create_response_from_buffer(data.size(), (void*)data.c_str(),
+                                                             MHD_RESPMEM_MUST_COPY);
 
     const Headers& headers = reply.get_headers();
 
@@ -78,6 +78,13 @@ void Backend::close(close_type type)
     }
 }
 
+void Backend::release()
+{
+    ss_dassert(in_use() && !is_waiting_result() && !session_command_count());
+    m_dcb->flags |= DCBF_POOLABLE;
+    close();
+}
+
 bool Backend::execute_session_command()
 {
     if (is_closed() || !session_command_count())
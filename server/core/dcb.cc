@@ -37,12 +37,13 @@
 #include <sys/stat.h>
 #include <sys/un.h>
 #include <time.h>
+#include <string>
+#include <vector>
 
 #include <maxscale/alloc.h>
 #include <maxscale/atomic.h>
 #include <maxscale/atomic.h>
 #include <maxscale/hashtable.h>
-#include <maxscale/hk_heartbeat.h>
 #include <maxscale/limits.h>
 #include <maxscale/listener.h>
 #include <maxscale/log_manager.h>
@@ -57,13 +58,17 @@
 #include <maxscale/semaphore.hh>
 
 #include "internal/modules.h"
+#include "internal/persistentpool.hh"
 #include "internal/session.h"
 #include "internal/worker.hh"
 #include "internal/workertask.hh"
 
+using maxscale::PersistentPool;
 using maxscale::Worker;
 using maxscale::WorkerTask;
 using maxscale::Semaphore;
+using std::string;
+using std::vector;
 
 //#define DCB_LOG_EVENT_HANDLING
 #if defined(DCB_LOG_EVENT_HANDLING)
@@ -79,12 +84,10 @@ static struct
 {
     DCB dcb_initialized; /** A DCB with null values, used for initialization. */
     DCB** all_dcbs;      /** #workers sized array of pointers to DCBs where dcbs are listed. */
-    bool check_timeouts; /** Should session timeouts be checked. */
 } this_unit;
 
 static thread_local struct
 {
-    long next_timeout_check; /** When to next check for idle sessions. */
     DCB* current_dcb;        /** The DCB currently being handled by event handlers. */
 } this_thread;
 
@@ -98,6 +101,7 @@ static int  dcb_null_auth(DCB *dcb, SERVER *server, MXS_SESSION *session, GWBUF
 static inline DCB * dcb_find_in_list(DCB *dcb);
 static void dcb_stop_polling_and_shutdown (DCB *dcb);
 static bool dcb_maybe_add_persistent(DCB *);
+static void dcb_start_idle_timer(DCB *dcb);
 static inline bool dcb_write_parameter_check(DCB *dcb, GWBUF *queue);
 static int dcb_bytes_readable(DCB *dcb);
 static int dcb_read_no_bytes_available(DCB *dcb, int nreadtotal);
@@ -195,7 +199,7 @@ dcb_alloc(dcb_role_t role, SERV_LISTENER *listener)
     dcb_initialize(newdcb);
     newdcb->dcb_role = role;
     newdcb->listener = listener;
-    newdcb->last_read = hkheartbeat;
+    newdcb->last_read = mxs_worker_timer_now();
 
     if (role == DCB_ROLE_SERVICE_LISTENER)
     {
@@ -400,13 +404,19 @@ dcb_connect(SERVER *server, MXS_SESSION *session, const char *protocol)
             MXS_DEBUG("Reusing a persistent connection, dcb %p", dcb);
             dcb->persistentstart = 0;
             dcb->was_persistent = true;
-            dcb->last_read = hkheartbeat;
+            dcb->flags &= ~DCBF_POOLABLE;
+            dcb->last_read = mxs_worker_timer_now();
             atomic_add_uint64(&server->stats.n_from_pool, 1);
             return dcb;
         }
         else
         {
             MXS_DEBUG("Failed to find a reusable persistent connection");
+
+            if (server->persistpoolmax)
+            {
+                atomic_add_uint64(&server->stats.n_new_conn, 1);
+            }
         }
     }
 
@@ -584,7 +594,7 @@ int dcb_read(DCB   *dcb,
         else
         {
             GWBUF *buffer;
-            dcb->last_read = hkheartbeat;
+            dcb->last_read = mxs_worker_timer_now();
 
             buffer = dcb_basic_read(dcb, bytes_available, maxbytes, nreadtotal, &nsingleread);
             if (buffer)
@@ -738,7 +748,7 @@ dcb_read_SSL(DCB *dcb, GWBUF **head)
         dcb_drain_writeq(dcb);
     }
 
-    dcb->last_read = hkheartbeat;
+    dcb->last_read = mxs_worker_timer_now();
     buffer = dcb_basic_read_SSL(dcb, &nsingleread);
     if (buffer)
     {
@@ -747,7 +757,7 @@ dcb_read_SSL(DCB *dcb, GWBUF **head)
 
         while (buffer)
         {
-            dcb->last_read = hkheartbeat;
+            dcb->last_read = mxs_worker_timer_now();
             buffer = dcb_basic_read_SSL(dcb, &nsingleread);
             if (buffer)
             {
@@ -1215,6 +1225,11 @@ void dcb_final_close(DCB* dcb)
             {
                 atomic_add(&dcb->service->client_count, -1);
             }
+
+            if (dcb->session)
+            {
+                Worker::get(dcb->poll.thread.id)->deregister_session(dcb->session->ses_id);
+            }
         }
 
         if (dcb->server)
@@ -1273,12 +1288,12 @@ dcb_maybe_add_persistent(DCB *dcb)
         && strlen(dcb->user)
         && dcb->server
         && dcb->session
-        && session_valid_for_pool(dcb->session)
+        && ((dcb->flags & DCBF_POOLABLE) || session_valid_for_pool(dcb->session))
         && dcb->server->persistpoolmax
         && (dcb->server->status & SERVER_RUNNING)
         && !dcb->dcb_errhandle_called
         && !(dcb->flags & DCBF_HUNG)
-        && dcb_persistent_clean_count(dcb, dcb->poll.thread.id, false) < dcb->server->persistpoolmax
+        && dcb_persistent_clean_count(dcb->server, dcb->poll.thread.id, false) < dcb->server->persistpoolmax
         && dcb->server->stats.n_persistent < dcb->server->persistpoolmax)
     {
         DCB_CALLBACK *loopcallback;
@@ -1315,8 +1330,7 @@ dcb_maybe_add_persistent(DCB *dcb)
         dcb->delayq = NULL;
         dcb->writeq = NULL;
 
-        dcb->nextpersistent = dcb->server->persistent[dcb->poll.thread.id];
-        dcb->server->persistent[dcb->poll.thread.id] = dcb;
+        PersistentPool::get(dcb->server, dcb->poll.thread.id).add(dcb);
         atomic_add(&dcb->server->stats.n_persistent, 1);
         atomic_add(&dcb->server->stats.n_current, -1);
         return true;
@@ -1511,7 +1525,7 @@ static bool dprint_all_dcbs_cb(DCB *dcb, void *data)
  */
 void dprintAllDCBs(DCB *pdcb)
 {
-    dcb_foreach(dprint_all_dcbs_cb, pdcb);
+    dcb_foreach_print(pdcb, dprint_all_dcbs_cb);
 }
 
 static bool dlist_dcbs_cb(DCB *dcb, void *data)
@@ -1537,7 +1551,7 @@ dListDCBs(DCB *pdcb)
     dcb_printf(pdcb, " %-16s | %-26s | %-18s | %s\n",
                "DCB", "State", "Service", "Remote");
     dcb_printf(pdcb, "------------------+----------------------------+--------------------+----------\n");
-    dcb_foreach(dlist_dcbs_cb, pdcb);
+    dcb_foreach_print(pdcb, dlist_dcbs_cb);
     dcb_printf(pdcb, "------------------+----------------------------+--------------------+----------\n\n");
 }
 
@@ -1570,7 +1584,7 @@ dListClients(DCB *pdcb)
     dcb_printf(pdcb, " %-15s | %-16s | %-20s | %s\n",
                "Client", "DCB", "Service", "Session");
     dcb_printf(pdcb, "-----------------+------------------+----------------------+------------\n");
-    dcb_foreach(dlist_clients_cb, pdcb);
+    dcb_foreach_print(pdcb, dlist_clients_cb);
     dcb_printf(pdcb, "-----------------+------------------+----------------------+------------\n\n");
 }
 
@@ -2028,75 +2042,81 @@ dcb_hangup_foreach(struct server* server)
 /**
  * Check persistent pool for expiry or excess size and count
  *
- * @param dcb           The DCB being closed.
+ * The pool is ordered by the time the DCBs were added to it, so only the
+ * oldest DCBs need to be looked at.
+ *
+ * @param server        The server whose pool should be cleaned
  * @param id            Thread ID
  * @param cleanall      Boolean, if true the whole pool is cleared for the
- *                      server related to the given DCB
+ *                      given server
  * @return              A count of the DCBs remaining in the pool
  */
 int
-dcb_persistent_clean_count(DCB *dcb, int id, bool cleanall)
+dcb_persistent_clean_count(SERVER *server, int id, bool cleanall)
 {
     int count = 0;
-    if (dcb && dcb->server)
+    if (server && server->persistent)
     {
-        SERVER *server = dcb->server;
-        DCB *previousdcb = NULL;
-        DCB *persistentdcb, *nextdcb;
+        CHK_SERVER(server);
+        PersistentPool& pool = PersistentPool::get(server, id);
+
+        if (!(server->status & SERVER_RUNNING))
+        {
+            cleanall = true;
+        }
+
+        time_t now = time(NULL);
         DCB *disposals = NULL;
+        DCB *persistentdcb;
 
-        CHK_SERVER(server);
-        persistentdcb = server->persistent[id];
-        while (persistentdcb)
+        while ((persistentdcb = pool.oldest()) != NULL)
         {
             CHK_DCB(persistentdcb);
-            nextdcb = persistentdcb->nextpersistent;
             if (cleanall
-                || persistentdcb-> dcb_errhandle_called
-                || count >= server->persistpoolmax
-                || persistentdcb->server == NULL
-                || !(persistentdcb->server->status & SERVER_RUNNING)
-                || (time(NULL) - persistentdcb->persistentstart) > server->persistmaxtime)
+                || persistentdcb->dcb_errhandle_called
+                || (long)pool.size() > server->persistpoolmax
+                || (now - persistentdcb->persistentstart) > server->persistmaxtime)
             {
-                /* Remove from persistent pool */
-                if (previousdcb)
-                {
-                    previousdcb->nextpersistent = nextdcb;
-                }
-                else
-                {
-                    server->persistent[id] = nextdcb;
-                }
-                /* Add removed DCBs to disposal list for processing outside spinlock */
-                persistentdcb->nextpersistent = disposals;
+                /* Remove from persistent pool and close once the pool is consistent */
+                pool.remove(persistentdcb);
+                persistentdcb->pool.next = disposals;
                 disposals = persistentdcb;
                 atomic_add(&server->stats.n_persistent, -1);
+                atomic_add_uint64(&server->stats.n_pool_expired, 1);
             }
             else
             {
-                count++;
-                previousdcb = persistentdcb;
+                /* The remaining ones have been in the pool for a shorter time */
+                break;
             }
-            persistentdcb = nextdcb;
         }
+
+        count = pool.size();
         server->persistmax = MXS_MAX(server->persistmax, count);
 
         /** Call possible callback for this DCB in case of close */
         while (disposals)
         {
-            nextdcb = disposals->nextpersistent;
-            disposals->persistentstart = -1;
-            if (DCB_STATE_POLLING == disposals->state)
-            {
-                dcb_stop_polling_and_shutdown(disposals);
-            }
-            dcb_close(disposals);
+            DCB *nextdcb = disposals->pool.next;
+            disposals->pool.next = NULL;
+            dcb_persistent_dispose(disposals);
             disposals = nextdcb;
         }
     }
     return count;
 }
 
+void
+dcb_persistent_dispose(DCB *dcb)
+{
+    dcb->persistentstart = -1;
+    if (DCB_STATE_POLLING == dcb->state)
+    {
+        dcb_stop_polling_and_shutdown(dcb);
+    }
+    dcb_close(dcb);
+}
+
 struct dcb_usage_count
 {
     int count;
@@ -2151,13 +2171,27 @@ bool count_by_usage_cb(DCB *dcb, void *data)
 int
 dcb_count_by_usage(DCB_USAGE usage)
 {
-    struct dcb_usage_count val = {};
-    val.count = 0;
-    val.type = usage;
+    int nthr = config_threadcount();
+    vector<dcb_usage_count> vals(nthr);
+    vector<void*> data(nthr);
+
+    for (int i = 0; i < nthr; i++)
+    {
+        vals[i].count = 0;
+        vals[i].type = usage;
+        data[i] = &vals[i];
+    }
+
+    dcb_foreach_parallel(count_by_usage_cb, &data[0]);
 
-    dcb_foreach(count_by_usage_cb, &val);
+    int count = 0;
+
+    for (int i = 0; i < nthr; i++)
+    {
+        count += vals[i].count;
+    }
 
-    return val.count;
+    return count;
 }
 
 /**
@@ -2765,6 +2799,17 @@ static void dcb_add_to_list(DCB *dcb)
 
         ss_dassert(dcb->poll.thread.id == Worker::get_current_id());
 
+        if (dcb->dcb_role == DCB_ROLE_CLIENT_HANDLER)
+        {
+            dcb_start_idle_timer(dcb);
+
+            if (dcb->session && dcb->session->state == SESSION_STATE_ROUTER_READY)
+            {
+                // The session was created before the DCB was given to this worker.
+                Worker::get_current()->register_session(dcb->session);
+            }
+        }
+
         if (this_unit.all_dcbs[dcb->poll.thread.id] == NULL)
         {
             this_unit.all_dcbs[dcb->poll.thread.id] = dcb;
@@ -2785,6 +2830,8 @@ static void dcb_add_to_list(DCB *dcb)
  */
 static void dcb_remove_from_list(DCB *dcb)
 {
+    mxs_worker_timer_cancel(&dcb->idle_timer);
+
     if (dcb->dcb_role != DCB_ROLE_SERVICE_LISTENER)
     {
         if (dcb == this_unit.all_dcbs[dcb->poll.thread.id])
@@ -2829,52 +2876,113 @@ static void dcb_remove_from_list(DCB *dcb)
 }
 
 /**
- * Enable the timing out of idle connections.
+ * Called when the idle timer of a client DCB expires.
+ *
+ * If the time since the client last sent data is greater than the connection
+ * timeout of the service, the client is disconnected. Otherwise the timer is
+ * restarted for the remaining time.
+ *
+ * @param timer  The idle timer of the DCB.
  */
-void dcb_enable_session_timeouts()
+static void dcb_idle_timer_expired(MXS_WORKER_TIMER *timer)
 {
-    this_unit.check_timeouts = true;
+    DCB *dcb = (DCB*)timer->data;
+    ss_dassert(dcb->listener);
+    SERVICE *service = dcb->listener->service;
+
+    if (service->conn_idle_timeout && dcb->state == DCB_STATE_POLLING)
+    {
+        int64_t idle = mxs_worker_timer_now() - dcb->last_read;
+        int64_t timeout = service->conn_idle_timeout * 1000;
+
+        if (idle >= timeout)
+        {
+            MXS_WARNING("Timing out '%s'@%s, idle for %.1f seconds",
+                        dcb->user ? dcb->user : "<unknown>",
+                        dcb->remote ? dcb->remote : "<unknown>",
+                        (float)idle / 1000.f);
+            dcb->session->close_reason = SESSION_CLOSE_TIMEOUT;
+            poll_fake_hangup_event(dcb);
+        }
+        else
+        {
+            dcb_start_idle_timer(dcb);
+        }
+    }
 }
 
 /**
- * Close sessions that have been idle for too long.
+ * Start the idle timer of a client DCB, or cancel it if the service has no
+ * connection timeout. The timer is not moved whenever the client sends data,
+ * but only when it expires, so reading costs nothing extra.
  *
- * If the time since a session last sent data is greater than the set value in the
- * service, it is disconnected. The connection timeout is disabled by default.
+ * @param dcb  A client DCB, owned by the current worker.
  */
-void dcb_process_idle_sessions(int thr)
+static void dcb_start_idle_timer(DCB *dcb)
 {
-    if (this_unit.check_timeouts && hkheartbeat >= this_thread.next_timeout_check)
+    ss_dassert(dcb->dcb_role == DCB_ROLE_CLIENT_HANDLER);
+    ss_dassert(dcb->listener);
+    SERVICE *service = dcb->listener->service;
+
+    if (!mxs_worker_timer_is_active(&dcb->idle_timer))
     {
-        /** Because the resolution of the timeout is one second, we only need to
-         * check for it once per second. One heartbeat is 100 milliseconds. */
-        this_thread.next_timeout_check = hkheartbeat + 10;
+        mxs_worker_timer_init(&dcb->idle_timer, dcb_idle_timer_expired, dcb);
+    }
 
-        for (DCB *dcb = this_unit.all_dcbs[thr]; dcb; dcb = dcb->thread.next)
-        {
-            if (dcb->dcb_role == DCB_ROLE_CLIENT_HANDLER)
-            {
-                ss_dassert(dcb->listener);
-                SERVICE *service = dcb->listener->service;
+    if (service->conn_idle_timeout)
+    {
+        /** The last read is on the same clock as the timers. */
+        int64_t idle = mxs_worker_timer_now() - dcb->last_read;
+        int64_t timeout = service->conn_idle_timeout * 1000;
+        int64_t remaining = idle < timeout ? timeout - idle : 0;
 
-                if (service->conn_idle_timeout && dcb->state == DCB_STATE_POLLING)
-                {
-                    int64_t idle = hkheartbeat - dcb->last_read;
-                    int64_t timeout = service->conn_idle_timeout * 10;
+        mxs_worker_timer_add(&dcb->idle_timer, remaining);
+    }
+    else
+    {
+        mxs_worker_timer_cancel(&dcb->idle_timer);
+    }
+}
 
-                    if (idle > timeout)
-                    {
-                        MXS_WARNING("Timing out '%s'@%s, idle for %.1f seconds",
-                                    dcb->user ? dcb->user : "<unknown>",
-                                    dcb->remote ? dcb->remote : "<unknown>",
-                                    (float)idle / 10.f);
-                        dcb->session->close_reason = SESSION_CLOSE_TIMEOUT;
-                        poll_fake_hangup_event(dcb);
-                    }
-                }
+/** Task for applying a changed connection timeout to the DCBs of a worker */
+class UpdateIdleTimeouts : public mxs::WorkerDisposableTask
+{
+public:
+    UpdateIdleTimeouts(SERVICE* service)
+        : m_service(service)
+    {
+    }
+
+    void execute(Worker& worker)
+    {
+        for (DCB *dcb = this_unit.all_dcbs[worker.id()]; dcb; dcb = dcb->thread.next)
+        {
+            if (dcb->dcb_role == DCB_ROLE_CLIENT_HANDLER &&
+                dcb->state == DCB_STATE_POLLING &&
+                dcb->listener->service == m_service)
+            {
+                dcb_start_idle_timer(dcb);
             }
         }
     }
+
+private:
+    SERVICE* m_service;
+};
+
+void dcb_update_idle_timeouts(SERVICE *service)
+{
+    std::auto_ptr<UpdateIdleTimeouts> task(new (std::nothrow) UpdateIdleTimeouts(service));
+
+    if (task.get())
+    {
+        // Before the workers have been started there are no DCBs to update.
+        Worker::broadcast(task);
+    }
+    else
+    {
+        MXS_OOM();
+    }
 }
 
 /** Helper class for serial iteration over all DCBs */
@@ -2929,6 +3037,105 @@ bool dcb_foreach(bool(*func)(DCB *dcb, void *data), void *data)
     return task.more();
 }
 
+/** Helper class for concurrent iteration over all DCBs */
+class ParallelDcbTask : public WorkerTask
+{
+public:
+
+    ParallelDcbTask(bool(*func)(DCB *, void *), void **data):
+        m_func(func),
+        m_data(data),
+        m_more(1)
+    {
+    }
+
+    void execute(Worker& worker)
+    {
+        int thread_id = worker.id();
+
+        for (DCB *dcb = this_unit.all_dcbs[thread_id];
+             dcb && atomic_load_int32(&m_more);
+             dcb = dcb->thread.next)
+        {
+            ss_dassert(dcb->session);
+
+            if (dcb->session->state != SESSION_STATE_DUMMY)
+            {
+                if (!m_func(dcb, m_data[thread_id]))
+                {
+                    atomic_store_int32(&m_more, 0);
+                    break;
+                }
+            }
+        }
+    }
+
+    bool more() const
+    {
+        return m_more;
+    }
+
+private:
+    bool(*m_func)(DCB *dcb, void *data);
+    void** m_data;
+    int m_more;
+};
+
+bool dcb_foreach_parallel(bool(*func)(DCB *dcb, void *data), void **data)
+{
+    ParallelDcbTask task(func, data);
+    Worker::execute_concurrently(task);
+    return task.more();
+}
+
+/**
+ * Write function of the DCBs that dcb_foreach_print() gives to the workers.
+ * The data is appended to the string of the DCB.
+ */
+static int dcb_print_buffer_write(DCB *dcb, GWBUF *buf)
+{
+    string* output = static_cast<string*>(dcb->data);
+
+    for (GWBUF* b = buf; b; b = b->next)
+    {
+        output->append((const char*)GWBUF_DATA(b), GWBUF_LENGTH(b));
+    }
+
+    gwbuf_free(buf);
+    return 1;
+}
+
+void dcb_foreach_print(DCB *pdcb, bool(*func)(DCB *dcb, void *data))
+{
+    int nthr = config_threadcount();
+    vector<string> outputs(nthr);
+    vector<DCB> dcbs(nthr, this_unit.dcb_initialized);
+    vector<void*> data(nthr);
+
+    for (int i = 0; i < nthr; i++)
+    {
+        dcbs[i].dcb_role = DCB_ROLE_INTERNAL;
+        dcbs[i].func.write = dcb_print_buffer_write;
+        dcbs[i].data = &outputs[i];
+        data[i] = &dcbs[i];
+    }
+
+    dcb_foreach_parallel(func, &data[0]);
+
+    for (int i = 0; i < nthr; i++)
+    {
+        if (!outputs[i].empty())
+        {
+            GWBUF *buf = gwbuf_alloc_and_load(outputs[i].length(), outputs[i].data());
+
+            if (buf)
+            {
+                pdcb->func.write(pdcb, buf);
+            }
+        }
+    }
+}
+
 void dcb_foreach_local(bool(*func)(DCB *dcb, void *data), void *data)
 {
     int thread_id = Worker::get_current_id();
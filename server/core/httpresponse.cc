@@ -37,8 +37,19 @@ HttpResponse::HttpResponse(int code, json_t* response):
     }
 }
 
+HttpResponse::HttpResponse(int code, SBodyParts parts):
+    m_body(NULL),
+    m_parts(parts),
+    m_code(code)
+{
+    string http_date = http_get_date();
+    add_header(HTTP_RESPONSE_HEADER_DATE, http_date);
+    add_header(HTTP_RESPONSE_HEADER_CONTENT_TYPE, "application/json");
+}
+
 HttpResponse::HttpResponse(const HttpResponse& response):
     m_body(json_incref(response.m_body)),
+    m_parts(response.m_parts),
     m_code(response.m_code),
     m_headers(response.m_headers)
 {
@@ -48,6 +59,7 @@ HttpResponse& HttpResponse::operator=(const HttpResponse& response)
 {
     json_t* body = m_body;
     m_body = json_incref(response.m_body);
+    m_parts = response.m_parts;
     m_code = response.m_code;
     m_headers = response.m_headers;
     json_decref(body);
@@ -67,10 +79,16 @@ json_t* HttpResponse::get_response() const
     return m_body;
 }
 
+SBodyParts HttpResponse::get_body_parts() const
+{
+    return m_parts;
+}
+
 void HttpResponse::drop_response()
 {
     json_decref(m_body);
     m_body = NULL;
+    m_parts.reset();
 }
 
 int HttpResponse::get_code() const
@@ -19,4 +19,24 @@ MXS_BEGIN_DECLS
 void dcb_free_all_memory(DCB *dcb);
 void dcb_final_close(DCB *dcb);
 
+/**
+ * Close a DCB that has been removed from the persistent pool of its server.
+ *
+ * @param dcb  The DCB to close.
+ */
+void dcb_persistent_dispose(DCB *dcb);
+
+/**
+ * Call a function for each connected DCB, concurrently on all workers, and
+ * print to a DCB what the function prints.
+ *
+ * The function is given a worker specific DCB to print to, using dcb_printf(),
+ * instead of @c pdcb. Once all workers are done, what was printed on each
+ * worker is written to @c pdcb in the order of the workers.
+ *
+ * @param pdcb  The DCB to print to.
+ * @param func  The function to call, see dcb_foreach_parallel().
+ */
+void dcb_foreach_print(DCB *pdcb, bool (*func)(DCB *dcb, void *data));
+
 MXS_END_DECLS
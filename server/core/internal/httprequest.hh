@@ -135,6 +135,18 @@ public:
         return p.second;
     }
 
+    /**
+     * @brief Get the flags with which the JSON of the response is serialized
+     *
+     * @return JSON_INDENT(4) unless the `pretty` option is false, 0 otherwise
+     */
+    int get_json_flags() const
+    {
+        std::string pretty = get_option("pretty");
+
+        return (pretty == "true" || pretty.length() == 0) ? JSON_INDENT(4) : 0;
+    }
+
     /**
      * @brief Get request option count
      *
@@ -16,6 +16,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include <tr1/memory>
 #include <microhttpd.h>
 
@@ -32,6 +33,8 @@
 #define HTTP_RESPONSE_HEADER_CONTENT_TYPE  "Content-Type"
 
 typedef std::map<std::string, std::string> Headers;
+typedef std::vector<std::string> BodyParts;
+typedef std::tr1::shared_ptr<BodyParts> SBodyParts;
 
 class HttpResponse
 {
@@ -43,6 +46,18 @@ public:
      * @param code     HTTP return code
      */
     HttpResponse(int code = MHD_HTTP_OK, json_t* response = NULL);
+
+    /**
+     * @brief Create new HTTP response with an already serialized body
+     *
+     * The body is sent one part at a time, so that a large response is
+     * never copied into one contiguous buffer.
+     *
+     * @param code  HTTP return code
+     * @param parts The parts of the JSON response body, in order
+     */
+    HttpResponse(int code, SBodyParts parts);
+
     HttpResponse(const HttpResponse& response);
     HttpResponse& operator = (const HttpResponse& response);
 
@@ -55,6 +70,14 @@ public:
      */
     json_t* get_response() const;
 
+    /**
+     * @brief Get the serialized response body
+     *
+     * @return The parts of the response body, or an empty pointer if the
+     *         body is not serialized
+     */
+    SBodyParts get_body_parts() const;
+
     /**
      * @brief Drop response body
      *
@@ -85,7 +108,8 @@ public:
     const Headers& get_headers() const;
 
 private:
-    json_t* m_body;    /**< Message body */
-    int     m_code;    /**< The HTTP code for the response */
-    Headers m_headers; /**< Extra headers */
+    json_t*    m_body;    /**< Message body */
+    SBodyParts m_parts;   /**< Serialized message body */
+    int        m_code;    /**< The HTTP code for the response */
+    Headers    m_headers; /**< Extra headers */
 };
@@ -0,0 +1,149 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <maxscale/jansson.hh>
+
+namespace maxscale
+{
+
+/**
+ * A LatencyHistogram records durations in microseconds.
+ *
+ * The buckets are log-linear, as in an HDR histogram: each power of two is
+ * divided into 16 equally wide buckets, so the width of a bucket is at most
+ * 1/16th of the values it contains. Values below 32 microseconds have a
+ * bucket of their own, and values of 2^32 microseconds (~71 minutes) or
+ * more end up in the last bucket.
+ *
+ * Recording a value only increments a counter, so a LatencyHistogram can be
+ * used on the hot path. It is not thread safe; it is intended to be updated
+ * by the thread that owns it.
+ *
+ * A LatencyHistogram is trivial so that it can be a member of structures
+ * that are initialized with memset(). It must be value-initialized, i.e.
+ * created using @c LatencyHistogram(), to start out empty.
+ */
+class LatencyHistogram
+{
+public:
+    enum
+    {
+        SUB_BUCKET_BITS = 4,
+        SUB_BUCKETS     = 1 << SUB_BUCKET_BITS,
+        MAX_VALUE_BITS  = 32,
+        N_BUCKETS       = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+    };
+
+    /**
+     * Record a duration.
+     *
+     * @param us  The duration in microseconds.
+     */
+    void record(uint64_t us)
+    {
+        ++m_buckets[index_of(us)];
+
+        if (us > m_max)
+        {
+            m_max = us;
+        }
+    }
+
+    /**
+     * Add the counts of another histogram to this one. The other histogram
+     * may be updated concurrently, in which case the result is approximate.
+     *
+     * @param other  The histogram to add.
+     */
+    void add(const LatencyHistogram& other);
+
+    /**
+     * The number of recorded durations.
+     *
+     * @return The number of durations.
+     */
+    uint64_t count() const;
+
+    /**
+     * The longest recorded duration.
+     *
+     * @return The duration in microseconds.
+     */
+    uint64_t max() const
+    {
+        return m_max;
+    }
+
+    /**
+     * The duration below which a particular percentage of the durations are.
+     * The value is the upper bound of the bucket where the percentile is.
+     *
+     * @param percent  The percentile, between 0 and 100.
+     *
+     * @return The duration in microseconds, 0 if nothing has been recorded.
+     */
+    uint64_t percentile(double percent) const;
+
+    /**
+     * Convert the histogram to JSON. Only the buckets with values are included.
+     *
+     * @return The histogram as a JSON object.
+     */
+    json_t* to_json() const;
+
+    /**
+     * The bucket of a value.
+     *
+     * @param us  The value.
+     *
+     * @return The index of the bucket.
+     */
+    static int index_of(uint64_t us)
+    {
+        if (us >> MAX_VALUE_BITS)
+        {
+            return N_BUCKETS - 1;
+        }
+
+        int msb = 63 - __builtin_clzll(us | 1);
+        int shift = msb > SUB_BUCKET_BITS ? msb - SUB_BUCKET_BITS : 0;
+
+        return shift * SUB_BUCKETS + (int)(us >> shift);
+    }
+
+    /**
+     * The smallest value of a bucket.
+     *
+     * @param index  The index of the bucket.
+     *
+     * @return The smallest value that ends up in the bucket.
+     */
+    static uint64_t lower_bound(int index);
+
+    /**
+     * The largest value of a bucket.
+     *
+     * @param index  The index of the bucket.
+     *
+     * @return The largest value that ends up in the bucket.
+     */
+    static uint64_t upper_bound(int index);
+
+private:
+    uint64_t m_max;                  /*< The longest recorded duration. */
+    uint64_t m_buckets[N_BUCKETS];   /*< The number of durations in each bucket. */
+};
+
+}
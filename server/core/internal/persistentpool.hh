@@ -0,0 +1,127 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <string>
+#include <tr1/unordered_map>
+#include <maxscale/dcb.h>
+#include <maxscale/server.h>
+
+/**
+ * The base of PersistentPool, declared as an opaque type in server.h.
+ */
+struct server_persistent_pool
+{
+};
+
+namespace maxscale
+{
+
+/**
+ * A PersistentPool contains the unused persistent connections to one server
+ * of one worker.
+ *
+ * The connections are indexed by user, client host and protocol, so that a
+ * matching connection can be taken from the pool in constant time. They are
+ * also kept in the order in which they were added to the pool, so that the
+ * ones that have expired can be found without looking at the others.
+ *
+ * The DCBs are linked using their @c pool member, so adding and removing
+ * a DCB never allocates anything but possibly an index entry.
+ *
+ * A PersistentPool is not thread safe; it is only accessed by the worker
+ * it belongs to.
+ */
+class PersistentPool : public SERVER_PERSISTENT_POOL
+{
+    PersistentPool(const PersistentPool&);
+    PersistentPool& operator = (const PersistentPool&);
+
+public:
+    PersistentPool();
+
+    /**
+     * Get the pool of a server on a worker.
+     *
+     * @param pServer    The server.
+     * @param worker_id  The id of the worker.
+     *
+     * @return The pool.
+     */
+    static PersistentPool& get(const SERVER* pServer, int worker_id)
+    {
+        return *static_cast<PersistentPool*>(pServer->persistent[worker_id]);
+    }
+
+    /**
+     * The number of DCBs in the pool.
+     *
+     * @return The number of DCBs.
+     */
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * The DCB that has been in the pool the longest.
+     *
+     * @return The oldest DCB, or NULL if the pool is empty.
+     */
+    DCB* oldest() const
+    {
+        return m_pOldest;
+    }
+
+    /**
+     * Add a DCB to the pool. The DCB is indexed using its @c user, @c remote
+     * and @c protoname, which must not change while the DCB is in the pool.
+     *
+     * @param pDcb  The DCB to add.
+     */
+    void add(DCB* pDcb);
+
+    /**
+     * Take the most recently added DCB with a particular user, client host
+     * and protocol from the pool.
+     *
+     * @param zUser      The user.
+     * @param zHost      The client host.
+     * @param zProtocol  The protocol.
+     *
+     * @return A DCB that has been removed from the pool, or NULL if there
+     *         was no matching DCB.
+     */
+    DCB* take(const char* zUser, const char* zHost, const char* zProtocol);
+
+    /**
+     * Remove a DCB from the pool.
+     *
+     * @param pDcb  A DCB in the pool.
+     */
+    void remove(DCB* pDcb);
+
+private:
+    typedef std::tr1::unordered_map<std::string, DCB*> Index;
+
+    static std::string key(const char* zUser, const char* zHost, const char* zProtocol);
+
+private:
+    Index  m_index;   /*< The most recently added DCB of each user, host and protocol. */
+    DCB*   m_pNewest; /*< The most recently added DCB. */
+    DCB*   m_pOldest; /*< The least recently added DCB. */
+    size_t m_size;    /*< The number of DCBs. */
+};
+
+}
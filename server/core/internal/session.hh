@@ -13,6 +13,9 @@
  */
 
 #include <maxscale/cppdefs.hh>
+#include <string>
+#include <utility>
+#include <vector>
 #include <maxscale/session.h>
 
 namespace maxscale
@@ -36,4 +39,41 @@ struct RegistryTraits<MXS_SESSION>
     }
 };
 
+/**
+ * Which client sessions to list.
+ */
+struct SessionListFilter
+{
+    SessionListFilter()
+        : worker_id(-1)
+        , after(0)
+        , limit(0)
+    {
+    }
+
+    std::string service;   /*< If not empty, only sessions of this service. */
+    std::string user;      /*< If not empty, only sessions of this user. */
+    int         worker_id; /*< If not -1, only sessions of this worker. */
+    uint64_t    after;     /*< Only sessions whose id is greater than this. */
+    size_t      limit;     /*< If not 0, at most this many sessions. */
+};
+
+/**
+ * Session ids and the corresponding sessions in JSON format.
+ */
+typedef std::vector<std::pair<uint64_t, std::string> > SerializedSessions;
+
+/**
+ * Serialize client sessions to JSON. Each worker concurrently serializes
+ * the matching sessions it owns, so no worker is stalled while the sessions
+ * of the other workers are being processed.
+ *
+ * @param filter  Which sessions to serialize.
+ * @param host    Hostname of this server.
+ * @param flags   Flags for serializing the JSON.
+ *
+ * @return The sessions, in the order of their ids.
+ */
+SerializedSessions session_list_serialize(const SessionListFilter& filter, const char* host, int flags);
+
 }
@@ -0,0 +1,134 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <maxscale/worker_timer.h>
+
+namespace maxscale
+{
+
+/**
+ * A TimerWheel keeps track of timers with a resolution of one millisecond.
+ *
+ * The wheel is hierarchical; it consists of four levels of 256 slots each.
+ * A slot of the first level corresponds to one millisecond, a slot of the
+ * second level to 256 milliseconds, and so on. A timer is placed in the slot
+ * of the lowest level whose range covers its expiration time, and whenever
+ * the first level has gone full circle, the timers of the next slot of the
+ * second level are redistributed, and so on. Consequently, adding and
+ * cancelling a timer are O(1) operations, irrespective of how many timers
+ * there are.
+ *
+ * Timers expiring after more than 2^32 milliseconds (~49 days) expire
+ * after 2^32 - 1 milliseconds.
+ *
+ * A TimerWheel is not thread safe; it is intended to be used by one worker.
+ */
+class TimerWheel
+{
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator = (const TimerWheel&);
+
+public:
+    typedef MXS_WORKER_TIMER Timer;
+
+    enum
+    {
+        LEVEL_BITS = 8,
+        N_LEVELS   = 4,
+        N_SLOTS    = 1 << LEVEL_BITS,
+        SLOT_MASK  = N_SLOTS - 1
+    };
+
+    /**
+     * Constructor
+     *
+     * @param now  The current time, in milliseconds.
+     */
+    TimerWheel(uint64_t now);
+
+    /**
+     * The time of the wheel, i.e. the time up to which it has been advanced.
+     *
+     * @return The time in milliseconds.
+     */
+    uint64_t now() const
+    {
+        return m_next - 1;
+    }
+
+    /**
+     * The number of active timers.
+     *
+     * @return The number of timers.
+     */
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * Add a timer. If the timer is already active, it is rescheduled.
+     *
+     * @param pTimer  The timer.
+     * @param delay   After how many milliseconds, counted from the time of
+     *                the wheel, the timer should expire.
+     */
+    void add(Timer* pTimer, uint64_t delay);
+
+    /**
+     * Cancel a timer. If the timer is not active, nothing is done.
+     *
+     * @param pTimer  The timer.
+     */
+    void cancel(Timer* pTimer);
+
+    /**
+     * Advance the wheel, i.e. call the callbacks of all timers that have
+     * expired. A callback may add and cancel any timers, including the
+     * one being called.
+     *
+     * @param now  The current time, in milliseconds.
+     *
+     * @return The number of expired timers.
+     */
+    size_t advance(uint64_t now);
+
+    /**
+     * How long until the wheel should be advanced the next time. The value
+     * is a lower bound for when the next timer expires; when the wheel is
+     * advanced at that time, it may only be rearranged.
+     *
+     * @param now  The current time, in milliseconds.
+     *
+     * @return The number of milliseconds from @c now, or -1 if there are
+     *         no timers.
+     */
+    int64_t next_timeout(uint64_t now) const;
+
+private:
+    void insert(Timer* pTimer);
+    int  cascade(int level);
+
+    static void link(Timer** ppSlot, Timer* pTimer);
+    static void unlink(Timer* pTimer);
+
+private:
+    uint64_t m_next;                         /*< The next millisecond to process. */
+    size_t   m_size;                         /*< The number of active timers. */
+    Timer*   m_expired;                      /*< The timers being processed. */
+    Timer*   m_slots[N_LEVELS][N_SLOTS];     /*< The slots of the wheel. */
+};
+
+}
@@ -18,11 +18,13 @@
 #include <maxscale/platform.h>
 #include <maxscale/session.h>
 #include <maxscale/utils.hh>
+#include "latencyhistogram.hh"
 #include "messagequeue.hh"
 #include "poll.h"
 #include "worker.h"
 #include "workertask.hh"
 #include "session.hh"
+#include "timerwheel.hh"
 
 namespace maxscale
 {
@@ -54,10 +56,12 @@ struct WORKER_STATISTICS
     int64_t  evq_length;                  /*< Event queue length */
     int64_t  evq_max;                     /*< Maximum event queue length */
     int64_t  blockingpolls;               /*< Number of epoll_waits with a timeout specified */
-    uint32_t qtimes[N_QUEUE_TIMES + 1];
-    uint32_t exectimes[N_QUEUE_TIMES + 1];
-    int64_t  maxqtime;
-    int64_t  maxexectime;
+    uint32_t qtimes[N_QUEUE_TIMES + 1];   /*< Queue times in 100ms units */
+    uint32_t exectimes[N_QUEUE_TIMES + 1];/*< Execution times in 100ms units */
+    int64_t  maxqtime;                    /*< Maximum queue time in 100ms units */
+    int64_t  maxexectime;                 /*< Maximum execution time in 100ms units */
+    LatencyHistogram qtime_histogram;     /*< Queue times in microseconds */
+    LatencyHistogram exectime_histogram;  /*< Execution times in microseconds */
 };
 
 class Worker : public MXS_WORKER
@@ -135,7 +139,9 @@ public:
      *
      * @return The worker specific statistics.
      *
-     * @attentions The statistics may change at any time.
+     * @attentions The statistics may change at any time. They are updated by
+     *             the worker without synchronization, so other threads must
+     *             read them using relaxed atomic loads.
      */
     const STATISTICS& statistics() const
     {
@@ -420,11 +426,84 @@ public:
     bool post_message(uint32_t msg_id, intptr_t arg1, intptr_t arg2);
 
     /**
-     * Return a reference to the session registry of this worker.
+     * Register a session with this worker, so that it can be found by its id.
+     * The client DCB of the session must be handled by this worker.
+     *
+     * @param pSession  The session to register.
+     *
+     * @return True if the session was registered, false if a session with
+     *         the same id already was.
+     *
+     * @attention Must be called from this worker.
+     */
+    bool register_session(MXS_SESSION* pSession);
+
+    /**
+     * Deregister a session from this worker.
+     *
+     * @param id  The id of the session.
+     *
+     * @return True if the session was deregistered, false if it was not found.
+     *
+     * @attention Must be called from this worker.
+     */
+    bool deregister_session(uint64_t id);
+
+    /**
+     * Find a session registered with this worker.
+     *
+     * @param id  The id of the session.
+     *
+     * @return The session, or NULL if it was not found.
+     *
+     * @attention Must be called from this worker.
+     */
+    MXS_SESSION* find_session(uint64_t id) const;
+
+    /**
+     * Return the sessions registered with this worker.
      *
      * @return Session registry.
+     *
+     * @attention Must only be accessed from this worker.
+     */
+    const SessionsById& session_registry() const
+    {
+        return m_sessions;
+    }
+
+    /**
+     * Find the worker a session is registered with. The returned worker is
+     * the only one that may access the session; the answer may be out of
+     * date by the time the worker looks for the session itself.
+     *
+     * @param id  The id of the session.
+     *
+     * @return The id of the worker, or -1 if the session was not found.
+     *
+     * @attention This function can be called from any thread.
+     */
+    static int find_session_owner(uint64_t id);
+
+    /**
+     * Add a timer to the worker. If the timer is already active, it is
+     * rescheduled.
+     *
+     * @param pTimer    The timer.
+     * @param delay_ms  After how many milliseconds the timer should expire.
+     *
+     * @attention Must be called from the thread of the worker.
+     */
+    void add_timer(MXS_WORKER_TIMER* pTimer, uint32_t delay_ms);
+
+    /**
+     * Cancel a timer of the worker.
+     *
+     * @param pTimer  The timer.
+     *
+     * @attention Must be called from the thread of the worker.
      */
-    SessionsById& session_registry();
+    void cancel_timer(MXS_WORKER_TIMER* pTimer);
 
     /**
      * Broadcast a message to all worker.
@@ -533,11 +612,11 @@ private:
     bool          m_should_shutdown;      /*< Whether shutdown should be performed. */
     bool          m_shutdown_initiated;   /*< Whether shutdown has been initated. */
     SessionsById  m_sessions;             /*< A mapping of session_id->MXS_SESSION. The map
-                                           *  should contain sessions exclusive to this
-                                           *  worker and not e.g. listener sessions. For now,
-                                           *  it's up to the protocol to decide whether a new
-                                           *  session is added to the map. */
+                                           *  contains the client sessions whose client DCB
+                                           *  is handled by this worker, but not e.g. listener
+                                           *  or internal sessions. */
     Zombies       m_zombies;              /*< DCBs to be deleted. */
+    TimerWheel    m_timers;               /*< The timers of the worker. */
     uint32_t      m_nCurrent_descriptors; /*< Current number of descriptors. */
     uint64_t      m_nTotal_descriptors;   /*< Total number of descriptors. */
 };
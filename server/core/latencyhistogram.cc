@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "internal/latencyhistogram.hh"
+#include <maxscale/atomic.h>
+
+namespace maxscale
+{
+
+void LatencyHistogram::add(const LatencyHistogram& other)
+{
+    for (int i = 0; i < N_BUCKETS; ++i)
+    {
+        m_buckets[i] += atomic_load_uint64_relaxed(&other.m_buckets[i]);
+    }
+
+    uint64_t max = atomic_load_uint64_relaxed(&other.m_max);
+
+    if (max > m_max)
+    {
+        m_max = max;
+    }
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    uint64_t n = 0;
+
+    for (int i = 0; i < N_BUCKETS; ++i)
+    {
+        n += m_buckets[i];
+    }
+
+    return n;
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const
+{
+    uint64_t n = count();
+    uint64_t rv = 0;
+
+    if (n != 0)
+    {
+        // The rank of the value, counting from 1.
+        uint64_t rank = (uint64_t)(percent / 100.0 * n + 0.5);
+        rank = rank < 1 ? 1 : (rank > n ? n : rank);
+
+        uint64_t seen = 0;
+        int i = 0;
+
+        while ((seen += m_buckets[i]) < rank)
+        {
+            ++i;
+        }
+
+        rv = upper_bound(i);
+
+        if (rv > m_max)
+        {
+            rv = m_max;
+        }
+    }
+
+    return rv;
+}
+
+json_t* LatencyHistogram::to_json() const
+{
+    json_t* pBuckets = json_array();
+
+    for (int i = 0; i < N_BUCKETS; ++i)
+    {
+        if (m_buckets[i])
+        {
+            json_t* pBucket = json_object();
+            json_object_set_new(pBucket, "from", json_integer(lower_bound(i)));
+            json_object_set_new(pBucket, "to", json_integer(upper_bound(i)));
+            json_object_set_new(pBucket, "count", json_integer(m_buckets[i]));
+            json_array_append_new(pBuckets, pBucket);
+        }
+    }
+
+    json_t* pPercentiles = json_object();
+    json_object_set_new(pPercentiles, "50", json_integer(percentile(50)));
+    json_object_set_new(pPercentiles, "90", json_integer(percentile(90)));
+    json_object_set_new(pPercentiles, "99", json_integer(percentile(99)));
+    json_object_set_new(pPercentiles, "99.9", json_integer(percentile(99.9)));
+
+    json_t* pHistogram = json_object();
+    json_object_set_new(pHistogram, "count", json_integer(count()));
+    json_object_set_new(pHistogram, "max", json_integer(m_max));
+    json_object_set_new(pHistogram, "percentiles", pPercentiles);
+    json_object_set_new(pHistogram, "buckets", pBuckets);
+
+    return pHistogram;
+}
+
+//static
+uint64_t LatencyHistogram::lower_bound(int index)
+{
+    uint64_t rv = index;
+
+    if (index >= 2 * SUB_BUCKETS)
+    {
+        int shift = index / SUB_BUCKETS - 1;
+        rv = (uint64_t)(index - shift * SUB_BUCKETS) << shift;
+    }
+
+    return rv;
+}
+
+//static
+uint64_t LatencyHistogram::upper_bound(int index)
+{
+    return lower_bound(index + 1) - 1;
+}
+
+}
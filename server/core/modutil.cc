@@ -765,6 +765,248 @@ int modutil_count_signal_packets(GWBUF *reply, int n_found, bool* more_out, modu
     return total;
 }
 
+void modutil_reply_tracker_init(MXS_REPLY_TRACKER* tracker, uint8_t command)
+{
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->command = command;
+
+    switch (command)
+    {
+    case MXS_COM_FIELD_LIST:
+        // Column definitions terminated by an EOF packet
+        tracker->state = MXS_REPLY_TRACKER_COLDEF;
+        break;
+
+    case MXS_COM_STMT_FETCH:
+        // Rows terminated by an EOF packet
+        tracker->state = MXS_REPLY_TRACKER_ROWS;
+        break;
+
+    default:
+        tracker->state = MXS_REPLY_TRACKER_START;
+        break;
+    }
+}
+
+/**
+ * Check whether more results follow an EOF packet.
+ *
+ * @param tracker  The tracker
+ * @param payload  The payload of the EOF packet
+ * @param len      The number of available bytes of the payload
+ *
+ * @return True, if more results follow
+ */
+static bool reply_tracker_more_after_eof(MXS_REPLY_TRACKER* tracker, const uint8_t* payload, size_t len)
+{
+    // The command byte and the number of warnings precede the status.
+    uint16_t status = len >= 5 ? gw_mysql_get_byte2(payload + 3) : 0;
+    bool more = status & SERVER_MORE_RESULTS_EXIST;
+
+    // The same MySQL 5.6 and 5.7 quirk as in modutil_count_signal_packets
+    if (status & SERVER_PS_OUT_PARAMS)
+    {
+        tracker->ps_out_params = true;
+    }
+    else if (tracker->ps_out_params)
+    {
+        more = true;
+        tracker->ps_out_params = false;
+    }
+
+    return more;
+}
+
+/**
+ * Check whether more results follow an OK packet.
+ *
+ * @param payload  The payload of the OK packet
+ * @param len      The number of available bytes of the payload
+ *
+ * @return True, if more results follow
+ */
+static bool reply_tracker_more_after_ok(const uint8_t* payload, size_t len)
+{
+    // The number of affected rows and the last insert id precede the status.
+    const uint8_t* ptr = payload + 1;
+    const uint8_t* end = payload + len;
+    bool more = false;
+
+    if (ptr < end)
+    {
+        ptr += mxs_leint_bytes(ptr);
+
+        if (ptr < end)
+        {
+            ptr += mxs_leint_bytes(ptr);
+
+            if (end - ptr >= 2)
+            {
+                more = gw_mysql_get_byte2(ptr) & SERVER_MORE_RESULTS_EXIST;
+            }
+        }
+    }
+
+    return more;
+}
+
+/**
+ * Update the state of a tracker using the beginning of a packet.
+ *
+ * @param tracker      The tracker, whose prefix contains the header of the packet
+ *                     and as much of the payload as is needed
+ * @param payload_len  The length of the payload
+ */
+static void reply_tracker_process(MXS_REPLY_TRACKER* tracker, uint32_t payload_len)
+{
+    const uint8_t* payload = tracker->prefix + MYSQL_HEADER_LEN;
+    size_t len = tracker->n_prefix - MYSQL_HEADER_LEN;
+    uint8_t command = payload[0];
+    bool is_eof = (command == MYSQL_REPLY_EOF) &&
+                  (payload_len == MYSQL_EOF_PACKET_LEN - MYSQL_HEADER_LEN);
+
+    switch (tracker->state)
+    {
+    case MXS_REPLY_TRACKER_START:
+        if (command == MYSQL_REPLY_OK)
+        {
+            tracker->n_results++;
+            tracker->state = reply_tracker_more_after_ok(payload, len) ?
+                MXS_REPLY_TRACKER_START : MXS_REPLY_TRACKER_DONE;
+        }
+        else if (command == MYSQL_REPLY_ERR || command == MYSQL_REPLY_LOCAL_INFILE)
+        {
+            tracker->state = MXS_REPLY_TRACKER_DONE;
+        }
+        else
+        {
+            tracker->n_columns = mxs_leint_value(payload);
+            tracker->state = MXS_REPLY_TRACKER_COLDEF;
+        }
+        break;
+
+    case MXS_REPLY_TRACKER_COLDEF:
+        if (is_eof)
+        {
+            reply_tracker_more_after_eof(tracker, payload, len);
+
+            if (tracker->command == MXS_COM_FIELD_LIST)
+            {
+                tracker->n_results++;
+                tracker->state = MXS_REPLY_TRACKER_DONE;
+            }
+            else
+            {
+                tracker->state = MXS_REPLY_TRACKER_ROWS;
+            }
+        }
+        else if (command == MYSQL_REPLY_ERR)
+        {
+            tracker->state = MXS_REPLY_TRACKER_DONE;
+        }
+        break;
+
+    case MXS_REPLY_TRACKER_ROWS:
+        if (is_eof)
+        {
+            tracker->n_results++;
+            tracker->state = reply_tracker_more_after_eof(tracker, payload, len) ?
+                MXS_REPLY_TRACKER_START : MXS_REPLY_TRACKER_DONE;
+        }
+        else if (command == MYSQL_REPLY_ERR)
+        {
+            /** An error means that the generation of the result set was
+             * aborted and that no more results will follow. */
+            tracker->state = MXS_REPLY_TRACKER_DONE;
+        }
+        else
+        {
+            tracker->n_rows++;
+        }
+        break;
+
+    case MXS_REPLY_TRACKER_DONE:
+        ss_dassert(!true);
+        break;
+    }
+}
+
+size_t modutil_reply_tracker_consume(MXS_REPLY_TRACKER* tracker, const GWBUF* buffer, size_t offset)
+{
+    size_t consumed = 0;
+
+    while (buffer && offset >= GWBUF_LENGTH(buffer))
+    {
+        offset -= GWBUF_LENGTH(buffer);
+        buffer = buffer->next;
+    }
+
+    // Even if the state is DONE, the rest of the last packet must be consumed.
+    while (buffer && (tracker->state != MXS_REPLY_TRACKER_DONE || tracker->n_skip != 0))
+    {
+        const uint8_t* start = GWBUF_DATA(buffer) + offset;
+        const uint8_t* end = GWBUF_DATA(buffer) + GWBUF_LENGTH(buffer);
+        const uint8_t* ptr = start;
+
+        while (ptr < end && (tracker->state != MXS_REPLY_TRACKER_DONE || tracker->n_skip != 0))
+        {
+            size_t available = end - ptr;
+
+            if (tracker->n_skip != 0)
+            {
+                size_t n = MXS_MIN(tracker->n_skip, available);
+                ptr += n;
+                tracker->n_skip -= n;
+            }
+            else
+            {
+                size_t needed = MYSQL_HEADER_LEN;
+
+                if (tracker->n_prefix >= MYSQL_HEADER_LEN)
+                {
+                    needed += MXS_MIN(gw_mysql_get_byte3(tracker->prefix),
+                                      MXS_REPLY_TRACKER_PREFIX_LEN - MYSQL_HEADER_LEN);
+                }
+
+                size_t n = MXS_MIN(needed - tracker->n_prefix, available);
+                memcpy(tracker->prefix + tracker->n_prefix, ptr, n);
+                ptr += n;
+                tracker->n_prefix += n;
+
+                if (tracker->n_prefix >= MYSQL_HEADER_LEN)
+                {
+                    uint32_t payload_len = gw_mysql_get_byte3(tracker->prefix);
+
+                    if (tracker->n_prefix ==
+                        MYSQL_HEADER_LEN + MXS_MIN(payload_len, MXS_REPLY_TRACKER_PREFIX_LEN - MYSQL_HEADER_LEN))
+                    {
+                        // The payload of a packet following a packet of maximum
+                        // length is a continuation of the previous payload.
+                        bool continuation = tracker->continuation;
+                        tracker->continuation = (payload_len == GW_MYSQL_MAX_PACKET_LEN);
+
+                        if (!continuation && payload_len != 0)
+                        {
+                            reply_tracker_process(tracker, payload_len);
+                        }
+
+                        tracker->n_skip = payload_len - (tracker->n_prefix - MYSQL_HEADER_LEN);
+                        tracker->n_prefix = 0;
+                    }
+                }
+            }
+        }
+
+        consumed += ptr - start;
+        buffer = buffer->next;
+        offset = 0;
+    }
+
+    tracker->n_bytes += consumed;
+
+    return consumed;
+}
+
 /**
  * Create parse error and EPOLLIN event to event queue of the backend DCB.
  * When event is notified the error message is processed as error reply and routed
@@ -1233,57 +1475,632 @@ mxs_pcre2_result_t modutil_mysql_wildcard_match(const char* pattern, const char*
     return rval;
 }
 
-/*
- * Replace user-provided literals with question marks.
+/**
+ * The canonical form of a statement is created in one pass over the statement,
+ * by four stages that each pass their output to the next stage as soon as it
+ * is known. The stages produce exactly the same result as replace_quoted(),
+ * remove_mysql_comments(), replace_values() and squeeze_whitespace() would,
+ * if applied one after the other:
  *
- * TODO: Make the canonicalization allocate only one buffer of memory
+ * 1. The content of quoted strings is replaced with a question mark.
+ * 2. Comments, except executable comments, are removed.
+ * 3. Numbers and user variables are replaced with a question mark.
+ * 4. Whitespace is squeezed.
  *
- * @param querybuf GWBUF with a COM_QUERY statement
- * @return A copy of the query in its canonical form or NULL if an error occurred.
+ * The second and third stage hold back data only as long as it is not known
+ * whether a comment or a value starts at some position. All data is kept in
+ * thread specific buffers, so no memory is allocated once the buffers have
+ * grown large enough.
  */
-char* modutil_get_canonical(GWBUF* querybuf)
+
+/** Buffers larger than this are freed instead of being reused */
+#define CANON_BUFFER_MAX_RETAINED (1024 * 1024)
+
+typedef struct canon_buffer
+{
+    char*  data;
+    size_t len;
+    size_t size;
+} CANON_BUFFER;
+
+typedef struct canon_state
 {
-    char *querystr = NULL;
+    CANON_BUFFER comments;       /*< Data held back by the comment stage */
+    size_t       comments_skip;  /*< How much of the held back data is known not to end a comment */
+    CANON_BUFFER values;         /*< Data held back by the value stage */
+    char         values_prev;    /*< The character preceding the held back data, 0 if none */
+    bool         space;          /*< Whether whitespace precedes the next output character */
+    CANON_BUFFER output;         /*< The canonical statement */
+    bool         failed;         /*< Whether memory allocation failed */
+} CANON_STATE;
+
+static thread_local CANON_STATE canon_state;
+
+typedef enum
+{
+    CANON_NO_MATCH,
+    CANON_MATCH,
+    CANON_UNDECIDED /*< More data is needed for deciding whether there is a match */
+} canon_match_t;
 
-    if (GWBUF_LENGTH(querybuf) > MYSQL_HEADER_LEN + 1 && GWBUF_IS_SQL(querybuf))
+static inline bool canon_is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static inline bool canon_is_word(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static inline bool canon_is_number(char c)
+{
+    return (c >= '0' && c <= '9') || c == '.' || c == '-';
+}
+
+/** A character that may precede a value */
+static inline bool canon_is_value_prefix(char c)
+{
+    switch (c)
     {
-        size_t srcsize = GWBUF_LENGTH(querybuf) - MYSQL_HEADER_LEN - 1;
-        char *src = (char*)GWBUF_DATA(querybuf) + MYSQL_HEADER_LEN + 1;
-        size_t destsize = 0;
-        char *dest = NULL;
+    case '-':
+    case '=':
+    case ',':
+    case '+':
+    case '*':
+    case '/':
+    case '(':
+        return true;
+
+    default:
+        return canon_is_space(c);
+    }
+}
+
+/** A character that may follow a value */
+static inline bool canon_is_value_suffix(char c)
+{
+    switch (c)
+    {
+    case '-':
+    case '=':
+    case ',':
+    case '+':
+    case '*':
+    case '/':
+    case ')':
+    case ';':
+        return true;
+
+    default:
+        return canon_is_space(c);
+    }
+}
+
+static void canon_buffer_reset(CANON_BUFFER* buffer)
+{
+    if (buffer->size > CANON_BUFFER_MAX_RETAINED)
+    {
+        MXS_FREE(buffer->data);
+        buffer->data = NULL;
+        buffer->size = 0;
+    }
+
+    buffer->len = 0;
+}
+
+static inline void canon_buffer_append(CANON_STATE* state, CANON_BUFFER* buffer, char c)
+{
+    if (buffer->len == buffer->size)
+    {
+        size_t size = buffer->size ? 2 * buffer->size : 256;
+        char* data = (char*)MXS_REALLOC(buffer->data, size);
+
+        if (data)
+        {
+            buffer->data = data;
+            buffer->size = size;
+        }
+        else
+        {
+            state->failed = true;
+            return;
+        }
+    }
+
+    buffer->data[buffer->len++] = c;
+}
+
+static inline void canon_buffer_consume(CANON_BUFFER* buffer, size_t n)
+{
+    buffer->len -= n;
+    memmove(buffer->data, buffer->data + n, buffer->len);
+}
+
+/**
+ * Stage 4: Remove leading and trailing whitespace and replace all other
+ * sequences of whitespace with one space.
+ */
+static inline void canon_squeeze(CANON_STATE* state, char c)
+{
+    if (isspace(c))
+    {
+        state->space = state->output.len != 0;
+    }
+    else
+    {
+        if (state->space)
+        {
+            canon_buffer_append(state, &state->output, ' ');
+            state->space = false;
+        }
+
+        canon_buffer_append(state, &state->output, c);
+    }
+}
+
+/**
+ * Match a number, or the name of a user variable, starting at @c q.
+ *
+ * @param end On match, the end of the value including the character following it.
+ * @param suffix On match, whether the value is followed by a character.
+ */
+static canon_match_t canon_match_value(const char* data, size_t len, size_t q, char prev,
+                                       bool at_end, size_t* end, bool* suffix)
+{
+    canon_match_t rval = CANON_NO_MATCH;
+
+    if (q == len)
+    {
+        rval = at_end ? CANON_NO_MATCH : CANON_UNDECIDED;
+    }
+    else
+    {
+        if (canon_is_number(data[q]))
+        {
+            size_t e = q + 1;
+
+            while (e < len && canon_is_number(data[e]))
+            {
+                e++;
+            }
+
+            if (e == len)
+            {
+                if (at_end)
+                {
+                    *end = e;
+                    *suffix = false;
+                    rval = CANON_MATCH;
+                }
+                else
+                {
+                    rval = CANON_UNDECIDED;
+                }
+            }
+            else if (canon_is_value_suffix(data[e]))
+            {
+                *end = e + 1;
+                *suffix = true;
+                rval = CANON_MATCH;
+            }
+            else
+            {
+                // The number ends at the last minus sign, which then follows it
+                for (size_t k = e - 1; k > q; k--)
+                {
+                    if (data[k] == '-')
+                    {
+                        *end = k + 1;
+                        *suffix = true;
+                        rval = CANON_MATCH;
+                        break;
+                    }
+                }
+            }
+        }
 
-        if (replace_quoted((const char**)&src, &srcsize, &dest, &destsize))
+        if (rval == CANON_NO_MATCH && prev == '@' && canon_is_word(data[q]))
         {
-            /** Reset the buffers so that the old result is reused and a new
-             * result is created.*/
-            src = dest;
-            srcsize = destsize;
-            dest = NULL;
-            destsize = 0;
+            size_t e = q + 1;
+
+            while (e < len && canon_is_word(data[e]))
+            {
+                e++;
+            }
 
-            if (remove_mysql_comments((const char**)&src, &srcsize, &dest, &destsize))
+            if (e == len)
             {
-                /** Both buffers now contain allocated memory so all we need
-                 * to do is to swap them */
-                if (replace_values((const char**)&dest, &destsize, &src, &srcsize))
+                if (at_end)
                 {
-                    querystr = squeeze_whitespace(src);
-                    MXS_FREE(dest);
+                    *end = e;
+                    *suffix = false;
+                    rval = CANON_MATCH;
                 }
                 else
                 {
-                    MXS_FREE(src);
-                    MXS_FREE(dest);
+                    rval = CANON_UNDECIDED;
                 }
             }
+            else if (canon_is_value_suffix(data[e]))
+            {
+                *end = e + 1;
+                *suffix = true;
+                rval = CANON_MATCH;
+            }
+        }
+    }
+
+    return rval;
+}
+
+/**
+ * Match a value starting at @c i. The value may be preceded by a character, in
+ * which case that character is also a part of the match.
+ */
+static canon_match_t canon_match_prefixed_value(const char* data, size_t len, size_t i, char prev,
+                                                bool at_end, bool* prefix, size_t* end, bool* suffix)
+{
+    char c = data[i];
+    canon_match_t rval = CANON_NO_MATCH;
+
+    if (canon_is_value_prefix(c))
+    {
+        rval = canon_match_value(data, len, i + 1, c, at_end, end, suffix);
+        *prefix = true;
+    }
+
+    if (rval == CANON_NO_MATCH && canon_is_word(prev) != canon_is_word(c))
+    {
+        rval = canon_match_value(data, len, i, prev, at_end, end, suffix);
+        *prefix = false;
+    }
+
+    if (rval == CANON_NO_MATCH && c == '@')
+    {
+        rval = canon_match_value(data, len, i + 1, c, at_end, end, suffix);
+        *prefix = true;
+    }
+
+    return rval;
+}
+
+static void canon_flush_values(CANON_STATE* state, bool at_end)
+{
+    CANON_BUFFER* buffer = &state->values;
+    const char* data = buffer->data;
+    size_t i = 0;
+
+    while (i < buffer->len)
+    {
+        char prev = i ? data[i - 1] : state->values_prev;
+        bool prefix;
+        size_t end;
+        bool suffix;
+        canon_match_t rval = canon_match_prefixed_value(data, buffer->len, i, prev, at_end,
+                                                        &prefix, &end, &suffix);
+
+        if (rval == CANON_UNDECIDED)
+        {
+            break;
+        }
+        else if (rval == CANON_MATCH)
+        {
+            if (prefix)
+            {
+                canon_squeeze(state, data[i]);
+            }
+
+            canon_squeeze(state, '?');
+
+            if (suffix)
+            {
+                canon_squeeze(state, data[end - 1]);
+            }
+
+            i = end;
+        }
+        else
+        {
+            canon_squeeze(state, data[i]);
+            i++;
+        }
+    }
+
+    if (i)
+    {
+        state->values_prev = data[i - 1];
+        canon_buffer_consume(buffer, i);
+    }
+}
+
+/**
+ * Stage 3: Replace numbers and user variables with question marks.
+ *
+ * A value can not extend past a character that can not be a part of one, so
+ * the held back data is processed only when such a character arrives.
+ */
+static inline void canon_replace_values(CANON_STATE* state, char c)
+{
+    canon_buffer_append(state, &state->values, c);
+
+    if (!canon_is_number(c) && !canon_is_word(c))
+    {
+        canon_flush_values(state, false);
+    }
+}
+
+/**
+ * Match a comment or a quoted identifier starting at @c i.
+ *
+ * @param skip How much of the data following @c i is already known not to end
+ *             the match; updated if more data is needed.
+ * @param end On match, the end of the match.
+ * @param keep On match, whether the matched data is retained.
+ */
+static canon_match_t canon_match_comment(const char* data, size_t len, size_t i, bool at_end,
+                                         size_t* skip, size_t* end, bool* keep)
+{
+    canon_match_t rval = CANON_NO_MATCH;
+    char c = data[i];
+    size_t base = 0;    // Where the data that may end the match starts
+
+    if (c == '`')
+    {
+        base = i + 1;
+        const char* ptr = (const char*)memchr(data + base + *skip, '`', len - base - *skip);
+
+        if (ptr)
+        {
+            *end = ptr - data + 1;
+            *keep = true;
+            rval = CANON_MATCH;
+        }
+        else if (!at_end)
+        {
+            *skip = len - base;
+            rval = CANON_UNDECIDED;
+        }
+    }
+    else if (c == '#' || c == '-')
+    {
+        if (c == '#')
+        {
+            base = i + 1;
+        }
+        else if (i + 1 == len || (data[i + 1] == '-' && i + 2 == len))
+        {
+            rval = at_end ? CANON_NO_MATCH : CANON_UNDECIDED;
+        }
+        else if (data[i + 1] == '-' && canon_is_space(data[i + 2]))
+        {
+            base = i + 3;
+        }
+
+        if (base)
+        {
+            // The comment extends to the end of the line
+            const char* ptr = (const char*)memchr(data + base + *skip, '\n', len - base - *skip);
+
+            if (ptr || at_end)
+            {
+                *end = ptr ? ptr - data + 1 : len;
+                *keep = false;
+                rval = CANON_MATCH;
+            }
+            else
+            {
+                *skip = len - base;
+                rval = CANON_UNDECIDED;
+            }
+        }
+    }
+    else if (c == '/')
+    {
+        base = i + 2;
+
+        if (i + 1 == len)
+        {
+            rval = at_end ? CANON_NO_MATCH : CANON_UNDECIDED;
+        }
+        else if (data[i + 1] == '*')
+        {
+            if (!at_end && (base == len || (data[base] == 'M' && base + 1 == len)))
+            {
+                rval = CANON_UNDECIDED;
+            }
+            else if (base < len && (data[base] == '!' ||
+                                    (data[base] == 'M' && base + 1 < len && data[base + 1] == '!')))
+            {
+                // An executable comment is retained
+            }
             else
             {
-                MXS_FREE(src);
+                // The comment must end on the line where it starts
+                size_t k = base + *skip;
+
+                while (k < len && data[k] != '\n' && rval == CANON_NO_MATCH)
+                {
+                    if (data[k] == '*' && k + 1 < len && data[k + 1] == '/')
+                    {
+                        *end = k + 2;
+                        *keep = false;
+                        rval = CANON_MATCH;
+                    }
+
+                    k++;
+                }
+
+                if (k == len && rval == CANON_NO_MATCH && !at_end)
+                {
+                    // A trailing asterisk may start the end of the comment
+                    *skip = len - base - (len - 1 >= base && data[len - 1] == '*' ? 1 : 0);
+                    rval = CANON_UNDECIDED;
+                }
+            }
+        }
+    }
+
+    return rval;
+}
+
+static void canon_flush_comments(CANON_STATE* state, bool at_end)
+{
+    CANON_BUFFER* buffer = &state->comments;
+    const char* data = buffer->data;
+    size_t i = 0;
+
+    while (i < buffer->len)
+    {
+        size_t end;
+        bool keep;
+        canon_match_t rval = canon_match_comment(data, buffer->len, i, at_end,
+                                                 &state->comments_skip, &end, &keep);
+
+        if (rval == CANON_UNDECIDED)
+        {
+            break;
+        }
+        else if (rval == CANON_MATCH)
+        {
+            for (size_t k = i; keep && k < end; k++)
+            {
+                canon_replace_values(state, data[k]);
             }
+
+            i = end;
+        }
+        else
+        {
+            canon_replace_values(state, data[i]);
+            i++;
         }
+
+        state->comments_skip = 0;
     }
 
-    return querystr;
+    canon_buffer_consume(buffer, i);
+}
+
+/**
+ * Stage 2: Remove comments. Quoted identifiers are skipped, so that comments
+ * are not looked for inside them.
+ */
+static inline void canon_remove_comments(CANON_STATE* state, char c)
+{
+    if (state->comments.len == 0 && c != '`' && c != '#' && c != '-' && c != '/')
+    {
+        canon_replace_values(state, c);
+    }
+    else
+    {
+        canon_buffer_append(state, &state->comments, c);
+        canon_flush_comments(state, false);
+    }
+}
+
+/**
+ * Find the closing quote of a quoted string. If no quote is found that is not
+ * preceded by a backslash, the last quote is the closing one.
+ *
+ * @return The closing quote or NULL if there is none.
+ */
+static const char* canon_find_closing_quote(const char* ptr, const char* end, char quote)
+{
+    const char* last = NULL;
+    const char* rval = NULL;
+
+    while (!rval && (ptr = (const char*)memchr(ptr, quote, end - ptr)))
+    {
+        if (ptr[-1] != '\\')
+        {
+            rval = ptr;
+        }
+
+        last = ptr++;
+    }
+
+    return rval ? rval : last;
+}
+
+/**
+ * Create the canonical form of a statement into the thread specific buffer.
+ *
+ * @return True if the statement could be processed.
+ */
+static bool canon_process(CANON_STATE* state, const char* ptr, const char* end)
+{
+    canon_buffer_reset(&state->comments);
+    canon_buffer_reset(&state->values);
+    canon_buffer_reset(&state->output);
+    state->comments_skip = 0;
+    state->values_prev = '\0';
+    state->space = false;
+    state->failed = false;
+
+    /**
+     * Stage 1: Replace the content of quoted strings with question marks. The
+     * canonical statement ends at the first null character, if any, outside
+     * the quoted strings.
+     */
+    while (ptr < end && *ptr)
+    {
+        char c = *ptr++;
+        const char* quote;
+
+        if ((c == '\'' || c == '"') && (quote = canon_find_closing_quote(ptr, end, c)))
+        {
+            canon_remove_comments(state, c);
+            canon_remove_comments(state, '?');
+            c = *quote;
+            ptr = quote + 1;
+        }
+
+        canon_remove_comments(state, c);
+    }
+
+    canon_flush_comments(state, true);
+    canon_flush_values(state, true);
+    canon_buffer_append(state, &state->output, '\0');
+
+    return !state->failed;
+}
+
+const char* modutil_get_canonical_r(GWBUF* querybuf, size_t* len)
+{
+    const char* rval = NULL;
+
+    if (GWBUF_LENGTH(querybuf) > MYSQL_HEADER_LEN + 1 && GWBUF_IS_SQL(querybuf))
+    {
+        const char* sql = (const char*)GWBUF_DATA(querybuf) + MYSQL_HEADER_LEN + 1;
+        CANON_STATE* state = &canon_state;
+
+        if (canon_process(state, sql, (const char*)GWBUF_DATA(querybuf) + GWBUF_LENGTH(querybuf)))
+        {
+            rval = state->output.data;
+
+            if (len)
+            {
+                *len = state->output.len - 1;
+            }
+        }
+    }
+
+    return rval;
+}
+
+/*
+ * Replace user-provided literals with question marks.
+ *
+ * @param querybuf GWBUF with a COM_QUERY statement
+ * @return A copy of the query in its canonical form or NULL if an error occurred.
+ */
+char* modutil_get_canonical(GWBUF* querybuf)
+{
+    size_t len;
+    const char* canonical = modutil_get_canonical_r(querybuf, &len);
+
+    return canonical ? MXS_STRNDUP(canonical, len) : NULL;
 }
 
 
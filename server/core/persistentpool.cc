@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "internal/persistentpool.hh"
+#include <maxscale/debug.h>
+
+using std::string;
+
+namespace maxscale
+{
+
+PersistentPool::PersistentPool()
+    : m_pNewest(NULL)
+    , m_pOldest(NULL)
+    , m_size(0)
+{
+}
+
+void PersistentPool::add(DCB* pDcb)
+{
+    // Within the DCBs of the same key, the newest is first.
+    DCB*& pFirst = m_index[key(pDcb->user, pDcb->remote, pDcb->protoname)];
+
+    pDcb->pool.prev = NULL;
+    pDcb->pool.next = pFirst;
+
+    if (pFirst)
+    {
+        pFirst->pool.prev = pDcb;
+    }
+
+    pFirst = pDcb;
+
+    pDcb->pool.older = m_pNewest;
+    pDcb->pool.newer = NULL;
+
+    if (m_pNewest)
+    {
+        m_pNewest->pool.newer = pDcb;
+    }
+    else
+    {
+        m_pOldest = pDcb;
+    }
+
+    m_pNewest = pDcb;
+    ++m_size;
+}
+
+DCB* PersistentPool::take(const char* zUser, const char* zHost, const char* zProtocol)
+{
+    DCB* pDcb = NULL;
+
+    if (m_size != 0)
+    {
+        Index::const_iterator i = m_index.find(key(zUser, zHost, zProtocol));
+
+        if (i != m_index.end())
+        {
+            pDcb = i->second;
+            remove(pDcb);
+        }
+    }
+
+    return pDcb;
+}
+
+void PersistentPool::remove(DCB* pDcb)
+{
+    ss_dassert(m_size != 0);
+
+    if (pDcb->pool.prev)
+    {
+        pDcb->pool.prev->pool.next = pDcb->pool.next;
+    }
+    else if (pDcb->pool.next)
+    {
+        m_index[key(pDcb->user, pDcb->remote, pDcb->protoname)] = pDcb->pool.next;
+    }
+    else
+    {
+        m_index.erase(key(pDcb->user, pDcb->remote, pDcb->protoname));
+    }
+
+    if (pDcb->pool.next)
+    {
+        pDcb->pool.next->pool.prev = pDcb->pool.prev;
+    }
+
+    if (pDcb->pool.newer)
+    {
+        pDcb->pool.newer->pool.older = pDcb->pool.older;
+    }
+    else
+    {
+        m_pNewest = pDcb->pool.older;
+    }
+
+    if (pDcb->pool.older)
+    {
+        pDcb->pool.older->pool.newer = pDcb->pool.newer;
+    }
+    else
+    {
+        m_pOldest = pDcb->pool.newer;
+    }
+
+    pDcb->pool.prev = NULL;
+    pDcb->pool.next = NULL;
+    pDcb->pool.newer = NULL;
+    pDcb->pool.older = NULL;
+
+    --m_size;
+}
+
+//static
+string PersistentPool::key(const char* zUser, const char* zHost, const char* zProtocol)
+{
+    // The parts are separated by a NUL, which none of them can contain.
+    string k(zUser ? zUser : "");
+    k += '\0';
+    k += (zHost ? zHost : "");
+    k += '\0';
+    k += (zProtocol ? zProtocol : "");
+
+    return k;
+}
+
+}
@@ -29,6 +29,7 @@
 #include "internal/httprequest.hh"
 #include "internal/httpresponse.hh"
 #include "internal/session.h"
+#include "internal/session.hh"
 #include "internal/filter.h"
 #include "internal/monitor.h"
 #include "internal/service.h"
@@ -517,9 +518,158 @@ HttpResponse cb_get_monitor(const HttpRequest& request)
     return HttpResponse(MHD_HTTP_OK, monitor_to_json(monitor, request.host()));
 }
 
+/**
+ * Get the value of a numeric request option
+ *
+ * @param request The request
+ * @param option  The option
+ * @param value   Set to the value of the option, if it was given
+ *
+ * @return False if the option was given but is not a number
+ */
+static bool get_numeric_option(const HttpRequest& request, const char* option, uint64_t* value)
+{
+    string str = request.get_option(option);
+    bool rval = true;
+
+    if (str.length())
+    {
+        char* end;
+        errno = 0;
+        unsigned long long n = strtoull(str.c_str(), &end, 10);
+
+        if (isdigit(str[0]) && *end == '\0' && errno == 0)
+        {
+            *value = n;
+        }
+        else
+        {
+            rval = false;
+        }
+    }
+
+    return rval;
+}
+
+/**
+ * Percent-encode a value for use in a URL
+ *
+ * @param str Value to encode
+ *
+ * @return The encoded value
+ */
+static string url_encode(const string& str)
+{
+    string rval;
+
+    for (string::const_iterator it = str.begin(); it != str.end(); it++)
+    {
+        if (isalnum(*it) || strchr("-_.~", *it))
+        {
+            rval += *it;
+        }
+        else
+        {
+            char buf[4];
+            snprintf(buf, sizeof(buf), "%%%02X", (unsigned char)*it);
+            rval += buf;
+        }
+    }
+
+    return rval;
+}
+
 HttpResponse cb_all_sessions(const HttpRequest& request)
 {
-    return HttpResponse(MHD_HTTP_OK, session_list_to_json(request.host()));
+    const char* options[] = {"page[size]", "page[after]", "filter[worker]"};
+    uint64_t size = 0;
+    uint64_t worker_id = 0;
+    mxs::SessionListFilter filter;
+
+    filter.service = request.get_option("filter[service]");
+    filter.user = request.get_option("filter[user]");
+
+    bool has_worker = request.get_option(options[2]).length();
+
+    if (!get_numeric_option(request, options[0], &size) ||
+        !get_numeric_option(request, options[1], &filter.after) ||
+        !get_numeric_option(request, options[2], &worker_id) ||
+        (has_worker && worker_id >= (uint64_t)config_threadcount()))
+    {
+        return HttpResponse(MHD_HTTP_BAD_REQUEST,
+                            mxs_json_error("Invalid value for the `%s`, `%s` or `%s` parameter",
+                                           options[0], options[1], options[2]));
+    }
+
+    if (has_worker)
+    {
+        filter.worker_id = worker_id;
+    }
+
+    // One session more than fits on the page tells whether there is a next page
+    filter.limit = size ? size + 1 : 0;
+
+    int flags = request.get_json_flags();
+    mxs::SerializedSessions sessions = mxs::session_list_serialize(filter, request.host(), flags);
+    bool more = size && sessions.size() > size;
+
+    if (more)
+    {
+        sessions.resize(size);
+    }
+
+    string self = string(request.host()) + MXS_JSON_API_SESSIONS;
+    json_t* links = json_object();
+    json_object_set_new(links, CN_SELF, json_string(self.c_str()));
+
+    if (more)
+    {
+        stringstream next;
+        next << self << "?page[size]=" << size << "&page[after]=" << sessions.back().first;
+
+        if (filter.service.length())
+        {
+            next << "&filter[service]=" << url_encode(filter.service);
+        }
+
+        if (filter.user.length())
+        {
+            next << "&filter[user]=" << url_encode(filter.user);
+        }
+
+        if (has_worker)
+        {
+            next << "&filter[worker]=" << worker_id;
+        }
+
+        json_object_set_new(links, "next", json_string(next.str().c_str()));
+    }
+
+    /**
+     * The sessions have already been serialized by the workers, so the
+     * document is sent as is, one session at a time.
+     */
+    const char* separator = flags ? ",\n" : ",";
+    SBodyParts parts(new BodyParts);
+
+    parts->push_back(string("{\"") + CN_LINKS + "\": " + mxs::json_dump(links, flags) +
+                     ", \"" + CN_DATA + "\": [" + (flags ? "\n" : ""));
+    json_decref(links);
+
+    for (mxs::SerializedSessions::iterator it = sessions.begin(); it != sessions.end(); it++)
+    {
+        if (it != sessions.begin())
+        {
+            parts->push_back(separator);
+        }
+
+        parts->push_back(string());
+        parts->back().swap(it->second);
+    }
+
+    parts->push_back(string(flags ? "\n" : "") + "]}");
+
+    return HttpResponse(MHD_HTTP_OK, parts);
 }
 
 HttpResponse cb_get_session(const HttpRequest& request)
@@ -33,6 +33,7 @@
 #include <maxscale/log_manager.h>
 #include <maxscale/ssl.h>
 #include <maxscale/alloc.h>
+#include <maxscale/atomic.h>
 #include <maxscale/paths.h>
 #include <maxscale/utils.h>
 #include <maxscale/semaphore.hh>
@@ -41,11 +42,14 @@
 #include <maxscale/http.hh>
 #include <maxscale/maxscale.h>
 
+#include "internal/dcb.h"
 #include "internal/monitor.h"
+#include "internal/persistentpool.hh"
 #include "internal/poll.h"
 #include "internal/workertask.hh"
 #include "internal/worker.hh"
 
+using maxscale::PersistentPool;
 using maxscale::Semaphore;
 using maxscale::Worker;
 using maxscale::WorkerTask;
@@ -66,6 +70,48 @@ static SERVER *allServers = NULL;
 
 static void spin_reporter(void *, char *, int);
 static void server_parameter_free(SERVER_PARAM *tofree);
+static void persistent_pools_free(SERVER_PERSISTENT_POOL **pools, int nthr);
+
+/**
+ * Allocate the per-thread persistent connection pools of a server
+ *
+ * @param nthr  Number of threads
+ * @return      The pools or NULL on memory allocation failure
+ */
+static SERVER_PERSISTENT_POOL** persistent_pools_alloc(int nthr)
+{
+    SERVER_PERSISTENT_POOL **pools = (SERVER_PERSISTENT_POOL**)MXS_CALLOC(nthr, sizeof(*pools));
+
+    for (int i = 0; pools && i < nthr; i++)
+    {
+        if ((pools[i] = new (std::nothrow) PersistentPool) == NULL)
+        {
+            persistent_pools_free(pools, i);
+            pools = NULL;
+        }
+    }
+
+    return pools;
+}
+
+/**
+ * Free the per-thread persistent connection pools of a server
+ *
+ * @param pools  The pools, each of which must be empty
+ * @param nthr   Number of threads
+ */
+static void persistent_pools_free(SERVER_PERSISTENT_POOL **pools, int nthr)
+{
+    if (pools)
+    {
+        for (int i = 0; i < nthr; i++)
+        {
+            delete static_cast<PersistentPool*>(pools[i]);
+        }
+
+        MXS_FREE(pools);
+    }
+}
 
 
 SERVER* server_alloc(const char *name, const char *address, unsigned short port,
@@ -99,13 +145,13 @@ SERVER* server_alloc(const char *name, const char *address, unsigned short port,
     char *my_name = MXS_STRDUP(name);
     char *my_protocol = MXS_STRDUP(protocol);
     char *my_authenticator = MXS_STRDUP(authenticator);
-    DCB **persistent = (DCB**)MXS_CALLOC(nthr, sizeof(*persistent));
+    SERVER_PERSISTENT_POOL **persistent = persistent_pools_alloc(nthr);
 
     if (!server || !my_name || !my_protocol || !my_authenticator || !persistent)
     {
         MXS_FREE(server);
         MXS_FREE(my_name);
-        MXS_FREE(persistent);
+        persistent_pools_free(persistent, nthr);
         MXS_FREE(my_protocol);
         MXS_FREE(my_authenticator);
         return NULL;
@@ -204,9 +250,9 @@ server_free(SERVER *tofreeserver)
 
         for (int i = 0; i < nthr; i++)
         {
-            dcb_persistent_clean_count(tofreeserver->persistent[i], i, true);
+            dcb_persistent_clean_count(tofreeserver, i, true);
         }
-        MXS_FREE(tofreeserver->persistent);
+        persistent_pools_free(tofreeserver->persistent, nthr);
     }
     MXS_FREE(tofreeserver);
     return 1;
@@ -225,59 +271,41 @@ server_free(SERVER *tofreeserver)
  */
 DCB* server_get_persistent(SERVER *server, const char *user, const char* ip, const char *protocol, int id)
 {
-    DCB *dcb, *previous = NULL;
+    DCB *dcb = NULL;
 
-    if (server->persistent[id]
-        && dcb_persistent_clean_count(server->persistent[id], id, false)
-        && server->persistent[id] // Check after cleaning
+    if (ip
+        && dcb_persistent_clean_count(server, id, false)
         && (server->status & SERVER_RUNNING))
     {
-        dcb = server->persistent[id];
-        while (dcb)
+        PersistentPool& pool = PersistentPool::get(server, id);
+
+        while ((dcb = pool.take(user, ip, protocol)) != NULL)
         {
-            if (dcb->user
-                && dcb->protoname
-                && dcb->remote
-                && ip
-                && !dcb-> dcb_errhandle_called
-                && !(dcb->flags & DCBF_HUNG)
-                && 0 == strcmp(dcb->user, user)
-                && 0 == strcmp(dcb->remote, ip)
-                && 0 == strcmp(dcb->protoname, protocol))
-            {
-                if (NULL == previous)
-                {
-                    server->persistent[id] = dcb->nextpersistent;
-                }
-                else
-                {
-                    previous->nextpersistent = dcb->nextpersistent;
-                }
-                MXS_FREE(dcb->user);
-                dcb->user = NULL;
-                atomic_add(&server->stats.n_persistent, -1);
-                atomic_add(&server->stats.n_current, 1);
-                return dcb;
-            }
-            else
+            atomic_add(&server->stats.n_persistent, -1);
+
+            if (!dcb->dcb_errhandle_called && !(dcb->flags & DCBF_HUNG))
             {
-                MXS_DEBUG("%lu [server_get_persistent] Rejected dcb "
-                          "%p from pool, user %s looking for %s, protocol %s "
-                          "looking for %s, hung flag %s, error handle called %s.",
-                          pthread_self(),
-                          dcb,
-                          dcb->user ? dcb->user : "NULL",
-                          user,
-                          dcb->protoname ? dcb->protoname : "NULL",
-                          protocol,
-                          (dcb->flags & DCBF_HUNG) ? "true" : "false",
-                          dcb-> dcb_errhandle_called ? "true" : "false");
+                break;
             }
-            previous = dcb;
-            dcb = dcb->nextpersistent;
+
+            MXS_DEBUG("%lu [server_get_persistent] Rejected dcb "
+                      "%p from pool, hung flag %s, error handle called %s.",
+                      pthread_self(),
+                      dcb,
+                      (dcb->flags & DCBF_HUNG) ? "true" : "false",
+                      dcb->dcb_errhandle_called ? "true" : "false");
+            atomic_add_uint64(&server->stats.n_pool_expired, 1);
+            dcb_persistent_dispose(dcb);
+        }
+
+        if (dcb)
+        {
+            MXS_FREE(dcb->user);
+            dcb->user = NULL;
+            atomic_add(&server->stats.n_current, 1);
         }
     }
-    return NULL;
+    return dcb;
 }
 
 static inline SERVER* next_active_server(SERVER *server)
@@ -470,7 +498,7 @@ public:
     void execute(Worker& worker)
     {
         int thread_id = worker.get_current_id();
-        dcb_persistent_clean_count(m_server->persistent[thread_id], thread_id, false);
+        dcb_persistent_clean_count(const_cast<SERVER*>(m_server), thread_id, false);
     }
 
 private:
@@ -569,6 +597,11 @@ dprintServer(DCB *dcb, const SERVER *server)
     dcb_printf(dcb, "\tCurrent no. of conns:                %d\n", server->stats.n_current);
     dcb_printf(dcb, "\tCurrent no. of operations:           %d\n", server->stats.n_current_ops);
     dcb_printf(dcb, "\tNumber of routed packets:            %lu\n", server->stats.packets);
+    if (server->stats.response_time)
+    {
+        dcb_printf(dcb, "\tAverage response time:               %lu us\n",
+                   server->stats.response_time);
+    }
     if (server->persistpoolmax)
     {
         dcb_printf(dcb, "\tPersistent pool size:                %d\n", server->stats.n_persistent);
@@ -578,6 +611,8 @@ dprintServer(DCB *dcb, const SERVER *server)
         dcb_printf(dcb, "\tPersistent pool size limit:          %ld\n", server->persistpoolmax);
         dcb_printf(dcb, "\tPersistent max time (secs):          %ld\n", server->persistmaxtime);
         dcb_printf(dcb, "\tConnections taken from pool:         %lu\n", server->stats.n_from_pool);
+        dcb_printf(dcb, "\tConnections not found in pool:       %lu\n", server->stats.n_new_conn);
+        dcb_printf(dcb, "\tConnections expired from pool:       %lu\n", server->stats.n_pool_expired);
         double d =  (double)server->stats.n_from_pool / (double)(server->stats.n_connections +
                                                                  server->stats.n_from_pool + 1);
         dcb_printf(dcb, "\tPool availability:                   %0.2lf%%\n", d * 100.0);
@@ -1416,6 +1451,29 @@ bool server_is_mxs_service(const SERVER *server)
     return rval;
 }
 
+void server_add_response_time(SERVER *server, uint64_t us)
+{
+    /** The average is updated without locking, a sample may be lost if
+     * two threads update it at the same time */
+    uint64_t average = atomic_load_uint64(&server->stats.response_time);
+
+    if (average == 0)
+    {
+        average = us;
+    }
+    else
+    {
+        average = (average * 7 + us) / 8;
+    }
+
+    atomic_store_uint64(&server->stats.response_time, average ? average : 1);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    atomic_store_uint64(&server->stats.response_time_sampled,
+                        now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
 static json_t* server_json_attributes(const SERVER* server)
 {
     /** Resource attributes */
@@ -1518,8 +1576,12 @@ static json_t* server_json_attributes(const SERVER* server)
     json_object_set_new(stats, "connections", json_integer(server->stats.n_current));
     json_object_set_new(stats, "total_connections", json_integer(server->stats.n_connections));
     json_object_set_new(stats, "persistent_connections", json_integer(server->stats.n_persistent));
+    json_object_set_new(stats, "persistent_pool_hits", json_integer(server->stats.n_from_pool));
+    json_object_set_new(stats, "persistent_pool_misses", json_integer(server->stats.n_new_conn));
+    json_object_set_new(stats, "persistent_pool_expirations", json_integer(server->stats.n_pool_expired));
     json_object_set_new(stats, "active_operations", json_integer(server->stats.n_current_ops));
     json_object_set_new(stats, "routed_packets", json_integer(server->stats.packets));
+    json_object_set_new(stats, "average_response_time", json_integer(server->stats.response_time));
 
     json_object_set_new(attr, "statistics", stats);
 
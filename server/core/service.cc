@@ -1212,11 +1212,10 @@ serviceSetTimeout(SERVICE *service, int val)
         return 0;
     }
 
-    /** Enable the session timeout checks if and only if at least one service is
-     * configured with a idle timeout. */
-    if ((service->conn_idle_timeout = val))
+    if (service->conn_idle_timeout != val)
     {
-        dcb_enable_session_timeouts();
+        service->conn_idle_timeout = val;
+        dcb_update_idle_timeouts(service);
     }
 
     return 1;
@@ -22,28 +22,36 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <algorithm>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include <maxscale/alloc.h>
 #include <maxscale/atomic.h>
+#include <maxscale/config.h>
 #include <maxscale/dcb.h>
 #include <maxscale/housekeeper.h>
 #include <maxscale/log_manager.h>
 #include <maxscale/poll.h>
 #include <maxscale/router.h>
+#include <maxscale/semaphore.hh>
 #include <maxscale/service.h>
 #include <maxscale/spinlock.h>
 #include <maxscale/utils.h>
 #include <maxscale/json_api.h>
+#include <maxscale/jansson.hh>
 #include <maxscale/protocol/mysql.h>
 
 #include "internal/dcb.h"
 #include "internal/session.h"
+#include "internal/session.hh"
 #include "internal/filter.h"
 #include "internal/worker.hh"
 #include "internal/workertask.hh"
 
+using maxscale::Semaphore;
+using maxscale::Worker;
 using std::string;
 using std::stringstream;
 
@@ -64,7 +72,7 @@ static void session_add_to_all_list(MXS_SESSION *session);
 static MXS_SESSION *session_find_free();
 static void session_final_free(MXS_SESSION *session);
 static MXS_SESSION* session_alloc_body(SERVICE* service, DCB* client_dcb,
-                                       MXS_SESSION* session);
+                                       MXS_SESSION* session, bool routing);
 
 /**
  * The clientReply of the session.
@@ -94,6 +102,23 @@ session_initialize(MXS_SESSION *session)
     session->ses_chk_tail = CHK_NUM_SESSION;
 }
 
+/**
+ * Whether a router session should be created for a client DCB
+ *
+ * Only create a router session if we are not the listening DCB or an
+ * internal DCB. Creating a router session may create a connection to
+ * a backend server, depending upon the router module implementation
+ * and should be avoided for a listener session.
+ *
+ * @param client_dcb  The client DCB of the session
+ * @return True, if the router session and the filters should be created
+ */
+static bool session_is_routing(const DCB *client_dcb)
+{
+    return client_dcb->state != DCB_STATE_LISTENING &&
+           client_dcb->dcb_role != DCB_ROLE_INTERNAL;
+}
+
 MXS_SESSION* session_alloc(SERVICE *service, DCB *client_dcb)
 {
     MXS_SESSION *session = (MXS_SESSION *)(MXS_MALLOC(sizeof(*session)));
@@ -104,7 +129,7 @@ MXS_SESSION* session_alloc(SERVICE *service, DCB *client_dcb)
 
     session_initialize(session);
     session->ses_id = session_get_next_id();
-    return session_alloc_body(service, client_dcb, session);
+    return session_alloc_body(service, client_dcb, session, session_is_routing(client_dcb));
 }
 
 MXS_SESSION* session_alloc_with_id(SERVICE *service, DCB *client_dcb, uint64_t id)
@@ -117,11 +142,26 @@ MXS_SESSION* session_alloc_with_id(SERVICE *service, DCB *client_dcb, uint64_t i
 
     session_initialize(session);
     session->ses_id = id;
-    return session_alloc_body(service, client_dcb, session);
+    return session_alloc_body(service, client_dcb, session, session_is_routing(client_dcb));
+}
+
+MXS_SESSION* session_alloc_internal(SERVICE *service, DCB *client_dcb)
+{
+    ss_dassert(client_dcb->dcb_role == DCB_ROLE_INTERNAL);
+
+    MXS_SESSION *session = (MXS_SESSION *)(MXS_MALLOC(sizeof(*session)));
+    if (session == NULL)
+    {
+        return NULL;
+    }
+
+    session_initialize(session);
+    session->ses_id = session_get_next_id();
+    return session_alloc_body(service, client_dcb, session, true);
 }
 
 static MXS_SESSION* session_alloc_body(SERVICE* service, DCB* client_dcb,
-                                       MXS_SESSION* session)
+                                       MXS_SESSION* session, bool routing)
 {
     session->service = service;
     session->client_dcb = client_dcb;
@@ -155,16 +195,10 @@ static MXS_SESSION* session_alloc_body(SERVICE* service, DCB* client_dcb,
     session->trx_state = SESSION_TRX_INACTIVE;
     session->autocommit = true;
     /*
-     * Only create a router session if we are not the listening DCB or an
-     * internal DCB. Creating a router session may create a connection to
-     * a backend server, depending upon the router module implementation
-     * and should be avoided for a listener session.
-     *
      * Router session creation may create other DCBs that link to the
      * session.
      */
-    if (client_dcb->state != DCB_STATE_LISTENING &&
-        client_dcb->dcb_role != DCB_ROLE_INTERNAL)
+    if (routing)
     {
         session->router_session = service->router->newSession(service->router_instance, session);
         if (session->router_session == NULL)
@@ -244,6 +278,18 @@ static MXS_SESSION* session_alloc_body(SERVICE* service, DCB* client_dcb,
     CHK_SESSION(session);
 
     client_dcb->session = session;
+
+    if (session->state == SESSION_STATE_ROUTER_READY &&
+        client_dcb->dcb_role == DCB_ROLE_CLIENT_HANDLER &&
+        client_dcb->state == DCB_STATE_POLLING)
+    {
+        /**
+         * The client DCB is already handled by this worker. If it is not, the
+         * session is registered when the DCB is added to a worker.
+         */
+        ss_dassert(client_dcb->poll.thread.id == Worker::get_current_id());
+        Worker::get_current()->register_session(session);
+    }
     return (session->state == SESSION_STATE_TO_BE_FREED) ? NULL : session;
 }
 
@@ -482,7 +528,7 @@ bool dprintAllSessions_cb(DCB *dcb, void *data)
 void
 dprintAllSessions(DCB *dcb)
 {
-    dcb_foreach(dprintAllSessions_cb, dcb);
+    dcb_foreach_print(dcb, dprintAllSessions_cb);
 }
 
 /**
@@ -507,8 +553,8 @@ dprintSession(DCB *dcb, MXS_SESSION *print_session)
 
     if (print_session->client_dcb && print_session->client_dcb->remote)
     {
-        double idle = (hkheartbeat - print_session->client_dcb->last_read);
-        idle = idle > 0 ? idle / 10.f : 0;
+        double idle = ((int64_t)mxs_worker_timer_now() - print_session->client_dcb->last_read);
+        idle = idle > 0 ? idle / 1000.f : 0;
         dcb_printf(dcb, "\tClient Address:          %s%s%s\n",
                    print_session->client_dcb->user ? print_session->client_dcb->user : "",
                    print_session->client_dcb->user ? "@" : "",
@@ -566,7 +612,7 @@ dListSessions(DCB *dcb)
     dcb_printf(dcb, "Session          | Client          | Service        | State\n");
     dcb_printf(dcb, "-----------------+-----------------+----------------+--------------------------\n");
 
-    dcb_foreach(dListSessions_cb, dcb);
+    dcb_foreach_print(dcb, dListSessions_cb);
 
     dcb_printf(dcb, "-----------------+-----------------+----------------+--------------------------\n\n");
 }
@@ -754,50 +800,97 @@ session_get_user(const MXS_SESSION *session)
     return (session && session->client_dcb) ? session->client_dcb->user : NULL;
 }
 
+/**
+ * A row of the session list
+ */
+struct SessionListRow
+{
+    string      session;
+    string      client;
+    string      service;
+    const char* state;
+};
+
+typedef std::vector<SessionListRow> SessionListRows;
+
+/**
+ * The rows of the session list collected on one worker
+ */
+struct SessionListRowsOfWorker
+{
+    SESSIONLISTFILTER filter;
+    SessionListRows   rows;
+};
+
 /**
  * Callback structure for the session list extraction
  */
 typedef struct
 {
-    int index;
-    int current;
+    size_t index;
     SESSIONLISTFILTER filter;
-    RESULT_ROW *row;
+    SessionListRows *rows; /**< The rows of all workers, collected for the first row */
     RESULTSET *set;
 } SESSIONFILTER;
 
 bool dcb_iter_cb(DCB *dcb, void *data)
 {
-    SESSIONFILTER *cbdata = (SESSIONFILTER*)data;
+    SessionListRowsOfWorker *cbdata = (SessionListRowsOfWorker*)data;
 
-    if (cbdata->current < cbdata->index)
-    {
-        if (cbdata->filter == SESSION_LIST_ALL ||
-            (cbdata->filter == SESSION_LIST_CONNECTION &&
-             (dcb->session->state != SESSION_STATE_LISTENER)))
-        {
-            cbdata->current++;
-        }
-    }
-    else
+    if (cbdata->filter == SESSION_LIST_ALL ||
+        (cbdata->filter == SESSION_LIST_CONNECTION &&
+         (dcb->session->state != SESSION_STATE_LISTENER)))
     {
         char buf[20];
         MXS_SESSION *list_session = dcb->session;
+        SessionListRow row;
 
-        cbdata->index++;
-        cbdata->row = resultset_make_row(cbdata->set);
         snprintf(buf, sizeof(buf), "%p", list_session);
-        resultset_row_set(cbdata->row, 0, buf);
-        resultset_row_set(cbdata->row, 1, ((list_session->client_dcb && list_session->client_dcb->remote)
-                                           ? list_session->client_dcb->remote : ""));
-        resultset_row_set(cbdata->row, 2, (list_session->service && list_session->service->name
-                                           ? list_session->service->name : ""));
-        resultset_row_set(cbdata->row, 3, session_state(list_session->state));
-        return false;
+        row.session = buf;
+        row.client = (list_session->client_dcb && list_session->client_dcb->remote)
+                     ? list_session->client_dcb->remote : "";
+        row.service = (list_session->service && list_session->service->name
+                       ? list_session->service->name : "");
+        row.state = session_state(list_session->state);
+
+        cbdata->rows.push_back(row);
     }
     return true;
 }
 
+/**
+ * Collect the rows of the session list on all workers concurrently
+ *
+ * @param filter  Which sessions to list
+ * @return The rows of all workers, in the order of the workers
+ */
+static SessionListRows* session_list_collect(SESSIONLISTFILTER filter)
+{
+    int nthr = config_threadcount();
+    std::vector<SessionListRowsOfWorker> workers(nthr);
+    std::vector<void*> data(nthr);
+
+    for (int i = 0; i < nthr; i++)
+    {
+        workers[i].filter = filter;
+        data[i] = &workers[i];
+    }
+
+    dcb_foreach_parallel(dcb_iter_cb, &data[0]);
+
+    SessionListRows* rows = new (std::nothrow) SessionListRows;
+
+    if (rows)
+    {
+        for (int i = 0; i < nthr; i++)
+        {
+            rows->insert(rows->end(), workers[i].rows.begin(), workers[i].rows.end());
+        }
+    }
+
+    return rows;
+}
+
 /**
  * Provide a row to the result set that defines the set of sessions
  *
@@ -811,16 +904,24 @@ sessionRowCallback(RESULTSET *set, void *data)
     SESSIONFILTER *cbdata = (SESSIONFILTER*)data;
     RESULT_ROW *row = NULL;
 
-    cbdata->current = 0;
-    dcb_foreach(dcb_iter_cb, cbdata);
+    if (!cbdata->rows)
+    {
+        cbdata->rows = session_list_collect(cbdata->filter);
+    }
 
-    if (cbdata->row)
+    if (cbdata->rows && cbdata->index < cbdata->rows->size())
     {
-        row = cbdata->row;
-        cbdata->row = NULL;
+        const SessionListRow& r = (*cbdata->rows)[cbdata->index++];
+
+        row = resultset_make_row(cbdata->set);
+        resultset_row_set(row, 0, r.session.c_str());
+        resultset_row_set(row, 1, r.client.c_str());
+        resultset_row_set(row, 2, r.service.c_str());
+        resultset_row_set(row, 3, r.state);
     }
     else
     {
+        delete cbdata->rows;
         MXS_FREE(cbdata);
     }
 
@@ -851,8 +952,7 @@ sessionGetList(SESSIONLISTFILTER filter)
     }
     data->index = 0;
     data->filter = filter;
-    data->current = 0;
-    data->row = NULL;
+    data->rows = NULL;
 
     if ((set = resultset_create(sessionRowCallback, data)) == NULL)
     {
@@ -906,28 +1006,61 @@ const char* session_trx_state_to_string(mxs_session_trx_state_t state)
     return "UNKNOWN";
 }
 
-static bool ses_find_id(DCB *dcb, void *data)
+namespace
 {
-    void **params = (void**)data;
-    MXS_SESSION **ses = (MXS_SESSION**)params[0];
-    uint64_t *id = (uint64_t*)params[1];
-    bool rval = true;
 
-    if (dcb->session->ses_id == *id)
+/**
+ * Finds a session among the sessions of a worker and takes a reference to it.
+ */
+class FindSession : public mxs::WorkerTask
+{
+public:
+    FindSession(uint64_t id)
+        : m_id(id)
+        , m_pSession(NULL)
     {
-        *ses = session_get_ref(dcb->session);
-        rval = false;
     }
 
-    return rval;
+    void execute(Worker& worker)
+    {
+        MXS_SESSION* pSession = worker.find_session(m_id);
+
+        if (pSession)
+        {
+            m_pSession = session_get_ref(pSession);
+        }
+    }
+
+    MXS_SESSION* session() const
+    {
+        return m_pSession;
+    }
+
+private:
+    uint64_t     m_id;
+    MXS_SESSION* m_pSession;
+};
+
 }
 
 MXS_SESSION* session_get_by_id(uint64_t id)
 {
-    MXS_SESSION *session = NULL;
-    void *params[] = {&session, &id};
+    MXS_SESSION* session = NULL;
+    int worker_id = Worker::find_session_owner(id);
 
-    dcb_foreach(ses_find_id, params);
+    if (worker_id != -1)
+    {
+        // Only the worker that owns the session may access it.
+        Worker* worker = Worker::get(worker_id);
+        FindSession task(id);
+        Semaphore sem;
+
+        if (worker->post(&task, &sem))
+        {
+            sem.wait();
+            session = task.session();
+        }
+    }
 
     return session;
 }
@@ -1057,8 +1190,8 @@ json_t* session_json_data(const MXS_SESSION *session, const char *host)
 
     if (session->client_dcb->state == DCB_STATE_POLLING)
     {
-        double idle = (hkheartbeat - session->client_dcb->last_read);
-        idle = idle > 0 ? idle / 10.f : 0;
+        double idle = ((int64_t)mxs_worker_timer_now() - session->client_dcb->last_read);
+        idle = idle > 0 ? idle / 1000.f : 0;
         json_object_set_new(attr, "idle", json_real(idle));
     }
 
@@ -1075,28 +1208,126 @@ json_t* session_to_json(const MXS_SESSION *session, const char *host)
     return mxs_json_resource(host, ss.str().c_str(), session_json_data(session, host));
 }
 
-struct SessionListData
+namespace
 {
-    json_t* json;
-    const char* host;
-};
 
-bool seslist_cb(DCB* dcb, void* data)
+bool session_id_less(const MXS_SESSION* pLhs, const MXS_SESSION* pRhs)
 {
-    if (dcb->dcb_role == DCB_ROLE_CLIENT_HANDLER)
+    return pLhs->ses_id < pRhs->ses_id;
+}
+
+/**
+ * Serializes the matching sessions of each worker. A worker only accesses
+ * its own sessions and its own result.
+ */
+class SerializeSessions : public mxs::WorkerTask
+{
+public:
+    SerializeSessions(const mxs::SessionListFilter& filter, const char* zHost, int flags)
+        : m_filter(filter)
+        , m_zHost(zHost)
+        , m_flags(flags)
+        , m_results(config_threadcount())
     {
-        SessionListData* d = (SessionListData*)data;
-        json_array_append_new(d->json, session_json_data(dcb->session, d->host));
     }
 
-    return true;
+    void execute(Worker& worker)
+    {
+        const Worker::SessionsById& registry = worker.session_registry();
+        std::vector<MXS_SESSION*> sessions;
+
+        for (Worker::SessionsById::const_iterator i = registry.begin(); i != registry.end(); ++i)
+        {
+            if (matches(i->second))
+            {
+                sessions.push_back(i->second);
+            }
+        }
+
+        // Only the sessions with the smallest ids can be included in the end.
+        size_t n = sessions.size();
+
+        if (m_filter.limit != 0 && m_filter.limit < n)
+        {
+            n = m_filter.limit;
+        }
+
+        std::partial_sort(sessions.begin(), sessions.begin() + n, sessions.end(), session_id_less);
+
+        mxs::SerializedSessions& result = m_results[worker.id()];
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            json_t* pJson = session_json_data(sessions[i], m_zHost);
+            result.push_back(std::make_pair(sessions[i]->ses_id, mxs::json_dump(pJson, m_flags)));
+            json_decref(pJson);
+        }
+    }
+
+    mxs::SerializedSessions result() const
+    {
+        mxs::SerializedSessions sessions;
+
+        for (std::vector<mxs::SerializedSessions>::const_iterator i = m_results.begin();
+             i != m_results.end(); ++i)
+        {
+            sessions.insert(sessions.end(), i->begin(), i->end());
+        }
+
+        std::sort(sessions.begin(), sessions.end());
+
+        if (m_filter.limit != 0 && m_filter.limit < sessions.size())
+        {
+            sessions.resize(m_filter.limit);
+        }
+
+        return sessions;
+    }
+
+private:
+    bool matches(const MXS_SESSION* pSession) const
+    {
+        const char* zUser = pSession->client_dcb->user;
+
+        return pSession->ses_id > m_filter.after &&
+               (m_filter.service.empty() || m_filter.service == pSession->service->name) &&
+               (m_filter.user.empty() || (zUser && m_filter.user == zUser));
+    }
+
+    const mxs::SessionListFilter&        m_filter;
+    const char*                          m_zHost;
+    int                                  m_flags;
+    std::vector<mxs::SerializedSessions> m_results;
+};
+
 }
 
-json_t* session_list_to_json(const char* host)
+namespace maxscale
+{
+
+SerializedSessions session_list_serialize(const SessionListFilter& filter, const char* host, int flags)
 {
-    SessionListData data = {json_array(), host};
-    dcb_foreach(seslist_cb, &data);
-    return mxs_json_resource(host, MXS_JSON_API_SESSIONS, data.json);
+    SerializeSessions task(filter, host, flags);
+
+    if (filter.worker_id == -1)
+    {
+        Worker::execute_concurrently(task);
+    }
+    else
+    {
+        ss_dassert(filter.worker_id < config_threadcount());
+        Worker* worker = Worker::get(filter.worker_id);
+        Semaphore sem;
+
+        if (worker->post(&task, &sem))
+        {
+            sem.wait();
+        }
+    }
+
+    return task.result();
+}
+
 }
 
 void session_qualify_for_pool(MXS_SESSION* session)
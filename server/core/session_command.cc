@@ -13,11 +13,338 @@
 
 #include <maxscale/session_command.hh>
 
+#include <ctype.h>
 #include <maxscale/modutil.h>
 #include <maxscale/protocol/mysql.h>
 
 using namespace maxscale;
 
+namespace
+{
+
+/**
+ * Parser that recognizes statements which overwrite exactly one piece of
+ * session state with a constant value. Everything else is treated as
+ * having unknown effects.
+ */
+class StateKeyParser
+{
+    StateKeyParser(const StateKeyParser&);
+    StateKeyParser& operator=(const StateKeyParser&);
+
+public:
+    StateKeyParser(const char* pSql, size_t len)
+        : m_pI(pSql)
+        , m_pEnd(pSql + len)
+        , m_has_string(false)
+    {
+    }
+
+    /**
+     * Parse the statement
+     *
+     * @return The state key or an empty string if the statement is not recognized
+     */
+    std::string parse()
+    {
+        std::string key;
+
+        bypass_whitespace();
+
+        if (consume_keyword("USE"))
+        {
+            bypass_whitespace();
+
+            if (consume_identifier(NULL) && is_statement_end())
+            {
+                key = "USE";
+            }
+        }
+        else if (consume_keyword("SET"))
+        {
+            bypass_whitespace();
+            key = parse_set();
+        }
+
+        return key;
+    }
+
+    /**
+     * @return True if the assigned value contains a string literal
+     */
+    bool has_string() const
+    {
+        return m_has_string;
+    }
+
+private:
+    std::string parse_set()
+    {
+        std::string key;
+
+        if (consume_keyword("NAMES"))
+        {
+            key = "NAMES";
+        }
+        else
+        {
+            std::string prefix = "@@";
+
+            if (consume_char('@'))
+            {
+                if (consume_char('@'))
+                {
+                    if (consume_keyword("SESSION") || consume_keyword("LOCAL"))
+                    {
+                        if (!consume_char('.'))
+                        {
+                            return key;
+                        }
+                    }
+                    else if (consume_keyword("GLOBAL"))
+                    {
+                        return key;
+                    }
+                }
+                else
+                {
+                    prefix = "@";
+                }
+            }
+            else if (consume_keyword("GLOBAL"))
+            {
+                return key;
+            }
+            else if (consume_keyword("SESSION") || consume_keyword("LOCAL"))
+            {
+                bypass_whitespace();
+            }
+
+            std::string name;
+
+            // The SQL mode changes how all following statements are parsed
+            if (!consume_identifier(&name) || (prefix == "@@" && name == "sql_mode"))
+            {
+                return key;
+            }
+
+            bypass_whitespace();
+
+            if (consume_char(':'))
+            {
+                if (m_pI == m_pEnd || *m_pI != '=')
+                {
+                    return key;
+                }
+            }
+            else if (m_pI == m_pEnd || *m_pI != '=')
+            {
+                return key;
+            }
+
+            ++m_pI;
+            key = prefix + name;
+        }
+
+        if (!is_constant_value())
+        {
+            key.clear();
+        }
+
+        return key;
+    }
+
+    static bool is_identifier_char(char c)
+    {
+        return isalnum(c) || c == '_' || c == '$';
+    }
+
+    void bypass_whitespace()
+    {
+        while (m_pI != m_pEnd && isspace(*m_pI))
+        {
+            ++m_pI;
+        }
+    }
+
+    bool consume_char(char c)
+    {
+        bool rval = false;
+
+        if (m_pI != m_pEnd && *m_pI == c)
+        {
+            ++m_pI;
+            rval = true;
+        }
+
+        return rval;
+    }
+
+    /**
+     * Consume a keyword, the keyword must be given in upper case
+     */
+    bool consume_keyword(const char* zKeyword)
+    {
+        const char* pI = m_pI;
+
+        while (*zKeyword && pI != m_pEnd && toupper(*pI) == *zKeyword)
+        {
+            ++pI;
+            ++zKeyword;
+        }
+
+        bool rval = false;
+
+        if (*zKeyword == '\0' && (pI == m_pEnd || !is_identifier_char(*pI)))
+        {
+            m_pI = pI;
+            rval = true;
+        }
+
+        return rval;
+    }
+
+    /**
+     * Consume a plain or a backtick quoted identifier, the name is stored in lower case
+     */
+    bool consume_identifier(std::string* pName)
+    {
+        const char* pStart = m_pI;
+        const char* pI = m_pI;
+        std::string name;
+
+        if (pI != m_pEnd && *pI == '`')
+        {
+            ++pI;
+
+            while (pI != m_pEnd && *pI != '`')
+            {
+                name += tolower(*pI++);
+            }
+
+            if (pI == m_pEnd)
+            {
+                return false;
+            }
+
+            ++pI;
+        }
+        else
+        {
+            while (pI != m_pEnd && is_identifier_char(*pI))
+            {
+                name += tolower(*pI++);
+            }
+        }
+
+        bool rval = false;
+
+        if (pI != pStart && !name.empty())
+        {
+            m_pI = pI;
+            rval = true;
+
+            if (pName)
+            {
+                pName->swap(name);
+            }
+        }
+
+        return rval;
+    }
+
+    bool is_statement_end()
+    {
+        bypass_whitespace();
+
+        if (consume_char(';'))
+        {
+            bypass_whitespace();
+        }
+
+        return m_pI == m_pEnd;
+    }
+
+    /**
+     * Check that the rest of the statement is a value that does not read any
+     * session state. Variables, function calls, subqueries, comments, lists
+     * and identifiers that are not plain ASCII are rejected.
+     */
+    bool is_constant_value()
+    {
+        bool empty = true;
+
+        while (m_pI != m_pEnd)
+        {
+            char c = *m_pI;
+
+            if (c & 0x80)
+            {
+                return false;
+            }
+            else if (c == '\'' || c == '"')
+            {
+                ++m_pI;
+
+                while (m_pI != m_pEnd && *m_pI != c)
+                {
+                    if (*m_pI & 0x80)
+                    {
+                        return false;
+                    }
+                    else if (*m_pI == '\\' && m_pI + 1 != m_pEnd)
+                    {
+                        ++m_pI;
+                    }
+
+                    ++m_pI;
+                }
+
+                if (m_pI == m_pEnd)
+                {
+                    return false;
+                }
+
+                m_has_string = true;
+                empty = false;
+            }
+            else if (c == ';')
+            {
+                return !empty && is_statement_end();
+            }
+            else if (c == '@' || c == '(' || c == ',' || c == '`' || c == '#' || c == '/' ||
+                     (c == '-' && m_pI + 1 != m_pEnd && m_pI[1] == '-'))
+            {
+                return false;
+            }
+            else if (!isspace(c))
+            {
+                empty = false;
+            }
+
+            ++m_pI;
+        }
+
+        return !empty;
+    }
+
+    const char* m_pI;
+    const char* m_pEnd;
+    bool        m_has_string;
+};
+
+/**
+ * The character set of the connection decides how string literals are interpreted
+ */
+bool is_charset_key(const std::string& key)
+{
+    return key == "NAMES" ||
+           key.compare(0, 16, "@@character_set_") == 0 ||
+           key.compare(0, 12, "@@collation_") == 0;
+}
+
+}
+
 void SessionCommand::mark_reply_received()
 {
     m_reply_sent = true;
@@ -46,15 +373,41 @@ GWBUF* SessionCommand::deep_copy_buffer()
     return rval;
 }
 
+const std::string& SessionCommand::get_state_key() const
+{
+    return m_state_key;
+}
+
+bool SessionCommand::has_string_literal() const
+{
+    return m_has_string;
+}
+
 SessionCommand::SessionCommand(GWBUF *buffer, uint64_t id):
     m_buffer(buffer),
     m_command(0),
     m_pos(id),
-    m_reply_sent(false)
+    m_reply_sent(false),
+    m_has_string(false)
 {
     if (buffer)
     {
         gwbuf_copy_data(buffer, MYSQL_HEADER_LEN, 1, &m_command);
+
+        if (m_command == MXS_COM_INIT_DB)
+        {
+            m_state_key = "USE";
+        }
+        else if (m_command == MXS_COM_QUERY)
+        {
+            size_t len = gwbuf_length(buffer) - MYSQL_HEADER_LEN - 1;
+            std::string sql(len, '\0');
+            gwbuf_copy_data(buffer, MYSQL_HEADER_LEN + 1, len, (uint8_t*)&sql[0]);
+
+            StateKeyParser parser(sql.c_str(), sql.length());
+            m_state_key = parser.parse();
+            m_has_string = parser.has_string();
+        }
     }
 }
 
@@ -85,3 +438,45 @@ std::string SessionCommand::to_string()
 
     return str;
 }
+
+size_t maxscale::compact_session_commands(SessionCommandList& list, const SSessionCommand& sescmd,
+                                          std::vector<uint64_t>* removed)
+{
+    const std::string& key = sescmd->get_state_key();
+    size_t n_removed = 0;
+
+    if (!key.empty())
+    {
+        bool charset = is_charset_key(key);
+        SessionCommandList::iterator it = list.end();
+
+        // The command was most likely the last one to be added
+        while (it != list.begin() && *(--it) != sescmd)
+        {
+        }
+
+        while (it != list.begin())
+        {
+            --it;
+            const std::string& other = (*it)->get_state_key();
+
+            if (other == key)
+            {
+                if (removed)
+                {
+                    removed->push_back((*it)->get_position());
+                }
+
+                it = list.erase(it);
+                ++n_removed;
+            }
+            else if (other.empty() || (charset && (*it)->has_string_literal()))
+            {
+                // The command could depend on the state that would be removed
+                break;
+            }
+        }
+    }
+
+    return n_removed;
+}
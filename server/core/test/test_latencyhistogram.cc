@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <stdlib.h>
+#include <iostream>
+#include "../internal/latencyhistogram.hh"
+
+using namespace std;
+using maxscale::LatencyHistogram;
+
+namespace
+{
+
+int test_buckets()
+{
+    int rv = EXIT_SUCCESS;
+    int previous = -1;
+
+    // Every bucket must be used and contain exactly the values between its bounds.
+    for (int i = 0; i < LatencyHistogram::N_BUCKETS; ++i)
+    {
+        uint64_t lower = LatencyHistogram::lower_bound(i);
+        uint64_t upper = LatencyHistogram::upper_bound(i);
+
+        if (LatencyHistogram::index_of(lower) != i || LatencyHistogram::index_of(upper) != i
+            || (i != 0 && LatencyHistogram::index_of(lower - 1) != previous))
+        {
+            cout << "ERROR: Bucket " << i << " does not contain the values "
+                 << lower << " - " << upper << "." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        // The width of a bucket is at most 1/16th of its values.
+        if ((upper - lower + 1) * LatencyHistogram::SUB_BUCKETS > lower && (upper != lower))
+        {
+            cout << "ERROR: Bucket " << i << " is too wide." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        previous = i;
+    }
+
+    if (LatencyHistogram::index_of(UINT64_MAX) != LatencyHistogram::N_BUCKETS - 1)
+    {
+        cout << "ERROR: Large values do not end up in the last bucket." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+int test_percentiles()
+{
+    int rv = EXIT_SUCCESS;
+
+    LatencyHistogram histogram = LatencyHistogram();
+
+    if (histogram.count() != 0 || histogram.percentile(50) != 0)
+    {
+        cout << "ERROR: An empty histogram has values." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    for (uint64_t us = 1; us <= 10000; ++us)
+    {
+        histogram.record(us);
+    }
+
+    const double percents[] = { 1, 50, 90, 99, 99.9, 100 };
+
+    for (size_t i = 0; i < sizeof(percents) / sizeof(percents[0]); ++i)
+    {
+        uint64_t expected = percents[i] * 100;
+        uint64_t value = histogram.percentile(percents[i]);
+
+        // The value is the upper bound of the bucket, so it may be 1/16th larger.
+        if (value < expected || value > expected + expected / LatencyHistogram::SUB_BUCKETS)
+        {
+            cout << "ERROR: Percentile " << percents[i] << " is " << value
+                 << " instead of " << expected << "." << endl;
+            rv = EXIT_FAILURE;
+        }
+    }
+
+    LatencyHistogram total = LatencyHistogram();
+    total.add(histogram);
+    total.add(histogram);
+
+    if (total.count() != 20000 || total.max() != 10000)
+    {
+        cout << "ERROR: Adding histograms resulted in " << total.count()
+             << " values with the maximum " << total.max() << "." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+}
+
+int main()
+{
+    int rv = EXIT_SUCCESS;
+
+    if (test_buckets() != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    if (test_percentiles() != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
@@ -36,6 +36,8 @@
 #include <maxscale/alloc.h>
 #include <maxscale/modutil.h>
 #include <maxscale/buffer.h>
+#include <maxscale/protocol/mysql.h>
+#include <time.h>
 
 /**
  * test1    Allocate a service and do lots of other things
@@ -629,6 +631,256 @@ void test_bypass_whitespace()
     ss_info_dassert(*sql == 'S', "9");
 }
 
+/** An OK packet with SERVER_MORE_RESULTS_EXIST set */
+static const uint8_t ok_more[] =
+{
+    0x07, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00
+};
+
+/** An ERR packet */
+static const uint8_t err[] =
+{
+    0x09, 0x00, 0x00, 0x01, 0xff, 0x28, 0x04, 0x23, 0x34, 0x32, 0x30, 0x30, 0x30
+};
+
+static GWBUF* create_split_buffer(const uint8_t* data, size_t len, size_t chunk)
+{
+    GWBUF* buffer = NULL;
+
+    for (size_t i = 0; i < len; i += chunk)
+    {
+        buffer = gwbuf_append(buffer, gwbuf_alloc_and_load(MXS_MIN(chunk, len - i), data + i));
+    }
+
+    return buffer;
+}
+
+void test_reply_tracker()
+{
+    /** A result set, split in all possible ways and fed one part at a time */
+    for (size_t chunk = 1; chunk <= sizeof(resultset); chunk++)
+    {
+        MXS_REPLY_TRACKER tracker;
+        modutil_reply_tracker_init(&tracker, MXS_COM_QUERY);
+
+        for (size_t i = 0; i < sizeof(resultset); i += chunk)
+        {
+            ss_info_dassert(!modutil_reply_tracker_is_complete(&tracker), "Response should not be complete");
+            size_t len = MXS_MIN(chunk, sizeof(resultset) - i);
+            GWBUF* buffer = gwbuf_alloc_and_load(len, resultset + i);
+            ss_info_dassert(modutil_reply_tracker_consume(&tracker, buffer, 0) == len,
+                            "All data should be consumed");
+            gwbuf_free(buffer);
+        }
+
+        ss_info_dassert(modutil_reply_tracker_is_complete(&tracker), "Response should be complete");
+        ss_info_dassert(tracker.n_columns == 1, "There should be one column");
+        ss_info_dassert(tracker.n_rows == 1, "There should be one row");
+        ss_info_dassert(tracker.n_bytes == sizeof(resultset), "All bytes should be consumed");
+    }
+
+    /** A collected result, provided as a whole with an offset */
+    for (size_t chunk = 1; chunk <= sizeof(resultset); chunk++)
+    {
+        MXS_REPLY_TRACKER tracker;
+        modutil_reply_tracker_init(&tracker, MXS_COM_QUERY);
+        GWBUF* buffer = NULL;
+
+        for (size_t i = 0; i < sizeof(resultset); i += chunk)
+        {
+            size_t len = MXS_MIN(chunk, sizeof(resultset) - i);
+            buffer = gwbuf_append(buffer, gwbuf_alloc_and_load(len, resultset + i));
+            modutil_reply_tracker_consume(&tracker, buffer, tracker.n_bytes);
+        }
+
+        ss_info_dassert(modutil_reply_tracker_is_complete(&tracker), "Response should be complete");
+        ss_info_dassert(tracker.n_bytes == sizeof(resultset), "All bytes should be consumed");
+        gwbuf_free(buffer);
+    }
+
+    /** An OK packet followed by more results, and data following the response */
+    uint8_t multi[sizeof(ok_more) + 2 * sizeof(resultset)];
+    memcpy(multi, ok_more, sizeof(ok_more));
+    memcpy(multi + sizeof(ok_more), resultset, sizeof(resultset));
+    memcpy(multi + sizeof(ok_more) + sizeof(resultset), resultset, sizeof(resultset));
+
+    for (size_t chunk = 1; chunk <= sizeof(multi); chunk++)
+    {
+        MXS_REPLY_TRACKER tracker;
+        modutil_reply_tracker_init(&tracker, MXS_COM_QUERY);
+        GWBUF* buffer = create_split_buffer(multi, sizeof(multi), chunk);
+
+        size_t consumed = modutil_reply_tracker_consume(&tracker, buffer, 0);
+        ss_info_dassert(modutil_reply_tracker_is_complete(&tracker), "Response should be complete");
+        ss_info_dassert(consumed == sizeof(ok_more) + sizeof(resultset),
+                        "Data following the response should not be consumed");
+        ss_info_dassert(tracker.n_results == 2, "There should be two results");
+        gwbuf_free(buffer);
+    }
+
+    /** An error */
+    MXS_REPLY_TRACKER tracker;
+    modutil_reply_tracker_init(&tracker, MXS_COM_QUERY);
+    GWBUF* buffer = gwbuf_alloc_and_load(sizeof(err), err);
+    ss_info_dassert(modutil_reply_tracker_consume(&tracker, buffer, 0) == sizeof(err), "All data should be consumed");
+    ss_info_dassert(modutil_reply_tracker_is_complete(&tracker), "Response should be complete");
+    gwbuf_free(buffer);
+
+    /** Rows of a COM_STMT_FETCH, that is, packets 4 and 5 of the result set */
+    modutil_reply_tracker_init(&tracker, MXS_COM_STMT_FETCH);
+    buffer = gwbuf_alloc_and_load(PACKET_4_LEN + PACKET_5_LEN, resultset + PACKET_4_IDX);
+    modutil_reply_tracker_consume(&tracker, buffer, 0);
+    ss_info_dassert(modutil_reply_tracker_is_complete(&tracker), "Response should be complete");
+    ss_info_dassert(tracker.n_rows == 1, "There should be one row");
+    gwbuf_free(buffer);
+}
+
+/**
+ * Compare the tracking of a multi-megabyte result set that arrives in parts
+ * and is collected into one buffer, by repeatedly counting the signal packets
+ * of the contiguous collected buffer and by using a reply tracker.
+ */
+void test_reply_tracker_performance()
+{
+    const size_t n_rows = 20000;
+    const size_t row_len = 200;
+    const size_t chunk = 64 * 1024;
+
+    size_t len = PACKET_1_LEN + PACKET_2_LEN + PACKET_3_LEN + n_rows * (MYSQL_HEADER_LEN + row_len) + PACKET_5_LEN;
+    uint8_t* data = (uint8_t*)MXS_MALLOC(len);
+    MXS_ABORT_IF_NULL(data);
+
+    uint8_t* ptr = data;
+    memcpy(ptr, resultset, PACKET_4_IDX);
+    ptr += PACKET_4_IDX;
+
+    for (size_t i = 0; i < n_rows; i++)
+    {
+        gw_mysql_set_byte3(ptr, row_len);
+        ptr[3] = 0;
+        ptr[4] = row_len - 1;
+        memset(ptr + 5, 'x', row_len - 1);
+        ptr += MYSQL_HEADER_LEN + row_len;
+    }
+
+    memcpy(ptr, resultset + PACKET_5_IDX, PACKET_5_LEN);
+
+    clock_t start = clock();
+    GWBUF* collected = NULL;
+    bool complete = false;
+
+    for (size_t i = 0; i < len; i += chunk)
+    {
+        collected = gwbuf_append(collected, gwbuf_alloc_and_load(MXS_MIN(chunk, len - i), data + i));
+        GWBUF* tmp = gwbuf_make_contiguous(collected);
+        MXS_ABORT_IF_NULL(tmp);
+        collected = tmp;
+
+        bool more;
+        int n_eof = modutil_count_signal_packets(collected, 0, &more, NULL);
+        complete = (n_eof == 2);
+    }
+
+    double rescan = (double)(clock() - start) / CLOCKS_PER_SEC;
+    ss_info_dassert(complete, "Response should be complete");
+    gwbuf_free(collected);
+
+    start = clock();
+    collected = NULL;
+    MXS_REPLY_TRACKER tracker;
+    modutil_reply_tracker_init(&tracker, MXS_COM_QUERY);
+
+    for (size_t i = 0; i < len; i += chunk)
+    {
+        collected = gwbuf_append(collected, gwbuf_alloc_and_load(MXS_MIN(chunk, len - i), data + i));
+        modutil_reply_tracker_consume(&tracker, collected, tracker.n_bytes);
+    }
+
+    GWBUF* tmp = gwbuf_make_contiguous(collected);
+    MXS_ABORT_IF_NULL(tmp);
+    collected = tmp;
+
+    double tracked = (double)(clock() - start) / CLOCKS_PER_SEC;
+    ss_info_dassert(modutil_reply_tracker_is_complete(&tracker), "Response should be complete");
+    ss_info_dassert(tracker.n_rows == n_rows, "All rows should be counted");
+    gwbuf_free(collected);
+
+    printf("Result set of %lu bytes arriving in %lu byte parts: rescanning %f s, tracking %f s.\n",
+           len, chunk, rescan, tracked);
+
+    MXS_FREE(data);
+}
+
+void test_canonical()
+{
+    struct
+    {
+        const char* sql;
+        const char* canonical;
+    } tests[] =
+    {
+        {
+            "SELECT * FROM t1 WHERE a = 1 AND b = 'x' /* comment */",
+            "SELECT * FROM t1 WHERE a = ? AND b = '?'"
+        },
+        {
+            "  SELECT\t@a,   -5 , `c -- d` -- comment\n FROM t1",
+            "SELECT @?, ? , `c ? d` FROM t1"
+        },
+        {
+            "SELECT /*!40101 1 */ \"it's\" # comment",
+            "SELECT /*!? ? */ \"?\""
+        }
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        GWBUF* buffer = modutil_create_query(tests[i].sql);
+        char* canonical = modutil_get_canonical(buffer);
+        size_t len;
+        const char* ref = modutil_get_canonical_r(buffer, &len);
+
+        ss_info_dassert(canonical && strcmp(canonical, tests[i].canonical) == 0,
+                        "The canonical form should be as expected");
+        ss_info_dassert(ref && len == strlen(ref) && strcmp(ref, canonical) == 0,
+                        "The canonical forms should be identical");
+
+        MXS_FREE(canonical);
+        gwbuf_free(buffer);
+    }
+}
+
+static void test_canonical_throughput(const char* name, const char* sql, int n)
+{
+    GWBUF* buffer = modutil_create_query(sql);
+    clock_t start = clock();
+
+    for (int i = 0; i < n; i++)
+    {
+        modutil_get_canonical_r(buffer, NULL);
+    }
+
+    double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("Canonicalized %s statements of %lu bytes at %.0f statements/s.\n",
+           name, strlen(sql), secs > 0 ? n / secs : 0);
+
+    gwbuf_free(buffer);
+}
+
+void test_canonical_performance()
+{
+    test_canonical_throughput("short", "SELECT * FROM t1 WHERE id = 1 AND name = 'abc'", 100000);
+
+    char sql[5000] = "INSERT INTO t1 (id, name, value) VALUES ";
+
+    for (int i = 0; strlen(sql) < 4096; i++)
+    {
+        sprintf(sql + strlen(sql), "%s(%d, 'name %d', %d.5)", i ? ", " : "", i, i, i * 7);
+    }
+
+    test_canonical_throughput("long", sql, 2000);
+}
+
 int main(int argc, char **argv)
 {
     int result = 0;
@@ -643,5 +895,9 @@ int main(int argc, char **argv)
     test_strnchr_esc_mysql();
     test_large_packets();
     test_bypass_whitespace();
+    test_reply_tracker();
+    test_reply_tracker_performance();
+    test_canonical();
+    test_canonical_performance();
     exit(result);
 }
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+#include "../internal/persistentpool.hh"
+
+using namespace std;
+using maxscale::PersistentPool;
+
+namespace
+{
+
+char* USERS[] = { (char*)"alice", (char*)"bob", (char*)"carol" };
+char* HOSTS[] = { (char*)"127.0.0.1", (char*)"192.168.0.1" };
+char* PROTOCOL = (char*)"MySQLBackend";
+
+const size_t N_USERS = sizeof(USERS) / sizeof(USERS[0]);
+const size_t N_HOSTS = sizeof(HOSTS) / sizeof(HOSTS[0]);
+
+void init(vector<DCB>& dcbs)
+{
+    for (size_t i = 0; i < dcbs.size(); ++i)
+    {
+        DCB& dcb = dcbs[i];
+        dcb.user = USERS[i % N_USERS];
+        dcb.remote = HOSTS[(i / N_USERS) % N_HOSTS];
+        dcb.protoname = PROTOCOL;
+    }
+}
+
+int test_take()
+{
+    int rv = EXIT_SUCCESS;
+    const size_t N = 60;
+
+    PersistentPool pool;
+    vector<DCB> dcbs(N, DCB());
+    init(dcbs);
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        pool.add(&dcbs[i]);
+    }
+
+    if (pool.take("alice", "10.0.0.1", PROTOCOL) || pool.take("alice", HOSTS[0], "other"))
+    {
+        cout << "ERROR: A DCB that does not match was taken." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    // The most recently added matching DCB should be taken first.
+    for (size_t i = N; i-- > 0;)
+    {
+        DCB* pDcb = pool.take(dcbs[i].user, dcbs[i].remote, PROTOCOL);
+
+        if (pDcb != &dcbs[i])
+        {
+            cout << "ERROR: Expected DCB " << i << " but got " << pDcb << "." << endl;
+            rv = EXIT_FAILURE;
+        }
+    }
+
+    if (pool.size() != 0 || pool.oldest())
+    {
+        cout << "ERROR: " << pool.size() << " DCBs remain in the pool." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+int test_remove()
+{
+    int rv = EXIT_SUCCESS;
+    const size_t N = 99;
+
+    PersistentPool pool;
+    vector<DCB> dcbs(N, DCB());
+    init(dcbs);
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        pool.add(&dcbs[i]);
+    }
+
+    // Every third DCB is removed, then the rest should be found from
+    // the oldest onwards in the order they were added.
+    for (size_t i = 0; i < N; i += 3)
+    {
+        pool.remove(&dcbs[i]);
+    }
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        if (i % 3 != 0)
+        {
+            DCB* pDcb = pool.oldest();
+
+            if (pDcb != &dcbs[i])
+            {
+                cout << "ERROR: Expected oldest DCB " << i << " but got " << pDcb << "." << endl;
+                rv = EXIT_FAILURE;
+                break;
+            }
+
+            pool.remove(pDcb);
+        }
+    }
+
+    if (pool.size() != 0 || pool.oldest())
+    {
+        cout << "ERROR: " << pool.size() << " DCBs remain in the pool." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+int test_random()
+{
+    int rv = EXIT_SUCCESS;
+    const size_t N = 1000;
+
+    PersistentPool pool;
+    vector<DCB> dcbs(N, DCB());
+    vector<bool> pooled(N, false);
+    init(dcbs);
+
+    size_t n_pooled = 0;
+
+    for (size_t k = 0; k < 100000; ++k)
+    {
+        size_t i = random() % N;
+
+        if (!pooled[i])
+        {
+            pool.add(&dcbs[i]);
+            pooled[i] = true;
+            ++n_pooled;
+        }
+        else if (random() % 2)
+        {
+            pool.remove(&dcbs[i]);
+            pooled[i] = false;
+            --n_pooled;
+        }
+        else
+        {
+            DCB* pDcb = pool.take(dcbs[i].user, dcbs[i].remote, PROTOCOL);
+
+            if (!pDcb || pDcb->user != dcbs[i].user || pDcb->remote != dcbs[i].remote)
+            {
+                cout << "ERROR: A matching DCB was not taken." << endl;
+                return EXIT_FAILURE;
+            }
+
+            pooled[pDcb - &dcbs[0]] = false;
+            --n_pooled;
+        }
+    }
+
+    if (pool.size() != n_pooled)
+    {
+        cout << "ERROR: The pool has " << pool.size() << " DCBs instead of " << n_pooled << "." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    while (DCB* pDcb = pool.oldest())
+    {
+        if (!pooled[pDcb - &dcbs[0]])
+        {
+            cout << "ERROR: A DCB not in the pool was found." << endl;
+            return EXIT_FAILURE;
+        }
+
+        pool.remove(pDcb);
+    }
+
+    return rv;
+}
+
+}
+
+int main()
+{
+    int rv = EXIT_SUCCESS;
+
+    if (test_take() != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    if (test_remove() != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    if (test_random() != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <maxscale/modutil.h>
+#include <maxscale/session_command.hh>
+
+using namespace maxscale;
+using namespace std;
+
+namespace
+{
+
+struct key_test_case
+{
+    const char* zStmt;
+    const char* zKey;
+} key_test_cases[] =
+{
+    { "USE test", "USE" },
+    { "use `my db`;", "USE" },
+    { "USE", "" },
+    { "USE test; SELECT 1", "" },
+
+    { "SET NAMES utf8", "NAMES" },
+    { "set names utf8mb4 collate utf8mb4_bin", "NAMES" },
+    { "SET CHARACTER SET utf8", "" },
+
+    { "SET @a = 1", "@a" },
+    { "SET @A := 'x'", "@a" },
+    { "SET @a=1;", "@a" },
+    { "SET @a = -1.5e3", "@a" },
+    { "SET @a = NULL", "@a" },
+    { "SET @a = @b", "" },
+    { "SET @a = @a + 1", "" },
+    { "SET @a = NOW()", "" },
+    { "SET @a = (SELECT 1)", "" },
+    { "SET @a = 1, @b = 2", "" },
+    { "SET @a = 1 /* comment */", "" },
+    { "SET @a = 1 -- comment", "" },
+    { "SET @a = 1; SET @b = 2", "" },
+    { "SET @a =", "" },
+    { "SET @a = 'caf\xc3\xa9'", "" },
+
+    { "SET autocommit=1", "@@autocommit" },
+    { "SET SESSION autocommit = 0", "@@autocommit" },
+    { "SET LOCAL autocommit = 0", "@@autocommit" },
+    { "SET @@autocommit = 0", "@@autocommit" },
+    { "SET @@session.autocommit = 0", "@@autocommit" },
+    { "SET @@LOCAL.AUTOCOMMIT = 0", "@@autocommit" },
+    { "SET local_infile = 0", "@@local_infile" },
+    { "SET GLOBAL autocommit = 0", "" },
+    { "SET @@global.autocommit = 0", "" },
+    { "SET sql_mode = 'ANSI_QUOTES'", "" },
+    { "SET SESSION TRANSACTION ISOLATION LEVEL READ COMMITTED", "" },
+    { "SET TRANSACTION READ ONLY", "" },
+    { "SET STATEMENT max_statement_time=1 FOR SELECT 1", "" },
+
+    { "SELECT 1", "" },
+    { "PREPARE ps FROM 'SELECT 1'", "" },
+};
+
+const size_t n_key_test_cases = sizeof(key_test_cases) / sizeof(key_test_cases[0]);
+
+int test_keys()
+{
+    int rc = 0;
+
+    for (size_t i = 0; i < n_key_test_cases; ++i)
+    {
+        const key_test_case& test = key_test_cases[i];
+        SessionCommand sescmd(modutil_create_query(test.zStmt), i);
+
+        if (sescmd.get_state_key() != test.zKey)
+        {
+            cout << "ERROR: `" << test.zStmt << "` produced key '" << sescmd.get_state_key()
+                 << "', expected '" << test.zKey << "'." << endl;
+            rc = 1;
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * A recorded session command history. Each command is assumed to succeed and
+ * the history is compacted after each command. The statements that remain in
+ * the history are compared to the expected ones.
+ */
+struct history_test_case
+{
+    const char* zName;
+    const char* azHistory[16];
+    const char* azExpected[16];
+} history_test_cases[] =
+{
+    {
+        "Connector initialization repeated by a pool",
+        {
+            "SET NAMES utf8", "SET autocommit=1", "USE app",
+            "SET NAMES utf8", "SET autocommit=1", "USE app",
+            "SET NAMES utf8", "SET autocommit=0", "USE app2",
+            NULL
+        },
+        {
+            "SET NAMES utf8", "SET autocommit=0", "USE app2",
+            NULL
+        }
+    },
+    {
+        "Different ways of setting the same variable",
+        {
+            "SET autocommit=1", "SET SESSION autocommit=0", "SET @@session.autocommit=1",
+            "SET @@autocommit=0",
+            NULL
+        },
+        {
+            "SET @@autocommit=0",
+            NULL
+        }
+    },
+    {
+        "User variables",
+        {
+            "SET @a = 1", "SET @b = 2", "SET @A = 3", "SET @b = 4",
+            NULL
+        },
+        {
+            "SET @A = 3", "SET @b = 4",
+            NULL
+        }
+    },
+    {
+        "Command reading a variable stops compaction",
+        {
+            "SET @a = 1", "SET @b = @a", "SET @a = 2", "SET @a = 3",
+            NULL
+        },
+        {
+            "SET @a = 1", "SET @b = @a", "SET @a = 3",
+            NULL
+        }
+    },
+    {
+        "Unknown commands stop compaction",
+        {
+            "USE a", "SET sql_mode='ANSI'", "USE b", "PREPARE ps FROM 'SELECT 1'", "USE c",
+            NULL
+        },
+        {
+            "USE a", "SET sql_mode='ANSI'", "USE b", "PREPARE ps FROM 'SELECT 1'", "USE c",
+            NULL
+        }
+    },
+    {
+        "String literals depend on the character set",
+        {
+            "SET NAMES latin1", "SET @a = 'x'", "SET NAMES utf8", "SET @b = 1", "SET NAMES utf8mb4",
+            NULL
+        },
+        {
+            "SET NAMES latin1", "SET @a = 'x'", "SET @b = 1", "SET NAMES utf8mb4",
+            NULL
+        }
+    },
+};
+
+const size_t n_history_test_cases = sizeof(history_test_cases) / sizeof(history_test_cases[0]);
+
+int test_history(const history_test_case& test)
+{
+    int rc = 0;
+    SessionCommandList history;
+    std::vector<uint64_t> removed;
+    size_t n_removed = 0;
+    uint64_t id = 1;
+
+    for (const char* const* pzStmt = test.azHistory; *pzStmt; ++pzStmt)
+    {
+        SSessionCommand sescmd(new SessionCommand(modutil_create_query(*pzStmt), id++));
+        history.push_back(sescmd);
+        n_removed += compact_session_commands(history, sescmd, &removed);
+    }
+
+    if (n_removed != removed.size())
+    {
+        cout << "ERROR: " << test.zName << ": returned " << n_removed << " removed commands but "
+             << removed.size() << " positions were reported." << endl;
+        rc = 1;
+    }
+
+    SessionCommandList::iterator it = history.begin();
+    const char* const* pzExpected = test.azExpected;
+
+    while (it != history.end() && *pzExpected)
+    {
+        if ((*it)->to_string() != *pzExpected)
+        {
+            cout << "ERROR: " << test.zName << ": found `" << (*it)->to_string()
+                 << "`, expected `" << *pzExpected << "`." << endl;
+            rc = 1;
+        }
+
+        ++it;
+        ++pzExpected;
+    }
+
+    if (it != history.end() || *pzExpected)
+    {
+        cout << "ERROR: " << test.zName << ": history has the wrong number of commands." << endl;
+        rc = 1;
+    }
+
+    return rc;
+}
+
+int test_histories()
+{
+    int rc = 0;
+
+    for (size_t i = 0; i < n_history_test_cases; ++i)
+    {
+        rc |= test_history(history_test_cases[i]);
+    }
+
+    return rc;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int rc = 0;
+
+    rc |= test_keys();
+    rc |= test_histories();
+
+    cout << (rc == 0 ? "OK" : "ERROR") << endl;
+
+    return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+#include "../internal/timerwheel.hh"
+
+using namespace std;
+using maxscale::TimerWheel;
+
+namespace
+{
+
+TimerWheel* pWheel;
+
+struct Expected
+{
+    uint64_t expires;  // When the timer should expire.
+    uint64_t expired;  // When the timer did expire, 0 if not yet.
+    uint32_t period;   // If non-zero, the timer is added again with this delay.
+    size_t   count;    // How many times the timer has expired.
+};
+
+void expired_cb(MXS_WORKER_TIMER* pTimer)
+{
+    Expected* pExpected = static_cast<Expected*>(pTimer->data);
+
+    pExpected->expired = pWheel->now();
+    ++pExpected->count;
+
+    if (pExpected->period)
+    {
+        pExpected->expires = pWheel->now() + pExpected->period;
+        pWheel->add(pTimer, pExpected->period);
+    }
+}
+
+void add(MXS_WORKER_TIMER* pTimer, Expected* pExpected, uint64_t delay)
+{
+    pTimer->callback = expired_cb;
+    pTimer->data = pExpected;
+    // A timer added with no delay expires at the next millisecond.
+    pExpected->expires = pWheel->now() + (delay ? delay : 1);
+    pExpected->expired = 0;
+    pWheel->add(pTimer, delay);
+}
+
+int test_expiration()
+{
+    int rv = EXIT_SUCCESS;
+    const size_t N = 9999;
+
+    // Delays that exercise all levels of the wheel.
+    const uint64_t max_delays[] = { 256, 65536, 1 << 20, 1 << 25 };
+
+    for (size_t k = 0; k < sizeof(max_delays) / sizeof(max_delays[0]); ++k)
+    {
+        TimerWheel wheel(12345);
+        pWheel = &wheel;
+
+        vector<MXS_WORKER_TIMER> timers(N, MXS_WORKER_TIMER());
+        vector<Expected> expected(N, Expected());
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            add(&timers[i], &expected[i], random() % max_delays[k]);
+        }
+
+        // Every third timer is cancelled and every third is rescheduled.
+        for (size_t i = 0; i < N; i += 3)
+        {
+            wheel.cancel(&timers[i]);
+            add(&timers[i + 1], &expected[i + 1], random() % max_delays[k]);
+        }
+
+        uint64_t end = wheel.now() + max_delays[k] + 1;
+
+        while (wheel.now() < end)
+        {
+            wheel.advance(wheel.now() + 1 + random() % 1000);
+        }
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            bool cancelled = (i % 3 == 0);
+
+            if (cancelled ? (expected[i].expired != 0) : (expected[i].expired != expected[i].expires))
+            {
+                cout << "ERROR: Timer " << i << " should have expired at " << expected[i].expires
+                     << " but expired at " << expected[i].expired << "." << endl;
+                rv = EXIT_FAILURE;
+            }
+        }
+
+        if (wheel.size() != 0)
+        {
+            cout << "ERROR: " << wheel.size() << " timers remain in the wheel." << endl;
+            rv = EXIT_FAILURE;
+        }
+    }
+
+    return rv;
+}
+
+int test_periodic()
+{
+    int rv = EXIT_SUCCESS;
+
+    TimerWheel wheel(0);
+    pWheel = &wheel;
+
+    MXS_WORKER_TIMER timer = MXS_WORKER_TIMER();
+    Expected expected = Expected();
+    expected.period = 300;
+
+    add(&timer, &expected, expected.period);
+    wheel.advance(300 * 1000);
+
+    if (expected.count != 1000 || !mxs_worker_timer_is_active(&timer))
+    {
+        cout << "ERROR: A periodic timer expired " << expected.count << " times." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    wheel.cancel(&timer);
+
+    if (wheel.size() != 0 || mxs_worker_timer_is_active(&timer))
+    {
+        cout << "ERROR: A cancelled timer is still active." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+int test_next_timeout()
+{
+    int rv = EXIT_SUCCESS;
+
+    TimerWheel wheel(0);
+    pWheel = &wheel;
+
+    if (wheel.next_timeout(0) != -1)
+    {
+        cout << "ERROR: An empty wheel has a timeout." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    const size_t N = 100;
+    vector<MXS_WORKER_TIMER> timers(N, MXS_WORKER_TIMER());
+    vector<Expected> expected(N, Expected());
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        add(&timers[i], &expected[i], 1 + random() % 100000);
+    }
+
+    size_t n_expired = 0;
+
+    // All timers should have expired long before the end.
+    while (wheel.size() != 0 && wheel.now() < 1000000)
+    {
+        int64_t timeout = wheel.next_timeout(wheel.now());
+
+        if (timeout <= 0)
+        {
+            cout << "ERROR: Invalid timeout " << timeout << "." << endl;
+            return EXIT_FAILURE;
+        }
+
+        // Nothing may expire before the timeout.
+        if (wheel.advance(wheel.now() + timeout - 1) != 0)
+        {
+            cout << "ERROR: Timers expired before the timeout." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        n_expired += wheel.advance(wheel.now() + 1);
+    }
+
+    if (n_expired != N)
+    {
+        cout << "ERROR: " << n_expired << " timers expired instead of " << N << "." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+}
+
+int main()
+{
+    int rv = EXIT_SUCCESS;
+
+    if (test_expiration() != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    if (test_periodic() != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    if (test_next_timeout() != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "internal/timerwheel.hh"
+#include <string.h>
+#include <maxscale/debug.h>
+
+namespace
+{
+
+const uint64_t MAX_DELAY = 0xffffffff;
+
+}
+
+namespace maxscale
+{
+
+TimerWheel::TimerWheel(uint64_t now)
+    : m_next(now + 1)
+    , m_size(0)
+    , m_expired(NULL)
+{
+    memset(m_slots, 0, sizeof(m_slots));
+}
+
+void TimerWheel::add(Timer* pTimer, uint64_t delay)
+{
+    if (pTimer->slot)
+    {
+        unlink(pTimer);
+    }
+    else
+    {
+        ++m_size;
+    }
+
+    pTimer->expires = now() + (delay < MAX_DELAY ? delay : MAX_DELAY);
+    insert(pTimer);
+}
+
+void TimerWheel::cancel(Timer* pTimer)
+{
+    if (pTimer->slot)
+    {
+        unlink(pTimer);
+        --m_size;
+    }
+}
+
+size_t TimerWheel::advance(uint64_t now)
+{
+    size_t n = 0;
+
+    if (m_size == 0 && now >= m_next)
+    {
+        // Nothing to expire or to rearrange, so the time can simply be moved.
+        m_next = now + 1;
+    }
+
+    while (m_next <= now)
+    {
+        int index = m_next & SLOT_MASK;
+
+        // When the first level has gone full circle, the timers of the next
+        // slot of the second level are moved down, and so on.
+        if (index == 0 && cascade(1) == 0 && cascade(2) == 0)
+        {
+            cascade(3);
+        }
+
+        // The expired timers are moved aside, so that a timer that a callback
+        // adds can never end up among the ones being processed.
+        ss_dassert(!m_expired);
+        Timer* pTimer = m_slots[0][index];
+        m_slots[0][index] = NULL;
+
+        for (Timer* p = pTimer; p; p = p->next)
+        {
+            p->slot = &m_expired;
+        }
+
+        m_expired = pTimer;
+        ++m_next;
+
+        while ((pTimer = m_expired) != NULL)
+        {
+            unlink(pTimer);
+            --m_size;
+            ++n;
+
+            pTimer->callback(pTimer);
+        }
+    }
+
+    return n;
+}
+
+int64_t TimerWheel::next_timeout(uint64_t now) const
+{
+    int64_t timeout = -1;
+
+    if (m_size != 0)
+    {
+        uint64_t next = m_next;
+
+        // The first level is scanned up to the next cascade point, beyond
+        // which the first level will contain other timers.
+        for (int i = 0; i < N_SLOTS; ++i, ++next)
+        {
+            int index = next & SLOT_MASK;
+
+            if (m_slots[0][index] || (index == 0))
+            {
+                break;
+            }
+        }
+
+        timeout = (next > now) ? next - now : 0;
+    }
+
+    return timeout;
+}
+
+void TimerWheel::insert(Timer* pTimer)
+{
+    uint64_t expires = pTimer->expires;
+    Timer** ppSlot;
+
+    if (expires < m_next)
+    {
+        // Already expired, it will be processed at the next millisecond.
+        ppSlot = &m_slots[0][m_next & SLOT_MASK];
+    }
+    else
+    {
+        uint64_t delta = expires - m_next;
+        int level = 0;
+
+        while ((level < N_LEVELS - 1) && (delta >> ((level + 1) * LEVEL_BITS)) != 0)
+        {
+            ++level;
+        }
+
+        ppSlot = &m_slots[level][(expires >> (level * LEVEL_BITS)) & SLOT_MASK];
+    }
+
+    link(ppSlot, pTimer);
+}
+
+int TimerWheel::cascade(int level)
+{
+    int index = (m_next >> (level * LEVEL_BITS)) & SLOT_MASK;
+
+    Timer* pTimer = m_slots[level][index];
+    m_slots[level][index] = NULL;
+
+    while (pTimer)
+    {
+        Timer* pNext = pTimer->next;
+        insert(pTimer);
+        pTimer = pNext;
+    }
+
+    return index;
+}
+
+//static
+void TimerWheel::link(Timer** ppSlot, Timer* pTimer)
+{
+    pTimer->slot = ppSlot;
+    pTimer->prev = NULL;
+    pTimer->next = *ppSlot;
+
+    if (*ppSlot)
+    {
+        (*ppSlot)->prev = pTimer;
+    }
+
+    *ppSlot = pTimer;
+}
+
+//static
+void TimerWheel::unlink(Timer* pTimer)
+{
+    if (pTimer->prev)
+    {
+        pTimer->prev->next = pTimer->next;
+    }
+    else
+    {
+        *pTimer->slot = pTimer->next;
+    }
+
+    if (pTimer->next)
+    {
+        pTimer->next->prev = pTimer->prev;
+    }
+
+    pTimer->slot = NULL;
+    pTimer->prev = NULL;
+    pTimer->next = NULL;
+}
+
+}
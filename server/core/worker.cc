@@ -17,17 +17,19 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <vector>
 #include <sstream>
+#include <tr1/unordered_map>
 
 #include <maxscale/alloc.h>
 #include <maxscale/atomic.h>
 #include <maxscale/config.h>
-#include <maxscale/hk_heartbeat.h>
 #include <maxscale/log_manager.h>
 #include <maxscale/platform.h>
 #include <maxscale/semaphore.hh>
+#include <maxscale/spinlock.hh>
 #include <maxscale/json_api.h>
 #include <maxscale/utils.hh>
 
@@ -40,6 +42,7 @@
 
 #define WORKER_ABSENT_ID -1
 
+using maxscale::LatencyHistogram;
 using maxscale::Worker;
 using maxscale::Closer;
 using maxscale::Semaphore;
@@ -90,6 +93,131 @@ typedef struct worker_message
     intptr_t arg2; /*< Message specific second argument. */
 } WORKER_MESSAGE;
 
+/**
+ * The index of the worker of each registered session. It is what makes it
+ * possible to find a session by its id without asking every worker.
+ *
+ * The index is split into shards with a lock of their own, so that workers
+ * that register and deregister sessions seldom contend for the same lock.
+ */
+class SessionIndex
+{
+    SessionIndex(const SessionIndex&);
+    SessionIndex& operator = (const SessionIndex&);
+
+public:
+    SessionIndex()
+    {
+    }
+
+    void add(uint64_t id, int worker_id)
+    {
+        Shard& shard = get_shard(id);
+        mxs::SpinLockGuard guard(shard.lock);
+
+        shard.workers[id] = worker_id;
+    }
+
+    void remove(uint64_t id)
+    {
+        Shard& shard = get_shard(id);
+        mxs::SpinLockGuard guard(shard.lock);
+
+        shard.workers.erase(id);
+    }
+
+    int find(uint64_t id)
+    {
+        int worker_id = WORKER_ABSENT_ID;
+
+        Shard& shard = get_shard(id);
+        mxs::SpinLockGuard guard(shard.lock);
+
+        Workers::const_iterator i = shard.workers.find(id);
+
+        if (i != shard.workers.end())
+        {
+            worker_id = i->second;
+        }
+
+        return worker_id;
+    }
+
+private:
+    typedef std::tr1::unordered_map<uint64_t, int> Workers;
+
+    struct Shard
+    {
+        mxs::SpinLock lock;
+        Workers       workers;
+    };
+
+    enum
+    {
+        N_SHARDS = 64
+    };
+
+    Shard& get_shard(uint64_t id)
+    {
+        return m_shards[id % N_SHARDS];
+    }
+
+    Shard m_shards[N_SHARDS];
+};
+
+SessionIndex session_index;
+
+/**
+ * The current time in milliseconds, used as the time of the timers.
+ *
+ * @return Monotonic time in milliseconds.
+ */
+uint64_t time_in_ms()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * The current time in microseconds, used for the event statistics.
+ *
+ * @return Monotonic time in microseconds.
+ */
+uint64_t time_in_us()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * Record a duration in the statistics.
+ *
+ * @param us         The duration in microseconds.
+ * @param times      The histogram in 100ms units.
+ * @param max        The maximum in 100ms units.
+ * @param histogram  The histogram in microseconds.
+ */
+inline void record_time(uint64_t us,
+                        uint32_t (&times)[Worker::STATISTICS::N_QUEUE_TIMES + 1],
+                        int64_t& max,
+                        LatencyHistogram& histogram)
+{
+    int64_t t = us / 100000;
+
+    times[t < Worker::STATISTICS::N_QUEUE_TIMES ? t : Worker::STATISTICS::N_QUEUE_TIMES]++;
+
+    if (t > max)
+    {
+        max = t;
+    }
+
+    histogram.record(us);
+}
+
 /**
  * Check error returns from epoll_ctl; impossible ones lead to crash.
  *
@@ -162,6 +290,7 @@ Worker::Worker(int id,
     , m_started(false)
     , m_should_shutdown(false)
     , m_shutdown_initiated(false)
+    , m_timers(time_in_ms())
     , m_nCurrent_descriptors(0)
     , m_nTotal_descriptors(0)
 {
@@ -281,7 +410,7 @@ int64_t one_stats_get(int64_t Worker::STATISTICS::*what, enum ts_stats_type type
 
         const Worker::STATISTICS& s = pWorker->statistics();
 
-        int64_t value = s.*what;
+        int64_t value = atomic_load_int64_relaxed(&(s.*what));
 
         switch (type)
         {
@@ -337,7 +466,7 @@ Worker::STATISTICS Worker::get_statistics()
             Worker* pWorker = Worker::get(j);
             ss_dassert(pWorker);
 
-            cs.n_fds[i] += pWorker->statistics().n_fds[i];
+            cs.n_fds[i] += atomic_load_int64_relaxed(&pWorker->statistics().n_fds[i]);
         }
     }
 
@@ -348,14 +477,23 @@ Worker::STATISTICS Worker::get_statistics()
             Worker* pWorker = Worker::get(j);
             ss_dassert(pWorker);
 
-            cs.qtimes[i] += pWorker->statistics().qtimes[i];
-            cs.exectimes[i] += pWorker->statistics().exectimes[i];
+            cs.qtimes[i] += atomic_load_uint32_relaxed(&pWorker->statistics().qtimes[i]);
+            cs.exectimes[i] += atomic_load_uint32_relaxed(&pWorker->statistics().exectimes[i]);
         }
 
         cs.qtimes[i] /= this_unit.n_workers;
         cs.exectimes[i] /= this_unit.n_workers;
     }
 
+    for (int i = 0; i < this_unit.n_workers; ++i)
+    {
+        Worker* pWorker = Worker::get(i);
+        ss_dassert(pWorker);
+
+        cs.qtime_histogram.add(pWorker->statistics().qtime_histogram);
+        cs.exectime_histogram.add(pWorker->statistics().exectime_histogram);
+    }
+
     return cs;
 }
 
@@ -757,26 +895,118 @@ bool mxs_worker_register_session(MXS_SESSION* session)
 {
     Worker* worker = Worker::get_current();
     ss_dassert(worker);
-    return worker->session_registry().add(session);
+    return worker->register_session(session);
 }
 
 bool mxs_worker_deregister_session(uint64_t id)
 {
     Worker* worker = Worker::get_current();
     ss_dassert(worker);
-    return worker->session_registry().remove(id);
+    return worker->deregister_session(id);
 }
 
 MXS_SESSION* mxs_worker_find_session(uint64_t id)
 {
     Worker* worker = Worker::get_current();
     ss_dassert(worker);
-    return worker->session_registry().lookup(id);
+    return worker->find_session(id);
 }
 
-Worker::SessionsById& Worker::session_registry()
+int mxs_worker_find_session_owner(uint64_t id)
 {
-    return m_sessions;
+    return Worker::find_session_owner(id);
+}
+
+bool Worker::register_session(MXS_SESSION* pSession)
+{
+    ss_dassert(Worker::get_current() == this);
+
+    bool rv = m_sessions.add(pSession);
+
+    if (rv)
+    {
+        session_index.add(pSession->ses_id, m_id);
+    }
+
+    return rv;
+}
+
+bool Worker::deregister_session(uint64_t id)
+{
+    ss_dassert(Worker::get_current() == this);
+
+    bool rv = m_sessions.remove(id);
+
+    if (rv)
+    {
+        session_index.remove(id);
+    }
+
+    return rv;
+}
+
+MXS_SESSION* Worker::find_session(uint64_t id) const
+{
+    ss_dassert(Worker::get_current() == this);
+
+    return m_sessions.lookup(id);
+}
+
+//static
+int Worker::find_session_owner(uint64_t id)
+{
+    return session_index.find(id);
+}
+
+void Worker::add_timer(MXS_WORKER_TIMER* pTimer, uint32_t delay_ms)
+{
+    ss_dassert(Worker::get_current() == this);
+
+    // The wheel is advanced only once per poll cycle, so the delay is
+    // adjusted by how much the wheel lags behind the clock.
+    uint64_t now = time_in_ms();
+    uint64_t lag = now > m_timers.now() ? now - m_timers.now() : 0;
+
+    m_timers.add(pTimer, delay_ms + lag);
+}
+
+void Worker::cancel_timer(MXS_WORKER_TIMER* pTimer)
+{
+    ss_dassert(Worker::get_current() == this);
+
+    m_timers.cancel(pTimer);
+}
+
+void mxs_worker_timer_init(MXS_WORKER_TIMER* timer, mxs_worker_timer_cb_t callback, void* data)
+{
+    timer->callback = callback;
+    timer->data = data;
+    timer->expires = 0;
+    timer->prev = NULL;
+    timer->next = NULL;
+    timer->slot = NULL;
+}
+
+void mxs_worker_timer_add(MXS_WORKER_TIMER* timer, uint32_t delay_ms)
+{
+    Worker* worker = Worker::get_current();
+    ss_dassert(worker);
+    worker->add_timer(timer, delay_ms);
+}
+
+void mxs_worker_timer_cancel(MXS_WORKER_TIMER* timer)
+{
+    if (mxs_worker_timer_is_active(timer))
+    {
+        Worker* worker = Worker::get_current();
+        ss_dassert(worker);
+        worker->cancel_timer(timer);
+    }
+}
+
+uint64_t mxs_worker_timer_now(void)
+{
+    return time_in_ms();
 }
 
 class WorkerInfoTask: public maxscale::WorkerTask
@@ -802,6 +1032,8 @@ public:
         json_object_set_new(stats, "max_event_queue_length", json_integer(s.evq_max));
         json_object_set_new(stats, "max_exec_time", json_integer(s.maxexectime));
         json_object_set_new(stats, "max_queue_time", json_integer(s.maxqtime));
+        json_object_set_new(stats, "exec_time_histogram", s.exectime_histogram.to_json());
+        json_object_set_new(stats, "queue_time_histogram", s.qtime_histogram.to_json());
 
         json_t* attr = json_object();
         json_object_set_new(attr, "stats", stats);
@@ -1128,7 +1360,7 @@ void Worker::poll_waitevents()
     {
         m_state = POLLING;
 
-        atomic_add_int64(&m_statistics.n_polls, 1);
+        ++m_statistics.n_polls;
         if ((nfds = epoll_wait(m_epoll_fd, events, MAX_EVENTS, 0)) == -1)
         {
             int eno = errno;
@@ -1153,11 +1385,18 @@ void Worker::poll_waitevents()
             {
                 timeout_bias++;
             }
-            atomic_add_int64(&m_statistics.blockingpolls, 1);
-            nfds = epoll_wait(m_epoll_fd,
-                              events,
-                              MAX_EVENTS,
-                              (this_unit.max_poll_sleep * timeout_bias) / 10);
+            ++m_statistics.blockingpolls;
+
+            int timeout = (this_unit.max_poll_sleep * timeout_bias) / 10;
+            int64_t timer_timeout = m_timers.next_timeout(time_in_ms());
+
+            if (timer_timeout >= 0 && timer_timeout < timeout)
+            {
+                // Wake up in time for the next timer.
+                timeout = timer_timeout;
+            }
+
+            nfds = epoll_wait(m_epoll_fd, events, MAX_EVENTS, timeout);
             if (nfds == 0)
             {
                 poll_spins = 0;
@@ -1175,37 +1414,27 @@ void Worker::poll_waitevents()
             timeout_bias = 1;
             if (poll_spins <= this_unit.number_poll_spins + 1)
             {
-                atomic_add_int64(&m_statistics.n_nbpollev, 1);
+                ++m_statistics.n_nbpollev;
             }
             poll_spins = 0;
             MXS_DEBUG("%lu [poll_waitevents] epoll_wait found %d fds",
                       pthread_self(),
                       nfds);
-            atomic_add_int64(&m_statistics.n_pollev, 1);
+            ++m_statistics.n_pollev;
 
             m_state = PROCESSING;
 
             m_statistics.n_fds[(nfds < STATISTICS::MAXNFDS ? (nfds - 1) : STATISTICS::MAXNFDS - 1)]++;
         }
 
-        uint64_t cycle_start = hkheartbeat;
+        uint64_t cycle_start = nfds > 0 ? time_in_us() : 0;
+        uint64_t started = cycle_start;
 
         for (int i = 0; i < nfds; i++)
         {
             /** Calculate event queue statistics */
-            int64_t started = hkheartbeat;
-            int64_t qtime = started - cycle_start;
-
-            if (qtime > STATISTICS::N_QUEUE_TIMES)
-            {
-                m_statistics.qtimes[STATISTICS::N_QUEUE_TIMES]++;
-            }
-            else
-            {
-                m_statistics.qtimes[qtime]++;
-            }
-
-            m_statistics.maxqtime = MXS_MAX(m_statistics.maxqtime, qtime);
+            record_time(started - cycle_start, m_statistics.qtimes,
+                        m_statistics.maxqtime, m_statistics.qtime_histogram);
 
             MXS_POLL_DATA *data = (MXS_POLL_DATA*)events[i].data.ptr;
 
@@ -1213,45 +1442,39 @@ void Worker::poll_waitevents()
 
             if (actions & MXS_POLL_ACCEPT)
             {
-                atomic_add_int64(&m_statistics.n_accept, 1);
+                ++m_statistics.n_accept;
             }
 
             if (actions & MXS_POLL_READ)
             {
-                atomic_add_int64(&m_statistics.n_read, 1);
+                ++m_statistics.n_read;
             }
 
             if (actions & MXS_POLL_WRITE)
             {
-                atomic_add_int64(&m_statistics.n_write, 1);
+                ++m_statistics.n_write;
             }
 
             if (actions & MXS_POLL_HUP)
             {
-                atomic_add_int64(&m_statistics.n_hup, 1);
+                ++m_statistics.n_hup;
             }
 
             if (actions & MXS_POLL_ERROR)
             {
-                atomic_add_int64(&m_statistics.n_error, 1);
+                ++m_statistics.n_error;
             }
 
             /** Calculate event execution statistics */
-            qtime = hkheartbeat - started;
-
-            if (qtime > STATISTICS::N_QUEUE_TIMES)
-            {
-                m_statistics.exectimes[STATISTICS::N_QUEUE_TIMES]++;
-            }
-            else
-            {
-                m_statistics.exectimes[qtime % STATISTICS::N_QUEUE_TIMES]++;
-            }
+            uint64_t ended = time_in_us();
+            record_time(ended - started, m_statistics.exectimes,
+                        m_statistics.maxexectime, m_statistics.exectime_histogram);
 
-            m_statistics.maxexectime = MXS_MAX(m_statistics.maxexectime, qtime);
+            // The next event has been waiting until now.
+            started = ended;
         }
 
-        dcb_process_idle_sessions(m_id);
+        m_timers.advance(time_in_ms());
 
         m_state = ZPROCESSING;
 
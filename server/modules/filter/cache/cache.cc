@@ -16,7 +16,7 @@
 #include <new>
 #include <set>
 #include <string>
-#include <zlib.h>
+#include <string.h>
 #include <maxscale/alloc.h>
 #include <maxscale/buffer.h>
 #include <maxscale/modutil.h>
@@ -27,6 +27,129 @@
 
 using namespace std;
 
+namespace
+{
+
+/*
+ * The key is generated using the 128-bit variant of MurmurHash3, which
+ * processes 16 bytes per round and is considerably faster than crc32. It
+ * has been modified so that the state can be carried over from one piece
+ * of data to the next.
+ */
+
+inline uint64_t rotl64(uint64_t x, int8_t r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+
+    return k;
+}
+
+/**
+ * Update a 128-bit hash with data.
+ *
+ * @param pData  The data to be hashed.
+ * @param len    The length of the data.
+ * @param pHash  The hash, updated by the call. Initially all zeroes.
+ */
+void hash128(const uint8_t* pData, size_t len, uint64_t* pHash)
+{
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+    uint64_t h1 = pHash[0];
+    uint64_t h2 = pHash[1];
+
+    const size_t n_blocks = len / 16;
+
+    for (size_t i = 0; i < n_blocks; ++i)
+    {
+        uint64_t k1;
+        uint64_t k2;
+
+        memcpy(&k1, pData + i * 16, sizeof(k1));
+        memcpy(&k2, pData + i * 16 + 8, sizeof(k2));
+
+        k1 *= c1;
+        k1 = rotl64(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+
+        h1 = rotl64(h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2;
+        k2 = rotl64(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+
+        h2 = rotl64(h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const uint8_t* pTail = pData + n_blocks * 16;
+
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+
+    switch (len & 15)
+    {
+    case 15: k2 ^= ((uint64_t)pTail[14]) << 48;
+    case 14: k2 ^= ((uint64_t)pTail[13]) << 40;
+    case 13: k2 ^= ((uint64_t)pTail[12]) << 32;
+    case 12: k2 ^= ((uint64_t)pTail[11]) << 24;
+    case 11: k2 ^= ((uint64_t)pTail[10]) << 16;
+    case 10: k2 ^= ((uint64_t)pTail[9]) << 8;
+    case 9:
+        k2 ^= ((uint64_t)pTail[8]);
+        k2 *= c2;
+        k2 = rotl64(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+
+    case 8: k1 ^= ((uint64_t)pTail[7]) << 56;
+    case 7: k1 ^= ((uint64_t)pTail[6]) << 48;
+    case 6: k1 ^= ((uint64_t)pTail[5]) << 40;
+    case 5: k1 ^= ((uint64_t)pTail[4]) << 32;
+    case 4: k1 ^= ((uint64_t)pTail[3]) << 24;
+    case 3: k1 ^= ((uint64_t)pTail[2]) << 16;
+    case 2: k1 ^= ((uint64_t)pTail[1]) << 8;
+    case 1:
+        k1 ^= ((uint64_t)pTail[0]);
+        k1 *= c1;
+        k1 = rotl64(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+    }
+
+    h1 ^= len;
+    h2 ^= len;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    pHash[0] = h1;
+    pHash[1] = h2;
+}
+
+}
+
 Cache::Cache(const std::string&  name,
              const CACHE_CONFIG* pConfig,
              SCacheRules         sRules,
@@ -35,6 +158,7 @@ Cache::Cache(const std::string&  name,
     , m_config(*pConfig)
     , m_sRules(sRules)
     , m_sFactory(sFactory)
+    , m_generation(0)
 {
 }
 
@@ -135,22 +259,15 @@ cache_result_t Cache::get_default_key(const char* zDefault_db,
 
     modutil_extract_SQL(const_cast<GWBUF*>(pQuery), &pSql, &length);
 
-    uint64_t crc1 = crc32(0, Z_NULL, 0);
-
-    const Bytef* pData;
+    pKey->data[0] = 0;
+    pKey->data[1] = 0;
 
     if (zDefault_db)
     {
-        pData = reinterpret_cast<const Bytef*>(zDefault_db);
-        crc1 = crc32(crc1, pData, strlen(zDefault_db));
+        hash128(reinterpret_cast<const uint8_t*>(zDefault_db), strlen(zDefault_db), pKey->data);
     }
 
-    pData = reinterpret_cast<const Bytef*>(pSql);
-
-    crc1 = crc32(crc1, pData, length);
-    uint64_t crc2 = crc32(crc1, pData, length);
-
-    pKey->data = (crc1 << 32 | crc2);
+    hash128(reinterpret_cast<const uint8_t*>(pSql), length, pKey->data);
 
     return CACHE_RESULT_OK;
 }
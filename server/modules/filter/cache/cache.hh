@@ -16,6 +16,8 @@
 #include <tr1/functional>
 #include <tr1/memory>
 #include <string>
+#include <vector>
+#include <maxscale/atomic.h>
 #include <maxscale/buffer.h>
 #include <maxscale/session.h>
 #include "cachefilter.h"
@@ -124,13 +126,32 @@ public:
     /**
      * See @Storage::put_value
      */
-    virtual cache_result_t put_value(const CACHE_KEY& key, const GWBUF* pValue) = 0;
+    virtual cache_result_t put_value(const CACHE_KEY& key,
+                                     const std::vector<std::string>& invalidation_words,
+                                     const GWBUF* pValue) = 0;
 
     /**
      * See @Storage::del_value
      */
     virtual cache_result_t del_value(const CACHE_KEY& key) = 0;
 
+    /**
+     * See @Storage::invalidate
+     */
+    virtual cache_result_t invalidate(const std::vector<std::string>& words) = 0;
+
+    /**
+     * Returns the invalidation generation of the cache. It changes whenever
+     * entries are invalidated, so if it changes while a result is being fetched
+     * from the server, the result may already be stale and must not be stored.
+     *
+     * @return The current generation.
+     */
+    uint64_t generation() const
+    {
+        return atomic_load_uint64(&m_generation);
+    }
+
 protected:
     Cache(const std::string&  name,
           const CACHE_CONFIG* pConfig,
@@ -143,13 +164,19 @@ protected:
 
     json_t* do_get_info(uint32_t what) const;
 
+    void next_generation()
+    {
+        atomic_add_uint64(&m_generation, 1);
+    }
+
 private:
     Cache(const Cache&);
     Cache& operator = (const Cache&);
 
 protected:
-    const std::string   m_name;     // The name of the instance; the section name in the config.
-    const CACHE_CONFIG& m_config;   // The configuration of the cache instance.
-    SCacheRules         m_sRules;   // The rules of the cache instance.
-    SStorageFactory     m_sFactory; // The storage factory.
+    const std::string   m_name;       // The name of the instance; the section name in the config.
+    const CACHE_CONFIG& m_config;     // The configuration of the cache instance.
+    SCacheRules         m_sRules;     // The rules of the cache instance.
+    SStorageFactory     m_sFactory;   // The storage factory.
+    uint64_t            m_generation; // The invalidation generation.
 };
@@ -58,11 +58,24 @@ typedef enum cache_thread_model
     CACHE_THREAD_MODEL_MT
 } cache_thread_model_t;
 
+typedef enum cache_admission
+{
+    CACHE_ADMISSION_ALL,     /*< All values are admitted. */
+    CACHE_ADMISSION_TINYLFU, /*< A value must be used more often than the value it would evict. */
+} cache_admission_t;
+
 typedef void* CACHE_STORAGE;
 
+#define CACHE_KEY_WORDS 2
+
 typedef struct cache_key
 {
-    uint64_t data;
+    /**
+     * A 128-bit hash of the default database and the statement. With
+     * fewer bits, the likelihood of two statements sharing the same key
+     * would not be negligible.
+     */
+    uint64_t data[CACHE_KEY_WORDS];
 } CACHE_KEY;
 
 /**
@@ -138,6 +151,14 @@ typedef struct cache_storage_config_t
      * specify 0, unless CACHE_STORAGE_CAP_MAX_SIZE is returned at initialization.
      */
     uint64_t max_size;
+
+    /**
+     * Which values are admitted into the storage, when storing a value requires
+     * another value to be evicted. The caller should specify CACHE_ADMISSION_ALL,
+     * unless CACHE_STORAGE_CAP_MAX_COUNT or CACHE_STORAGE_CAP_MAX_SIZE is returned
+     * at initialization.
+     */
+    cache_admission_t admission;
 } CACHE_STORAGE_CONFIG;
 
 typedef struct cache_storage_api
@@ -223,10 +244,13 @@ typedef struct cache_storage_api
     /**
      * Put a value to the cache.
      *
-     * @param storage    Pointer to a CACHE_STORAGE.
-     * @param key        A key generated with get_key.
-     * @param value      Pointer to GWBUF containing the value to be stored.
-     *                   Must be one contiguous buffer.
+     * @param storage             Pointer to a CACHE_STORAGE.
+     * @param key                 A key generated with get_key.
+     * @param invalidation_words  NULL terminated array of words, typically fully
+     *                            qualified table names, via which the value can
+     *                            later be invalidated. May be NULL.
+     * @param value               Pointer to GWBUF containing the value to be stored.
+     *                            Must be one contiguous buffer.
      *
      * @return CACHE_RESULT_OK if item was successfully put,
      *         CACHE_RESULT_OUT_OF_RESOURCES if item could not be put, due to
@@ -234,6 +258,7 @@ typedef struct cache_storage_api
      */
     cache_result_t (*putValue)(CACHE_STORAGE* storage,
                                const CACHE_KEY* key,
+                               const char* const* invalidation_words,
                                const GWBUF* value);
 
     /**
@@ -248,6 +273,18 @@ typedef struct cache_storage_api
     cache_result_t (*delValue)(CACHE_STORAGE* storage,
                                const CACHE_KEY* key);
 
+    /**
+     * Invalidate entries in the cache.
+     *
+     * @param storage  Pointer to a CACHE_STORAGE.
+     * @param words    NULL terminated array of words. All values that were
+     *                 put with at least one of the words are deleted.
+     *
+     * @return CACHE_RESULT_OK if the invalidation succeeded.
+     */
+    cache_result_t (*invalidate)(CACHE_STORAGE* storage,
+                                 const char* const* words);
+
     /**
      * Get the head item from the storage. This is only intended for testing and
      * debugging purposes and if the storage is being used by different threads
@@ -327,6 +364,38 @@ typedef struct cache_storage_api
      */
     cache_result_t (*getItems)(CACHE_STORAGE* storage,
                                uint64_t* items);
+
+    /**
+     * Get a value the storage has restored, for instance from a file written
+     * before MaxScale was restarted. Restored values may become available some
+     * time after the storage has been created and each is returned only once.
+     *
+     * If the storage is decorated with LRU eviction, the decorator only asks
+     * for values it knows about, so it calls this function until it returns
+     * something else than CACHE_RESULT_OK or CACHE_RESULT_NOT_FOUND, and adds
+     * the returned values to its bookkeeping.
+     *
+     * @param storage  Pointer to a CACHE_STORAGE.
+     * @param key      Pointer to variable that after a successful return will
+     *                 contain the key.
+     * @param size     Pointer to variable that after a successful return will
+     *                 contain the size of the value.
+     * @param words    Pointer to variable that after a successful return will
+     *                 point to a NULL terminated array of the invalidation words
+     *                 of the value, or be NULL. The caller should free the words
+     *                 and the array using MXS_FREE.
+     *
+     * @return CACHE_RESULT_OK if a value was returned,
+     *         CACHE_RESULT_NOT_FOUND if no value is available now, but
+     *         one may become available later,
+     *         CACHE_RESULT_OUT_OF_RESOURCES if the storage does not restore
+     *         values or has returned all of them, and
+     *         CACHE_RESULT_ERROR otherwise.
+     */
+    cache_result_t (*getRestored)(CACHE_STORAGE* storage,
+                                  CACHE_KEY* key,
+                                  uint64_t* size,
+                                  char*** words);
 } CACHE_STORAGE_API;
 
 #define CACHE_STORAGE_ENTRY_POINT "CacheGetStorageAPI"
@@ -51,7 +51,7 @@ std::string cache_key_to_string(const CACHE_KEY& key);
 
 inline bool operator == (const CACHE_KEY& lhs, const CACHE_KEY& rhs)
 {
-    return lhs.data == rhs.data;
+    return cache_key_equal_to(&lhs, &rhs);
 }
 
 inline bool operator != (const CACHE_KEY& lhs, const CACHE_KEY& rhs)
@@ -64,7 +64,8 @@ class CacheKey : public CACHE_KEY
 public:
     CacheKey()
     {
-        data = 0;
+        data[0] = 0;
+        data[1] = 0;
     }
 };
 
@@ -82,6 +83,7 @@ public:
         this->soft_ttl = soft_ttl;
         this->max_count = max_count;
         this->max_size = max_size;
+        this->admission = CACHE_ADMISSION_ALL;
     }
 
     CacheStorageConfig()
@@ -91,6 +93,7 @@ public:
         soft_ttl = 0;
         max_count = 0;
         max_size = 0;
+        admission = CACHE_ADMISSION_ALL;
     }
 
     CacheStorageConfig(const CACHE_STORAGE_CONFIG& config)
@@ -100,5 +103,6 @@ public:
         soft_ttl = config.soft_ttl;
         max_count = config.max_count;
         max_size = config.max_size;
+        admission = config.admission;
     }
 };
@@ -150,6 +150,22 @@ static const MXS_ENUM_VALUE parameter_cache_in_trxs_values[] =
     {NULL}
 };
 
+// Enumeration values for `invalidate`
+static const MXS_ENUM_VALUE parameter_invalidate_values[] =
+{
+    {"never",   CACHE_INVALIDATE_NEVER},
+    {"current", CACHE_INVALIDATE_CURRENT},
+    {NULL}
+};
+
+// Enumeration values for `admission`
+static const MXS_ENUM_VALUE parameter_admission_values[] =
+{
+    {"all",     CACHE_ADMISSION_ALL},
+    {"tinylfu", CACHE_ADMISSION_TINYLFU},
+    {NULL}
+};
+
 extern "C" MXS_MODULE* MXS_CREATE_MODULE()
 {
     static modulecmd_arg_type_t show_argv[] =
@@ -232,6 +248,11 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
                 MXS_MODULE_OPT_NONE,
                 parameter_cached_data_values
             },
+            {
+                "shards",
+                MXS_MODULE_PARAM_COUNT,
+                CACHE_ZDEFAULT_SHARDS
+            },
             {
                 "selects",
                 MXS_MODULE_PARAM_ENUM,
@@ -246,6 +267,25 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
                 MXS_MODULE_OPT_NONE,
                 parameter_cache_in_trxs_values
             },
+            {
+                "invalidate",
+                MXS_MODULE_PARAM_ENUM,
+                CACHE_ZDEFAULT_INVALIDATE,
+                MXS_MODULE_OPT_NONE,
+                parameter_invalidate_values
+            },
+            {
+                "verify_statements",
+                MXS_MODULE_PARAM_BOOL,
+                CACHE_ZDEFAULT_VERIFY_STATEMENTS
+            },
+            {
+                "admission",
+                MXS_MODULE_PARAM_ENUM,
+                CACHE_ZDEFAULT_ADMISSION,
+                MXS_MODULE_OPT_NONE,
+                parameter_admission_values
+            },
             {MXS_END_MODULE_PARAMS}
         }
     };
@@ -348,18 +388,32 @@ bool CacheFilter::process_params(char **pzOptions, MXS_CONFIG_PARAMETER *ppParam
     config.thread_model = static_cast<cache_thread_model_t>(config_get_enum(ppParams,
                                                                             "cached_data",
                                                                             parameter_cached_data_values));
+    config.shards = config_get_integer(ppParams, "shards");
     config.selects = static_cast<cache_selects_t>(config_get_enum(ppParams,
                                                                   "selects",
                                                                   parameter_selects_values));
     config.cache_in_trxs = static_cast<cache_in_trxs_t>(config_get_enum(ppParams,
                                                                         "cache_in_transactions",
                                                                         parameter_cache_in_trxs_values));
+    config.invalidate = static_cast<cache_invalidate_t>(config_get_enum(ppParams,
+                                                                        "invalidate",
+                                                                        parameter_invalidate_values));
+    config.verify_statements = config_get_bool(ppParams, "verify_statements");
+    config.admission = static_cast<cache_admission_t>(config_get_enum(ppParams,
+                                                                      "admission",
+                                                                      parameter_admission_values));
 
     if (!config.storage)
     {
         error = true;
     }
 
+    if (config.shards == 0)
+    {
+        MXS_ERROR("The value of the configuration entry 'shards' must be at least 1.");
+        error = true;
+    }
+
     if ((config.debug < CACHE_DEBUG_MIN) || (config.debug > CACHE_DEBUG_MAX))
     {
         MXS_ERROR("The value of the configuration entry 'debug' must "
@@ -61,6 +61,8 @@ typedef enum cache_selects
 // Thread model
 #define CACHE_ZDEFAULT_THREAD_MODEL                   "thread_specific"
 const cache_thread_model CACHE_DEFAULT_THREAD_MODEL = CACHE_THREAD_MODEL_ST;
+// Positive integer
+#define CACHE_ZDEFAULT_SHARDS                         "1"
 // Cacheable selects
 #define CACHE_ZDEFAULT_SELECTS                        "assume_cacheable"
 const cache_selects_t CACHE_DEFAULT_SELECTS =         CACHE_SELECTS_ASSUME_CACHEABLE;
@@ -77,6 +79,21 @@ typedef enum cache_in_trxs
     CACHE_IN_TRXS_ALL,
 } cache_in_trxs_t;
 
+// Invalidation
+#define CACHE_ZDEFAULT_INVALIDATE                     "never"
+
+typedef enum cache_invalidate
+{
+    CACHE_INVALIDATE_NEVER,
+    CACHE_INVALIDATE_CURRENT,
+} cache_invalidate_t;
+
+// Admission
+#define CACHE_ZDEFAULT_ADMISSION                      "all"
+
+// Verification of cache hits
+#define CACHE_ZDEFAULT_VERIFY_STATEMENTS              "false"
+
 typedef struct cache_config
 {
     uint64_t max_resultset_rows;       /**< The maximum number of rows of a resultset for it to be cached. */
@@ -92,6 +109,10 @@ typedef struct cache_config
     uint64_t max_size;                 /**< Maximum size of the cache.*/
     uint32_t debug;                    /**< Debug settings. */
     cache_thread_model_t thread_model; /**< Thread model. */
+    uint32_t shards;                   /**< Number of shards of a shared cache. */
     cache_selects_t selects;           /**< Assume/verify that selects are cacheable. */
     cache_in_trxs_t cache_in_trxs;     /**< To cache or not to cache inside transactions. */
+    cache_invalidate_t invalidate;     /**< How to invalidate entries when tables are modified. */
+    bool verify_statements;            /**< Whether the statement of a hit should be verified. */
+    cache_admission_t admission;       /**< Which values are admitted into a full cache. */
 } CACHE_CONFIG;
@@ -18,6 +18,7 @@
 #include <maxscale/modutil.h>
 #include <maxscale/mysql_utils.h>
 #include <maxscale/query_classifier.h>
+#include <maxscale/utils.h>
 #include "storage.hh"
 
 namespace
@@ -33,6 +34,9 @@ inline bool cache_max_resultset_size_exceeded(const CACHE_CONFIG& config, uint64
     return config.max_resultset_size == 0 ? false : size > config.max_resultset_size;
 }
 
+// Every entry can be invalidated via this word, as it cannot be a table name.
+const char INVALIDATE_ALL[] = "*";
+
 }
 
 namespace
@@ -185,8 +189,9 @@ CacheFilterSession::CacheFilterSession(MXS_SESSION* pSession, Cache* pCache, cha
     , m_zUseDb(NULL)
     , m_refreshing(false)
     , m_is_read_only(true)
+    , m_generation(0)
 {
-    m_key.data = 0;
+    memset(&m_key, 0, sizeof(m_key));
 
     reset_response_state();
 }
@@ -277,6 +282,13 @@ int CacheFilterSession::routeQuery(GWBUF* pPacket)
         {
             MXS_NOTICE("COM_STMT_PREPARE, ignoring.");
         }
+
+        if (m_pCache->config().invalidate != CACHE_INVALIDATE_NEVER &&
+            get_modified_words(pPacket, &m_prepared_words))
+        {
+            // The statement ID is in the response.
+            m_state = CACHE_EXPECTING_PREPARE_RESPONSE;
+        }
         break;
 
     case MXS_COM_STMT_EXECUTE:
@@ -284,6 +296,17 @@ int CacheFilterSession::routeQuery(GWBUF* pPacket)
         {
             MXS_NOTICE("COM_STMT_EXECUTE, ignoring.");
         }
+
+        if (m_pCache->config().invalidate != CACHE_INVALIDATE_NEVER)
+        {
+            WordsById::const_iterator i = m_words_by_ps_id.find(mxs_mysql_extract_ps_id(pPacket));
+
+            prepare_invalidation(i != m_words_by_ps_id.end() ? i->second : std::vector<std::string>());
+        }
+        break;
+
+    case MXS_COM_STMT_CLOSE:
+        m_words_by_ps_id.erase(mxs_mysql_extract_ps_id(pPacket));
         break;
 
     case MXS_COM_QUERY:
@@ -306,6 +329,13 @@ int CacheFilterSession::clientReply(GWBUF* pData)
 {
     int rv;
 
+    if (!m_words_to_invalidate.empty())
+    {
+        // The response to a modifying statement; whether it succeeded or not
+        // does not matter, invalidating too much is always safe.
+        invalidate();
+    }
+
     if (m_res.pData)
     {
         gwbuf_append(m_res.pData, pData);
@@ -359,6 +389,10 @@ int CacheFilterSession::clientReply(GWBUF* pData)
         rv = handle_expecting_use_response();
         break;
 
+    case CACHE_EXPECTING_PREPARE_RESPONSE:
+        rv = handle_expecting_prepare_response();
+        break;
+
     case CACHE_IGNORING_RESPONSE:
         rv = handle_ignoring_response();
         break;
@@ -661,6 +695,54 @@ int CacheFilterSession::handle_expecting_use_response()
     return rv;
 }
 
+/**
+ * Called when the response to a COM_STMT_PREPARE of a modifying statement
+ * is handled.
+ */
+int CacheFilterSession::handle_expecting_prepare_response()
+{
+    ss_dassert(m_state == CACHE_EXPECTING_PREPARE_RESPONSE);
+    ss_dassert(m_res.pData);
+
+    int rv = 1;
+
+    size_t buflen = m_res.length;
+    ss_dassert(m_res.length == gwbuf_length(m_res.pData));
+
+    if (buflen >= MYSQL_HEADER_LEN + 1) // We need the command byte.
+    {
+        uint8_t command;
+        copy_data(MYSQL_HEADER_LEN, 1, &command);
+
+        bool done = true;
+
+        if (command == MYSQL_REPLY_OK)
+        {
+            if (buflen >= MYSQL_PS_ID_OFFSET + MYSQL_PS_ID_SIZE)
+            {
+                uint8_t id[MYSQL_PS_ID_SIZE];
+                copy_data(MYSQL_PS_ID_OFFSET, sizeof(id), id);
+
+                m_words_by_ps_id[gw_mysql_get_byte4(id)].swap(m_prepared_words);
+            }
+            else
+            {
+                done = false;
+            }
+        }
+
+        if (done)
+        {
+            m_prepared_words.clear();
+
+            rv = send_upstream();
+            m_state = CACHE_IGNORING_RESPONSE;
+        }
+    }
+
+    return rv;
+}
+
 /**
  * Called when all data from the server is ignored.
  */
@@ -717,19 +799,40 @@ void CacheFilterSession::store_result()
     {
         m_res.pData = pData;
 
-        cache_result_t result = m_pCache->put_value(m_key, m_res.pData);
-
-        if (!CACHE_RESULT_IS_OK(result))
+        if (m_pCache->generation() == m_generation)
         {
-            MXS_ERROR("Could not store cache item, deleting it.");
+            GWBUF* pValue = m_res.pData;
+
+            if (m_pCache->config().verify_statements)
+            {
+                pValue = add_statement(m_res.pData);
+            }
 
-            result = m_pCache->del_value(m_key);
+            cache_result_t result = pValue ?
+                m_pCache->put_value(m_key, m_invalidation_words, pValue) :
+                CACHE_RESULT_OUT_OF_RESOURCES;
 
-            if (!CACHE_RESULT_IS_OK(result) || !CACHE_RESULT_IS_NOT_FOUND(result))
+            if (pValue != m_res.pData)
             {
-                MXS_ERROR("Could not delete cache item.");
+                gwbuf_free(pValue);
+            }
+
+            if (!CACHE_RESULT_IS_OK(result))
+            {
+                MXS_ERROR("Could not store cache item, deleting it.");
+
+                result = m_pCache->del_value(m_key);
+
+                if (!CACHE_RESULT_IS_OK(result) || !CACHE_RESULT_IS_NOT_FOUND(result))
+                {
+                    MXS_ERROR("Could not delete cache item.");
+                }
             }
         }
+        else if (log_decisions())
+        {
+            MXS_NOTICE("Cache was invalidated while the result was fetched, not storing.");
+        }
     }
 
     if (m_refreshing)
@@ -739,6 +842,281 @@ void CacheFilterSession::store_result()
     }
 }
 
+/**
+ * Get the words via which the result of a statement is invalidated, that is,
+ * the fully qualified names of the tables the statement accesses.
+ *
+ * @param pPacket  A contiguous COM_QUERY or COM_STMT_PREPARE packet.
+ * @param pWords   On return, the words. Empty, if invalidation is not enabled.
+ */
+void CacheFilterSession::get_invalidation_words(GWBUF* pPacket, std::vector<std::string>* pWords) const
+{
+    pWords->clear();
+
+    if (m_pCache->config().invalidate != CACHE_INVALIDATE_NEVER)
+    {
+        int n_tables;
+        char** pzTables = qc_get_table_names(pPacket, &n_tables, true);
+
+        if (pzTables)
+        {
+            for (int i = 0; i < n_tables; ++i)
+            {
+                std::string word;
+
+                if (!strchr(pzTables[i], '.') && m_zDefaultDb)
+                {
+                    word += m_zDefaultDb;
+                    word += '.';
+                }
+
+                word += pzTables[i];
+
+                // Table names may or may not be case sensitive, so all
+                // are treated as case insensitive. At worst, too much is
+                // invalidated.
+                for (std::string::iterator j = word.begin(); j != word.end(); ++j)
+                {
+                    *j = tolower(*j);
+                }
+
+                pWords->push_back(word);
+
+                MXS_FREE(pzTables[i]);
+            }
+
+            MXS_FREE(pzTables);
+        }
+    }
+}
+
+/**
+ * Get the words via which the entries a statement modifies are invalidated.
+ *
+ * What a stored procedure modifies is not known, so a CALL modifies everything.
+ *
+ * @param pPacket  A contiguous COM_QUERY or COM_STMT_PREPARE packet.
+ * @param pWords   On return, the words.
+ *
+ * @return True, if the statement modifies data.
+ */
+bool CacheFilterSession::get_modified_words(GWBUF* pPacket, std::vector<std::string>* pWords) const
+{
+    bool modifies = false;
+
+    pWords->clear();
+
+    if (qc_get_operation(pPacket) == QUERY_OP_CALL)
+    {
+        pWords->push_back(INVALIDATE_ALL);
+        modifies = true;
+    }
+    else if (qc_query_is_type(qc_get_type_mask(pPacket), QUERY_TYPE_WRITE))
+    {
+        get_invalidation_words(pPacket, pWords);
+        modifies = true;
+    }
+
+    return modifies;
+}
+
+/**
+ * Figure out whether a statement modifies tables whose data may be cached,
+ * and if so, what should be invalidated once the response arrives or the
+ * current transaction ends.
+ *
+ * The tables modified by a text protocol prepared statement are recorded
+ * when it is prepared, and invalidated when it is executed.
+ *
+ * @param pPacket  A contiguous COM_QUERY packet.
+ */
+void CacheFilterSession::prepare_invalidation(GWBUF* pPacket)
+{
+    std::vector<std::string> words;
+    qc_query_op_t op = qc_get_operation(pPacket);
+    uint32_t type_mask = qc_get_type_mask(pPacket);
+
+    if (qc_query_is_type(type_mask, QUERY_TYPE_PREPARE_NAMED_STMT) ||
+        qc_query_is_type(type_mask, QUERY_TYPE_DEALLOC_PREPARE) ||
+        op == QUERY_OP_EXECUTE)
+    {
+        char* zName = qc_get_prepare_name(pPacket);
+        std::string name(zName ? zName : "");
+        MXS_FREE(zName);
+
+        if (qc_query_is_type(type_mask, QUERY_TYPE_PREPARE_NAMED_STMT))
+        {
+            GWBUF* pStmt = qc_get_preparable_stmt(pPacket);
+
+            if (!pStmt)
+            {
+                // PREPARE ... FROM @var, what is prepared is not known.
+                m_words_by_ps_name[name].assign(1, INVALIDATE_ALL);
+            }
+            else if (get_modified_words(pStmt, &words))
+            {
+                m_words_by_ps_name[name].swap(words);
+            }
+            else
+            {
+                m_words_by_ps_name.erase(name);
+            }
+
+            words.clear();
+        }
+        else if (qc_query_is_type(type_mask, QUERY_TYPE_DEALLOC_PREPARE))
+        {
+            m_words_by_ps_name.erase(name);
+        }
+        else
+        {
+            WordsByName::const_iterator i = m_words_by_ps_name.find(name);
+
+            if (i != m_words_by_ps_name.end())
+            {
+                words = i->second;
+            }
+        }
+    }
+    else
+    {
+        get_modified_words(pPacket, &words);
+    }
+
+    prepare_invalidation(words);
+}
+
+/**
+ * Prepare the invalidation of what a statement modifies, once the response
+ * arrives or, inside a transaction, when it ends.
+ *
+ * @param words  The words via which the modified entries are invalidated.
+ */
+void CacheFilterSession::prepare_invalidation(const std::vector<std::string>& words)
+{
+    if (!words.empty())
+    {
+        if (session_trx_is_active(m_pSession) && !session_trx_is_ending(m_pSession))
+        {
+            // Until the transaction is committed, other sessions will see
+            // the old data, so the cache entries are still valid.
+            m_trx_words.insert(words.begin(), words.end());
+        }
+        else
+        {
+            m_words_to_invalidate.insert(m_words_to_invalidate.end(), words.begin(), words.end());
+        }
+    }
+
+    if (session_trx_is_ending(m_pSession) && !m_trx_words.empty())
+    {
+        m_words_to_invalidate.insert(m_words_to_invalidate.end(), m_trx_words.begin(), m_trx_words.end());
+        m_trx_words.clear();
+    }
+}
+
+/**
+ * Invalidate the cache entries that depend upon modified tables.
+ */
+void CacheFilterSession::invalidate()
+{
+    cache_result_t result = m_pCache->invalidate(m_words_to_invalidate);
+
+    if (!CACHE_RESULT_IS_OK(result))
+    {
+        MXS_ERROR("Could not invalidate cache entries.");
+    }
+    else if (log_decisions())
+    {
+        MXS_NOTICE("Invalidated cache entries of %lu table(s).", m_words_to_invalidate.size());
+    }
+
+    m_words_to_invalidate.clear();
+}
+
+/**
+ * Remember the statement of the current key, so that hits can be verified.
+ *
+ * @param pPacket  A contiguous COM_QUERY packet.
+ */
+void CacheFilterSession::set_statement(GWBUF* pPacket)
+{
+    char* pSql;
+    int length;
+
+    modutil_extract_SQL(pPacket, &pSql, &length);
+
+    m_statement.clear();
+
+    if (m_zDefaultDb)
+    {
+        m_statement.append(m_zDefaultDb);
+    }
+
+    // The separator prevents "db" + "select" from matching "d" + "bselect".
+    m_statement.append(1, '\0');
+    m_statement.append(pSql, length);
+}
+
+/**
+ * Prefix a value with the statement it is the result of.
+ *
+ * @param pData  A contiguous result.
+ *
+ * @return A contiguous buffer containing the length of the statement, the
+ *         statement and the result, or NULL if memory could not be allocated.
+ */
+GWBUF* CacheFilterSession::add_statement(GWBUF* pData) const
+{
+    size_t len = m_statement.length();
+    size_t total = 4 + len + gwbuf_length(pData);
+
+    GWBUF* pValue = gwbuf_alloc(total);
+
+    if (pValue)
+    {
+        uint8_t* pDest = GWBUF_DATA(pValue);
+
+        pDest = mxs_set_byte4(pDest, len);
+        memcpy(pDest, m_statement.data(), len);
+        pDest += len;
+        gwbuf_copy_data(pData, 0, gwbuf_length(pData), pDest);
+    }
+
+    return pValue;
+}
+
+/**
+ * Check that a value is the result of the current statement and remove
+ * the statement from it. Two statements may share the same key, although
+ * it is extremely unlikely.
+ *
+ * @param ppData  Pointer to a contiguous value, on return the result only.
+ *
+ * @return True if the value is the result of the current statement.
+ */
+bool CacheFilterSession::remove_statement(GWBUF** ppData) const
+{
+    bool rv = false;
+    size_t length = gwbuf_length(*ppData);
+
+    if (length >= 4)
+    {
+        const uint8_t* pData = GWBUF_DATA(*ppData);
+        size_t len = mxs_get_byte4(pData);
+
+        if ((len == m_statement.length()) &&
+            (length >= 4 + len) &&
+            (memcmp(pData + 4, m_statement.data(), len) == 0))
+        {
+            *ppData = gwbuf_consume(*ppData, 4 + len);
+            rv = true;
+        }
+    }
+
+    return rv;
+}
+
 /**
  * Whether the cache should be consulted.
  *
@@ -921,6 +1299,11 @@ CacheFilterSession::routing_action_t CacheFilterSession::route_COM_QUERY(GWBUF*
     routing_action_t routing_action = ROUTING_CONTINUE;
     cache_action_t cache_action = get_cache_action(pPacket);
 
+    if (m_pCache->config().invalidate != CACHE_INVALIDATE_NEVER)
+    {
+        prepare_invalidation(pPacket);
+    }
+
     if (cache_action != CACHE_IGNORE)
     {
         if (m_pCache->should_store(m_zDefaultDb, pPacket))
@@ -929,6 +1312,11 @@ CacheFilterSession::routing_action_t CacheFilterSession::route_COM_QUERY(GWBUF*
 
             if (CACHE_RESULT_IS_OK(result))
             {
+                if (m_pCache->config().verify_statements)
+                {
+                    set_statement(pPacket);
+                }
+
                 routing_action = route_SELECT(cache_action, pPacket);
             }
             else
@@ -967,6 +1355,22 @@ CacheFilterSession::routing_action_t CacheFilterSession::route_SELECT(cache_acti
         GWBUF* pResponse;
         cache_result_t result = m_pCache->get_value(m_key, flags, &pResponse);
 
+        if (CACHE_RESULT_IS_OK(result) &&
+            m_pCache->config().verify_statements &&
+            !remove_statement(&pResponse))
+        {
+            // Another statement with the same key. When the response to
+            // this one arrives, it will replace the value in the cache.
+            if (log_decisions())
+            {
+                MXS_NOTICE("Cache data is the result of another statement, "
+                           "fetching data from server.");
+            }
+
+            gwbuf_free(pResponse);
+            result = CACHE_RESULT_NOT_FOUND;
+        }
+
         if (CACHE_RESULT_IS_OK(result))
         {
             if (CACHE_RESULT_IS_STALE(result))
@@ -1044,6 +1448,18 @@ CacheFilterSession::routing_action_t CacheFilterSession::route_SELECT(cache_acti
         m_state = CACHE_EXPECTING_RESPONSE;
     }
 
+    if (m_state == CACHE_EXPECTING_RESPONSE)
+    {
+        // The response will be stored, so it must be known what it depends upon.
+        get_invalidation_words(pPacket, &m_invalidation_words);
+        m_generation = m_pCache->generation();
+
+        if (m_pCache->config().invalidate != CACHE_INVALIDATE_NEVER)
+        {
+            m_invalidation_words.push_back(INVALIDATE_ALL);
+        }
+    }
+
     return routing_action;
 }
 
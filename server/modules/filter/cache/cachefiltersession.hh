@@ -13,6 +13,10 @@
  */
 
 #include <maxscale/cppdefs.hh>
+#include <set>
+#include <string>
+#include <vector>
+#include <tr1/unordered_map>
 #include <maxscale/buffer.h>
 #include <maxscale/filter.hh>
 #include "cache.hh"
@@ -29,6 +33,7 @@ public:
         CACHE_EXPECTING_ROWS,         // A select has been sent, and we want more rows.
         CACHE_EXPECTING_NOTHING,      // We are not expecting anything from the server.
         CACHE_EXPECTING_USE_RESPONSE, // A "USE DB" was issued.
+        CACHE_EXPECTING_PREPARE_RESPONSE, // A modifying statement is being prepared.
         CACHE_IGNORING_RESPONSE,      // We are not interested in the data received from the server.
     };
 
@@ -98,6 +103,7 @@ private:
     int handle_expecting_response();
     int handle_expecting_rows();
     int handle_expecting_use_response();
+    int handle_expecting_prepare_response();
     int handle_ignoring_response();
 
     int send_upstream();
@@ -111,6 +117,22 @@ private:
 
     void store_result();
 
+    void get_invalidation_words(GWBUF* pPacket, std::vector<std::string>* pWords) const;
+
+    bool get_modified_words(GWBUF* pPacket, std::vector<std::string>* pWords) const;
+
+    void prepare_invalidation(GWBUF* pPacket);
+
+    void prepare_invalidation(const std::vector<std::string>& words);
+
+    void invalidate();
+
+    void set_statement(GWBUF* pPacket);
+
+    GWBUF* add_statement(GWBUF* pData) const;
+
+    bool remove_statement(GWBUF** ppData) const;
+
     enum cache_action_t
     {
         CACHE_IGNORE           = 0,
@@ -145,19 +167,30 @@ private:
     void copy_command_header_at_offset(uint8_t* pHeader) const;
 
 private:
+    typedef std::tr1::unordered_map<uint32_t, std::vector<std::string> >    WordsById;
+    typedef std::tr1::unordered_map<std::string, std::vector<std::string> > WordsByName;
+
     CacheFilterSession(MXS_SESSION* pSession, Cache* pCache, char* zDefaultDb);
 
     CacheFilterSession(const CacheFilterSession&);
     CacheFilterSession& operator = (const CacheFilterSession&);
 
 private:
-    cache_session_state_t m_state;       /**< What state is the session in, what data is expected. */
-    Cache*                m_pCache;      /**< The cache instance the session is associated with. */
-    CACHE_RESPONSE_STATE  m_res;         /**< The response state. */
-    CACHE_KEY             m_key;         /**< Key storage. */
-    char*                 m_zDefaultDb;  /**< The default database. */
-    char*                 m_zUseDb;      /**< Pending default database. Needs server response. */
-    bool                  m_refreshing;  /**< Whether the session is updating a stale cache entry. */
-    bool                  m_is_read_only;/**< Whether the current trx has been read-only in pratice. */
+    cache_session_state_t    m_state;               /**< What state is the session in, what data is expected. */
+    Cache*                   m_pCache;              /**< The cache instance the session is associated with. */
+    CACHE_RESPONSE_STATE     m_res;                 /**< The response state. */
+    CACHE_KEY                m_key;                 /**< Key storage. */
+    char*                    m_zDefaultDb;          /**< The default database. */
+    char*                    m_zUseDb;              /**< Pending default database. Needs server response. */
+    bool                     m_refreshing;          /**< Whether the session is updating a stale cache entry. */
+    bool                     m_is_read_only;        /**< Whether the current trx has been read-only in pratice. */
+    std::vector<std::string> m_invalidation_words;  /**< Tables the response being fetched depends upon. */
+    uint64_t                 m_generation;          /**< Cache generation when the response was requested. */
+    std::vector<std::string> m_words_to_invalidate; /**< Tables to invalidate when the response arrives. */
+    std::set<std::string>    m_trx_words;           /**< Tables to invalidate when the trx ends. */
+    std::string              m_statement;           /**< The statement of m_key, if hits are verified. */
+    std::vector<std::string> m_prepared_words;      /**< Tables the statement being prepared modifies. */
+    WordsById                m_words_by_ps_id;      /**< Tables modified by binary prepared statements. */
+    WordsByName              m_words_by_ps_name;    /**< Tables modified by text prepared statements. */
 };
 
@@ -89,11 +89,13 @@ CacheMT* CacheMT::Create(const std::string&  name,
                                       pConfig->soft_ttl,
                                       pConfig->max_count,
                                       pConfig->max_size);
+    storage_config.admission = pConfig->admission;
 
     int argc = pConfig->storage_argc;
     char** argv = pConfig->storage_argv;
 
-    Storage* pStorage = sFactory->createStorage(name.c_str(), storage_config, argc, argv);
+    Storage* pStorage = sFactory->createShardedStorage(name.c_str(), storage_config,
+                                                         pConfig->shards, argc, argv);
 
     if (pStorage)
     {
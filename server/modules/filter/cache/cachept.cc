@@ -17,6 +17,7 @@
 #include <maxscale/atomic.h>
 #include <maxscale/config.h>
 #include <maxscale/platform.h>
+#include <maxscale/worker.h>
 
 #include "cachest.hh"
 #include "storagefactory.hh"
@@ -46,6 +47,33 @@ inline int thread_index()
     return u_thread_id;
 }
 
+/**
+ * An invalidation that is delivered to the caches of the other threads.
+ */
+struct Invalidation
+{
+    Invalidation(CachePT* pCache, const std::vector<string>& words, int origin, int n_refs)
+        : pCache(pCache)
+        , words(words)
+        , origin(origin)
+        , n_refs(n_refs)
+    {
+    }
+
+    CachePT*            pCache; /*< The cache being invalidated. */
+    std::vector<string> words;  /*< The invalidation words. */
+    int                 origin; /*< The worker that already invalidated its cache. */
+    int                 n_refs; /*< The number of workers that have yet to process it. */
+};
+
+void release_invalidation(Invalidation* pInvalidation, int n)
+{
+    if (atomic_add(&pInvalidation->n_refs, -n) == n)
+    {
+        delete pInvalidation;
+    }
+}
+
 }
 
 CachePT::CachePT(const std::string&  name,
@@ -135,9 +163,11 @@ cache_result_t CachePT::get_value(const CACHE_KEY& key, uint32_t flags, GWBUF**
     return thread_cache().get_value(key, flags, ppValue);
 }
 
-cache_result_t CachePT::put_value(const CACHE_KEY& key, const GWBUF* pValue)
+cache_result_t CachePT::put_value(const CACHE_KEY& key,
+                                  const std::vector<std::string>& invalidation_words,
+                                  const GWBUF* pValue)
 {
-    return thread_cache().put_value(key, pValue);
+    return thread_cache().put_value(key, invalidation_words, pValue);
 }
 
 cache_result_t CachePT::del_value(const CACHE_KEY& key)
@@ -145,6 +175,49 @@ cache_result_t CachePT::del_value(const CACHE_KEY& key)
     return thread_cache().del_value(key);
 }
 
+cache_result_t CachePT::invalidate(const std::vector<std::string>& words)
+{
+    next_generation();
+
+    // The cache of the current thread is invalidated immediately, so that the
+    // session itself will never see stale data.
+    cache_result_t result = thread_cache().invalidate(words);
+
+    int n_workers = m_caches.size();
+
+    if (n_workers > 1)
+    {
+        // The caches of the other threads may only be accessed by the threads
+        // themselves, so the invalidation is delivered to them as a message.
+        Invalidation* pInvalidation = NULL;
+
+        MXS_EXCEPTION_GUARD(pInvalidation = new Invalidation(this, words,
+                                                             mxs_worker_get_current_id(),
+                                                             n_workers + 1));
+
+        if (pInvalidation)
+        {
+            int n_posted = mxs_worker_broadcast_message(MXS_WORKER_MSG_CALL,
+                                                        (intptr_t)&CachePT::invalidate_thread_cache,
+                                                        (intptr_t)pInvalidation);
+
+            if (n_posted != n_workers)
+            {
+                MXS_ERROR("Could not deliver cache invalidation to all threads.");
+                result = CACHE_RESULT_ERROR;
+            }
+
+            release_invalidation(pInvalidation, n_workers - n_posted + 1);
+        }
+        else
+        {
+            result = CACHE_RESULT_OUT_OF_RESOURCES;
+        }
+    }
+
+    return result;
+}
+
 // static
 CachePT* CachePT::Create(const std::string&  name,
                          const CACHE_CONFIG* pConfig,
@@ -199,6 +272,19 @@ CachePT* CachePT::Create(const std::string&  name,
     return pCache;
 }
 
+// static
+void CachePT::invalidate_thread_cache(int worker_id, void* pData)
+{
+    Invalidation* pInvalidation = static_cast<Invalidation*>(pData);
+
+    if (worker_id != pInvalidation->origin)
+    {
+        pInvalidation->pCache->thread_cache().invalidate(pInvalidation->words);
+    }
+
+    release_invalidation(pInvalidation, 1);
+}
+
 Cache& CachePT::thread_cache()
 {
     int i = thread_index();
@@ -34,10 +34,14 @@ public:
 
     cache_result_t get_value(const CACHE_KEY& key, uint32_t flags, GWBUF** ppValue) const;
 
-    cache_result_t put_value(const CACHE_KEY& key, const GWBUF* pValue);
+    cache_result_t put_value(const CACHE_KEY& key,
+                             const std::vector<std::string>& invalidation_words,
+                             const GWBUF* pValue);
 
     cache_result_t del_value(const CACHE_KEY& key);
 
+    cache_result_t invalidate(const std::vector<std::string>& words);
+
 private:
     typedef std::tr1::shared_ptr<Cache> SCache;
     typedef std::vector<SCache>         Caches;
@@ -55,6 +59,8 @@ private:
 
     Cache& thread_cache();
 
+    static void invalidate_thread_cache(int worker_id, void* pData);
+
     const Cache& thread_cache() const
     {
         return const_cast<CachePT*>(this)->thread_cache();
@@ -27,10 +27,14 @@ public:
 
     cache_result_t get_value(const CACHE_KEY& key, uint32_t flags, GWBUF** ppValue) const;
 
-    cache_result_t put_value(const CACHE_KEY& key, const GWBUF* pValue);
+    cache_result_t put_value(const CACHE_KEY& key,
+                             const std::vector<std::string>& invalidation_words,
+                             const GWBUF* pValue);
 
     cache_result_t del_value(const CACHE_KEY& key);
 
+    cache_result_t invalidate(const std::vector<std::string>& words);
+
 protected:
     CacheSimple(const std::string&  name,
                 const CACHE_CONFIG* pConfig,
@@ -93,6 +93,7 @@ CacheST* CacheST::Create(const std::string&  name,
                                       pConfig->soft_ttl,
                                       pConfig->max_count,
                                       pConfig->max_size);
+    storage_config.admission = pConfig->admission;
 
     int argc = pConfig->storage_argc;
     char** argv = pConfig->storage_argv;
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#define MXS_MODULE_NAME "cache"
+#include "frequencysketch.hh"
+
+namespace
+{
+
+const size_t MIN_WIDTH = 1024;
+const size_t MAX_WIDTH = 1024 * 1024;
+
+// With ten times more increments than there are counters in a row, the
+// counters of frequently used keys will have reached their maximum value.
+const size_t SAMPLE_FACTOR = 10;
+
+}
+
+FrequencySketch::FrequencySketch(size_t n_keys)
+    : m_additions(0)
+    , m_resets(0)
+{
+    size_t width = MIN_WIDTH;
+
+    while ((width < n_keys) && (width < MAX_WIDTH))
+    {
+        width *= 2;
+    }
+
+    m_width = width;
+    m_mask = width - 1;
+    m_sample_size = SAMPLE_FACTOR * width;
+    m_counters.resize(DEPTH * width);
+}
+
+void FrequencySketch::increment(const CACHE_KEY& key)
+{
+    bool incremented = false;
+
+    // Only the smallest counters are incremented, which reduces the error
+    // caused by other keys that share some of the counters.
+    uint8_t min = frequency(key);
+
+    if (min < MAX_COUNT)
+    {
+        for (size_t row = 0; row < DEPTH; ++row)
+        {
+            uint8_t& counter = m_counters[row * m_width + index(key, row)];
+
+            if (counter == min)
+            {
+                ++counter;
+                incremented = true;
+            }
+        }
+    }
+
+    if (incremented && (++m_additions == m_sample_size))
+    {
+        reset();
+    }
+}
+
+uint8_t FrequencySketch::frequency(const CACHE_KEY& key) const
+{
+    uint8_t min = MAX_COUNT;
+
+    for (size_t row = 0; row < DEPTH; ++row)
+    {
+        uint8_t counter = m_counters[row * m_width + index(key, row)];
+
+        if (counter < min)
+        {
+            min = counter;
+        }
+    }
+
+    return min;
+}
+
+size_t FrequencySketch::index(const CACHE_KEY& key, size_t row) const
+{
+    // The key is a hash, so the rows can be indexed using double hashing.
+    uint64_t h = key.data[0] + row * (key.data[1] | 1);
+
+    return (h ^ (h >> 32)) & m_mask;
+}
+
+void FrequencySketch::reset()
+{
+    for (std::vector<uint8_t>::iterator i = m_counters.begin(); i != m_counters.end(); ++i)
+    {
+        *i >>= 1;
+    }
+
+    m_additions /= 2;
+    ++m_resets;
+}
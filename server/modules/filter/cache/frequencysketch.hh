@@ -0,0 +1,85 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <vector>
+#include "cache_storage_api.h"
+
+/**
+ * A FrequencySketch estimates how often keys have been used recently. It is
+ * a count-min sketch, that is, each key is counted in a few rows of counters
+ * and the estimate is the smallest of those counters. The counters saturate
+ * at a small value and they are all halved periodically, so that keys that
+ * were popular a long time ago are eventually forgotten.
+ *
+ * The sketch is used for implementing TinyLFU admission; a new value is
+ * stored only if its key has been used more often than the key of the value
+ * that would be evicted.
+ */
+class FrequencySketch
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param n_keys  The expected number of distinct keys, used for sizing
+     *                the sketch.
+     */
+    FrequencySketch(size_t n_keys);
+
+    /**
+     * Record a use of a key.
+     *
+     * @param key  The key that was used.
+     */
+    void increment(const CACHE_KEY& key);
+
+    /**
+     * Estimate how often a key has been used.
+     *
+     * @param key  A key.
+     *
+     * @return The estimated number of uses, at most @c MAX_COUNT.
+     */
+    uint8_t frequency(const CACHE_KEY& key) const;
+
+    /**
+     * @return How many times the counters have been halved.
+     */
+    uint64_t n_resets() const
+    {
+        return m_resets;
+    }
+
+    enum
+    {
+        DEPTH = 4,      /*< The number of rows. */
+        MAX_COUNT = 15  /*< The value at which a counter saturates. */
+    };
+
+private:
+    FrequencySketch(const FrequencySketch&);
+    FrequencySketch& operator = (const FrequencySketch&);
+
+    size_t index(const CACHE_KEY& key, size_t row) const;
+    void reset();
+
+private:
+    std::vector<uint8_t> m_counters;   /*< DEPTH rows of counters. */
+    size_t               m_mask;       /*< Mask for getting an index into a row. */
+    size_t               m_width;      /*< The number of counters in a row. */
+    uint64_t             m_additions;  /*< Increments since the last reset. */
+    uint64_t             m_sample_size;/*< Increments after which the counters are halved. */
+    uint64_t             m_resets;     /*< How many times the counters have been halved. */
+};
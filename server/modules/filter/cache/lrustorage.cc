@@ -21,7 +21,15 @@ LRUStorage::LRUStorage(const CACHE_STORAGE_CONFIG& config, Storage* pStorage)
     , m_max_size(config.max_size != 0 ? config.max_size : UINT64_MAX)
     , m_pHead(NULL)
     , m_pTail(NULL)
+    , m_pSketch(NULL)
+    , m_restoring(true)
 {
+    if (config.admission == CACHE_ADMISSION_TINYLFU)
+    {
+        // With no limit on the number of items, the number of items that
+        // fit in the cache cannot be known in advance.
+        m_pSketch = new FrequencySketch(config.max_count != 0 ? config.max_count : 16 * 1024);
+    }
 }
 
 LRUStorage::~LRUStorage()
@@ -34,6 +42,7 @@ LRUStorage::~LRUStorage()
     }
 
     delete m_pStorage;
+    delete m_pSketch;
 }
 
 void LRUStorage::get_config(CACHE_STORAGE_CONFIG* pConfig)
@@ -41,6 +50,13 @@ void LRUStorage::get_config(CACHE_STORAGE_CONFIG* pConfig)
     *pConfig = m_config;
 }
 
+cache_result_t LRUStorage::get_restored(CACHE_KEY* pKey,
+                                        uint64_t* pSize,
+                                        std::vector<std::string>* pWords)
+{
+    return CACHE_RESULT_OUT_OF_RESOURCES;
+}
+
 cache_result_t LRUStorage::do_get_info(uint32_t what,
                                        json_t** ppInfo) const
 {
@@ -76,21 +92,41 @@ cache_result_t LRUStorage::do_get_value(const CACHE_KEY& key,
                                         uint32_t flags,
                                         GWBUF** ppValue) const
 {
+    if (m_restoring)
+    {
+        restore();
+    }
+
     return access_value(APPROACH_GET, key, flags, ppValue);
 }
 
-cache_result_t LRUStorage::do_put_value(const CACHE_KEY& key, const GWBUF* pvalue)
+cache_result_t LRUStorage::do_put_value(const CACHE_KEY& key,
+                                        const std::vector<std::string>& invalidation_words,
+                                        const GWBUF* pvalue)
 {
     cache_result_t result = CACHE_RESULT_ERROR;
 
+    if (m_restoring)
+    {
+        restore();
+    }
+
     size_t value_size = GWBUF_LENGTH(pvalue);
 
     Node* pNode = NULL;
 
     NodesByKey::iterator i = m_nodes_by_key.find(key);
     bool existed = (i != m_nodes_by_key.end());
+    bool admitted = existed || admit(key, value_size);
 
-    if (existed)
+    if (!admitted)
+    {
+        // Not storing a value is not an error, the cache is simply not
+        // populated with a value that is unlikely to be used again.
+        ++m_stats.rejections;
+        result = CACHE_RESULT_OK;
+    }
+    else if (existed)
     {
         result = get_existing_node(i, pvalue, &pNode);
     }
@@ -99,11 +135,15 @@ cache_result_t LRUStorage::do_put_value(const CACHE_KEY& key, const GWBUF* pvalu
         result = get_new_node(key, pvalue, &i, &pNode);
     }
 
-    if (CACHE_RESULT_IS_OK(result))
+    if (admitted && CACHE_RESULT_IS_OK(result))
     {
         ss_dassert(pNode);
 
-        result = m_pStorage->put_value(key, pvalue);
+        // The invalidation words are maintained here, as entries are always
+        // removed from the actual storage via this class. They are passed on
+        // nonetheless, so that a storage that persists its content can
+        // restore them.
+        result = m_pStorage->put_value(key, invalidation_words, pvalue);
 
         if (CACHE_RESULT_IS_OK(result))
         {
@@ -112,6 +152,8 @@ cache_result_t LRUStorage::do_put_value(const CACHE_KEY& key, const GWBUF* pvalu
                 ++m_stats.updates;
                 ss_dassert(m_stats.size >= pNode->size());
                 m_stats.size -= pNode->size();
+
+                remove_from_index(pNode);
             }
             else
             {
@@ -121,6 +163,9 @@ cache_result_t LRUStorage::do_put_value(const CACHE_KEY& key, const GWBUF* pvalu
             pNode->reset(&i->first, value_size);
             m_stats.size += pNode->size();
 
+            pNode->set_invalidation_words(invalidation_words);
+            add_to_index(pNode);
+
             move_to_head(pNode);
         }
         else if (!existed)
@@ -137,6 +182,11 @@ cache_result_t LRUStorage::do_del_value(const CACHE_KEY& key)
 {
     cache_result_t result = CACHE_RESULT_NOT_FOUND;
 
+    if (m_restoring)
+    {
+        restore();
+    }
+
     NodesByKey::iterator i = m_nodes_by_key.find(key);
     bool existed = (i != m_nodes_by_key.end());
 
@@ -162,6 +212,63 @@ cache_result_t LRUStorage::do_del_value(const CACHE_KEY& key)
     return result;
 }
 
+cache_result_t LRUStorage::do_invalidate(const std::vector<std::string>& words)
+{
+    cache_result_t result = CACHE_RESULT_OK;
+
+    if (m_restoring)
+    {
+        restore();
+    }
+
+    for (std::vector<std::string>::const_iterator i = words.begin();
+         (i != words.end()) && CACHE_RESULT_IS_OK(result);
+         ++i)
+    {
+        NodesByWord::iterator j = m_nodes_by_word.find(*i);
+
+        if (j != m_nodes_by_word.end())
+        {
+            // Freeing a node removes it from the index, so the nodes are copied.
+            std::vector<Node*> nodes(j->second.begin(), j->second.end());
+
+            for (std::vector<Node*>::iterator k = nodes.begin();
+                 (k != nodes.end()) && CACHE_RESULT_IS_OK(result);
+                 ++k)
+            {
+                Node* pNode = *k;
+                ss_dassert(pNode->key());
+
+                NodesByKey::iterator l = m_nodes_by_key.find(*pNode->key());
+                ss_dassert(l != m_nodes_by_key.end());
+
+                cache_result_t rv = m_pStorage->del_value(l->first);
+
+                if (CACHE_RESULT_IS_OK(rv) || CACHE_RESULT_IS_NOT_FOUND(rv))
+                {
+                    // If it wasn't found, we'll assume it was because ttl has hit in.
+                    ++m_stats.invalidations;
+
+                    ss_dassert(m_stats.size >= pNode->size());
+                    ss_dassert(m_stats.items > 0);
+
+                    m_stats.size -= pNode->size();
+                    --m_stats.items;
+
+                    free_node(l);
+                }
+                else
+                {
+                    MXS_ERROR("Could not remove invalidated value from storage.");
+                    result = rv;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
 cache_result_t LRUStorage::do_get_head(CACHE_KEY* pKey, GWBUF** ppValue) const
 {
     cache_result_t result = CACHE_RESULT_NOT_FOUND;
@@ -220,6 +327,12 @@ cache_result_t LRUStorage::access_value(access_approach_t approach,
 {
     cache_result_t result = CACHE_RESULT_NOT_FOUND;
 
+    if (m_pSketch && (approach == APPROACH_GET))
+    {
+        // Misses are counted as well, as a miss is followed by a put.
+        m_pSketch->increment(key);
+    }
+
     NodesByKey::iterator i = m_nodes_by_key.find(key);
     bool existed = (i != m_nodes_by_key.end());
 
@@ -255,6 +368,37 @@ cache_result_t LRUStorage::access_value(access_approach_t approach,
     return result;
 }
 
+/**
+ * Decide whether a new value should be stored. If storing it would cause
+ * the least recently used value to be evicted, the new value is stored only
+ * if its key has been used more often than the key of the evicted value.
+ *
+ * @param key         The key of the new value.
+ * @param value_size  The size of the new value.
+ *
+ * @return True, if the value should be stored.
+ */
+bool LRUStorage::admit(const CACHE_KEY& key, size_t value_size) const
+{
+    bool admitted = true;
+
+    if (m_pSketch && m_pTail)
+    {
+        size_t new_size = m_stats.size + value_size;
+
+        if ((new_size > m_max_size) || (m_stats.items == m_max_count))
+        {
+            ss_dassert(m_pTail->key());
+
+            // If more than one value would have to be evicted, only the first
+            // is considered.
+            admitted = m_pSketch->frequency(key) > m_pSketch->frequency(*m_pTail->key());
+        }
+    }
+
+    return admitted;
+}
+
 /**
  * Free the data associated with the least recently used node,
  * but not the node itself.
@@ -358,6 +502,8 @@ bool LRUStorage::free_node_data(Node* pNode)
             m_nodes_by_key.erase(i);
         }
 
+        remove_from_index(pNode);
+
         ss_dassert(m_stats.size >= pNode->size());
         ss_dassert(m_stats.items > 0);
 
@@ -397,6 +543,7 @@ void LRUStorage::free_node(Node* pNode) const
  */
 void LRUStorage::free_node(NodesByKey::iterator& i) const
 {
+    remove_from_index(i->second);
     free_node(i->second); // A Node
     m_nodes_by_key.erase(i);
 }
@@ -456,6 +603,136 @@ void LRUStorage::move_to_head(Node* pNode) const
     ss_dassert(m_pTail->next() == NULL);
 }
 
+/**
+ * Add a node that is not in the LRU list to the tail of the list.
+ *
+ * @param pNode  The node to be added.
+ */
+void LRUStorage::add_to_tail(Node* pNode) const
+{
+    ss_dassert(!pNode->prev() && !pNode->next());
+
+    m_pTail = pNode->append(m_pTail);
+
+    if (!m_pHead)
+    {
+        m_pHead = m_pTail;
+    }
+
+    ss_dassert(m_pHead->prev() == NULL);
+    ss_dassert(m_pTail->next() == NULL);
+}
+
+/**
+ * Add a node to the invalidation index, using the words of the node.
+ *
+ * @param pNode  The node to be added.
+ */
+void LRUStorage::add_to_index(Node* pNode) const
+{
+    const std::vector<std::string>& words = pNode->invalidation_words();
+
+    for (std::vector<std::string>::const_iterator i = words.begin(); i != words.end(); ++i)
+    {
+        m_nodes_by_word[*i].insert(pNode);
+    }
+}
+
+/**
+ * Remove a node from the invalidation index and clear the words of the node.
+ *
+ * @param pNode  The node to be removed.
+ */
+void LRUStorage::remove_from_index(Node* pNode) const
+{
+    const std::vector<std::string>& words = pNode->invalidation_words();
+
+    for (std::vector<std::string>::const_iterator i = words.begin(); i != words.end(); ++i)
+    {
+        NodesByWord::iterator j = m_nodes_by_word.find(*i);
+
+        if (j != m_nodes_by_word.end())
+        {
+            j->second.erase(pNode);
+
+            if (j->second.empty())
+            {
+                m_nodes_by_word.erase(j);
+            }
+        }
+    }
+
+    pNode->clear_invalidation_words();
+}
+
+/**
+ * Add the items the actual storage has restored, for instance after a restart,
+ * to the LRU list and the invalidation index; the storage does not serve an
+ * item unless it is asked for it here. Items that have been put since the
+ * startup are more relevant than restored ones, so restored items are added
+ * to the tail and only if no item has to be evicted for them. Items that do
+ * not fit are deleted from the storage.
+ */
+void LRUStorage::restore() const
+{
+    CACHE_KEY key;
+    uint64_t size;
+    std::vector<std::string> words;
+    cache_result_t result;
+
+    while ((result = m_pStorage->get_restored(&key, &size, &words)) == CACHE_RESULT_OK)
+    {
+        if (m_nodes_by_key.find(key) != m_nodes_by_key.end())
+        {
+            // The value has been put since the startup and replaced the restored one.
+            continue;
+        }
+
+        Node* pNode = NULL;
+
+        if ((m_stats.size + size <= m_max_size) && (m_stats.items < m_max_count))
+        {
+            pNode = new (std::nothrow) Node;
+        }
+
+        if (pNode)
+        {
+            try
+            {
+                pNode->set_invalidation_words(words);
+
+                NodesByKey::iterator i = m_nodes_by_key.insert(std::make_pair(key, pNode)).first;
+                pNode->reset(&i->first, size);
+            }
+            catch (const std::exception& x)
+            {
+                delete pNode;
+                pNode = NULL;
+            }
+        }
+
+        if (pNode)
+        {
+            add_to_index(pNode);
+            add_to_tail(pNode);
+
+            ++m_stats.items;
+            ++m_stats.restored;
+            m_stats.size += size;
+        }
+        else
+        {
+            m_pStorage->del_value(key);
+        }
+    }
+
+    if (result != CACHE_RESULT_NOT_FOUND)
+    {
+        // Either all items have been restored or the storage does not restore any.
+        m_restoring = false;
+    }
+}
+
 cache_result_t LRUStorage::get_existing_node(NodesByKey::iterator& i, const GWBUF* pValue, Node** ppNode)
 {
     cache_result_t result = CACHE_RESULT_OK;
@@ -599,4 +876,18 @@ void LRUStorage::Stats::fill(json_t* pObject) const
     set_integer(pObject, "updates", updates);
     set_integer(pObject, "deletes", deletes);
     set_integer(pObject, "evictions", evictions);
+    set_integer(pObject, "invalidations", invalidations);
+    set_integer(pObject, "rejections", rejections);
+    set_integer(pObject, "restored", restored);
+
+    if (hits + misses != 0)
+    {
+        json_t* pHit_ratio = json_real(static_cast<double>(hits) / (hits + misses));
+
+        if (pHit_ratio)
+        {
+            json_object_set(pObject, "hit_ratio", pHit_ratio);
+            json_decref(pHit_ratio);
+        }
+    }
 }
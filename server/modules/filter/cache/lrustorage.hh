@@ -14,8 +14,10 @@
 
 #include <maxscale/cppdefs.hh>
 #include <tr1/unordered_map>
+#include <tr1/unordered_set>
 #include "cachefilter.h"
 #include "cache_storage_api.hh"
+#include "frequencysketch.hh"
 #include "storage.hh"
 
 class LRUStorage : public Storage
@@ -28,6 +30,14 @@ public:
      */
     void get_config(CACHE_STORAGE_CONFIG* pConfig);
 
+    /**
+     * @return CACHE_RESULT_OUT_OF_RESOURCES, as the values restored by the
+     *         decorated storage are served by this storage.
+     */
+    cache_result_t get_restored(CACHE_KEY* pKey,
+                                uint64_t* pSize,
+                                std::vector<std::string>* pWords);
+
 protected:
     LRUStorage(const CACHE_STORAGE_CONFIG& config, Storage* pStorage);
 
@@ -47,6 +57,7 @@ protected:
      * @see Storage::put_value
      */
     cache_result_t do_put_value(const CACHE_KEY& key,
+                                const std::vector<std::string>& invalidation_words,
                                 const GWBUF* pValue);
 
     /**
@@ -54,6 +65,11 @@ protected:
      */
     cache_result_t do_del_value(const CACHE_KEY& key);
 
+    /**
+     * @see Storage::invalidate
+     */
+    cache_result_t do_invalidate(const std::vector<std::string>& words);
+
     /**
      * @see Storage::get_head
      */
@@ -166,6 +182,40 @@ private:
             return this;
         }
 
+        /**
+         * Move the node after the node provided as argument.
+         *
+         * @param  pnode  The node after which this should be moved.
+         * @return This node.
+         */
+        Node* append(Node* pNode)
+        {
+            if (pNode && (pNode != this))
+            {
+                if (m_pPrev)
+                {
+                    m_pPrev->m_pNext = m_pNext;
+                }
+
+                if (m_pNext)
+                {
+                    m_pNext->m_pPrev = m_pPrev;
+                }
+
+                if (pNode->m_pNext)
+                {
+                    pNode->m_pNext->m_pPrev = this;
+                }
+
+                m_pNext = pNode->m_pNext;
+                m_pPrev = pNode;
+
+                pNode->m_pNext = this;
+            }
+
+            return this;
+        }
+
         /**
          * Remove this node from the list.
          *
@@ -197,15 +247,34 @@ private:
             m_size = size;
         }
 
+        const std::vector<std::string>& invalidation_words() const
+        {
+            return m_invalidation_words;
+        }
+
+        void set_invalidation_words(const std::vector<std::string>& words)
+        {
+            m_invalidation_words = words;
+        }
+
+        void clear_invalidation_words()
+        {
+            m_invalidation_words.clear();
+        }
+
     private:
-        const CACHE_KEY* m_pKey;  /*< Points at the key stored in nodes_by_key_ below. */
-        size_t           m_size;  /*< The size of the data referred to by m_pKey. */
-        Node*            m_pNext; /*< The next node in the LRU list. */
-        Node*            m_pPrev; /*< The previous node in the LRU list. */
+        const CACHE_KEY*         m_pKey;               /*< Points at the key stored in nodes_by_key_ below. */
+        size_t                   m_size;               /*< The size of the data referred to by m_pKey. */
+        Node*                    m_pNext;              /*< The next node in the LRU list. */
+        Node*                    m_pPrev;              /*< The previous node in the LRU list. */
+        std::vector<std::string> m_invalidation_words; /*< The words via which the node can be invalidated. */
     };
 
     typedef std::tr1::unordered_map<CACHE_KEY, Node*> NodesByKey;
+    typedef std::tr1::unordered_set<Node*> Nodes;
+    typedef std::tr1::unordered_map<std::string, Nodes> NodesByWord;
 
+    bool admit(const CACHE_KEY& key, size_t value_size) const;
     Node* vacate_lru();
     Node* vacate_lru(size_t space);
     bool free_node_data(Node* pNode);
@@ -213,6 +282,10 @@ private:
     void free_node(NodesByKey::iterator& i) const;
     void remove_node(Node* pNode) const;
     void move_to_head(Node* pNode) const;
+    void add_to_tail(Node* pNode) const;
+    void add_to_index(Node* pNode) const;
+    void remove_from_index(Node* pNode) const;
+    void restore() const;
 
     cache_result_t get_existing_node(NodesByKey::iterator& i, const GWBUF* pvalue, Node** ppNode);
     cache_result_t get_new_node(const CACHE_KEY& key,
@@ -231,25 +304,34 @@ private:
             , updates(0)
             , deletes(0)
             , evictions(0)
+            , invalidations(0)
+            , rejections(0)
+            , restored(0)
         {}
 
         void fill(json_t* pObject) const;
 
-        uint64_t size;       /*< The total size of the stored values. */
-        uint64_t items;      /*< The number of stored items. */
-        uint64_t hits;       /*< How many times a key was found in the cache. */
-        uint64_t misses;     /*< How many times a key was not found in the cache. */
-        uint64_t updates;    /*< How many times an existing key in the cache was updated. */
-        uint64_t deletes;    /*< How many times an existing key in the cache was deleted. */
-        uint64_t evictions;  /*< How many times an item has been evicted from the cache. */
+        uint64_t size;          /*< The total size of the stored values. */
+        uint64_t items;         /*< The number of stored items. */
+        uint64_t hits;          /*< How many times a key was found in the cache. */
+        uint64_t misses;        /*< How many times a key was not found in the cache. */
+        uint64_t updates;       /*< How many times an existing key in the cache was updated. */
+        uint64_t deletes;       /*< How many times an existing key in the cache was deleted. */
+        uint64_t evictions;     /*< How many times an item has been evicted from the cache. */
+        uint64_t invalidations; /*< How many times an item has been invalidated. */
+        uint64_t rejections;    /*< How many times an item was not admitted to the cache. */
+        uint64_t restored;      /*< How many items restored by the storage were added. */
     };
 
-    const CACHE_STORAGE_CONFIG m_config;       /*< The configuration. */
-    Storage*                   m_pStorage;     /*< The actual storage. */
-    const uint64_t             m_max_count;    /*< The maximum number of items in the LRU list, */
-    const uint64_t             m_max_size;     /*< The maximum size of all cached items. */
-    mutable Stats              m_stats;        /*< Cache statistics. */
-    mutable NodesByKey         m_nodes_by_key; /*< Mapping from cache keys to corresponding Node. */
-    mutable Node*              m_pHead;        /*< The node at the LRU list. */
-    mutable Node*              m_pTail;        /*< The node at bottom of the LRU list.*/
+    const CACHE_STORAGE_CONFIG m_config;        /*< The configuration. */
+    Storage*                   m_pStorage;      /*< The actual storage. */
+    const uint64_t             m_max_count;     /*< The maximum number of items in the LRU list, */
+    const uint64_t             m_max_size;      /*< The maximum size of all cached items. */
+    mutable Stats              m_stats;         /*< Cache statistics. */
+    mutable NodesByKey         m_nodes_by_key;  /*< Mapping from cache keys to corresponding Node. */
+    mutable NodesByWord        m_nodes_by_word; /*< Mapping from invalidation words to Nodes. */
+    mutable Node*              m_pHead;         /*< The node at the LRU list. */
+    mutable Node*              m_pTail;         /*< The node at bottom of the LRU list.*/
+    FrequencySketch*           m_pSketch;       /*< Key frequencies, if TinyLFU admission is used. */
+    mutable bool               m_restoring;     /*< Whether the storage may still restore items. */
 };
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#define MXS_MODULE_NAME "cache"
+#include "shardedstorage.hh"
+
+ShardedStorage::ShardedStorage(const CACHE_STORAGE_CONFIG& config, const Shards& shards)
+    : m_config(config)
+    , m_shards(shards)
+{
+    MXS_NOTICE("Created sharded storage with %lu shards.", m_shards.size());
+}
+
+ShardedStorage::~ShardedStorage()
+{
+    for (Shards::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        delete *i;
+    }
+}
+
+ShardedStorage* ShardedStorage::create(const CACHE_STORAGE_CONFIG& config, const Shards& shards)
+{
+    ss_dassert(!shards.empty());
+
+    ShardedStorage* pStorage = NULL;
+
+    MXS_EXCEPTION_GUARD(pStorage = new ShardedStorage(config, shards));
+
+    return pStorage;
+}
+
+void ShardedStorage::get_config(CACHE_STORAGE_CONFIG* pConfig)
+{
+    *pConfig = m_config;
+}
+
+cache_result_t ShardedStorage::get_info(uint32_t what,
+                                        json_t** ppInfo) const
+{
+    *ppInfo = json_object();
+
+    if (*ppInfo)
+    {
+        json_t* pShards = json_array();
+
+        if (pShards)
+        {
+            for (Shards::const_iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+            {
+                json_t* pShard_info;
+
+                cache_result_t result = (*i)->get_info(what, &pShard_info);
+
+                if (CACHE_RESULT_IS_OK(result))
+                {
+                    json_array_append_new(pShards, pShard_info);
+                }
+            }
+
+            json_object_set(*ppInfo, "shards", pShards);
+            json_decref(pShards);
+        }
+    }
+
+    return *ppInfo ? CACHE_RESULT_OK : CACHE_RESULT_OUT_OF_RESOURCES;
+}
+
+cache_result_t ShardedStorage::get_value(const CACHE_KEY& key,
+                                         uint32_t flags,
+                                         GWBUF** ppValue) const
+{
+    return shard(key).get_value(key, flags, ppValue);
+}
+
+cache_result_t ShardedStorage::put_value(const CACHE_KEY& key,
+                                         const std::vector<std::string>& invalidation_words,
+                                         const GWBUF* pValue)
+{
+    return shard(key).put_value(key, invalidation_words, pValue);
+}
+
+cache_result_t ShardedStorage::del_value(const CACHE_KEY& key)
+{
+    return shard(key).del_value(key);
+}
+
+cache_result_t ShardedStorage::invalidate(const std::vector<std::string>& words)
+{
+    cache_result_t rv = CACHE_RESULT_OK;
+
+    // The values depending upon a particular word may be in any shard.
+    for (Shards::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        cache_result_t result = (*i)->invalidate(words);
+
+        if (!CACHE_RESULT_IS_OK(result))
+        {
+            rv = result;
+        }
+    }
+
+    return rv;
+}
+
+cache_result_t ShardedStorage::get_head(CACHE_KEY* pKey, GWBUF** ppHead) const
+{
+    return CACHE_RESULT_OUT_OF_RESOURCES;
+}
+
+cache_result_t ShardedStorage::get_tail(CACHE_KEY* pKey, GWBUF** ppTail) const
+{
+    return CACHE_RESULT_OUT_OF_RESOURCES;
+}
+
+cache_result_t ShardedStorage::get_size(uint64_t* pSize) const
+{
+    cache_result_t rv = CACHE_RESULT_OK;
+    uint64_t total = 0;
+
+    for (Shards::const_iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        uint64_t size;
+        cache_result_t result = (*i)->get_size(&size);
+
+        if (CACHE_RESULT_IS_OK(result))
+        {
+            total += size;
+        }
+        else
+        {
+            rv = result;
+        }
+    }
+
+    *pSize = total;
+
+    return rv;
+}
+
+cache_result_t ShardedStorage::get_items(uint64_t* pItems) const
+{
+    cache_result_t rv = CACHE_RESULT_OK;
+    uint64_t total = 0;
+
+    for (Shards::const_iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        uint64_t items;
+        cache_result_t result = (*i)->get_items(&items);
+
+        if (CACHE_RESULT_IS_OK(result))
+        {
+            total += items;
+        }
+        else
+        {
+            rv = result;
+        }
+    }
+
+    *pItems = total;
+
+    return rv;
+}
+
+cache_result_t ShardedStorage::get_restored(CACHE_KEY* pKey,
+                                            uint64_t* pSize,
+                                            std::vector<std::string>* pWords)
+{
+    return CACHE_RESULT_OUT_OF_RESOURCES;
+}
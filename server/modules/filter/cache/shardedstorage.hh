@@ -0,0 +1,102 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <vector>
+#include "cache_storage_api.hh"
+#include "storage.hh"
+
+/**
+ * A ShardedStorage partitions the keys across a number of independent
+ * storages, each of which has its own lock and its own LRU list. Threads
+ * accessing different keys will then contend only if the keys happen to
+ * map to the same shard.
+ *
+ * Since there is no global LRU order, the least recently used item that is
+ * evicted is the least recently used item of a particular shard.
+ */
+class ShardedStorage : public Storage
+{
+public:
+    typedef std::vector<Storage*> Shards;
+
+    ~ShardedStorage();
+
+    /**
+     * Create a sharded storage.
+     *
+     * @param config   The configuration of the storage as a whole.
+     * @param shards   The shards, each one of which must be thread safe. The
+     *                 created instance takes ownership of them.
+     *
+     * @return A new instance or NULL if one could not be created.
+     */
+    static ShardedStorage* create(const CACHE_STORAGE_CONFIG& config, const Shards& shards);
+
+    void get_config(CACHE_STORAGE_CONFIG* pConfig);
+
+    cache_result_t get_info(uint32_t what,
+                            json_t** ppInfo) const;
+
+    cache_result_t get_value(const CACHE_KEY& key,
+                             uint32_t flags,
+                             GWBUF** ppValue) const;
+
+    cache_result_t put_value(const CACHE_KEY& key,
+                             const std::vector<std::string>& invalidation_words,
+                             const GWBUF* pValue);
+
+    cache_result_t del_value(const CACHE_KEY& key);
+
+    cache_result_t invalidate(const std::vector<std::string>& words);
+
+    /**
+     * @return CACHE_RESULT_OUT_OF_RESOURCES, as there is no global LRU order.
+     */
+    cache_result_t get_head(CACHE_KEY* pKey,
+                            GWBUF** ppValue) const;
+
+    /**
+     * @return CACHE_RESULT_OUT_OF_RESOURCES, as there is no global LRU order.
+     */
+    cache_result_t get_tail(CACHE_KEY* pKey,
+                            GWBUF** ppValue) const;
+
+    cache_result_t get_size(uint64_t* pSize) const;
+
+    cache_result_t get_items(uint64_t* pItems) const;
+
+    /**
+     * @return CACHE_RESULT_OUT_OF_RESOURCES, as the shards serve the values
+     *         they have restored themselves.
+     */
+    cache_result_t get_restored(CACHE_KEY* pKey,
+                                uint64_t* pSize,
+                                std::vector<std::string>* pWords);
+
+private:
+    ShardedStorage(const CACHE_STORAGE_CONFIG& config, const Shards& shards);
+
+    ShardedStorage(const ShardedStorage&);
+    ShardedStorage& operator = (const ShardedStorage&);
+
+    Storage& shard(const CACHE_KEY& key) const
+    {
+        return *m_shards[cache_key_hash(&key) % m_shards.size()];
+    }
+
+private:
+    const CACHE_STORAGE_CONFIG m_config; /*< The configuration. */
+    Shards                     m_shards; /*< The shards. */
+};
@@ -13,6 +13,8 @@
  */
 
 #include <maxscale/cppdefs.hh>
+#include <string>
+#include <vector>
 #include "cache_storage_api.h"
 
 class Storage
@@ -64,14 +66,18 @@ public:
     /**
      * Put a value to the cache.
      *
-     * @param key     A key generated with get_key.
-     * @param pValue  Pointer to GWBUF containing the value to be stored.
-     *                Must be one contiguous buffer.
+     * @param key                 A key generated with get_key.
+     * @param invalidation_words  Words via which the value can be invalidated,
+     *                            typically fully qualified table names.
+     * @param pValue              Pointer to GWBUF containing the value to be stored.
+     *                            Must be one contiguous buffer.
      * @return CACHE_RESULT_OK if item was successfully put,
      *         CACHE_RESULT_OUT_OF_RESOURCES if item could not be put, due to
      *         some resource having become exhausted, or some other error code.
      */
-    virtual cache_result_t put_value(const CACHE_KEY& key, const GWBUF* pValue) = 0;
+    virtual cache_result_t put_value(const CACHE_KEY& key,
+                                     const std::vector<std::string>& invalidation_words,
+                                     const GWBUF* pValue) = 0;
 
     /**
      * Delete a value from the cache.
@@ -84,6 +90,16 @@ public:
      */
     virtual cache_result_t del_value(const CACHE_KEY& key) = 0;
 
+    /**
+     * Invalidate entries in the cache.
+     *
+     * @param words  Words via which values are invalidated. All values that were
+     *               put with at least one of the words are deleted.
+     *
+     * @return CACHE_RESULT_OK if the invalidation succeeded.
+     */
+    virtual cache_result_t invalidate(const std::vector<std::string>& words) = 0;
+
     /**
      * Get the head item from the storage. This is only intended for testing and
      * debugging purposes and if the storage is being used by different threads
@@ -154,6 +170,28 @@ public:
      */
     virtual cache_result_t get_items(uint64_t* pItems) const = 0;
 
+    /**
+     * Get a value the storage has restored, for instance from a file written
+     * before MaxScale was restarted. Each value is returned only once.
+     *
+     * @param pKey    Pointer to variable that after a successful return will
+     *                contain the key.
+     * @param pSize   Pointer to variable that after a successful return will
+     *                contain the size of the value.
+     * @param pWords  Pointer to variable that after a successful return will
+     *                contain the invalidation words of the value.
+     *
+     * @return CACHE_RESULT_OK if a value was returned,
+     *         CACHE_RESULT_NOT_FOUND if no value is available now, but
+     *         one may become available later,
+     *         CACHE_RESULT_OUT_OF_RESOURCES if the storage does not restore
+     *         values or has returned all of them, and
+     *         CACHE_RESULT_ERROR otherwise.
+     */
+    virtual cache_result_t get_restored(CACHE_KEY* pKey,
+                                        uint64_t* pSize,
+                                        std::vector<std::string>* pWords) = 0;
+
 protected:
     Storage();
 
@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#define MXS_MODULE_NAME "storage_inmemory"
+#include "inmemorysnapshot.hh"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <maxscale/alloc.h>
+#include <maxscale/atomic.h>
+
+using std::string;
+using std::vector;
+
+namespace
+{
+
+const char     SNAPSHOT_MAGIC[8] = { 'M', 'X', 'S', 'C', 'A', 'C', 'H', 'E' };
+const uint32_t SNAPSHOT_VERSION = 1;
+
+// How much submitted data may wait for being written.
+const size_t MAX_QUEUED = 4 * InMemorySnapshot::BATCH_SIZE;
+
+struct SnapshotHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t key_size;  /*< sizeof(CACHE_KEY), so that a key layout change is detected. */
+    uint64_t n_records;
+};
+
+template<class T>
+void append(InMemorySnapshot::Data* pData, const T& t)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&t);
+    pData->insert(pData->end(), p, p + sizeof(T));
+}
+
+/**
+ * Write all of a memory area to a file, at its current position.
+ *
+ * @return True, if everything could be written.
+ */
+bool write_all(int fd, const uint8_t* p, size_t n)
+{
+    bool error = false;
+
+    while (!error && (n != 0))
+    {
+        ssize_t written = ::write(fd, p, n);
+
+        if (written > 0)
+        {
+            p += written;
+            n -= written;
+        }
+        else if ((written == -1) && (errno != EINTR))
+        {
+            error = true;
+        }
+    }
+
+    return !error;
+}
+
+/**
+ * Read a value from a memory area, whose alignment is not known.
+ *
+ * @return True, if the value could be read without reading past the end.
+ */
+template<class T>
+bool extract(const uint8_t** ppData, const uint8_t* pEnd, T* pT)
+{
+    bool rv = false;
+
+    if (pEnd - *ppData >= static_cast<ptrdiff_t>(sizeof(T)))
+    {
+        memcpy(pT, *ppData, sizeof(T));
+        *ppData += sizeof(T);
+        rv = true;
+    }
+
+    return rv;
+}
+
+}
+
+InMemorySnapshot::InMemorySnapshot(const string& path, uint32_t interval)
+    : m_path(path)
+    , m_interval(interval)
+    , m_next(time(NULL) + interval)
+    , m_running(false)
+    , m_fd(-1)
+    , m_n_written(0)
+    , m_loaded(0)
+    , m_queued(0)
+    , m_stopping(false)
+{
+}
+
+InMemorySnapshot::~InMemorySnapshot()
+{
+    if (m_running)
+    {
+        m_lock.acquire();
+        m_stopping = true;
+        m_lock.release();
+
+        m_work.post();
+        thread_wait(m_thread);
+    }
+}
+
+InMemorySnapshot* InMemorySnapshot::create(const string& path, uint32_t interval)
+{
+    InMemorySnapshot* pSnapshot = NULL;
+
+    MXS_EXCEPTION_GUARD(pSnapshot = new InMemorySnapshot(path, interval));
+
+    if (pSnapshot)
+    {
+        if (thread_start(&pSnapshot->m_thread, &InMemorySnapshot::thread_main, pSnapshot, 0))
+        {
+            pSnapshot->m_running = true;
+        }
+        else
+        {
+            MXS_ERROR("Could not start the snapshot thread for '%s'.", path.c_str());
+            delete pSnapshot;
+            pSnapshot = NULL;
+        }
+    }
+
+    return pSnapshot;
+}
+
+bool InMemorySnapshot::take_records(Records* pRecords)
+{
+    bool rv = false;
+
+    if (atomic_load_int32(&m_loaded))
+    {
+        mxs::SpinLockGuard guard(m_lock);
+
+        pRecords->swap(m_records);
+        m_loaded = 0;
+        rv = true;
+    }
+
+    return rv;
+}
+
+bool InMemorySnapshot::is_ready() const
+{
+    mxs::SpinLockGuard guard(m_lock);
+
+    return m_queued < MAX_QUEUED;
+}
+
+void InMemorySnapshot::wait_until_ready() const
+{
+    while (!is_ready())
+    {
+        usleep(1000);
+    }
+}
+
+void InMemorySnapshot::submit(Data& data, uint64_t n_records, bool first, bool last, time_t now)
+{
+    mxs::SpinLockGuard guard(m_lock);
+
+    m_batches.push_back(Batch());
+
+    Batch& batch = m_batches.back();
+    batch.data.swap(data);
+    batch.n_records = n_records;
+    batch.first = first;
+    batch.last = last;
+
+    m_queued += batch.data.size();
+
+    if (first)
+    {
+        m_next = now + m_interval;
+    }
+
+    m_work.post();
+}
+
+//static
+void InMemorySnapshot::add(Data* pData,
+                           const CACHE_KEY& key,
+                           uint32_t time,
+                           uint32_t length,
+                           bool compressed,
+                           const vector<uint8_t>& value,
+                           const vector<string>& words)
+{
+    append(pData, key);
+    append(pData, time);
+    append(pData, length);
+    append(pData, static_cast<uint32_t>(value.size()));
+    append(pData, static_cast<uint8_t>(compressed));
+    append(pData, static_cast<uint8_t>(0));
+    append(pData, static_cast<uint16_t>(words.size()));
+
+    for (vector<string>::const_iterator i = words.begin(); i != words.end(); ++i)
+    {
+        append(pData, static_cast<uint16_t>(i->length()));
+        pData->insert(pData->end(), i->begin(), i->end());
+    }
+
+    pData->insert(pData->end(), value.begin(), value.end());
+}
+
+//static
+void InMemorySnapshot::thread_main(void* pArg)
+{
+    static_cast<InMemorySnapshot*>(pArg)->run();
+}
+
+void InMemorySnapshot::run()
+{
+    load();
+
+    bool stop = false;
+
+    while (!stop)
+    {
+        m_work.wait();
+        stop = save();
+    }
+
+    if (m_fd != -1)
+    {
+        // The last batch was never submitted.
+        discard_file();
+    }
+
+    // A batch may have been written at an earlier post than its own.
+    while (m_work.trywait())
+    {
+    }
+}
+
+void InMemorySnapshot::load()
+{
+    Records records;
+
+    int fd = open(m_path.c_str(), O_RDONLY);
+
+    if (fd != -1)
+    {
+        struct stat st;
+
+        if (fstat(fd, &st) == 0)
+        {
+            if (st.st_size != 0)
+            {
+                void* pMap = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if (pMap != MAP_FAILED)
+                {
+                    const uint8_t* pBegin = static_cast<const uint8_t*>(pMap);
+
+                    if (parse(pBegin, pBegin + st.st_size, &records))
+                    {
+                        MXS_NOTICE("Loaded %lu cached values from '%s'.",
+                                   records.size(), m_path.c_str());
+                    }
+                    else
+                    {
+                        MXS_ERROR("The cache snapshot '%s' is not valid, it will be ignored.",
+                                  m_path.c_str());
+                        Records().swap(records);
+                    }
+
+                    munmap(pMap, st.st_size);
+                }
+                else
+                {
+                    MXS_ERROR("Could not map the cache snapshot '%s': %s",
+                              m_path.c_str(), mxs_strerror(errno));
+                }
+            }
+        }
+        else
+        {
+            MXS_ERROR("Could not stat the cache snapshot '%s': %s",
+                      m_path.c_str(), mxs_strerror(errno));
+        }
+
+        close(fd);
+    }
+    else if (errno != ENOENT)
+    {
+        MXS_ERROR("Could not open the cache snapshot '%s': %s",
+                  m_path.c_str(), mxs_strerror(errno));
+    }
+
+    mxs::SpinLockGuard guard(m_lock);
+
+    m_records.swap(records);
+    atomic_store_int32(&m_loaded, 1);
+}
+
+/**
+ * Write the submitted batches.
+ *
+ * @return True, if the thread should exit.
+ */
+bool InMemorySnapshot::save()
+{
+    bool stop = false;
+    bool more = true;
+
+    while (more)
+    {
+        Batch batch;
+
+        m_lock.acquire();
+
+        if (m_batches.empty())
+        {
+            stop = m_stopping;
+            more = false;
+        }
+        else
+        {
+            Batch& front = m_batches.front();
+            batch.data.swap(front.data);
+            batch.n_records = front.n_records;
+            batch.first = front.first;
+            batch.last = front.last;
+
+            m_batches.pop_front();
+        }
+
+        m_lock.release();
+
+        if (more)
+        {
+            write(batch);
+
+            // The batch is no longer waiting, once it has been written.
+            mxs::SpinLockGuard guard(m_lock);
+            m_queued -= batch.data.size();
+        }
+    }
+
+    return stop;
+}
+
+bool InMemorySnapshot::parse(const uint8_t* pData, const uint8_t* pEnd, Records* pRecords) const
+{
+    SnapshotHeader header;
+
+    bool ok = extract(&pData, pEnd, &header) &&
+              (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0) &&
+              (header.version == SNAPSHOT_VERSION) &&
+              (header.key_size == sizeof(CACHE_KEY));
+
+    if (ok)
+    {
+        // The count is not trusted further than what the file can contain.
+        const size_t min_record_size = sizeof(CACHE_KEY) + 4 * sizeof(uint32_t);
+        uint64_t max_records = (pEnd - pData) / min_record_size;
+
+        pRecords->reserve(header.n_records < max_records ? header.n_records : max_records);
+    }
+
+    for (uint64_t i = 0; ok && (i < header.n_records); ++i)
+    {
+        pRecords->push_back(Record());
+        Record& record = pRecords->back();
+
+        uint32_t size;
+        uint8_t compressed;
+        uint8_t padding;
+        uint16_t n_words;
+
+        ok = extract(&pData, pEnd, &record.key) &&
+             extract(&pData, pEnd, &record.time) &&
+             extract(&pData, pEnd, &record.length) &&
+             extract(&pData, pEnd, &size) &&
+             extract(&pData, pEnd, &compressed) &&
+             extract(&pData, pEnd, &padding) &&
+             extract(&pData, pEnd, &n_words);
+
+        record.compressed = (compressed != 0);
+
+        for (uint16_t j = 0; ok && (j < n_words); ++j)
+        {
+            uint16_t length;
+
+            ok = extract(&pData, pEnd, &length) && (pEnd - pData >= length);
+
+            if (ok)
+            {
+                record.invalidation_words.push_back(string(pData, pData + length));
+                pData += length;
+            }
+        }
+
+        if (ok)
+        {
+            ok = (pEnd - pData >= size);
+
+            if (ok)
+            {
+                record.value.assign(pData, pData + size);
+                pData += size;
+            }
+        }
+    }
+
+    return ok && (pData == pEnd);
+}
+
+/**
+ * Write a batch to the temporary file. The first batch of a snapshot creates
+ * the file and the last one replaces the snapshot with it. If the file cannot
+ * be written, the batches are ignored until the next snapshot is started.
+ *
+ * @param batch  The batch.
+ */
+void InMemorySnapshot::write(const Batch& batch)
+{
+    if (batch.first)
+    {
+        if (m_fd != -1)
+        {
+            // The previous snapshot was restarted before its last batch.
+            discard_file();
+        }
+
+        begin_file();
+    }
+
+    if (m_fd != -1)
+    {
+        if (batch.data.empty() || write_all(m_fd, &batch.data.front(), batch.data.size()))
+        {
+            m_n_written += batch.n_records;
+
+            if (batch.last)
+            {
+                end_file();
+            }
+        }
+        else
+        {
+            MXS_ERROR("Could not write the cache snapshot '%s.tmp': %s",
+                      m_path.c_str(), mxs_strerror(errno));
+            discard_file();
+        }
+    }
+}
+
+/**
+ * Create the temporary file and write a header of no records to it.
+ *
+ * The snapshot is written to a temporary file that is then renamed, so that
+ * a crash while writing does not leave a truncated snapshot behind.
+ */
+void InMemorySnapshot::begin_file()
+{
+    ss_dassert(m_fd == -1);
+
+    string tmp = m_path + ".tmp";
+
+    m_fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+
+    if (m_fd != -1)
+    {
+        SnapshotHeader header;
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.key_size = sizeof(CACHE_KEY);
+        header.n_records = 0;
+
+        m_n_written = 0;
+
+        if (!write_all(m_fd, reinterpret_cast<const uint8_t*>(&header), sizeof(header)))
+        {
+            MXS_ERROR("Could not write the cache snapshot '%s': %s",
+                      tmp.c_str(), mxs_strerror(errno));
+            discard_file();
+        }
+    }
+    else
+    {
+        MXS_ERROR("Could not create the cache snapshot '%s': %s",
+                  tmp.c_str(), mxs_strerror(errno));
+    }
+}
+
+/**
+ * Store the number of records in the header of the temporary file and
+ * replace the snapshot with it.
+ */
+void InMemorySnapshot::end_file()
+{
+    ss_dassert(m_fd != -1);
+
+    string tmp = m_path + ".tmp";
+    uint64_t n_records = m_n_written;
+    off_t offset = offsetof(SnapshotHeader, n_records);
+
+    if (pwrite(m_fd, &n_records, sizeof(n_records), offset) == sizeof(n_records))
+    {
+        close(m_fd);
+        m_fd = -1;
+
+        if (rename(tmp.c_str(), m_path.c_str()) != 0)
+        {
+            MXS_ERROR("Could not rename '%s' to '%s': %s",
+                      tmp.c_str(), m_path.c_str(), mxs_strerror(errno));
+            unlink(tmp.c_str());
+        }
+    }
+    else
+    {
+        MXS_ERROR("Could not write the cache snapshot '%s': %s",
+                  tmp.c_str(), mxs_strerror(errno));
+        discard_file();
+    }
+}
+
+/**
+ * Close and remove the temporary file.
+ */
+void InMemorySnapshot::discard_file()
+{
+    ss_dassert(m_fd != -1);
+
+    close(m_fd);
+    m_fd = -1;
+
+    unlink((m_path + ".tmp").c_str());
+}
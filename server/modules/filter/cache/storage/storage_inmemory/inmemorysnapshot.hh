@@ -0,0 +1,218 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <deque>
+#include <string>
+#include <vector>
+#include <maxscale/semaphore.hh>
+#include <maxscale/spinlock.hh>
+#include <maxscale/thread.h>
+#include "../../cache_storage_api.hh"
+
+/**
+ * An InMemorySnapshot maintains a file containing a copy of the content of
+ * an in-memory storage.
+ *
+ * The file is read and written by a thread of its own. When the snapshot is
+ * created, the thread starts by loading the file, after which the storage can
+ * take the loaded records. Thereafter, the storage periodically serializes its
+ * content in batches of about @c BATCH_SIZE bytes, one batch at a time, and
+ * the thread appends each batch to a temporary file as soon as it has been
+ * submitted. When the last batch has been written, the temporary file replaces
+ * the file. So, the storage never copies more than a batch at a time, at most
+ * a few batches are waiting to be written, and the thread of the storage is
+ * never blocked by file I/O.
+ *
+ * The file consists of a header followed by the records. All integers are in
+ * host byte order, so a file can only be read on the kind of machine where it
+ * was written. A record is laid out as follows:
+ *
+ *     CACHE_KEY key
+ *     uint32_t  time          When the value was stored.
+ *     uint32_t  length        The uncompressed length of the value.
+ *     uint32_t  size          The size of the value, as stored.
+ *     uint8_t   compressed    Whether the value is compressed.
+ *     uint8_t   padding
+ *     uint16_t  n_words       The number of invalidation words.
+ *     n_words * (uint16_t length, char word[length])
+ *     uint8_t   value[size]
+ */
+class InMemorySnapshot
+{
+public:
+    typedef std::vector<uint8_t> Data;
+
+    /**
+     * The size up to which a storage should serialize records into a batch.
+     */
+    static const size_t BATCH_SIZE = 1024 * 1024;
+
+    struct Record
+    {
+        Record()
+            : time(0)
+            , length(0)
+            , compressed(false)
+        {}
+
+        CACHE_KEY                key;
+        uint32_t                 time;
+        uint32_t                 length;
+        bool                     compressed;
+        std::vector<uint8_t>     value;
+        std::vector<std::string> invalidation_words;
+    };
+
+    typedef std::vector<Record> Records;
+
+    /**
+     * Destructor
+     *
+     * Writes the batches that have been submitted, if they have not been
+     * written already, and waits for the thread to exit. If the last batch
+     * of a snapshot has not been submitted, the file is not replaced.
+     */
+    ~InMemorySnapshot();
+
+    /**
+     * Create a snapshot. The loading of an existing file is started
+     * immediately.
+     *
+     * @param path      The path of the snapshot file.
+     * @param interval  How often, in seconds, the content should be written.
+     *                  If 0, the content is written only when the snapshot is
+     *                  deleted.
+     *
+     * @return A new instance or NULL if one could not be created.
+     */
+    static InMemorySnapshot* create(const std::string& path, uint32_t interval);
+
+    /**
+     * Take the records that were loaded from the file. Records are returned
+     * only once, at the first call after the loading has finished.
+     *
+     * @param pRecords  On return, the loaded records.
+     *
+     * @return True, if records were returned.
+     */
+    bool take_records(Records* pRecords);
+
+    /**
+     * Whether the content of the storage should be submitted.
+     *
+     * @param now  The current time.
+     *
+     * @return True, if data should be submitted.
+     */
+    bool is_due(time_t now) const
+    {
+        return (m_interval != 0) && (now >= m_next);
+    }
+
+    /**
+     * Whether a batch can be submitted. If too much data submitted earlier is
+     * still waiting to be written, a batch should not be submitted.
+     *
+     * @return True, if a batch can be submitted.
+     */
+    bool is_ready() const;
+
+    /**
+     * Wait until a batch can be submitted.
+     */
+    void wait_until_ready() const;
+
+    /**
+     * Submit a batch of records to be written to the file.
+     *
+     * @param data       Records added using @c add. On return, contains
+     *                   unspecified data.
+     * @param n_records  The number of records in @c data.
+     * @param first      Whether the batch is the first of a snapshot. The
+     *                   batches of a snapshot whose last batch has not been
+     *                   submitted are discarded.
+     * @param last       Whether the batch is the last of the snapshot.
+     * @param now        The current time.
+     */
+    void submit(Data& data, uint64_t n_records, bool first, bool last, time_t now);
+
+    /**
+     * Add a record to a batch.
+     *
+     * @param pData        The batch.
+     * @param key          The key.
+     * @param time         When the value was stored.
+     * @param length       The uncompressed length of the value.
+     * @param compressed   Whether the value is compressed.
+     * @param value        The value, as stored.
+     * @param words        The invalidation words of the value.
+     */
+    static void add(Data* pData,
+                    const CACHE_KEY& key,
+                    uint32_t time,
+                    uint32_t length,
+                    bool compressed,
+                    const std::vector<uint8_t>& value,
+                    const std::vector<std::string>& words);
+
+private:
+    InMemorySnapshot(const std::string& path, uint32_t interval);
+
+    InMemorySnapshot(const InMemorySnapshot&);
+    InMemorySnapshot& operator = (const InMemorySnapshot&);
+
+    struct Batch
+    {
+        Batch()
+            : n_records(0)
+            , first(false)
+            , last(false)
+        {}
+
+        Data     data;
+        uint64_t n_records;
+        bool     first;
+        bool     last;
+    };
+
+    typedef std::deque<Batch> Batches;
+
+    static void thread_main(void* pArg);
+
+    void run();
+    void load();
+    bool save();
+    bool parse(const uint8_t* pBegin, const uint8_t* pEnd, Records* pRecords) const;
+    void write(const Batch& batch);
+    void begin_file();
+    void end_file();
+    void discard_file();
+
+private:
+    const std::string m_path;      /*< The path of the file. */
+    const uint32_t    m_interval;  /*< How often the content should be written. */
+    time_t            m_next;      /*< When the content should be submitted the next time. */
+    THREAD            m_thread;    /*< The thread reading and writing the file. */
+    bool              m_running;   /*< Whether the thread was started. */
+    int               m_fd;        /*< The temporary file being written, used by the thread. */
+    uint64_t          m_n_written; /*< The number of records in the temporary file. */
+    mxs::Semaphore    m_work;      /*< Posted when there are batches or the thread should exit. */
+    mxs::SpinLock     m_lock;      /*< Protects the members below. */
+    int32_t           m_loaded;    /*< Whether the loading has finished. */
+    Records           m_records;   /*< The loaded records. */
+    Batches           m_batches;   /*< The submitted batches not yet written. */
+    size_t            m_queued;    /*< The size of the submitted batches not yet written. */
+    bool              m_stopping;  /*< Whether the thread should exit. */
+};
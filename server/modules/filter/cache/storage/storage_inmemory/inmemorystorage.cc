@@ -13,9 +13,11 @@
 
 #define MXS_MODULE_NAME "storage_inmemory"
 #include "inmemorystorage.hh"
+#include <zlib.h>
 #include <maxscale/alloc.h>
 #include <maxscale/modutil.h>
 #include <maxscale/query_classifier.h>
+#include <maxscale/utils.h>
 #include "inmemorystoragest.hh"
 #include "inmemorystoragemt.hh"
 
@@ -32,16 +34,51 @@ const size_t INMEMORY_KEY_LENGTH = 2 * SHA512_DIGEST_LENGTH;
 #error storage_inmemory key is too long.
 #endif
 
+const uint32_t DEFAULT_SNAPSHOT_INTERVAL = 60;
+
 }
 
-InMemoryStorage::InMemoryStorage(const string& name, const CACHE_STORAGE_CONFIG& config)
+InMemoryStorage::InMemoryStorage(const string& name,
+                                 const CACHE_STORAGE_CONFIG& config,
+                                 size_t compression_threshold,
+                                 InMemorySnapshot* pSnapshot)
     : m_name(name)
     , m_config(config)
+    , m_compression_threshold(compression_threshold)
+    , m_pSnapshot(pSnapshot)
+    , m_snapshot_loaded(false)
+    , m_snapshot_bucket(0)
+    , m_snapshot_buckets(0)
 {
 }
 
 InMemoryStorage::~InMemoryStorage()
 {
+    if (m_pSnapshot)
+    {
+        InMemorySnapshot::Records records;
+
+        if (m_pSnapshot->take_records(&records))
+        {
+            add_records(records);
+        }
+
+        // If the loading has not finished, the current content is not written,
+        // as it would replace the snapshot with something less complete.
+        if (m_snapshot_loaded)
+        {
+            time_t now = time(NULL);
+
+            do
+            {
+                m_pSnapshot->wait_until_ready();
+                submit_snapshot_batch(now);
+            }
+            while (m_snapshot_buckets != 0);
+        }
+
+        delete m_pSnapshot;
+    }
 }
 
 bool InMemoryStorage::Initialize(uint32_t* pCapabilities)
@@ -69,12 +106,95 @@ InMemoryStorage* InMemoryStorage::Create_instance(const char* zName,
                     "does not enforce such a limit.", (unsigned long)config.max_size);
     }
 
+    size_t compression_threshold = 0;
+    string snapshot_directory;
+    uint32_t snapshot_interval = DEFAULT_SNAPSHOT_INTERVAL;
+
+    for (int i = 0; i < argc; ++i)
+    {
+        size_t len = strlen(argv[i]);
+        char arg[len + 1];
+        strcpy(arg, argv[i]);
+
+        const char* zValue = NULL;
+        char *zEq = strchr(arg, '=');
+
+        if (zEq)
+        {
+            *zEq = 0;
+            zValue = trim(zEq + 1);
+        }
+
+        const char* zKey = trim(arg);
+
+        if (strcmp(zKey, "compression_threshold") == 0)
+        {
+            char* zEnd;
+            long value = zValue ? strtol(zValue, &zEnd, 10) : -1;
+
+            if (zValue && (*zEnd == 0) && (value >= 0))
+            {
+                compression_threshold = value;
+            }
+            else
+            {
+                MXS_WARNING("Invalid value specified for '%s', compression will not be used.", zKey);
+            }
+        }
+        else if (strcmp(zKey, "snapshot_directory") == 0)
+        {
+            if (zValue && *zValue)
+            {
+                snapshot_directory = zValue;
+            }
+            else
+            {
+                MXS_WARNING("No value specified for '%s', no snapshot will be maintained.", zKey);
+            }
+        }
+        else if (strcmp(zKey, "snapshot_interval") == 0)
+        {
+            char* zEnd;
+            long value = zValue ? strtol(zValue, &zEnd, 10) : -1;
+
+            if (zValue && (*zEnd == 0) && (value >= 0))
+            {
+                snapshot_interval = value;
+            }
+            else
+            {
+                MXS_WARNING("Invalid value specified for '%s', using the default %u.",
+                            zKey, DEFAULT_SNAPSHOT_INTERVAL);
+            }
+        }
+        else
+        {
+            MXS_WARNING("Unknown argument '%s'.", zKey);
+        }
+    }
+
+    InMemorySnapshot* pSnapshot = NULL;
+
+    if (!snapshot_directory.empty())
+    {
+        // The name is unique, also when there is a storage per thread.
+        string path = snapshot_directory + "/" + zName + ".snapshot";
+
+        pSnapshot = InMemorySnapshot::create(path, snapshot_interval);
+
+        if (!pSnapshot)
+        {
+            MXS_WARNING("Could not create snapshot '%s', the content will not be persisted.",
+                        path.c_str());
+        }
+    }
+
     auto_ptr<InMemoryStorage> sStorage;
 
     switch (config.thread_model)
     {
     case CACHE_THREAD_MODEL_ST:
-        sStorage = InMemoryStorageST::Create(zName, config, argc, argv);
+        sStorage = InMemoryStorageST::Create(zName, config, compression_threshold, pSnapshot);
         break;
 
     default:
@@ -82,7 +202,7 @@ InMemoryStorage* InMemoryStorage::Create_instance(const char* zName,
         MXS_ERROR("Unknown thread model %d, creating multi-thread aware storage.",
                   (int)config.thread_model);
     case CACHE_THREAD_MODEL_MT:
-        sStorage = InMemoryStorageMT::Create(zName, config, argc, argv);
+        sStorage = InMemoryStorageMT::Create(zName, config, compression_threshold, pSnapshot);
         break;
     }
 
@@ -132,6 +252,11 @@ cache_result_t InMemoryStorage::do_get_value(const CACHE_KEY& key, uint32_t flag
 {
     cache_result_t result = CACHE_RESULT_NOT_FOUND;
 
+    if (m_pSnapshot)
+    {
+        check_snapshot();
+    }
+
     Entries::iterator i = m_entries.find(key);
 
     if (i != m_entries.end())
@@ -148,23 +273,47 @@ cache_result_t InMemoryStorage::do_get_value(const CACHE_KEY& key, uint32_t flag
 
         if (is_hard_stale)
         {
-            m_entries.erase(i);
+            remove_entry(i);
         }
         else if (!is_soft_stale || include_stale)
         {
-            size_t length = entry.value.size();
+            size_t length = entry.length;
 
             *ppResult = gwbuf_alloc(length);
 
             if (*ppResult)
             {
-                memcpy(GWBUF_DATA(*ppResult), entry.value.data(), length);
+                bool ok = true;
 
-                result = CACHE_RESULT_OK;
+                if (entry.compressed)
+                {
+                    // Decompressed directly into the buffer that will be returned.
+                    uLongf decompressed_length = length;
+
+                    ok = (uncompress(GWBUF_DATA(*ppResult), &decompressed_length,
+                                     entry.value.data(), entry.value.size()) == Z_OK) &&
+                         (decompressed_length == length);
+                }
+                else
+                {
+                    memcpy(GWBUF_DATA(*ppResult), entry.value.data(), length);
+                }
 
-                if (is_soft_stale)
+                if (ok)
                 {
-                    result |= CACHE_RESULT_STALE;
+                    result = CACHE_RESULT_OK;
+
+                    if (is_soft_stale)
+                    {
+                        result |= CACHE_RESULT_STALE;
+                    }
+                }
+                else
+                {
+                    MXS_ERROR("Could not decompress cached value.");
+                    gwbuf_free(*ppResult);
+                    *ppResult = NULL;
+                    result = CACHE_RESULT_ERROR;
                 }
             }
             else
@@ -186,11 +335,16 @@ cache_result_t InMemoryStorage::do_get_value(const CACHE_KEY& key, uint32_t flag
     return result;
 }
 
-cache_result_t InMemoryStorage::do_put_value(const CACHE_KEY& key, const GWBUF& value)
+cache_result_t InMemoryStorage::do_put_value(const CACHE_KEY& key,
+                                             const std::vector<std::string>& invalidation_words,
+                                             const GWBUF& value)
 {
     ss_dassert(GWBUF_IS_CONTIGUOUS(&value));
 
-    size_t size = GWBUF_LENGTH(&value);
+    if (m_pSnapshot)
+    {
+        check_snapshot();
+    }
 
     Entries::iterator i = m_entries.find(key);
     Entry* pEntry;
@@ -200,7 +354,6 @@ cache_result_t InMemoryStorage::do_put_value(const CACHE_KEY& key, const GWBUF&
         m_stats.items += 1;
 
         pEntry = &m_entries[key];
-        pEntry->value.resize(size);
     }
     else
     {
@@ -208,28 +361,32 @@ cache_result_t InMemoryStorage::do_put_value(const CACHE_KEY& key, const GWBUF&
 
         pEntry = &i->second;
 
-        m_stats.size -= pEntry->value.size();
+        m_stats.size -= pEntry->length;
+        m_stats.stored_size -= pEntry->value.size();
 
-        if (size < pEntry->value.capacity())
-        {
-            // If the needed value is less than what is currently stored,
-            // we shrink the buffer so as not to waste space.
-            Value entry_value(size);
-            pEntry->value.swap(entry_value);
-        }
-        else
+        if (pEntry->compressed)
         {
-            pEntry->value.resize(size);
+            m_stats.compressed_items -= 1;
         }
+
+        remove_from_index(key, *pEntry);
     }
 
-    m_stats.size += size;
+    set_value(pEntry, GWBUF_DATA(&value), GWBUF_LENGTH(&value));
+
+    m_stats.size += pEntry->length;
+    m_stats.stored_size += pEntry->value.size();
 
-    const uint8_t* pData = GWBUF_DATA(&value);
+    if (pEntry->compressed)
+    {
+        m_stats.compressed_items += 1;
+    }
 
-    copy(pData, pData + size, pEntry->value.begin());
     pEntry->time = time(NULL);
 
+    pEntry->invalidation_words = invalidation_words;
+    add_to_index(key, *pEntry);
+
     return CACHE_RESULT_OK;
 }
 
@@ -239,19 +396,302 @@ cache_result_t InMemoryStorage::do_del_value(const CACHE_KEY& key)
 
     if (i != m_entries.end())
     {
-        ss_dassert(m_stats.size >= i->second.value.size());
-        ss_dassert(m_stats.items > 0);
-
-        m_stats.size -= i->second.value.size();
-        m_stats.items -= 1;
         m_stats.deletes += 1;
 
-        m_entries.erase(i);
+        remove_entry(i);
     }
 
     return i != m_entries.end() ? CACHE_RESULT_OK : CACHE_RESULT_NOT_FOUND;
 }
 
+cache_result_t InMemoryStorage::do_invalidate(const std::vector<std::string>& words)
+{
+    for (std::vector<std::string>::const_iterator i = words.begin(); i != words.end(); ++i)
+    {
+        KeysByWord::iterator j = m_keys_by_word.find(*i);
+
+        if (j != m_keys_by_word.end())
+        {
+            // Removing an entry removes it from the index, so the keys are copied.
+            std::vector<CACHE_KEY> keys(j->second.begin(), j->second.end());
+
+            for (std::vector<CACHE_KEY>::iterator k = keys.begin(); k != keys.end(); ++k)
+            {
+                Entries::iterator l = m_entries.find(*k);
+                ss_dassert(l != m_entries.end());
+
+                m_stats.invalidations += 1;
+
+                remove_entry(l);
+            }
+        }
+    }
+
+    return CACHE_RESULT_OK;
+}
+
+cache_result_t InMemoryStorage::do_get_restored(CACHE_KEY* pKey,
+                                                uint64_t* pSize,
+                                                std::vector<std::string>* pWords)
+{
+    cache_result_t result = CACHE_RESULT_OUT_OF_RESOURCES;
+
+    if (m_pSnapshot)
+    {
+        check_snapshot();
+
+        result = m_snapshot_loaded ? CACHE_RESULT_OUT_OF_RESOURCES : CACHE_RESULT_NOT_FOUND;
+
+        while (!m_restored.empty() && (result != CACHE_RESULT_OK))
+        {
+            CACHE_KEY key = m_restored.back();
+            m_restored.pop_back();
+
+            // The value may have been deleted since it was restored.
+            Entries::iterator i = m_entries.find(key);
+
+            if (i != m_entries.end())
+            {
+                const Entry& entry = i->second;
+
+                *pKey = key;
+                *pSize = entry.length;
+                *pWords = entry.invalidation_words;
+
+                result = CACHE_RESULT_OK;
+            }
+        }
+
+        if (m_restored.empty())
+        {
+            // Releases the memory.
+            std::vector<CACHE_KEY>().swap(m_restored);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Set the value of an entry. If the value is at least as large as the
+ * compression threshold and it can be compressed, it is stored compressed.
+ *
+ * @param pEntry  The entry.
+ * @param pData   The value.
+ * @param size    The size of the value.
+ */
+void InMemoryStorage::set_value(Entry* pEntry, const uint8_t* pData, size_t size)
+{
+    bool compressed = false;
+
+    if ((m_compression_threshold != 0) && (size >= m_compression_threshold))
+    {
+        uLongf length = compressBound(size);
+        Value buffer(length);
+
+        if ((compress2(&buffer[0], &length, pData, size, Z_BEST_SPEED) == Z_OK) &&
+            (length < size))
+        {
+            // Copied, so that the entry does not hold on to the excess capacity.
+            Value value(buffer.begin(), buffer.begin() + length);
+            pEntry->value.swap(value);
+            compressed = true;
+        }
+    }
+
+    if (!compressed)
+    {
+        Value value(pData, pData + size);
+        pEntry->value.swap(value);
+    }
+
+    pEntry->length = size;
+    pEntry->compressed = compressed;
+}
+
+void InMemoryStorage::remove_entry(Entries::iterator i)
+{
+    Entry& entry = i->second;
+
+    ss_dassert(m_stats.size >= entry.length);
+    ss_dassert(m_stats.stored_size >= entry.value.size());
+    ss_dassert(m_stats.items > 0);
+
+    m_stats.size -= entry.length;
+    m_stats.stored_size -= entry.value.size();
+    m_stats.items -= 1;
+
+    if (entry.compressed)
+    {
+        ss_dassert(m_stats.compressed_items > 0);
+        m_stats.compressed_items -= 1;
+    }
+
+    remove_from_index(i->first, entry);
+    m_entries.erase(i);
+}
+
+/**
+ * Add the records of the snapshot, once they have been loaded, and submit
+ * the next batch of the current content, if it is time to do so.
+ */
+void InMemoryStorage::check_snapshot()
+{
+    ss_dassert(m_pSnapshot);
+
+    if (!m_snapshot_loaded)
+    {
+        InMemorySnapshot::Records records;
+
+        if (m_pSnapshot->take_records(&records))
+        {
+            add_records(records);
+        }
+    }
+
+    time_t now = time(NULL);
+
+    // Until the records have been added, the content would be incomplete.
+    if (m_snapshot_loaded &&
+        ((m_snapshot_buckets != 0) || m_pSnapshot->is_due(now)) &&
+        m_pSnapshot->is_ready())
+    {
+        submit_snapshot_batch(now);
+    }
+}
+
+/**
+ * Add records loaded from the snapshot. Records that have already become
+ * stale or whose key has been stored since the startup are ignored. The keys
+ * of the added records are remembered, so that a storage decorating this one
+ * can obtain them using get_restored.
+ *
+ * @param records  The records. On return, the values and words of the
+ *                 added records have been moved to the entries.
+ */
+void InMemoryStorage::add_records(InMemorySnapshot::Records& records)
+{
+    uint32_t now = time(NULL);
+    size_t n_added = 0;
+
+    for (InMemorySnapshot::Records::iterator i = records.begin(); i != records.end(); ++i)
+    {
+        InMemorySnapshot::Record& record = *i;
+
+        bool is_hard_stale = m_config.hard_ttl == 0 ? false : (now - record.time > m_config.hard_ttl);
+
+        if (!is_hard_stale && (m_entries.find(record.key) == m_entries.end()))
+        {
+            Entry& entry = m_entries[record.key];
+
+            entry.time = record.time;
+            entry.length = record.length;
+            entry.compressed = record.compressed;
+            entry.value.swap(record.value);
+            entry.invalidation_words.swap(record.invalidation_words);
+
+            m_stats.items += 1;
+            m_stats.size += entry.length;
+            m_stats.stored_size += entry.value.size();
+
+            if (entry.compressed)
+            {
+                m_stats.compressed_items += 1;
+            }
+
+            add_to_index(record.key, entry);
+            m_restored.push_back(record.key);
+            ++n_added;
+        }
+    }
+
+    if (!records.empty())
+    {
+        MXS_NOTICE("Added %lu of %lu values in the snapshot to '%s'.",
+                   n_added, records.size(), m_name.c_str());
+    }
+
+    m_snapshot_loaded = true;
+}
+
+/**
+ * Serialize the next batch of the content and submit it to the snapshot for
+ * writing. The entries are serialized bucket by bucket, until the batch is
+ * full, so that the storage is never held up by copying all of a large cache
+ * at once. If the entries have been rehashed since the previous batch, the
+ * buckets no longer correspond and the submitting is started anew.
+ *
+ * @param now  The current time.
+ */
+void InMemoryStorage::submit_snapshot_batch(time_t now)
+{
+    bool first = (m_snapshot_buckets == 0) || (m_snapshot_buckets != m_entries.bucket_count());
+
+    if (first)
+    {
+        m_snapshot_bucket = 0;
+        m_snapshot_buckets = m_entries.bucket_count();
+    }
+
+    InMemorySnapshot::Data data;
+    uint64_t n_records = 0;
+
+    while ((m_snapshot_bucket < m_snapshot_buckets) && (data.size() < InMemorySnapshot::BATCH_SIZE))
+    {
+        Entries::const_local_iterator end = m_entries.end(m_snapshot_bucket);
+
+        for (Entries::const_local_iterator i = m_entries.begin(m_snapshot_bucket); i != end; ++i)
+        {
+            const Entry& entry = i->second;
+
+            InMemorySnapshot::add(&data, i->first, entry.time, entry.length, entry.compressed,
+                                  entry.value, entry.invalidation_words);
+            ++n_records;
+        }
+
+        ++m_snapshot_bucket;
+    }
+
+    bool last = (m_snapshot_bucket == m_snapshot_buckets);
+
+    m_pSnapshot->submit(data, n_records, first, last, now);
+
+    if (last)
+    {
+        m_snapshot_buckets = 0;
+    }
+}
+
+void InMemoryStorage::add_to_index(const CACHE_KEY& key, const Entry& entry)
+{
+    const std::vector<std::string>& words = entry.invalidation_words;
+
+    for (std::vector<std::string>::const_iterator i = words.begin(); i != words.end(); ++i)
+    {
+        m_keys_by_word[*i].insert(key);
+    }
+}
+
+void InMemoryStorage::remove_from_index(const CACHE_KEY& key, const Entry& entry)
+{
+    const std::vector<std::string>& words = entry.invalidation_words;
+
+    for (std::vector<std::string>::const_iterator i = words.begin(); i != words.end(); ++i)
+    {
+        KeysByWord::iterator j = m_keys_by_word.find(*i);
+
+        if (j != m_keys_by_word.end())
+        {
+            j->second.erase(key);
+
+            if (j->second.empty())
+            {
+                m_keys_by_word.erase(j);
+            }
+        }
+    }
+}
+
 static void set_integer(json_t* pObject, const char* zName, size_t value)
 {
     json_t* pValue = json_integer(value);
@@ -271,4 +711,16 @@ void InMemoryStorage::Stats::fill(json_t* pObject) const
     set_integer(pObject, "misses", misses);
     set_integer(pObject, "updates", updates);
     set_integer(pObject, "deletes", deletes);
+    set_integer(pObject, "invalidations", invalidations);
+    set_integer(pObject, "stored_size", stored_size);
+    set_integer(pObject, "compressed_items", compressed_items);
+
+    // How many times more data fits into the same memory, thanks to compression.
+    json_t* pRatio = json_real(stored_size != 0 ? static_cast<double>(size) / stored_size : 1.0);
+
+    if (pRatio)
+    {
+        json_object_set(pObject, "compression_ratio", pRatio);
+        json_decref(pRatio);
+    }
 }
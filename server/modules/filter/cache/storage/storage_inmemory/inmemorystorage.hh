@@ -17,7 +17,9 @@
 #include <string>
 #include <vector>
 #include <tr1/unordered_map>
+#include <tr1/unordered_set>
 #include "../../cache_storage_api.hh"
+#include "inmemorysnapshot.hh"
 
 class InMemoryStorage
 {
@@ -33,8 +35,14 @@ public:
     void get_config(CACHE_STORAGE_CONFIG* pConfig);
     virtual cache_result_t get_info(uint32_t what, json_t** ppInfo) const = 0;
     virtual cache_result_t get_value(const CACHE_KEY& key, uint32_t flags, GWBUF** ppResult) = 0;
-    virtual cache_result_t put_value(const CACHE_KEY& key, const GWBUF& value) = 0;
+    virtual cache_result_t put_value(const CACHE_KEY& key,
+                                     const std::vector<std::string>& invalidation_words,
+                                     const GWBUF& value) = 0;
     virtual cache_result_t del_value(const CACHE_KEY& key) = 0;
+    virtual cache_result_t invalidate(const std::vector<std::string>& words) = 0;
+    virtual cache_result_t get_restored(CACHE_KEY* pKey,
+                                        uint64_t* pSize,
+                                        std::vector<std::string>* pWords) = 0;
 
     cache_result_t get_head(CACHE_KEY* pKey, GWBUF** ppHead) const;
     cache_result_t get_tail(CACHE_KEY* pKey, GWBUF** ppHead) const;
@@ -43,12 +51,20 @@ public:
 
 protected:
     InMemoryStorage(const std::string& name,
-                    const CACHE_STORAGE_CONFIG& config);
+                    const CACHE_STORAGE_CONFIG& config,
+                    size_t compression_threshold,
+                    InMemorySnapshot* pSnapshot);
 
     cache_result_t do_get_info(uint32_t what, json_t** ppInfo) const;
     cache_result_t do_get_value(const CACHE_KEY& key, uint32_t flags, GWBUF** ppResult);
-    cache_result_t do_put_value(const CACHE_KEY& key, const GWBUF& value);
+    cache_result_t do_put_value(const CACHE_KEY& key,
+                                const std::vector<std::string>& invalidation_words,
+                                const GWBUF& value);
     cache_result_t do_del_value(const CACHE_KEY& key);
+    cache_result_t do_invalidate(const std::vector<std::string>& words);
+    cache_result_t do_get_restored(CACHE_KEY* pKey,
+                                   uint64_t* pSize,
+                                   std::vector<std::string>* pWords);
 
 private:
     InMemoryStorage(const InMemoryStorage&);
@@ -61,10 +77,15 @@ private:
     {
         Entry()
             : time(0)
+            , length(0)
+            , compressed(false)
         {}
 
-        uint32_t time;
-        Value    value;
+        uint32_t                 time;
+        Value                    value;
+        uint32_t                 length;     /*< The uncompressed length of the value. */
+        bool                     compressed; /*< Whether the value is compressed. */
+        std::vector<std::string> invalidation_words;
     };
 
     struct Stats
@@ -76,22 +97,45 @@ private:
             , misses(0)
             , updates(0)
             , deletes(0)
+            , invalidations(0)
+            , stored_size(0)
+            , compressed_items(0)
         {}
 
         void fill(json_t* pObject) const;
 
-        uint64_t size;       /*< The total size of the stored values. */
-        uint64_t items;      /*< The number of stored items. */
-        uint64_t hits;       /*< How many times a key was found in the cache. */
-        uint64_t misses;     /*< How many times a key was not found in the cache. */
-        uint64_t updates;    /*< How many times an existing key in the cache was updated. */
-        uint64_t deletes;    /*< How many times an existing key in the cache was deleted. */
+        uint64_t size;             /*< The total size of the stored values. */
+        uint64_t items;            /*< The number of stored items. */
+        uint64_t hits;             /*< How many times a key was found in the cache. */
+        uint64_t misses;           /*< How many times a key was not found in the cache. */
+        uint64_t updates;          /*< How many times an existing key in the cache was updated. */
+        uint64_t deletes;          /*< How many times an existing key in the cache was deleted. */
+        uint64_t invalidations;    /*< How many times an existing key in the cache was invalidated. */
+        uint64_t stored_size;      /*< The total size of the values, as stored. */
+        uint64_t compressed_items; /*< The number of items stored compressed. */
     };
 
     typedef std::tr1::unordered_map<CACHE_KEY, Entry> Entries;
+    typedef std::tr1::unordered_set<CACHE_KEY> Keys;
+    typedef std::tr1::unordered_map<std::string, Keys> KeysByWord;
+
+    void add_to_index(const CACHE_KEY& key, const Entry& entry);
+    void remove_from_index(const CACHE_KEY& key, const Entry& entry);
+    void set_value(Entry* pEntry, const uint8_t* pData, size_t size);
+    void remove_entry(Entries::iterator i);
+    void check_snapshot();
+    void add_records(InMemorySnapshot::Records& records);
+    void submit_snapshot_batch(time_t now);
 
     std::string                m_name;
     const CACHE_STORAGE_CONFIG m_config;
+    const size_t               m_compression_threshold;
+    InMemorySnapshot*          m_pSnapshot;        /*< The snapshot, if one is maintained. */
+    bool                       m_snapshot_loaded;  /*< Whether the records of the snapshot have been added. */
+    size_t                     m_snapshot_bucket;  /*< The next bucket of the entries to be submitted. */
+    size_t                     m_snapshot_buckets; /*< The buckets being submitted, 0 if none are. */
+    std::vector<CACHE_KEY>     m_restored;         /*< Keys of added records not yet returned by get_restored. */
     Entries                    m_entries;
+    KeysByWord                 m_keys_by_word;
     Stats                      m_stats;
 };
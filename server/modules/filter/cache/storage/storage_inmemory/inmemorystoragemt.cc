@@ -18,8 +18,10 @@ using maxscale::SpinLockGuard;
 using std::auto_ptr;
 
 InMemoryStorageMT::InMemoryStorageMT(const std::string& name,
-                                     const CACHE_STORAGE_CONFIG& config)
-    : InMemoryStorage(name, config)
+                                     const CACHE_STORAGE_CONFIG& config,
+                                     size_t compression_threshold,
+                                     InMemorySnapshot* pSnapshot)
+    : InMemoryStorage(name, config, compression_threshold, pSnapshot)
 {
     spinlock_init(&m_lock);
 }
@@ -30,9 +32,10 @@ InMemoryStorageMT::~InMemoryStorageMT()
 
 auto_ptr<InMemoryStorageMT> InMemoryStorageMT::Create(const std::string& name,
                                                       const CACHE_STORAGE_CONFIG& config,
-                                                      int argc, char* argv[])
+                                                      size_t compression_threshold,
+                                                      InMemorySnapshot* pSnapshot)
 {
-    return auto_ptr<InMemoryStorageMT>(new InMemoryStorageMT(name, config));
+    return auto_ptr<InMemoryStorageMT>(new InMemoryStorageMT(name, config, compression_threshold, pSnapshot));
 }
 
 cache_result_t InMemoryStorageMT::get_info(uint32_t what, json_t** ppInfo) const
@@ -49,11 +52,13 @@ cache_result_t InMemoryStorageMT::get_value(const CACHE_KEY& key, uint32_t flags
     return do_get_value(key, flags, ppResult);
 }
 
-cache_result_t InMemoryStorageMT::put_value(const CACHE_KEY& key, const GWBUF& value)
+cache_result_t InMemoryStorageMT::put_value(const CACHE_KEY& key,
+                                            const std::vector<std::string>& invalidation_words,
+                                            const GWBUF& value)
 {
     SpinLockGuard guard(m_lock);
 
-    return do_put_value(key, value);
+    return do_put_value(key, invalidation_words, value);
 }
 
 cache_result_t InMemoryStorageMT::del_value(const CACHE_KEY& key)
@@ -62,3 +67,19 @@ cache_result_t InMemoryStorageMT::del_value(const CACHE_KEY& key)
 
     return do_del_value(key);
 }
+
+cache_result_t InMemoryStorageMT::invalidate(const std::vector<std::string>& words)
+{
+    SpinLockGuard guard(m_lock);
+
+    return do_invalidate(words);
+}
+
+cache_result_t InMemoryStorageMT::get_restored(CACHE_KEY* pKey,
+                                               uint64_t* pSize,
+                                               std::vector<std::string>* pWords)
+{
+    SpinLockGuard guard(m_lock);
+
+    return do_get_restored(pKey, pSize, pWords);
+}
@@ -17,8 +17,10 @@
 using std::auto_ptr;
 
 InMemoryStorageST::InMemoryStorageST(const std::string& name,
-                                     const CACHE_STORAGE_CONFIG& config)
-    : InMemoryStorage(name, config)
+                                     const CACHE_STORAGE_CONFIG& config,
+                                     size_t compression_threshold,
+                                     InMemorySnapshot* pSnapshot)
+    : InMemoryStorage(name, config, compression_threshold, pSnapshot)
 {
 }
 
@@ -28,9 +30,10 @@ InMemoryStorageST::~InMemoryStorageST()
 
 auto_ptr<InMemoryStorageST> InMemoryStorageST::Create(const std::string& name,
                                                       const CACHE_STORAGE_CONFIG& config,
-                                                      int argc, char* argv[])
+                                                      size_t compression_threshold,
+                                                      InMemorySnapshot* pSnapshot)
 {
-    return auto_ptr<InMemoryStorageST>(new InMemoryStorageST(name, config));
+    return auto_ptr<InMemoryStorageST>(new InMemoryStorageST(name, config, compression_threshold, pSnapshot));
 }
 
 cache_result_t InMemoryStorageST::get_info(uint32_t what, json_t** ppInfo) const
@@ -43,12 +46,26 @@ cache_result_t InMemoryStorageST::get_value(const CACHE_KEY& key, uint32_t flags
     return do_get_value(key, flags, ppResult);
 }
 
-cache_result_t InMemoryStorageST::put_value(const CACHE_KEY& key, const GWBUF& value)
+cache_result_t InMemoryStorageST::put_value(const CACHE_KEY& key,
+                                            const std::vector<std::string>& invalidation_words,
+                                            const GWBUF& value)
 {
-    return do_put_value(key, value);
+    return do_put_value(key, invalidation_words, value);
 }
 
 cache_result_t InMemoryStorageST::del_value(const CACHE_KEY& key)
 {
     return do_del_value(key);
 }
+
+cache_result_t InMemoryStorageST::invalidate(const std::vector<std::string>& words)
+{
+    return do_invalidate(words);
+}
+
+cache_result_t InMemoryStorageST::get_restored(CACHE_KEY* pKey,
+                                               uint64_t* pSize,
+                                               std::vector<std::string>* pWords)
+{
+    return do_get_restored(pKey, pSize, pWords);
+}
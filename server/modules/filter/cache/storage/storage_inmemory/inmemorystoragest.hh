@@ -24,15 +24,23 @@ public:
 
     static SInMemoryStorageST Create(const std::string& name,
                                      const CACHE_STORAGE_CONFIG& config,
-                                     int argc, char* argv[]);
+                                     size_t compression_threshold,
+                                     InMemorySnapshot* pSnapshot);
 
     cache_result_t get_info(uint32_t what, json_t** ppInfo) const;
     cache_result_t get_value(const CACHE_KEY& key, uint32_t flags, GWBUF** ppResult);
-    cache_result_t put_value(const CACHE_KEY& key, const GWBUF& pValue);
+    cache_result_t put_value(const CACHE_KEY& key,
+                             const std::vector<std::string>& invalidation_words,
+                             const GWBUF& value);
     cache_result_t del_value(const CACHE_KEY& key);
+    cache_result_t invalidate(const std::vector<std::string>& words);
+    cache_result_t get_restored(CACHE_KEY* pKey, uint64_t* pSize, std::vector<std::string>* pWords);
 
 private:
-    InMemoryStorageST(const std::string& name, const CACHE_STORAGE_CONFIG& config);
+    InMemoryStorageST(const std::string& name,
+                      const CACHE_STORAGE_CONFIG& config,
+                      size_t compression_threshold,
+                      InMemorySnapshot* pSnapshot);
 
 private:
     InMemoryStorageST(const InMemoryStorageST&);
@@ -369,6 +369,8 @@ cache_result_t RocksDBStorage::get_value(const CACHE_KEY& key, uint32_t flags, G
 
             if (is_hard_stale)
             {
+                update_index(key, Words());
+
                 status = m_sDb->Delete(Write_options(), rocksdb_key);
 
                 if (!status.ok())
@@ -423,7 +425,9 @@ cache_result_t RocksDBStorage::get_value(const CACHE_KEY& key, uint32_t flags, G
     return result;
 }
 
-cache_result_t RocksDBStorage::put_value(const CACHE_KEY& key, const GWBUF& value)
+cache_result_t RocksDBStorage::put_value(const CACHE_KEY& key,
+                                         const std::vector<std::string>& invalidation_words,
+                                         const GWBUF& value)
 {
     ss_dassert(GWBUF_IS_CONTIGUOUS(&value));
 
@@ -432,6 +436,11 @@ cache_result_t RocksDBStorage::put_value(const CACHE_KEY& key, const GWBUF& valu
 
     rocksdb::Status status = m_sDb->Put(Write_options(), rocksdb_key, rocksdb_value);
 
+    if (status.ok())
+    {
+        update_index(key, invalidation_words);
+    }
+
     return status.ok() ? CACHE_RESULT_OK : CACHE_RESULT_ERROR;
 }
 
@@ -439,11 +448,90 @@ cache_result_t RocksDBStorage::del_value(const CACHE_KEY& key)
 {
     rocksdb::Slice rocksdb_key(reinterpret_cast<const char*>(&key.data), sizeof(key.data));
 
+    update_index(key, Words());
+
     rocksdb::Status status = m_sDb->Delete(Write_options(), rocksdb_key);
 
     return status.ok() ? CACHE_RESULT_OK : CACHE_RESULT_ERROR;
 }
 
+cache_result_t RocksDBStorage::invalidate(const std::vector<std::string>& words)
+{
+    std::vector<CACHE_KEY> keys;
+
+    {
+        std::lock_guard<std::mutex> guard(m_index_lock);
+
+        for (const auto& word : words)
+        {
+            auto i = m_keys_by_word.find(word);
+
+            if (i != m_keys_by_word.end())
+            {
+                keys.insert(keys.end(), i->second.begin(), i->second.end());
+            }
+        }
+    }
+
+    cache_result_t result = CACHE_RESULT_OK;
+
+    // The same key may appear several times, but deleting a missing key is not an error.
+    for (const auto& key : keys)
+    {
+        if (!CACHE_RESULT_IS_OK(del_value(key)))
+        {
+            MXS_ERROR("Failed to delete invalidated item from RocksDB.");
+            result = CACHE_RESULT_ERROR;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Replace the invalidation words of a key. If there are no words, the key is
+ * removed from the index.
+ *
+ * @param key    A key.
+ * @param words  The words via which the value of the key can be invalidated.
+ */
+void RocksDBStorage::update_index(const CACHE_KEY& key, const Words& words)
+{
+    std::lock_guard<std::mutex> guard(m_index_lock);
+
+    auto i = m_words_by_key.find(key);
+
+    if (i != m_words_by_key.end())
+    {
+        for (const auto& word : i->second)
+        {
+            auto j = m_keys_by_word.find(word);
+
+            if (j != m_keys_by_word.end())
+            {
+                j->second.erase(key);
+
+                if (j->second.empty())
+                {
+                    m_keys_by_word.erase(j);
+                }
+            }
+        }
+
+        m_words_by_key.erase(i);
+    }
+
+    if (!words.empty())
+    {
+        m_words_by_key[key] = words;
+
+        for (const auto& word : words)
+        {
+            m_keys_by_word[word].insert(key);
+        }
+    }
+}
+
 cache_result_t RocksDBStorage::get_head(CACHE_KEY* pKey, GWBUF** ppHead) const
 {
     return CACHE_RESULT_OUT_OF_RESOURCES;
@@ -463,3 +551,10 @@ cache_result_t RocksDBStorage::get_items(uint64_t* pItems) const
 {
     return CACHE_RESULT_OUT_OF_RESOURCES;
 }
+
+cache_result_t RocksDBStorage::get_restored(CACHE_KEY* pKey,
+                                            uint64_t* pSize,
+                                            std::vector<std::string>* pWords)
+{
+    return CACHE_RESULT_OUT_OF_RESOURCES;
+}
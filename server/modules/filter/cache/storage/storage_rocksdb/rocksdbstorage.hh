@@ -14,9 +14,13 @@
 
 #include <maxscale/cppdefs.hh>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
+#include <tr1/unordered_map>
+#include <tr1/unordered_set>
 #include <rocksdb/utilities/db_ttl.h>
-#include "../../cache_storage_api.h"
+#include "../../cache_storage_api.hh"
 
 class RocksDBStorage
 {
@@ -33,13 +37,17 @@ public:
     void get_config(CACHE_STORAGE_CONFIG* pConfig);
     cache_result_t get_info(uint32_t flags, json_t** ppInfo) const;
     cache_result_t get_value(const CACHE_KEY& key, uint32_t flags, GWBUF** ppResult);
-    cache_result_t put_value(const CACHE_KEY& key, const GWBUF& value);
+    cache_result_t put_value(const CACHE_KEY& key,
+                             const std::vector<std::string>& invalidation_words,
+                             const GWBUF& value);
     cache_result_t del_value(const CACHE_KEY& key);
+    cache_result_t invalidate(const std::vector<std::string>& words);
 
     cache_result_t get_head(CACHE_KEY* pKey, GWBUF** ppHead) const;
     cache_result_t get_tail(CACHE_KEY* pKey, GWBUF** ppHead) const;
     cache_result_t get_size(uint64_t* pSize) const;
     cache_result_t get_items(uint64_t* pItems) const;
+    cache_result_t get_restored(CACHE_KEY* pKey, uint64_t* pSize, std::vector<std::string>* pWords);
 
 private:
     RocksDBStorage(const std::string& name,
@@ -60,11 +68,21 @@ private:
         return s_write_options;
     }
 
+    typedef std::vector<std::string> Words;
+    typedef std::tr1::unordered_set<CACHE_KEY> Keys;
+    typedef std::tr1::unordered_map<std::string, Keys> KeysByWord;
+    typedef std::tr1::unordered_map<CACHE_KEY, Words> WordsByKey;
+
+    void update_index(const CACHE_KEY& key, const Words& words);
+
 private:
     std::string                         m_name;
     const CACHE_STORAGE_CONFIG          m_config;
     std::string                         m_path;
     std::unique_ptr<rocksdb::DBWithTTL> m_sDb;
+    std::mutex                          m_index_lock;   /*< Protects the invalidation index. */
+    KeysByWord                          m_keys_by_word; /*< Keys by invalidation word. */
+    WordsByKey                          m_words_by_key; /*< Invalidation words by key. */
 
     static rocksdb::WriteOptions        s_write_options;
 };
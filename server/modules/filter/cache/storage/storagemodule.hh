@@ -13,6 +13,9 @@
  */
 
 #include <maxscale/cppdefs.hh>
+#include <string>
+#include <vector>
+#include <maxscale/alloc.h>
 
 template<class StorageType>
 class StorageModule
@@ -88,6 +91,7 @@ public:
 
     static cache_result_t putValue(CACHE_STORAGE* pCache_storage,
                                    const CACHE_KEY* pKey,
+                                   const char* const* pzInvalidation_words,
                                    const GWBUF* pValue)
     {
         ss_dassert(pCache_storage);
@@ -98,7 +102,7 @@ public:
 
         StorageType* pStorage = reinterpret_cast<StorageType*>(pCache_storage);
 
-        MXS_EXCEPTION_GUARD(result = pStorage->put_value(*pKey, *pValue));
+        MXS_EXCEPTION_GUARD(result = pStorage->put_value(*pKey, words(pzInvalidation_words), *pValue));
 
         return result;
     }
@@ -117,6 +121,19 @@ public:
         return result;
     }
 
+    static cache_result_t invalidate(CACHE_STORAGE* pCache_storage, const char* const* pzWords)
+    {
+        ss_dassert(pCache_storage);
+
+        cache_result_t result = CACHE_RESULT_ERROR;
+
+        StorageType* pStorage = reinterpret_cast<StorageType*>(pCache_storage);
+
+        MXS_EXCEPTION_GUARD(result = pStorage->invalidate(words(pzWords)));
+
+        return result;
+    }
+
     static cache_result_t getHead(CACHE_STORAGE* pCache_storage,
                                   CACHE_KEY* pKey,
                                   GWBUF** ppHead)
@@ -173,7 +190,73 @@ public:
         return result;
     }
 
+    static cache_result_t getRestored(CACHE_STORAGE* pCache_storage,
+                                      CACHE_KEY* pKey,
+                                      uint64_t* pSize,
+                                      char*** ppzWords)
+    {
+        ss_dassert(pCache_storage);
+
+        cache_result_t result = CACHE_RESULT_ERROR;
+
+        StorageType* pStorage = reinterpret_cast<StorageType*>(pCache_storage);
+
+        std::vector<std::string> words;
+
+        MXS_EXCEPTION_GUARD(result = pStorage->get_restored(pKey, pSize, &words));
+
+        if (result == CACHE_RESULT_OK)
+        {
+            *ppzWords = NULL;
+
+            if (!words.empty() && !(*ppzWords = zwords(words)))
+            {
+                result = CACHE_RESULT_OUT_OF_RESOURCES;
+            }
+        }
+
+        return result;
+    }
+
     static CACHE_STORAGE_API s_api;
+
+private:
+    static std::vector<std::string> words(const char* const* pzWords)
+    {
+        std::vector<std::string> rv;
+
+        if (pzWords)
+        {
+            while (*pzWords)
+            {
+                rv.push_back(*pzWords);
+                ++pzWords;
+            }
+        }
+
+        return rv;
+    }
+
+    static char** zwords(const std::vector<std::string>& words)
+    {
+        char** pzWords = static_cast<char**>(MXS_CALLOC(words.size() + 1, sizeof(char*)));
+
+        for (size_t i = 0; pzWords && (i < words.size()); ++i)
+        {
+            if (!(pzWords[i] = MXS_STRDUP(words[i].c_str())))
+            {
+                while (i > 0)
+                {
+                    MXS_FREE(pzWords[--i]);
+                }
+
+                MXS_FREE(pzWords);
+                pzWords = NULL;
+            }
+        }
+
+        return pzWords;
+    }
 };
 
 template<class StorageType>
@@ -187,8 +270,10 @@ CACHE_STORAGE_API StorageModule<StorageType>::s_api =
     &StorageModule<StorageType>::getValue,
     &StorageModule<StorageType>::putValue,
     &StorageModule<StorageType>::delValue,
+    &StorageModule<StorageType>::invalidate,
     &StorageModule<StorageType>::getHead,
     &StorageModule<StorageType>::getTail,
     &StorageModule<StorageType>::getSize,
-    &StorageModule<StorageType>::getItems
+    &StorageModule<StorageType>::getItems,
+    &StorageModule<StorageType>::getRestored
 };
@@ -16,12 +16,14 @@
 #include <dlfcn.h>
 #include <sys/param.h>
 #include <new>
+#include <sstream>
 #include <maxscale/alloc.h>
 #include <maxscale/paths.h>
 #include <maxscale/log_manager.h>
 #include "cachefilter.h"
 #include "lrustoragest.hh"
 #include "lrustoragemt.hh"
+#include "shardedstorage.hh"
 #include "storagereal.hh"
 
 
@@ -165,6 +167,7 @@ Storage* StorageFactory::createStorage(const char* zName,
         used_config.thread_model = CACHE_THREAD_MODEL_ST;
         used_config.max_count = 0;
         used_config.max_size = 0;
+        used_config.admission = CACHE_ADMISSION_ALL;
     }
 
     Storage* pStorage = createRawStorage(zName, used_config, argc, argv);
@@ -204,6 +207,82 @@ Storage* StorageFactory::createStorage(const char* zName,
     return pStorage;
 }
 
+Storage* StorageFactory::createShardedStorage(const char* zName,
+                                              const CACHE_STORAGE_CONFIG& config,
+                                              size_t n_shards,
+                                              int argc, char* argv[])
+{
+    ss_dassert(m_handle);
+    ss_dassert(m_pApi);
+
+    if ((n_shards <= 1) || (config.thread_model != CACHE_THREAD_MODEL_MT))
+    {
+        return createStorage(zName, config, argc, argv);
+    }
+
+    CacheStorageConfig shard_config(config);
+
+    // Each shard gets an equal share of the limits, but at least something
+    // as 0 means no limit.
+    if (config.max_count != 0)
+    {
+        shard_config.max_count = config.max_count / n_shards;
+
+        if (shard_config.max_count == 0)
+        {
+            shard_config.max_count = 1;
+        }
+    }
+
+    if (config.max_size != 0)
+    {
+        shard_config.max_size = config.max_size / n_shards;
+
+        if (shard_config.max_size == 0)
+        {
+            shard_config.max_size = 1;
+        }
+    }
+
+    ShardedStorage::Shards shards;
+    bool ok = true;
+
+    for (size_t i = 0; ok && (i < n_shards); ++i)
+    {
+        // A storage may use the name for naming persistent resources,
+        // so each shard must have a name of its own.
+        std::stringstream ss;
+        ss << zName << "-" << i;
+
+        Storage* pShard = createStorage(ss.str().c_str(), shard_config, argc, argv);
+
+        if (pShard)
+        {
+            shards.push_back(pShard);
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+
+    Storage* pStorage = NULL;
+
+    if (ok)
+    {
+        pStorage = ShardedStorage::create(config, shards);
+    }
+
+    if (!pStorage)
+    {
+        for (ShardedStorage::Shards::iterator i = shards.begin(); i != shards.end(); ++i)
+        {
+            delete *i;
+        }
+    }
+
+    return pStorage;
+}
 
 Storage* StorageFactory::createRawStorage(const char* zName,
                                           const CACHE_STORAGE_CONFIG& config,
@@ -66,6 +66,28 @@ public:
                            const CACHE_STORAGE_CONFIG& config,
                            int argc = 0, char* argv[] = NULL);
 
+    /**
+     * Create sharded storage instance.
+     *
+     * The keys are partitioned across a number of storages, each created
+     * as if by @c createStorage. The @c max_count and @c max_size limits
+     * are divided evenly between the shards. Only applicable if the
+     * thread model is @c CACHE_THREAD_MODEL_MT; if it is not or if the
+     * number of shards is 1, this is the same as @c createStorage.
+     *
+     * @param zName      The name of the storage.
+     * @param config     The storage configuration.
+     * @param n_shards   The number of shards.
+     * @argc             Number of items in argv.
+     * @argv             Storage specific arguments.
+     *
+     * @return A storage instance or NULL in case of errors.
+     */
+    Storage* createShardedStorage(const char* zName,
+                                  const CACHE_STORAGE_CONFIG& config,
+                                  size_t n_shards,
+                                  int argc = 0, char* argv[] = NULL);
+
     /**
      * Create raw storage instance.
      *
@@ -13,7 +13,30 @@
 
 #define MXS_MODULE_NAME "cache"
 #include "storagereal.hh"
+#include <maxscale/alloc.h>
 
+namespace
+{
+
+/**
+ * Convert words to the NULL terminated array expected by the storage API.
+ *
+ * @param words   The words.
+ * @param pZwords On return, pointers to the words followed by a NULL.
+ */
+void to_c_words(const std::vector<std::string>& words, std::vector<const char*>* pZwords)
+{
+    pZwords->reserve(words.size() + 1);
+
+    for (std::vector<std::string>::const_iterator i = words.begin(); i != words.end(); ++i)
+    {
+        pZwords->push_back(i->c_str());
+    }
+
+    pZwords->push_back(NULL);
+}
+
+}
 
 StorageReal::StorageReal(CACHE_STORAGE_API* pApi, CACHE_STORAGE* pStorage)
     : m_pApi(pApi)
@@ -45,9 +68,14 @@ cache_result_t StorageReal::get_value(const CACHE_KEY& key,
     return m_pApi->getValue(m_pStorage, &key, flags, ppValue);
 }
 
-cache_result_t StorageReal::put_value(const CACHE_KEY& key, const GWBUF* pValue)
+cache_result_t StorageReal::put_value(const CACHE_KEY& key,
+                                      const std::vector<std::string>& invalidation_words,
+                                      const GWBUF* pValue)
 {
-    return m_pApi->putValue(m_pStorage, &key, pValue);
+    std::vector<const char*> zInvalidation_words;
+    to_c_words(invalidation_words, &zInvalidation_words);
+
+    return m_pApi->putValue(m_pStorage, &key, &zInvalidation_words[0], pValue);
 }
 
 cache_result_t StorageReal::del_value(const CACHE_KEY& key)
@@ -55,6 +83,14 @@ cache_result_t StorageReal::del_value(const CACHE_KEY& key)
     return m_pApi->delValue(m_pStorage, &key);
 }
 
+cache_result_t StorageReal::invalidate(const std::vector<std::string>& words)
+{
+    std::vector<const char*> zWords;
+    to_c_words(words, &zWords);
+
+    return m_pApi->invalidate(m_pStorage, &zWords[0]);
+}
+
 cache_result_t StorageReal::get_head(CACHE_KEY* pKey, GWBUF** ppHead) const
 {
     return m_pApi->getHead(m_pStorage, pKey, ppHead);
@@ -74,3 +110,27 @@ cache_result_t StorageReal::get_items(uint64_t* pItems) const
 {
     return m_pApi->getItems(m_pStorage, pItems);
 }
+
+cache_result_t StorageReal::get_restored(CACHE_KEY* pKey,
+                                         uint64_t* pSize,
+                                         std::vector<std::string>* pWords)
+{
+    char** pzWords = NULL;
+
+    cache_result_t result = m_pApi->getRestored(m_pStorage, pKey, pSize, &pzWords);
+
+    if (result == CACHE_RESULT_OK)
+    {
+        pWords->clear();
+
+        for (char** pzWord = pzWords; pzWord && *pzWord; ++pzWord)
+        {
+            pWords->push_back(*pzWord);
+            MXS_FREE(*pzWord);
+        }
+
+        MXS_FREE(pzWords);
+    }
+
+    return result;
+}
@@ -30,10 +30,13 @@ public:
                              GWBUF** ppValue) const;
 
     cache_result_t put_value(const CACHE_KEY& key,
+                             const std::vector<std::string>& invalidation_words,
                              const GWBUF* pValue);
 
     cache_result_t del_value(const CACHE_KEY& key);
 
+    cache_result_t invalidate(const std::vector<std::string>& words);
+
     cache_result_t get_head(CACHE_KEY* pKey,
                             GWBUF** ppValue) const;
 
@@ -44,6 +47,10 @@ public:
 
     cache_result_t get_items(uint64_t* pItems) const;
 
+    cache_result_t get_restored(CACHE_KEY* pKey,
+                                uint64_t* pSize,
+                                std::vector<std::string>* pWords);
+
 private:
     friend class StorageFactory;
 
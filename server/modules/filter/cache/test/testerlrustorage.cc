@@ -12,6 +12,7 @@
  */
 
 #include "testerlrustorage.hh"
+#include <algorithm>
 #include "storage.hh"
 #include "storagefactory.hh"
 
@@ -41,8 +42,14 @@ int TesterLRUStorage::execute(size_t n_threads, size_t n_seconds, const CacheIte
     int rv4 = test_max_size(n_threads, n_seconds, cache_items, size);
     out() << endl;
     int rv5 = test_max_count_and_size(n_threads, n_seconds, cache_items, size);
+    out() << endl;
+    int rv6 = test_invalidation(cache_items);
+    out() << endl;
+    int rv7 = test_throughput(n_threads, n_seconds, cache_items);
+    out() << endl;
+    int rv8 = test_admission(cache_items);
 
-    return combine_rvs(rv1, rv2, rv3, rv4, rv5);
+    return combine_rvs(rv1, rv2, rv3, rv4, rv5, rv6, rv7, rv8);
 }
 
 Storage* TesterLRUStorage::get_storage(const CACHE_STORAGE_CONFIG& config) const
@@ -71,7 +78,7 @@ int TesterLRUStorage::test_lru(const CacheItems& cache_items, uint64_t size)
         {
             const CacheItems::value_type& cache_item = cache_items[i];
 
-            result = pStorage->put_value(cache_item.first, cache_item.second);
+            result = pStorage->put_value(cache_item.first, vector<string>(), cache_item.second);
 
             if (result == CACHE_RESULT_OK)
             {
@@ -144,6 +151,273 @@ int TesterLRUStorage::test_lru(const CacheItems& cache_items, uint64_t size)
     return rv;
 }
 
+int TesterLRUStorage::test_invalidation(const CacheItems& cache_items)
+{
+    int rv = EXIT_FAILURE;
+    out() << "LRU invalidation\n" << endl;
+
+    size_t items = cache_items.size() > 99 ? 99 : cache_items.size();
+
+    CacheStorageConfig config(CACHE_THREAD_MODEL_MT);
+
+    Storage* pStorage = get_storage(config);
+
+    if (pStorage)
+    {
+        rv = EXIT_SUCCESS;
+
+        const char* zTables[] = { "db.t0", "db.t1", "db.t2" };
+
+        // Each item depends upon one of the tables and every other upon db.t3 as well.
+        for (size_t i = 0; i < items; ++i)
+        {
+            vector<string> words;
+            words.push_back(zTables[i % 3]);
+
+            if (i % 2 == 0)
+            {
+                words.push_back("db.t3");
+            }
+
+            const CacheItems::value_type& cache_item = cache_items[i];
+
+            if (pStorage->put_value(cache_item.first, words, cache_item.second) != CACHE_RESULT_OK)
+            {
+                out() << "Could not put value." << endl;
+                rv = EXIT_FAILURE;
+            }
+        }
+
+        vector<string> words;
+        words.push_back("db.t0");
+        words.push_back("db.t4");
+
+        if (pStorage->invalidate(words) != CACHE_RESULT_OK)
+        {
+            out() << "Could not invalidate." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        words.clear();
+        words.push_back("db.t3");
+
+        if (pStorage->invalidate(words) != CACHE_RESULT_OK)
+        {
+            out() << "Could not invalidate." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        size_t n_expected = 0;
+
+        for (size_t i = 0; i < items; ++i)
+        {
+            bool invalidated = (i % 3 == 0) || (i % 2 == 0);
+
+            GWBUF* pValue = NULL;
+            cache_result_t result = pStorage->get_value(cache_items[i].first, 0, &pValue);
+
+            if (invalidated && (result != CACHE_RESULT_NOT_FOUND))
+            {
+                out() << "Invalidated value was found." << endl;
+                rv = EXIT_FAILURE;
+            }
+            else if (!invalidated && (result != CACHE_RESULT_OK))
+            {
+                out() << "Value that was not invalidated was not found." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            if (!invalidated)
+            {
+                ++n_expected;
+            }
+
+            gwbuf_free(pValue);
+        }
+
+        uint64_t n_items;
+        pStorage->get_items(&n_items);
+
+        if (n_items != n_expected)
+        {
+            out() << "Expected " << n_expected << " items, found " << n_items << "." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        delete pStorage;
+    }
+
+    return rv;
+}
+
+int TesterLRUStorage::test_admission(const CacheItems& cache_items)
+{
+    int rv = EXIT_FAILURE;
+    out() << "LRU admission\n" << endl;
+
+    const size_t max_count = 10;
+    const size_t n_hot = max_count / 2;
+
+    CacheStorageConfig config(CACHE_THREAD_MODEL_MT);
+    config.max_count = max_count;
+    config.admission = CACHE_ADMISSION_TINYLFU;
+
+    Storage* pStorage = NULL;
+
+    if (cache_items.size() >= 2 * max_count)
+    {
+        pStorage = get_storage(config);
+    }
+    else
+    {
+        out() << "Too few items for testing admission." << endl;
+    }
+
+    if (pStorage)
+    {
+        rv = EXIT_SUCCESS;
+
+        // The hot items are looked for a few times before they are stored,
+        // just like the cache filter would do.
+        for (size_t i = 0; i < n_hot; ++i)
+        {
+            const CacheItems::value_type& cache_item = cache_items[i];
+
+            for (size_t j = 0; j < 3; ++j)
+            {
+                GWBUF* pValue = NULL;
+                pStorage->get_value(cache_item.first, 0, &pValue);
+                gwbuf_free(pValue);
+            }
+
+            if (pStorage->put_value(cache_item.first, vector<string>(), cache_item.second) != CACHE_RESULT_OK)
+            {
+                out() << "Could not put value." << endl;
+                rv = EXIT_FAILURE;
+            }
+        }
+
+        // A scan of items that are used once only must not evict the hot items.
+        for (size_t i = n_hot; i < cache_items.size(); ++i)
+        {
+            const CacheItems::value_type& cache_item = cache_items[i];
+
+            GWBUF* pValue = NULL;
+            pStorage->get_value(cache_item.first, 0, &pValue);
+            gwbuf_free(pValue);
+
+            if (pStorage->put_value(cache_item.first, vector<string>(), cache_item.second) != CACHE_RESULT_OK)
+            {
+                out() << "Could not put value." << endl;
+                rv = EXIT_FAILURE;
+            }
+        }
+
+        for (size_t i = 0; i < n_hot; ++i)
+        {
+            GWBUF* pValue = NULL;
+            cache_result_t result = pStorage->get_value(cache_items[i].first, 0, &pValue);
+
+            if (result != CACHE_RESULT_OK)
+            {
+                out() << "Frequently used value was evicted by a scan." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            gwbuf_free(pValue);
+        }
+
+        uint64_t items;
+        pStorage->get_items(&items);
+
+        if (items > max_count)
+        {
+            out() << "Expected at most " << max_count << " items, found " << items << "." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        delete pStorage;
+    }
+
+    return rv;
+}
+
+int TesterLRUStorage::test_throughput(size_t n_threads, size_t n_seconds, const CacheItems& cache_items)
+{
+    out() << "LRU throughput\n" << endl;
+
+    // One shard per thread, so that in the ideal case there is no contention.
+    size_t n_shards = n_threads > 1 ? n_threads : 2;
+
+    double single;
+    int rv1 = test_throughput(n_threads, n_seconds, cache_items, 1, &single);
+    out() << endl;
+    double sharded;
+    int rv2 = test_throughput(n_threads, n_seconds, cache_items, n_shards, &sharded);
+
+    if ((rv1 == EXIT_SUCCESS) && (rv2 == EXIT_SUCCESS) && (single != 0))
+    {
+        out() << "\nSharded/single: " << sharded / single << endl;
+    }
+
+    return combine_rvs(rv1, rv2);
+}
+
+int TesterLRUStorage::test_throughput(size_t n_threads, size_t n_seconds,
+                                      const CacheItems& cache_items, size_t n_shards, double* pOps)
+{
+    int rv = EXIT_FAILURE;
+
+    size_t max_count = cache_items.size() / 4;
+
+    out() << "Shards: " << n_shards << ", max-count: " << max_count << "\n" << endl;
+
+    CacheStorageConfig config(CACHE_THREAD_MODEL_MT);
+    config.max_count = max_count;
+
+    Storage* pStorage = m_factory.createShardedStorage("unspecified", config, n_shards);
+
+    if (pStorage)
+    {
+        Tasks tasks;
+
+        for (size_t i = 0; i < n_threads; ++i)
+        {
+            tasks.push_back(new HitTask(&out(), pStorage, &cache_items));
+        }
+
+        rv = Tester::execute(out(), n_seconds, tasks);
+
+        size_t n_operations = 0;
+
+        for (Tasks::iterator i = tasks.begin(); i != tasks.end(); ++i)
+        {
+            n_operations += static_cast<HitTask*>(*i)->n_operations();
+        }
+
+        for_each(tasks.begin(), tasks.end(), Task::free);
+
+        *pOps = n_seconds != 0 ? static_cast<double>(n_operations) / n_seconds : 0;
+
+        out() << "Operations: " << n_operations << ", operations/s: " << *pOps << "." << endl;
+
+        uint64_t items;
+        cache_result_t result = pStorage->get_items(&items);
+        ss_dassert(result == CACHE_RESULT_OK);
+
+        out() << "Max count: " << max_count << ", count: " << items << "." << endl;
+
+        if (items > max_count)
+        {
+            rv = EXIT_FAILURE;
+        }
+
+        delete pStorage;
+    }
+
+    return rv;
+}
+
 int TesterLRUStorage::test_max_count(size_t n_threads, size_t n_seconds,
                                      const CacheItems& cache_items, uint64_t size)
 {
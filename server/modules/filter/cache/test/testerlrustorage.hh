@@ -46,6 +46,11 @@ private:
                       const CacheItems& cache_items, uint64_t size);
     int test_max_count_and_size(size_t n_threads, size_t n_seconds,
                                 const CacheItems& cache_items, uint64_t size);
+    int test_invalidation(const CacheItems& cache_items);
+    int test_admission(const CacheItems& cache_items);
+    int test_throughput(size_t n_threads, size_t n_seconds, const CacheItems& cache_items);
+    int test_throughput(size_t n_threads, size_t n_seconds,
+                        const CacheItems& cache_items, size_t n_shards, double* pOps);
 
 private:
     TesterLRUStorage(const TesterLRUStorage&);
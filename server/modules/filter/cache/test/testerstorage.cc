@@ -32,6 +32,7 @@ TesterStorage::HitTask::HitTask(ostream* pOut,
     , m_gets(0)
     , m_dels(0)
     , m_misses(0)
+    , m_seed(random())
 {
     ss_dassert(m_cache_items.size() > 0);
 }
@@ -52,13 +53,15 @@ int TesterStorage::HitTask::run()
 
         const CacheItems::value_type& cache_item = m_cache_items[i];
 
-        storage_action_t action = TesterStorage::get_random_action();
+        storage_action_t action = TesterStorage::get_random_action(&m_seed);
 
         switch (action)
         {
         case STORAGE_PUT:
             {
-                cache_result_t result = m_storage.put_value(cache_item.first, cache_item.second);
+                cache_result_t result = m_storage.put_value(cache_item.first,
+                                                            vector<string>(),
+                                                            cache_item.second);
                 if (CACHE_RESULT_IS_OK(result))
                 {
                     ++m_puts;
@@ -178,7 +181,7 @@ int TesterStorage::run(size_t n_threads,
 
         CacheKey key;
 
-        key.data = i;
+        key.data[0] = i;
 
         vector<uint8_t> value(size, static_cast<uint8_t>(i));
 
@@ -262,6 +265,28 @@ TesterStorage::storage_action_t TesterStorage::get_random_action()
     return action;
 }
 
+// static
+TesterStorage::storage_action_t TesterStorage::get_random_action(unsigned int* pSeed)
+{
+    storage_action_t action;
+    long l = rand_r(pSeed);
+
+    if (l < RAND_MAX / 3)
+    {
+        action = STORAGE_PUT;
+    }
+    else if (l < 2 * (RAND_MAX / 3))
+    {
+        action = STORAGE_GET;
+    }
+    else
+    {
+        action = STORAGE_DEL;
+    }
+
+    return action;
+}
+
 // static
 int TesterStorage::test_smoke(const CacheItems& cache_items)
 {
@@ -331,7 +356,7 @@ int TesterStorage::test_ttl(const CacheItems& cache_items, Storage& storage)
 
         const CacheItems::value_type& cache_item = cache_items[0];
 
-        cache_result_t result = storage.put_value(cache_item.first, cache_item.second);
+        cache_result_t result = storage.put_value(cache_item.first, vector<string>(), cache_item.second);
 
         if (!CACHE_RESULT_IS_OK(result))
         {
@@ -55,6 +55,14 @@ public:
          */
         int run();
 
+        /**
+         * @return The number of operations the task has performed.
+         */
+        size_t n_operations() const
+        {
+            return m_puts + m_gets + m_dels + m_misses;
+        }
+
     private:
         HitTask(const HitTask&);
         HitTask& operator = (const HitTask&);
@@ -66,6 +74,7 @@ public:
         size_t m_gets;                    /*< How many gets. */
         size_t m_dels;                    /*< How many deletes. */
         size_t m_misses;                  /*< How many misses. */
+        unsigned int m_seed;              /*< The seed for the random actions. */
     };
 
     /**
@@ -164,6 +173,16 @@ public:
      */
     static storage_action_t get_random_action();
 
+    /**
+     * Get a random action, without contending for the state of the global
+     * random number generator.
+     *
+     * @param pSeed  The seed, updated by the call.
+     *
+     * @return Some storage action.
+     */
+    static storage_action_t get_random_action(unsigned int* pSeed);
+
     int test_smoke(const CacheItems& cache_items);
 
     int test_ttl(const CacheItems& cache_items);
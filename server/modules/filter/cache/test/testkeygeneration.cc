@@ -12,6 +12,8 @@
  */
 
 #include <maxscale/cppdefs.hh>
+#include <time.h>
+#include <zlib.h>
 #include <iostream>
 #include <fstream>
 #include <tr1/unordered_map>
@@ -19,6 +21,7 @@
 #include <maxscale/paths.h>
 #include <maxscale/query_classifier.h>
 #include <maxscale/log_manager.h>
+#include <maxscale/modutil.h>
 #include "storagefactory.hh"
 #include "cache.hh"
 #include "cache_storage_api.hh"
@@ -39,6 +42,88 @@ void print_usage(const char* zProgram)
          << "  test-file       is the name of a text file." << endl;
 }
 
+/**
+ * Generates a key the way it was done before 128-bit keys were introduced,
+ * for comparison purposes.
+ */
+uint64_t get_crc32_key(const char* zDefault_db, const GWBUF* pQuery)
+{
+    char *pSql;
+    int length;
+
+    modutil_extract_SQL(const_cast<GWBUF*>(pQuery), &pSql, &length);
+
+    uint64_t crc1 = crc32(0, Z_NULL, 0);
+
+    const Bytef* pData;
+
+    if (zDefault_db)
+    {
+        pData = reinterpret_cast<const Bytef*>(zDefault_db);
+        crc1 = crc32(crc1, pData, strlen(zDefault_db));
+    }
+
+    pData = reinterpret_cast<const Bytef*>(pSql);
+
+    crc1 = crc32(crc1, pData, length);
+    uint64_t crc2 = crc32(crc1, pData, length);
+
+    return crc1 << 32 | crc2;
+}
+
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Compares the time it takes to generate the cache key with the time it
+ * takes to generate a key using crc32.
+ */
+void benchmark(const vector<GWBUF*>& queries)
+{
+    const size_t N_ROUNDS = 1000;
+    const char* zDefault_db = "test";
+
+    uint64_t sum = 0;
+    double start = now();
+
+    for (size_t i = 0; i < N_ROUNDS; ++i)
+    {
+        for (vector<GWBUF*>::const_iterator j = queries.begin(); j != queries.end(); ++j)
+        {
+            CACHE_KEY key;
+            Cache::get_default_key(zDefault_db, *j, &key);
+            sum += key.data[0];
+        }
+    }
+
+    double key_time = now() - start;
+
+    start = now();
+
+    for (size_t i = 0; i < N_ROUNDS; ++i)
+    {
+        for (vector<GWBUF*>::const_iterator j = queries.begin(); j != queries.end(); ++j)
+        {
+            sum += get_crc32_key(zDefault_db, *j);
+        }
+    }
+
+    double crc32_time = now() - start;
+
+    size_t n_keys = N_ROUNDS * queries.size();
+
+    // The sum is output so that the compiler cannot optimize the loops away.
+    cout << n_keys << " keys generated, "
+         << "128-bit: " << key_time << "s, "
+         << "crc32: " << crc32_time << "s "
+         << "(" << (sum & 1) << ")." << endl;
+}
+
 int test(StorageFactory& factory, istream& in)
 {
     int rv = EXIT_SUCCESS;
@@ -50,6 +135,7 @@ int test(StorageFactory& factory, istream& in)
     {
         typedef unordered_map<CACHE_KEY, string> Keys;
         Keys keys;
+        vector<GWBUF*> queries;
 
         size_t n_keys = 0;
         size_t n_collisions = 0;
@@ -90,7 +176,7 @@ int test(StorageFactory& factory, istream& in)
                     rv = EXIT_FAILURE;
                 }
 
-                gwbuf_free(pQuery);
+                queries.push_back(pQuery);
             }
             else
             {
@@ -103,6 +189,13 @@ int test(StorageFactory& factory, istream& in)
              << n_collisions << " collisions."
              << endl;
 
+        benchmark(queries);
+
+        for (vector<GWBUF*>::iterator i = queries.begin(); i != queries.end(); ++i)
+        {
+            gwbuf_free(*i);
+        }
+
 
         if (rv == EXIT_SUCCESS)
         {
@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <maxscale/alloc.h>
+#include <maxscale/paths.h>
+#include "cache_storage_api.hh"
+#include "storage.hh"
+#include "storagefactory.hh"
+#include "storage/storage_inmemory/inmemorysnapshot.hh"
+#include "teststorage.hh"
+
+using namespace std;
+
+namespace
+{
+
+typedef vector<pair<CacheKey, GWBUF*> > Items;
+
+const size_t ITEM_SIZE = 1000;
+const size_t N_ITEMS = 10;
+
+const char STORAGE_NAME[] = "snapshot";
+
+/**
+ * Create storage_inmemory storage, wrapped by the LRU storage, that maintains
+ * a snapshot in a directory. By default, the snapshot is only written when
+ * the storage is deleted.
+ */
+Storage* create_storage(StorageFactory& factory,
+                        const string& directory,
+                        uint64_t max_size,
+                        const char* zInterval = "0")
+{
+    string snapshot_directory = "snapshot_directory=" + directory;
+    string snapshot_interval = string("snapshot_interval=") + zInterval;
+
+    char* argv[] = { &snapshot_directory[0], &snapshot_interval[0] };
+
+    CacheStorageConfig config(CACHE_THREAD_MODEL_ST);
+    config.max_size = max_size;
+
+    return factory.createStorage(STORAGE_NAME, config, 2, argv);
+}
+
+/**
+ * Wait until the snapshot has been loaded and its items have been restored.
+ *
+ * @return The number of items in the storage.
+ */
+uint64_t wait_for_restore(Storage& storage)
+{
+    CacheKey probe;
+    uint64_t items = 0;
+
+    for (int i = 0; (i < 50) && (items == 0); ++i)
+    {
+        GWBUF* pValue = NULL;
+
+        // The restored items are added when the storage is accessed.
+        storage.get_value(probe, CACHE_FLAGS_NONE, &pValue);
+        gwbuf_free(pValue);
+
+        storage.get_items(&items);
+
+        if (items == 0)
+        {
+            usleep(100000);
+        }
+    }
+
+    return items;
+}
+
+/**
+ * @return The number of items that are found in the storage with the value they were put with.
+ */
+size_t count_hits(Storage& storage, const Items& items)
+{
+    size_t n_hits = 0;
+
+    for (Items::const_iterator i = items.begin(); i != items.end(); ++i)
+    {
+        GWBUF* pValue = NULL;
+
+        if ((storage.get_value(i->first, CACHE_FLAGS_NONE, &pValue) == CACHE_RESULT_OK) &&
+            (gwbuf_compare(pValue, i->second) == 0))
+        {
+            ++n_hits;
+        }
+
+        gwbuf_free(pValue);
+    }
+
+    return n_hits;
+}
+
+/**
+ * @return The number of items in the actual storage, below the LRU storage.
+ */
+uint64_t get_real_items(Storage& storage)
+{
+    uint64_t items = UINT64_MAX;
+    json_t* pInfo;
+
+    if (storage.get_info(Storage::INFO_ALL, &pInfo) == CACHE_RESULT_OK)
+    {
+        json_t* pItems = json_object_get(json_object_get(pInfo, "real_storage"), "items");
+
+        if (json_is_integer(pItems))
+        {
+            items = json_integer_value(pItems);
+        }
+
+        json_decref(pInfo);
+    }
+
+    return items;
+}
+
+void create_items(size_t first, size_t n, Items* pItems)
+{
+    for (size_t i = first; i < first + n; ++i)
+    {
+        CacheKey key;
+        key.data[0] = i;
+
+        vector<uint8_t> value(ITEM_SIZE, static_cast<uint8_t>(i));
+
+        pItems->push_back(make_pair(key, gwbuf_alloc_and_load(value.size(), &value[0])));
+    }
+}
+
+void free_items(Items& items)
+{
+    for (Items::iterator i = items.begin(); i != items.end(); ++i)
+    {
+        gwbuf_free(i->second);
+    }
+
+    items.clear();
+}
+
+class TestSnapshot : public TestStorage
+{
+public:
+    TestSnapshot(std::ostream* pOut)
+        : TestStorage(pOut)
+    {}
+
+private:
+    int execute(StorageFactory& factory,
+                size_t threads,
+                size_t seconds,
+                size_t items,
+                size_t min_size,
+                size_t max_size)
+    {
+        char directory[] = "testsnapshot-XXXXXX";
+
+        if (!mkdtemp(directory))
+        {
+            out() << "Could not create snapshot directory." << endl;
+            return EXIT_FAILURE;
+        }
+
+        int rv1 = test_restart(factory, directory);
+        out() << endl;
+        int rv2 = test_restart_smaller(factory, directory);
+        out() << endl;
+        int rv3 = test_batches(factory, directory);
+
+        string path = string(directory) + "/" + STORAGE_NAME + ".snapshot";
+        remove(path.c_str());
+        rmdir(directory);
+
+        return (rv1 == EXIT_SUCCESS) && (rv2 == EXIT_SUCCESS) && (rv3 == EXIT_SUCCESS) ?
+            EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    /**
+     * Put items, restart and check that the restored items are served by a
+     * storage whose max_size is reached by them, can be invalidated, and are
+     * evicted before items put after the restart.
+     */
+    int test_restart(StorageFactory& factory, const string& directory)
+    {
+        int rv = EXIT_FAILURE;
+        out() << "Restart\n" << endl;
+
+        const uint64_t max_size = N_ITEMS * ITEM_SIZE;
+
+        Items items;
+        create_items(1, N_ITEMS, &items);
+
+        Storage* pStorage = create_storage(factory, directory, max_size);
+
+        if (pStorage)
+        {
+            for (size_t i = 0; i < items.size(); ++i)
+            {
+                vector<string> words;
+                words.push_back(i % 2 == 0 ? "db.even" : "db.odd");
+
+                pStorage->put_value(items[i].first, words, items[i].second);
+            }
+
+            // Let the loading of the, non-existent, snapshot finish, as nothing is
+            // written if the storage is deleted before that.
+            sleep(1);
+            wait_for_restore(*pStorage);
+
+            delete pStorage;
+        }
+
+        pStorage = create_storage(factory, directory, max_size);
+
+        if (pStorage)
+        {
+            rv = EXIT_SUCCESS;
+
+            uint64_t n_items = wait_for_restore(*pStorage);
+            uint64_t size = 0;
+            pStorage->get_size(&size);
+
+            if ((n_items != N_ITEMS) || (size != max_size))
+            {
+                out() << "Restored " << n_items << " items of size " << size
+                      << ", expected " << N_ITEMS << " of size " << max_size << "." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            if (count_hits(*pStorage, items) != N_ITEMS)
+            {
+                out() << "Not all restored items were found." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            vector<string> words;
+            words.push_back("db.even");
+            pStorage->invalidate(words);
+
+            if (count_hits(*pStorage, items) != N_ITEMS / 2)
+            {
+                out() << "The restored items could not be invalidated." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            // Once the new items fill the storage, the restored ones are evicted.
+            Items new_items;
+            create_items(100, N_ITEMS, &new_items);
+
+            for (size_t i = 0; i < new_items.size(); ++i)
+            {
+                pStorage->put_value(new_items[i].first, vector<string>(), new_items[i].second);
+            }
+
+            pStorage->get_items(&n_items);
+            pStorage->get_size(&size);
+
+            if ((count_hits(*pStorage, items) != 0) || (count_hits(*pStorage, new_items) != N_ITEMS) ||
+                (n_items != N_ITEMS) || (size != max_size) || (get_real_items(*pStorage) != N_ITEMS))
+            {
+                out() << "Restored items were not evicted like other items." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            free_items(new_items);
+
+            delete pStorage;
+        }
+
+        free_items(items);
+
+        return rv;
+    }
+
+    /**
+     * Restart with a max_size too small for the snapshot and check that only the
+     * items that fit are restored, in the LRU storage as well as below it.
+     */
+    int test_restart_smaller(StorageFactory& factory, const string& directory)
+    {
+        int rv = EXIT_FAILURE;
+        out() << "Restart with a smaller max_size\n" << endl;
+
+        const uint64_t max_size = (N_ITEMS / 2) * ITEM_SIZE + ITEM_SIZE / 2;
+
+        // The items put after the restart in test_restart.
+        Items items;
+        create_items(100, N_ITEMS, &items);
+
+        Storage* pStorage = create_storage(factory, directory, max_size);
+
+        if (pStorage)
+        {
+            rv = EXIT_SUCCESS;
+
+            uint64_t n_items = wait_for_restore(*pStorage);
+            uint64_t size = 0;
+            pStorage->get_size(&size);
+
+            if ((n_items != N_ITEMS / 2) || (size > max_size))
+            {
+                out() << "Restored " << n_items << " items of size " << size
+                      << ", expected " << N_ITEMS / 2 << "." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            if (count_hits(*pStorage, items) != n_items)
+            {
+                out() << "Not all restored items were found." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            if (get_real_items(*pStorage) != n_items)
+            {
+                out() << "Items that were not restored remain in the storage." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            delete pStorage;
+        }
+
+        free_items(items);
+
+        return rv;
+    }
+
+    /**
+     * Put more items than fit in several snapshot batches and check that the
+     * snapshot is written periodically, while the storage is used, as well
+     * as when the storage is deleted, and that all items are restored.
+     */
+    int test_batches(StorageFactory& factory, const string& directory)
+    {
+        int rv = EXIT_FAILURE;
+        out() << "Snapshot of several batches\n" << endl;
+
+        const size_t n_items = 5 * InMemorySnapshot::BATCH_SIZE / ITEM_SIZE;
+        const uint64_t max_size = 2 * n_items * ITEM_SIZE;
+        const string path = directory + "/" + STORAGE_NAME + ".snapshot";
+
+        Items items;
+        create_items(1000, n_items, &items);
+
+        Storage* pStorage = create_storage(factory, directory, max_size, "1");
+
+        if (pStorage)
+        {
+            wait_for_restore(*pStorage);
+
+            for (size_t i = 0; i < items.size(); ++i)
+            {
+                pStorage->put_value(items[i].first, vector<string>(), items[i].second);
+            }
+
+            // A batch is submitted whenever the storage is used, once the
+            // interval has passed. The key must be known to the LRU storage
+            // for the actual storage to be used.
+            struct stat st;
+            bool written = false;
+
+            for (int i = 0; (i < 500) && !written; ++i)
+            {
+                GWBUF* pValue = NULL;
+                pStorage->get_value(items[0].first, CACHE_FLAGS_NONE, &pValue);
+                gwbuf_free(pValue);
+
+                written = (stat(path.c_str(), &st) == 0) && (st.st_size > (off_t)(n_items * ITEM_SIZE));
+
+                if (!written)
+                {
+                    usleep(10000);
+                }
+            }
+
+            if (written)
+            {
+                rv = EXIT_SUCCESS;
+            }
+            else
+            {
+                out() << "The snapshot was not written while the storage was used." << endl;
+            }
+
+            delete pStorage;
+        }
+
+        pStorage = create_storage(factory, directory, max_size);
+
+        if (pStorage)
+        {
+            wait_for_restore(*pStorage);
+
+            if (count_hits(*pStorage, items) != n_items)
+            {
+                out() << "Not all items were restored from a snapshot of several batches." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            delete pStorage;
+        }
+        else
+        {
+            rv = EXIT_FAILURE;
+        }
+
+        free_items(items);
+
+        return rv;
+    }
+};
+
+}
+
+int main(int argc, char* argv[])
+{
+    char* libdir = MXS_STRDUP("../../../../../query_classifier/qc_sqlite/");
+    set_libdir(libdir);
+
+    TestSnapshot test(&cout);
+    int rv = test.run(argc, argv);
+
+    return rv;
+}
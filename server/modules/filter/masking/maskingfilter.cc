@@ -86,7 +86,7 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
         MXS_FILTER_VERSION,
         "A masking filter that is capable of masking/obfuscating returned column values.",
         "V1.0.0",
-        RCAP_TYPE_STMT_INPUT | RCAP_TYPE_CONTIGUOUS_OUTPUT,
+        RCAP_TYPE_STMT_INPUT | RCAP_TYPE_PACKET_OUTPUT,
         &MaskingFilter::s_object,
         NULL, /* Process init. */
         NULL, /* Process finish. */
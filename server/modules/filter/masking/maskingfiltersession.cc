@@ -69,43 +69,54 @@ int MaskingFilterSession::routeQuery(GWBUF* pPacket)
 
 int MaskingFilterSession::clientReply(GWBUF* pPacket)
 {
-    ss_dassert(GWBUF_IS_CONTIGUOUS(pPacket));
-
-    ComResponse response(pPacket);
-
-    if (response.is_err())
-    {
-        // If we get an error response, we just abort what we were doing.
-        m_state = EXPECTING_NOTHING;
-    }
-    else
+    // The buffer contains complete packets, but it need not be contiguous.
+    // Each packet is processed as it is and masked values are rewritten in
+    // place, so the response is never copied as a whole.
+    ComPacketChain packets(pPacket);
+    uint8_t* pData;
+    bool done = false;
+
+    while (!done && (pData = packets.next()))
     {
-        switch (m_state)
-        {
-        case EXPECTING_NOTHING:
-            MXS_WARNING("Received data, although expected nothing.");
-        case IGNORING_RESPONSE:
-            break;
-
-        case EXPECTING_RESPONSE:
-            handle_response(pPacket);
-            break;
-
-        case EXPECTING_FIELD:
-            handle_field(pPacket);
-            break;
-
-        case EXPECTING_ROW:
-            handle_row(pPacket);
-            break;
+        ComResponse response(pData);
 
-        case EXPECTING_FIELD_EOF:
-        case EXPECTING_ROW_EOF:
-            handle_eof(pPacket);
-            break;
+        if (response.is_err())
+        {
+            // If we get an error response, we just abort what we were doing.
+            m_state = EXPECTING_NOTHING;
+        }
+        else
+        {
+            switch (m_state)
+            {
+            case EXPECTING_NOTHING:
+                MXS_WARNING("Received data, although expected nothing.");
+            case IGNORING_RESPONSE:
+            case SUPPRESSING_RESPONSE:
+                // The rest of the buffer need not be looked at.
+                done = true;
+                break;
+
+            case EXPECTING_RESPONSE:
+                handle_response(pData);
+                break;
+
+            case EXPECTING_FIELD:
+                handle_field(pData);
+                break;
+
+            case EXPECTING_ROW:
+                if (handle_row(pData))
+                {
+                    packets.set_modified();
+                }
+                break;
 
-        case SUPPRESSING_RESPONSE:
-            break;
+            case EXPECTING_FIELD_EOF:
+            case EXPECTING_ROW_EOF:
+                handle_eof(pData);
+                break;
+            }
         }
     }
 
@@ -124,7 +135,7 @@ int MaskingFilterSession::clientReply(GWBUF* pPacket)
     return rv;
 }
 
-void MaskingFilterSession::handle_response(GWBUF* pPacket)
+void MaskingFilterSession::handle_response(uint8_t* pPacket)
 {
     ComResponse response(pPacket);
 
@@ -160,7 +171,7 @@ void MaskingFilterSession::handle_response(GWBUF* pPacket)
     }
 }
 
-void MaskingFilterSession::handle_field(GWBUF* pPacket)
+void MaskingFilterSession::handle_field(uint8_t* pPacket)
 {
     ComQueryResponse::ColumnDef column_def(pPacket);
 
@@ -193,7 +204,7 @@ void MaskingFilterSession::handle_field(GWBUF* pPacket)
     }
 }
 
-void MaskingFilterSession::handle_eof(GWBUF* pPacket)
+void MaskingFilterSession::handle_eof(uint8_t* pPacket)
 {
     ComResponse response(pPacket);
 
@@ -232,8 +243,9 @@ void warn_of_type_mismatch(const MaskingRules::Rule& rule)
 
 }
 
-void MaskingFilterSession::handle_row(GWBUF* pPacket)
+bool MaskingFilterSession::handle_row(uint8_t* pPacket)
 {
+    bool masked = false;
     ComPacket response(pPacket);
 
     if ((response.payload_len() == ComEOF::PAYLOAD_LEN) &&
@@ -263,9 +275,12 @@ void MaskingFilterSession::handle_row(GWBUF* pPacket)
             else
             {
                 mask_values(response);
+                masked = true;
             }
         }
     }
+
+    return masked;
 }
 
 void MaskingFilterSession::handle_large_payload()
@@ -53,10 +53,10 @@ private:
         SUPPRESSING_RESPONSE
     };
 
-    void handle_response(GWBUF* pPacket);
-    void handle_field(GWBUF* pPacket);
-    void handle_row(GWBUF* pPacket);
-    void handle_eof(GWBUF* pPacket);
+    void handle_response(uint8_t* pPacket);
+    void handle_field(uint8_t* pPacket);
+    bool handle_row(uint8_t* pPacket);
+    void handle_eof(uint8_t* pPacket);
     void handle_large_payload();
 
     void mask_values(ComPacket& response);
@@ -503,8 +503,17 @@ public:
     };
 
     ComPacket(GWBUF* pPacket)
+        : m_pPacket(GWBUF_DATA(pPacket))
+        , m_pData(m_pPacket)
+        , m_payload_len(MYSQL_GET_PAYLOAD_LEN(m_pData))
+        , m_packet_no(MYSQL_GET_PACKET_NO(m_pData))
+    {
+        m_pData += MYSQL_HEADER_LEN;
+    }
+
+    ComPacket(uint8_t* pPacket)
         : m_pPacket(pPacket)
-        , m_pData(GWBUF_DATA(pPacket))
+        , m_pData(m_pPacket)
         , m_payload_len(MYSQL_GET_PAYLOAD_LEN(m_pData))
         , m_packet_no(MYSQL_GET_PACKET_NO(m_pData))
     {
@@ -513,7 +522,7 @@ public:
 
     ComPacket(const ComPacket& packet)
         : m_pPacket(packet.m_pPacket)
-        , m_pData(GWBUF_DATA(m_pPacket))
+        , m_pData(m_pPacket)
         , m_payload_len(packet.m_payload_len)
         , m_packet_no(packet.m_packet_no)
     {
@@ -536,7 +545,7 @@ public:
     }
 
 protected:
-    GWBUF*   m_pPacket;
+    uint8_t* m_pPacket; /*<! The beginning of the packet. */
     uint8_t* m_pData;
 
 private:
@@ -569,6 +578,14 @@ public:
         ++m_pData;
     }
 
+    ComResponse(uint8_t* pPacket)
+        : ComPacket(pPacket)
+        , m_type(*m_pData)
+    {
+        ss_dassert(packet_len() >= MYSQL_HEADER_LEN + 1);
+        ++m_pData;
+    }
+
     ComResponse(const ComPacket& packet)
         : ComPacket(packet)
         , m_type(*m_pData)
@@ -762,20 +779,20 @@ public:
         , m_org_name(&m_pData)
         , m_length_fixed_fields(&m_pData)
     {
-        m_character_set = *reinterpret_cast<const uint16_t*>(m_pData);
-        m_pData += 2;
-
-        m_column_length = *reinterpret_cast<const uint32_t*>(m_pData);
-        m_pData += 4;
-
-        m_type = static_cast<enum_field_types>(*m_pData);
-        m_pData += 1;
-
-        m_flags = *reinterpret_cast<const uint16_t*>(m_pData);
-        m_pData += 2;
+        extract_fixed_fields();
+    }
 
-        m_decimals = *m_pData;
-        m_pData += 1;
+    CQRColumnDef(uint8_t* pPacket)
+        : ComPacket(pPacket)
+        , m_catalog(&m_pData)
+        , m_schema(&m_pData)
+        , m_table(&m_pData)
+        , m_org_table(&m_pData)
+        , m_name(&m_pData)
+        , m_org_name(&m_pData)
+        , m_length_fixed_fields(&m_pData)
+    {
+        extract_fixed_fields();
     }
 
     const LEncString& catalog() const
@@ -825,6 +842,25 @@ public:
         return ss.str();
     }
 
+private:
+    void extract_fixed_fields()
+    {
+        m_character_set = *reinterpret_cast<const uint16_t*>(m_pData);
+        m_pData += 2;
+
+        m_column_length = *reinterpret_cast<const uint32_t*>(m_pData);
+        m_pData += 4;
+
+        m_type = static_cast<enum_field_types>(*m_pData);
+        m_pData += 1;
+
+        m_flags = *reinterpret_cast<const uint16_t*>(m_pData);
+        m_pData += 2;
+
+        m_decimals = *m_pData;
+        m_pData += 1;
+    }
+
 private:
     LEncString       m_catalog;
     LEncString       m_schema;
@@ -1251,7 +1287,7 @@ public:
 
     iterator end()
     {
-        uint8_t* pEnd = GWBUF_DATA(m_pPacket) + GWBUF_LENGTH(m_pPacket);
+        uint8_t* pEnd = m_pPacket + packet_len();
         return iterator(pEnd);
     }
 
@@ -1305,3 +1341,148 @@ public:
 private:
     LEncInt m_nFields;
 };
+
+/**
+ * @class ComPacketChain
+ *
+ * An instance of this class provides access to the packets of a chain of
+ * buffers that contains complete packets, without the chain having to be
+ * made contiguous.
+ *
+ * A packet that is contained in a single buffer is provided in place. A packet
+ * that is split between buffers is copied, and if the copy is modified it is
+ * written back when the next packet is moved to, or when the instance is
+ * destroyed. Thus, at any time at most one packet is copied.
+ */
+class ComPacketChain
+{
+public:
+    ComPacketChain(GWBUF* pBuffer)
+        : m_pBuffer(pBuffer)
+        , m_offset(0)
+        , m_len(0)
+        , m_copied(false)
+        , m_modified(false)
+    {
+    }
+
+    ~ComPacketChain()
+    {
+        flush();
+    }
+
+    /**
+     * Move to the next packet.
+     *
+     * @return The beginning of the packet, or NULL if there are no more packets.
+     */
+    uint8_t* next()
+    {
+        flush();
+
+        m_offset += m_len;
+        m_len = 0;
+        m_copied = false;
+
+        while (m_pBuffer && (m_offset >= GWBUF_LENGTH(m_pBuffer)))
+        {
+            m_offset -= GWBUF_LENGTH(m_pBuffer);
+            m_pBuffer = m_pBuffer->next;
+        }
+
+        uint8_t* pPacket = NULL;
+
+        if (m_pBuffer)
+        {
+            size_t available = GWBUF_LENGTH(m_pBuffer) - m_offset;
+            pPacket = GWBUF_DATA(m_pBuffer) + m_offset;
+
+            if ((available >= MYSQL_HEADER_LEN) &&
+                (available >= MYSQL_HEADER_LEN + MYSQL_GET_PAYLOAD_LEN(pPacket)))
+            {
+                m_len = MYSQL_HEADER_LEN + MYSQL_GET_PAYLOAD_LEN(pPacket);
+            }
+            else
+            {
+                pPacket = copy();
+            }
+        }
+
+        return pPacket;
+    }
+
+    /**
+     * Mark the current packet as modified. Needed only if the packet was
+     * modified, otherwise a modification of a copied packet is lost.
+     */
+    void set_modified()
+    {
+        m_modified = true;
+    }
+
+private:
+    ComPacketChain(const ComPacketChain&);
+    ComPacketChain& operator = (const ComPacketChain&);
+
+    uint8_t* copy()
+    {
+        uint8_t* pPacket = NULL;
+        uint8_t header[MYSQL_HEADER_LEN];
+
+        if (gwbuf_copy_data(m_pBuffer, m_offset, MYSQL_HEADER_LEN, header) == MYSQL_HEADER_LEN)
+        {
+            size_t len = MYSQL_HEADER_LEN + MYSQL_GET_PAYLOAD_LEN(header);
+            m_copy.resize(len);
+
+            if (gwbuf_copy_data(m_pBuffer, m_offset, len, &m_copy[0]) == len)
+            {
+                pPacket = &m_copy[0];
+                m_len = len;
+                m_copied = true;
+            }
+        }
+
+        if (!pPacket)
+        {
+            // Not a complete packet, so there is nothing more to provide.
+            ss_dassert(!true);
+            m_pBuffer = NULL;
+        }
+
+        return pPacket;
+    }
+
+    void flush()
+    {
+        if (m_copied && m_modified)
+        {
+            GWBUF* pBuffer = m_pBuffer;
+            size_t offset = m_offset;
+            const uint8_t* pData = &m_copy[0];
+            size_t n = m_len;
+
+            while (n != 0)
+            {
+                size_t available = GWBUF_LENGTH(pBuffer) - offset;
+                size_t len = n < available ? n : available;
+
+                memcpy(GWBUF_DATA(pBuffer) + offset, pData, len);
+                pData += len;
+                n -= len;
+
+                pBuffer = pBuffer->next;
+                offset = 0;
+            }
+        }
+
+        m_modified = false;
+    }
+
+private:
+    GWBUF*               m_pBuffer;  /*<! The buffer the current packet begins in. */
+    size_t               m_offset;   /*<! The offset of the current packet in m_pBuffer. */
+    size_t               m_len;      /*<! The length of the current packet. */
+    bool                 m_copied;   /*<! Whether the current packet was copied. */
+    bool                 m_modified; /*<! Whether the current packet was modified. */
+    std::vector<uint8_t> m_copy;     /*<! The copy of a split packet. */
+};
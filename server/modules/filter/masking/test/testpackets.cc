@@ -0,0 +1,586 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <vector>
+#include <maxscale/debug.h>
+#include <maxscale/limits.h>
+#include <maxscale/protocol/mysql.h>
+#include "maxscale/mock/backend.hh"
+#include "maxscale/mock/routersession.hh"
+#include "maxscale/mock/session.hh"
+
+using namespace std;
+using maxscale::FilterModule;
+namespace mock = maxscale::mock;
+
+namespace
+{
+
+const char rules_json[] =
+    "{"
+    "  \"rules\": ["
+    "    {"
+    "      \"replace\": { "
+    "        \"column\": \"a\" "
+    "      },"
+    "      \"with\": {"
+    "        \"fill\": \"X\" "
+    "      }"
+    "    }"
+    "  ]"
+    "}";
+
+typedef vector<uint8_t> Data;
+
+/**
+ * A file containing the masking rules, removed when the object is destroyed.
+ */
+class RulesFile
+{
+    RulesFile(const RulesFile&);
+    RulesFile& operator = (const RulesFile&);
+
+public:
+    RulesFile(const char* zRules)
+        : m_name("/tmp/masking_testpacketsXXXXXX")
+    {
+        int fd = mkstemp(&m_name[0]);
+        ss_dassert(fd != -1);
+        ssize_t n = write(fd, zRules, strlen(zRules));
+        ss_dassert(n == (ssize_t)strlen(zRules));
+        close(fd);
+    }
+
+    ~RulesFile()
+    {
+        unlink(m_name.c_str());
+    }
+
+    const string& name() const
+    {
+        return m_name;
+    }
+
+private:
+    string m_name;
+};
+
+/**
+ * Collects the data of the responses delivered to the client.
+ */
+class Collector : public mock::Client::Handler
+{
+public:
+    Collector(bool keep)
+        : m_keep(keep)
+    {
+    }
+
+    int32_t backend_reply(GWBUF* pResponse)
+    {
+        if (m_keep)
+        {
+            size_t offset = m_data.size();
+            m_data.resize(offset + gwbuf_length(pResponse));
+            gwbuf_copy_data(pResponse, 0, m_data.size() - offset, &m_data[offset]);
+        }
+
+        gwbuf_free(pResponse);
+        return 1;
+    }
+
+    int32_t maxscale_reply(GWBUF* pResponse)
+    {
+        cout << "ERROR: The filter responded to the client by itself." << endl;
+        gwbuf_free(pResponse);
+        return 0;
+    }
+
+    const Data& data() const
+    {
+        return m_data;
+    }
+
+private:
+    bool m_keep;
+    Data m_data;
+};
+
+void add_packet(Data& data, uint8_t seq, const Data& payload)
+{
+    uint32_t len = payload.size();
+    data.push_back(len);
+    data.push_back(len >> 8);
+    data.push_back(len >> 16);
+    data.push_back(seq);
+    data.insert(data.end(), payload.begin(), payload.end());
+}
+
+void add_lenenc_str(Data& payload, const string& value)
+{
+    ss_dassert(value.length() < 251);
+    payload.push_back(value.length());
+    payload.insert(payload.end(), value.begin(), value.end());
+}
+
+void add_column_def(Data& data, uint8_t seq, const char* zName)
+{
+    Data payload;
+    add_lenenc_str(payload, "def");
+    add_lenenc_str(payload, "db");
+    add_lenenc_str(payload, "t");
+    add_lenenc_str(payload, "t");
+    add_lenenc_str(payload, zName);
+    add_lenenc_str(payload, zName);
+    payload.push_back(0x0c);                 // Length of the fixed fields
+    payload.push_back(0x21);                 // Character set
+    payload.push_back(0x00);
+    payload.insert(payload.end(), 4, 0xff);  // Column length
+    payload.push_back(MYSQL_TYPE_VAR_STRING);
+    payload.insert(payload.end(), 2, 0x00);  // Flags
+    payload.push_back(0x00);                 // Decimals
+    payload.insert(payload.end(), 2, 0x00);  // Filler
+
+    add_packet(data, seq, payload);
+}
+
+void add_eof(Data& data, uint8_t seq)
+{
+    Data payload;
+    payload.push_back(0xfe);
+    payload.insert(payload.end(), 4, 0x00);
+
+    add_packet(data, seq, payload);
+}
+
+/**
+ * Add a row to a resultset.
+ *
+ * @param data    The resultset.
+ * @param seq     The sequence number of the packet.
+ * @param i       The number of the row.
+ * @param masked  Whether to add the row as the filter should return it.
+ */
+void add_row(Data& data, uint8_t seq, size_t i, bool masked)
+{
+    char value[32];
+    Data payload;
+
+    sprintf(value, "secret%lu", i);
+    add_lenenc_str(payload, masked ? string(strlen(value), 'X') : string(value));
+    sprintf(value, "public%lu", i);
+    add_lenenc_str(payload, value);
+
+    add_packet(data, seq, payload);
+}
+
+/**
+ * Create a text resultset with the columns a and b.
+ *
+ * @param n_rows  The number of rows.
+ * @param masked  Whether to create the resultset as the filter should return it.
+ *
+ * @return The packets of the resultset, one per element.
+ */
+vector<Data> create_resultset(size_t n_rows, bool masked)
+{
+    vector<Data> packets(n_rows + 5);
+    uint8_t seq = 1;
+    size_t i = 0;
+
+    add_packet(packets[i++], seq++, Data(1, 2));
+    add_column_def(packets[i++], seq++, "a");
+    add_column_def(packets[i++], seq++, "b");
+    add_eof(packets[i++], seq++);
+
+    for (size_t j = 0; j < n_rows; ++j)
+    {
+        add_row(packets[i++], seq++, j, masked);
+    }
+
+    add_eof(packets[i++], seq++);
+
+    return packets;
+}
+
+Data concatenate(const vector<Data>& packets)
+{
+    Data data;
+
+    for (vector<Data>::const_iterator i = packets.begin(); i != packets.end(); ++i)
+    {
+        data.insert(data.end(), i->begin(), i->end());
+    }
+
+    return data;
+}
+
+/**
+ * Create a chain of buffers, like the ones that are read from the network.
+ *
+ * @param data          The data.
+ * @param segment_size  The size of the buffers, the last one may be smaller.
+ *
+ * @return The chain.
+ */
+GWBUF* create_chain(const Data& data, size_t segment_size)
+{
+    GWBUF* pChain = NULL;
+
+    for (size_t i = 0; i < data.size(); i += segment_size)
+    {
+        size_t len = min(segment_size, data.size() - i);
+        pChain = gwbuf_append(pChain, gwbuf_alloc_and_load(len, &data[i]));
+    }
+
+    return pChain;
+}
+
+/**
+ * Send a query through a filter session and return the resultset in replies
+ * of complete packets, each one split into buffers of a particular size.
+ *
+ * @param filter_session      The filter session.
+ * @param router_session      The router session below the filter.
+ * @param packets             The packets of the resultset.
+ * @param packets_per_reply   How many packets each reply contains.
+ * @param segment_size        The size of the buffers of a reply.
+ */
+void query(FilterModule::Session& filter_session,
+           mock::RouterSession& router_session,
+           const vector<Data>& packets,
+           size_t packets_per_reply,
+           size_t segment_size)
+{
+    filter_session.routeQuery(mock::create_com_query("SELECT a, b FROM t"));
+    // The OK backend responds with an OK packet, the resultset is delivered instead.
+    router_session.discard_all_responses();
+
+    for (size_t i = 0; i < packets.size(); i += packets_per_reply)
+    {
+        size_t end = min(i + packets_per_reply, packets.size());
+        Data reply = concatenate(vector<Data>(packets.begin() + i, packets.begin() + end));
+
+        router_session.clientReply(create_chain(reply, segment_size));
+    }
+}
+
+int test_split_packets(FilterModule::Instance& filter_instance)
+{
+    int rv = EXIT_SUCCESS;
+    const size_t n_rows = 1000;
+
+    vector<Data> packets = create_resultset(n_rows, false);
+    Data expected = concatenate(create_resultset(n_rows, true));
+
+    size_t packets_per_reply[] = { 1, 7, packets.size() };
+    size_t segment_sizes[] = { 1, 2, 3, 5, 7, 11, 64, 1000, 32768 };
+
+    mock::OkBackend backend;
+    mock::RouterSession router_session(&backend);
+
+    for (size_t i = 0; i < sizeof(packets_per_reply) / sizeof(packets_per_reply[0]); ++i)
+    {
+        for (size_t j = 0; j < sizeof(segment_sizes) / sizeof(segment_sizes[0]); ++j)
+        {
+            Collector collector(true);
+            mock::Client client("bob", "127.0.0.1", &collector);
+            mock::Session session(&client);
+
+            auto_ptr<FilterModule::Session> sFilter_session = filter_instance.newSession(&session);
+
+            if (sFilter_session.get())
+            {
+                router_session.set_as_downstream_on(sFilter_session.get());
+                client.set_as_upstream_on(*sFilter_session.get());
+
+                query(*sFilter_session.get(), router_session, packets,
+                      packets_per_reply[i], segment_sizes[j]);
+
+                if (collector.data() != expected)
+                {
+                    cout << "ERROR: A resultset in replies of " << packets_per_reply[i]
+                         << " packets, split into buffers of " << segment_sizes[j]
+                         << " bytes, was not masked correctly." << endl;
+                    rv = EXIT_FAILURE;
+                }
+            }
+            else
+            {
+                cout << "ERROR: Could not create a filter session." << endl;
+                rv = EXIT_FAILURE;
+            }
+        }
+    }
+
+    return rv;
+}
+
+long peak_rss_kb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * Create a text resultset with the columns a and b as a chain of buffers.
+ * The resultset is created a buffer at a time, so that it exists only in
+ * the chain.
+ *
+ * @param n_rows        The number of rows.
+ * @param segment_size  The size of the buffers.
+ *
+ * @return The chain.
+ */
+GWBUF* create_large_resultset(size_t n_rows, size_t segment_size)
+{
+    GWBUF* pChain = NULL;
+    Data data;
+    uint8_t seq = 1;
+
+    add_packet(data, seq++, Data(1, 2));
+    add_column_def(data, seq++, "a");
+    add_column_def(data, seq++, "b");
+    add_eof(data, seq++);
+
+    for (size_t i = 0; i < n_rows; ++i)
+    {
+        add_row(data, seq++, i, false);
+
+        if (data.size() >= segment_size)
+        {
+            pChain = gwbuf_append(pChain, gwbuf_alloc_and_load(segment_size, &data[0]));
+            data.erase(data.begin(), data.begin() + segment_size);
+        }
+    }
+
+    add_eof(data, seq++);
+
+    return gwbuf_append(pChain, create_chain(data, segment_size));
+}
+
+/**
+ * Keeps the response delivered to the client, so that it can be used again.
+ */
+class Sink : public mock::Client::Handler
+{
+public:
+    Sink()
+        : m_pResponse(NULL)
+    {
+    }
+
+    ~Sink()
+    {
+        gwbuf_free(m_pResponse);
+    }
+
+    int32_t backend_reply(GWBUF* pResponse)
+    {
+        m_pResponse = gwbuf_append(m_pResponse, pResponse);
+        return 1;
+    }
+
+    int32_t maxscale_reply(GWBUF* pResponse)
+    {
+        gwbuf_free(pResponse);
+        return 0;
+    }
+
+    GWBUF* release()
+    {
+        GWBUF* pResponse = m_pResponse;
+        m_pResponse = NULL;
+        return pResponse;
+    }
+
+private:
+    GWBUF* m_pResponse;
+};
+
+/**
+ * Mask a large resultset delivered as one reply.
+ *
+ * @param ppChain     The resultset; on return contains what the client received.
+ * @param contiguous  Whether the reply is made contiguous before it is
+ *                    delivered, the way it was done for filters that
+ *                    required contiguous output.
+ *
+ * @return The time it took in seconds.
+ */
+double mask_large_resultset(FilterModule::Instance& filter_instance, GWBUF** ppChain, bool contiguous)
+{
+    Sink sink;
+    mock::Client client("bob", "127.0.0.1", &sink);
+    mock::Session session(&client);
+    mock::OkBackend backend;
+    mock::RouterSession router_session(&backend);
+
+    auto_ptr<FilterModule::Session> sFilter_session = filter_instance.newSession(&session);
+    ss_dassert(sFilter_session.get());
+
+    router_session.set_as_downstream_on(sFilter_session.get());
+    client.set_as_upstream_on(*sFilter_session.get());
+
+    sFilter_session->routeQuery(mock::create_com_query("SELECT a, b FROM t"));
+    router_session.discard_all_responses();
+
+    clock_t start = clock();
+
+    if (contiguous)
+    {
+        *ppChain = gwbuf_make_contiguous(*ppChain);
+    }
+
+    router_session.clientReply(*ppChain);
+    double duration = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    *ppChain = sink.release();
+
+    return duration;
+}
+
+int test_performance(FilterModule::Instance& filter_instance)
+{
+    const size_t n_rows = 1000000;
+
+    GWBUF* pChain = create_large_resultset(n_rows, MXS_MAX_NW_READ_BUFFER_SIZE);
+    cout << "Resultset of " << n_rows << " rows, " << gwbuf_length(pChain) << " bytes." << endl;
+
+    long rss_before = peak_rss_kb();
+    double streaming = mask_large_resultset(filter_instance, &pChain, false);
+    long rss_streaming = peak_rss_kb();
+    double contiguous = mask_large_resultset(filter_instance, &pChain, true);
+    long rss_contiguous = peak_rss_kb();
+
+    gwbuf_free(pChain);
+
+    cout << "Streaming : " << (long)(n_rows / streaming) << " rows/s, peak memory +"
+         << rss_streaming - rss_before << "kB" << endl;
+    cout << "Contiguous: " << (long)(n_rows / contiguous) << " rows/s, peak memory +"
+         << rss_contiguous - rss_streaming << "kB" << endl;
+
+    return EXIT_SUCCESS;
+}
+
+int run(bool performance)
+{
+    int rv = EXIT_FAILURE;
+
+    auto_ptr<FilterModule> sModule = FilterModule::load("masking");
+
+    if (sModule.get())
+    {
+        if (maxscale::Module::process_init())
+        {
+            if (maxscale::Module::thread_init())
+            {
+                RulesFile rules(rules_json);
+
+                auto_ptr<FilterModule::ConfigParameters> sParameters = sModule->create_default_parameters();
+                sParameters->set_value("rules", rules.name());
+
+                auto_ptr<FilterModule::Instance> sInstance =
+                    sModule->createInstance("test", NULL, sParameters);
+
+                if (sInstance.get())
+                {
+                    if (performance)
+                    {
+                        rv = test_performance(*sInstance.get());
+                    }
+                    else
+                    {
+                        rv = test_split_packets(*sInstance.get());
+                    }
+                }
+                else
+                {
+                    cerr << "error: Could not create filter instance." << endl;
+                }
+
+                maxscale::Module::thread_finish();
+            }
+            else
+            {
+                cerr << "error: Could not perform thread initialization." << endl;
+            }
+
+            maxscale::Module::process_finish();
+        }
+        else
+        {
+            cerr << "error: Could not perform process initialization." << endl;
+        }
+    }
+    else
+    {
+        cerr << "error: Could not load filter module." << endl;
+    }
+
+    return rv;
+}
+
+char USAGE[] =
+    "usage: masking_testpackets [-p]\n"
+    "\n"
+    "-p    report the throughput and memory use of masking a 1M-row resultset\n"
+    "      instead of checking that split resultsets are masked correctly\n";
+
+}
+
+int main(int argc, char* argv[])
+{
+    int rc = EXIT_SUCCESS;
+    bool performance = false;
+
+    int c;
+    while ((c = getopt(argc, argv, "p")) != -1)
+    {
+        switch (c)
+        {
+        case 'p':
+            performance = true;
+            break;
+
+        default:
+            rc = EXIT_FAILURE;
+        }
+    }
+
+    if (rc == EXIT_SUCCESS)
+    {
+        rc = EXIT_FAILURE;
+
+        if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_STDOUT))
+        {
+            rc = run(performance);
+
+            mxs_log_finish();
+        }
+    }
+    else
+    {
+        cout << USAGE << endl;
+    }
+
+    return rc;
+}
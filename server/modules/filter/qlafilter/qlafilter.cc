@@ -25,6 +25,7 @@
 
 #include <maxscale/cppdefs.hh>
 
+#include <algorithm>
 #include <cmath>
 #include <errno.h>
 #include <fcntl.h>
@@ -34,6 +35,7 @@
 #include <sstream>
 #include <sys/time.h>
 #include <fstream>
+#include <vector>
 
 #include <maxscale/alloc.h>
 #include <maxscale/atomic.h>
@@ -42,10 +44,14 @@
 #include <maxscale/modinfo.h>
 #include <maxscale/modutil.h>
 #include <maxscale/pcre2.h>
+#include <maxscale/semaphore.hh>
 #include <maxscale/service.h>
+#include <maxscale/spinlock.h>
+#include <maxscale/thread.h>
 #include <maxscale/utils.h>
 #include <maxscale/modulecmd.h>
 #include <maxscale/json_api.h>
+#include <maxscale/worker.h>
 
 /* Date string buffer size */
 #define QLA_DATE_BUFFER_SIZE 20
@@ -68,6 +74,12 @@ enum log_options
 /* Default values for logged data */
 #define LOG_DATA_DEFAULT "date,user,query"
 
+/* How often, in milliseconds, the asynchronous writer writes buffered entries */
+#define QLA_WRITER_INTERVAL_MS 100
+
+/* The stdio buffer size of the files written by the asynchronous writer */
+#define QLA_WRITER_FILE_BUFFER_SIZE (64 * 1024)
+
 /* The filter entry points */
 static MXS_FILTER *createInstance(const char *name, char **options, MXS_CONFIG_PARAMETER *);
 static MXS_FILTER_SESSION *newSession(MXS_FILTER *instance, MXS_SESSION *session);
@@ -80,6 +92,9 @@ static int clientReply(MXS_FILTER *instance, MXS_FILTER_SESSION *session, GWBUF
 static void diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb);
 static json_t* diagnostic_json(const MXS_FILTER *instance, const MXS_FILTER_SESSION *fsession);
 static uint64_t getCapabilities(MXS_FILTER* instance);
+static void destroyInstance(MXS_FILTER *instance);
+
+struct QLA_WRITER;
 
 /**
  * A instance structure, the assumption is that the option passed
@@ -111,6 +126,7 @@ typedef struct
     char *query_newline; /* Character(s) used to replace a newline within a query */
     char *separator; /*  Character(s) used to separate elements */
     bool write_warning_given; /* Avoid repeatedly printing some errors/warnings. */
+    QLA_WRITER *writer; /* The asynchronous writer, NULL if writes are synchronous */
 } QLA_INSTANCE;
 
 /**
@@ -157,6 +173,373 @@ typedef struct
     LOG_EVENT_DATA event_data; /* Information about the latest event, required if logging execution time. */
 } QLA_SESSION;
 
+/**
+ * The header of an entry in the buffer of a worker. The header is followed
+ * by @c len bytes of formatted log data.
+ */
+typedef struct
+{
+    FILE *fp;     /* The file the data is written to */
+    uint32_t len; /* The length of the data */
+} QLA_RECORD;
+
+/**
+ * The buffer of a worker. The worker is the only one appending to it and the
+ * writer thread is the only one consuming from it, so neither needs a lock.
+ */
+struct QLA_BUFFER
+{
+    QLA_BUFFER()
+        : data(NULL)
+        , head(0)
+        , tail(0)
+        , signaled(0)
+    {
+        spinlock_init(&lock);
+    }
+
+    char *data;                 /* The ring buffer */
+    uint64_t head;              /* Bytes appended; only modified by the worker */
+    uint64_t tail;              /* Bytes consumed; only modified by the writer thread */
+    int signaled;               /* Whether the writer thread has been woken up */
+    SPINLOCK lock;              /* Protects closing */
+    std::vector<FILE*> closing; /* Files to close once their entries have been written */
+};
+
+/**
+ * The asynchronous writer. Workers append formatted entries to buffers of their
+ * own and a thread of the writer writes them to the files in batches. If the
+ * disk cannot keep up and a buffer gets full, entries are dropped and counted.
+ */
+struct QLA_WRITER
+{
+    QLA_WRITER()
+        : buffers(NULL)
+        , n_buffers(0)
+        , size(0)
+        , flush(false)
+        , running(false)
+        , stop(0)
+        , dropped(0)
+        , write_error_given(false)
+    {
+    }
+
+    QLA_BUFFER *buffers;     /* The buffers of the workers */
+    int n_buffers;           /* The number of buffers */
+    uint64_t size;           /* The size of each buffer */
+    bool flush;              /* Flush the written files after each batch */
+    THREAD thread;           /* The writer thread */
+    bool running;            /* Whether the thread was started */
+    int stop;                /* Set when the thread should exit */
+    mxs::Semaphore wakeup;   /* Posted when a buffer is getting full */
+    uint64_t dropped;        /* Entries dropped because a buffer was full */
+    bool write_error_given;  /* Whether a write error has been reported */
+};
+
+static void ring_copy_in(QLA_BUFFER *buffer, uint64_t size, uint64_t pos, const void *src, size_t len)
+{
+    uint64_t offset = pos % size;
+    size_t n = MXS_MIN(len, size - offset);
+
+    memcpy(buffer->data + offset, src, n);
+    memcpy(buffer->data, (const char*)src + n, len - n);
+}
+
+static void ring_copy_out(const QLA_BUFFER *buffer, uint64_t size, uint64_t pos, void *dest, size_t len)
+{
+    uint64_t offset = pos % size;
+    size_t n = MXS_MIN(len, size - offset);
+
+    memcpy(dest, buffer->data + offset, n);
+    memcpy((char*)dest + n, buffer->data, len - n);
+}
+
+static bool ring_write(const QLA_BUFFER *buffer, uint64_t size, uint64_t pos, size_t len, FILE *fp)
+{
+    uint64_t offset = pos % size;
+    size_t n = MXS_MIN(len, size - offset);
+
+    return (fwrite(buffer->data + offset, 1, n, fp) == n) &&
+           (fwrite(buffer->data, 1, len - n, fp) == len - n);
+}
+
+/**
+ * Write everything the workers have appended and close the files whose
+ * sessions have been closed.
+ *
+ * @param writer The writer
+ */
+static void qla_writer_write(QLA_WRITER *writer)
+{
+    // The files to close are taken before the entries, so that all entries
+    // of a file are written before the file is closed.
+    std::vector<FILE*> closing;
+
+    for (int i = 0; i < writer->n_buffers; i++)
+    {
+        QLA_BUFFER *buffer = &writer->buffers[i];
+
+        spinlock_acquire(&buffer->lock);
+        closing.insert(closing.end(), buffer->closing.begin(), buffer->closing.end());
+        buffer->closing.clear();
+        spinlock_release(&buffer->lock);
+    }
+
+    std::vector<FILE*> written;
+    bool error = false;
+
+    for (int i = 0; i < writer->n_buffers; i++)
+    {
+        QLA_BUFFER *buffer = &writer->buffers[i];
+        uint64_t head = atomic_load_uint64(&buffer->head);
+        uint64_t tail = buffer->tail;
+
+        while (tail < head)
+        {
+            QLA_RECORD record;
+            ring_copy_out(buffer, writer->size, tail, &record, sizeof(record));
+            tail += sizeof(record);
+
+            if (!ring_write(buffer, writer->size, tail, record.len, record.fp))
+            {
+                error = true;
+            }
+            tail += record.len;
+
+            if (writer->flush && (written.empty() || written.back() != record.fp))
+            {
+                written.push_back(record.fp);
+            }
+        }
+
+        atomic_store_uint64(&buffer->tail, tail);
+        atomic_store_int32(&buffer->signaled, 0);
+    }
+
+    if (writer->flush)
+    {
+        std::sort(written.begin(), written.end());
+        written.erase(std::unique(written.begin(), written.end()), written.end());
+
+        for (std::vector<FILE*>::iterator it = written.begin(); it != written.end(); it++)
+        {
+            if (fflush(*it) != 0)
+            {
+                error = true;
+            }
+        }
+    }
+
+    for (std::vector<FILE*>::iterator it = closing.begin(); it != closing.end(); it++)
+    {
+        if (fclose(*it) != 0)
+        {
+            error = true;
+        }
+    }
+
+    if (error && !writer->write_error_given)
+    {
+        MXS_ERROR("Asynchronous write of the query log failed. "
+                  "Suppressing further similar warnings.");
+        writer->write_error_given = true;
+    }
+}
+
+static void qla_writer_main(void *arg)
+{
+    QLA_WRITER *writer = (QLA_WRITER*)arg;
+    bool stop = false;
+
+    while (!stop)
+    {
+        writer->wakeup.timedwait(0, QLA_WRITER_INTERVAL_MS * 1000000);
+
+        // Whatever was appended before the stop was requested is still written.
+        stop = atomic_load_int32(&writer->stop);
+        qla_writer_write(writer);
+    }
+}
+
+/**
+ * Destroy the asynchronous writer. All appended entries are written and all
+ * files whose closing has been requested are closed.
+ *
+ * @param writer The writer
+ */
+static void qla_writer_destroy(QLA_WRITER *writer)
+{
+    if (writer->running)
+    {
+        atomic_store_int32(&writer->stop, 1);
+        writer->wakeup.post();
+        thread_wait(writer->thread);
+    }
+
+    // A worker may have posted after the thread last waited.
+    while (writer->wakeup.trywait())
+    {
+    }
+
+    for (int i = 0; i < writer->n_buffers; i++)
+    {
+        MXS_FREE(writer->buffers[i].data);
+    }
+
+    delete [] writer->buffers;
+    delete writer;
+}
+
+/**
+ * Create an asynchronous writer with a buffer for each worker.
+ *
+ * @param size  The size of the buffer of each worker
+ * @param flush Whether the written files should be flushed after each batch
+ *
+ * @return A new writer or NULL on error
+ */
+static QLA_WRITER* qla_writer_create(uint64_t size, bool flush)
+{
+    QLA_WRITER *writer = NULL;
+
+    MXS_EXCEPTION_GUARD(writer = new QLA_WRITER);
+
+    if (writer)
+    {
+        bool error = false;
+        int n_buffers = config_threadcount();
+
+        writer->size = size;
+        writer->flush = flush;
+        MXS_EXCEPTION_GUARD(writer->buffers = new QLA_BUFFER[n_buffers]);
+
+        if (writer->buffers)
+        {
+            writer->n_buffers = n_buffers;
+
+            for (int i = 0; !error && i < n_buffers; i++)
+            {
+                if ((writer->buffers[i].data = (char*)MXS_MALLOC(size)) == NULL)
+                {
+                    error = true;
+                }
+            }
+        }
+        else
+        {
+            error = true;
+        }
+
+        if (!error)
+        {
+            if (thread_start(&writer->thread, qla_writer_main, writer, 0))
+            {
+                writer->running = true;
+            }
+            else
+            {
+                MXS_ERROR("Could not start the query log writer thread.");
+                error = true;
+            }
+        }
+
+        if (error)
+        {
+            qla_writer_destroy(writer);
+            writer = NULL;
+        }
+    }
+
+    return writer;
+}
+
+/**
+ * Append an entry to a buffer. If the buffer does not have room for the
+ * entry, the entry is dropped.
+ *
+ * @param writer The writer
+ * @param buffer The buffer, only appended to by the calling thread
+ * @param fp     The file the entry is written to
+ * @param entry  The formatted entry
+ *
+ * @return True, if the entry was appended
+ */
+static bool qla_buffer_append(QLA_WRITER *writer, QLA_BUFFER *buffer, FILE *fp, const std::string& entry)
+{
+    bool rval = false;
+    QLA_RECORD record = { fp, (uint32_t)entry.length() };
+    uint64_t needed = sizeof(record) + entry.length();
+    uint64_t used = buffer->head - atomic_load_uint64(&buffer->tail);
+
+    if (needed <= writer->size - used)
+    {
+        ring_copy_in(buffer, writer->size, buffer->head, &record, sizeof(record));
+        ring_copy_in(buffer, writer->size, buffer->head + sizeof(record),
+                     entry.data(), entry.length());
+        // Only now does the entry become visible to the writer thread.
+        atomic_store_uint64(&buffer->head, buffer->head + needed);
+        used += needed;
+        rval = true;
+    }
+    else
+    {
+        atomic_add_uint64(&writer->dropped, 1);
+    }
+
+    if (used > writer->size / 2 && !atomic_load_int32(&buffer->signaled))
+    {
+        atomic_store_int32(&buffer->signaled, 1);
+        writer->wakeup.post();
+    }
+
+    return rval;
+}
+
+/**
+ * Append an entry to the buffer of the calling worker. If the buffer does not
+ * have room for the entry, the entry is dropped.
+ *
+ * @param writer The writer
+ * @param fp     The file the entry is written to
+ * @param entry  The formatted entry
+ *
+ * @return True, if the entry was appended
+ */
+static bool qla_writer_append(QLA_WRITER *writer, FILE *fp, const std::string& entry)
+{
+    bool rval = false;
+    int id = mxs_worker_get_current_id();
+    ss_dassert(id >= 0 && id < writer->n_buffers);
+
+    if (id >= 0 && id < writer->n_buffers)
+    {
+        rval = qla_buffer_append(writer, &writer->buffers[id], fp, entry);
+    }
+    else
+    {
+        atomic_add_uint64(&writer->dropped, 1);
+    }
+
+    return rval;
+}
+
+/**
+ * Close a file once all entries appended to it have been written.
+ *
+ * @param writer The writer
+ * @param fp     The file to close
+ */
+static void qla_writer_close(QLA_WRITER *writer, FILE *fp)
+{
+    int id = mxs_worker_get_current_id();
+    QLA_BUFFER *buffer = &writer->buffers[(id >= 0 && id < writer->n_buffers) ? id : 0];
+
+    spinlock_acquire(&buffer->lock);
+    buffer->closing.push_back(fp);
+    spinlock_release(&buffer->lock);
+}
+
 static FILE* open_log_file(QLA_INSTANCE *, uint32_t, const char *);
 static int write_log_entry(FILE*, QLA_INSTANCE*, QLA_SESSION*, uint32_t,
                            const char*, const char*, size_t, int);
@@ -200,6 +583,8 @@ static const char PARAM_FLUSH[] = "flush";
 static const char PARAM_APPEND[] = "append";
 static const char PARAM_NEWLINE[] = "newline_replacement";
 static const char PARAM_SEPARATOR[] = "separator";
+static const char PARAM_ASYNC[] = "async";
+static const char PARAM_ASYNC_BUFFER_SIZE[] = "async_buffer_size";
 
 MXS_BEGIN_DECLS
 
@@ -243,7 +628,7 @@ MXS_MODULE* MXS_CREATE_MODULE()
         diagnostic,
         diagnostic_json,
         getCapabilities,
-        NULL, // No destroyInstance
+        destroyInstance,
     };
 
     static MXS_MODULE info =
@@ -325,6 +710,16 @@ MXS_MODULE* MXS_CREATE_MODULE()
                 MXS_MODULE_PARAM_BOOL,
                 "false"
             },
+            {
+                PARAM_ASYNC,
+                MXS_MODULE_PARAM_BOOL,
+                "false"
+            },
+            {
+                PARAM_ASYNC_BUFFER_SIZE,
+                MXS_MODULE_PARAM_SIZE,
+                "1Mi"
+            },
             {MXS_END_MODULE_PARAMS}
         }
     };
@@ -356,6 +751,7 @@ createInstance(const char *name, char **options, MXS_CONFIG_PARAMETER *params)
         my_instance->unified_fp = NULL;
         my_instance->unified_filename = NULL;
         my_instance->write_warning_given = false;
+        my_instance->writer = NULL;
 
         my_instance->source = config_copy_string(params, PARAM_SOURCE);
         my_instance->user_name = config_copy_string(params, PARAM_USER);
@@ -384,6 +780,17 @@ createInstance(const char *name, char **options, MXS_CONFIG_PARAMETER *params)
             error = true;
         }
 
+        if (!error && config_get_bool(params, PARAM_ASYNC))
+        {
+            my_instance->writer = qla_writer_create(config_get_size(params, PARAM_ASYNC_BUFFER_SIZE),
+                                                    my_instance->flush_writes);
+
+            if (my_instance->writer == NULL)
+            {
+                error = true;
+            }
+        }
+
         // Try to open the unified log file
         if (!error && (my_instance->log_mode_flags & CONFIG_FILE_UNIFIED))
         {
@@ -417,6 +824,10 @@ createInstance(const char *name, char **options, MXS_CONFIG_PARAMETER *params)
 
         if (error)
         {
+            if (my_instance->writer)
+            {
+                qla_writer_destroy(my_instance->writer);
+            }
             MXS_FREE(my_instance->name);
             MXS_FREE(my_instance->match);
             pcre2_code_free(my_instance->re_match);
@@ -438,6 +849,23 @@ createInstance(const char *name, char **options, MXS_CONFIG_PARAMETER *params)
     return (MXS_FILTER *) my_instance;
 }
 
+/**
+ * Destroy the filter instance. Only the asynchronous writer is destroyed, so
+ * that everything that has been logged is written before MaxScale exits.
+ *
+ * @param instance  The filter instance
+ */
+static void destroyInstance(MXS_FILTER *instance)
+{
+    QLA_INSTANCE *my_instance = (QLA_INSTANCE *) instance;
+
+    if (my_instance->writer)
+    {
+        qla_writer_destroy(my_instance->writer);
+        my_instance->writer = NULL;
+    }
+}
+
 /**
  * Associate a new session with this instance of the filter.
  *
@@ -530,11 +958,20 @@ newSession(MXS_FILTER *instance, MXS_SESSION *session)
 static void
 closeSession(MXS_FILTER *instance, MXS_FILTER_SESSION *session)
 {
+    QLA_INSTANCE *my_instance = (QLA_INSTANCE *) instance;
     QLA_SESSION *my_session = (QLA_SESSION *) session;
 
     if (my_session->active && my_session->fp)
     {
-        fclose(my_session->fp);
+        if (my_instance->writer)
+        {
+            // The writer may still have entries to write to the file.
+            qla_writer_close(my_instance->writer, my_session->fp);
+        }
+        else
+        {
+            fclose(my_session->fp);
+        }
     }
     clear(my_session->event_data);
 }
@@ -773,6 +1210,11 @@ diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb)
                my_instance->separator);
     dcb_printf(dcb, "\t\tNewline replacement     %s\n",
                my_instance->query_newline);
+    if (my_instance->writer)
+    {
+        dcb_printf(dcb, "\t\tDropped log entries     %lu\n",
+                   atomic_load_uint64(&my_instance->writer->dropped));
+    }
 }
 
 /**
@@ -818,6 +1260,13 @@ static json_t* diagnostic_json(const MXS_FILTER *instance, const MXS_FILTER_SESS
     }
     json_object_set_new(rval, PARAM_SEPARATOR, json_string(my_instance->separator));
     json_object_set_new(rval, PARAM_NEWLINE, json_string(my_instance->query_newline));
+    json_object_set_new(rval, PARAM_ASYNC, json_boolean(my_instance->writer != NULL));
+
+    if (my_instance->writer)
+    {
+        json_object_set_new(rval, "dropped_entries",
+                            json_integer(atomic_load_uint64(&my_instance->writer->dropped)));
+    }
 
     return rval;
 }
@@ -868,6 +1317,12 @@ static FILE* open_log_file(QLA_INSTANCE *instance, uint32_t data_flags, const ch
         }
     }
 
+    if (fp && instance->writer)
+    {
+        // The file is written in large batches by the writer thread.
+        setvbuf(fp, NULL, _IOFBF, QLA_WRITER_FILE_BUFFER_SIZE);
+    }
+
     if (fp && !file_existed && data_flags != 0)
     {
         // Print a header.
@@ -1048,6 +1503,13 @@ static int write_log_entry(FILE *logfile, QLA_INSTANCE *instance, QLA_SESSION *s
     }
     output << "\n";
 
+    if (instance->writer)
+    {
+        // A dropped entry is counted by the writer, it is not a write error.
+        std::string entry = output.str();
+        return qla_writer_append(instance->writer, logfile, entry) ? entry.length() : 0;
+    }
+
     // Finally, write the log event.
     int written = fprintf(logfile, "%s", output.str().c_str());
 
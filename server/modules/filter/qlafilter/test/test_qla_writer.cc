@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "../qlafilter.cc"
+#include <iostream>
+
+using std::cout;
+using std::endl;
+using std::string;
+
+namespace
+{
+
+/**
+ * Create a writer with one buffer and no writer thread, so that the buffer
+ * is only written when the test calls qla_writer_write.
+ *
+ * @param size The size of the buffer
+ *
+ * @return The writer
+ */
+QLA_WRITER* create_writer(uint64_t size)
+{
+    QLA_WRITER* writer = new QLA_WRITER;
+    writer->size = size;
+    writer->buffers = new QLA_BUFFER[1];
+    writer->buffers[0].data = (char*)MXS_MALLOC(size);
+    writer->n_buffers = 1;
+
+    return writer;
+}
+
+/**
+ * Write the buffered entries and return what was written.
+ */
+string write(QLA_WRITER* writer, FILE* fp)
+{
+    qla_writer_write(writer);
+    fflush(fp);
+    rewind(fp);
+
+    string rval;
+    char buf[256];
+    size_t n;
+
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    {
+        rval.append(buf, n);
+    }
+
+    rewind(fp);
+    ftruncate(fileno(fp), 0);
+
+    return rval;
+}
+
+int expect(bool value, const char* what)
+{
+    if (!value)
+    {
+        cout << "ERROR: " << what << endl;
+    }
+
+    return value ? 0 : 1;
+}
+
+int test_overflow()
+{
+    int rval = 0;
+    const string entry = "0123456789\n";
+    const uint64_t entry_size = sizeof(QLA_RECORD) + entry.length();
+
+    // Room for two entries, but not for three.
+    QLA_WRITER* writer = create_writer(2 * entry_size + entry_size / 2);
+    QLA_BUFFER* buffer = &writer->buffers[0];
+    FILE* fp = tmpfile();
+
+    rval += expect(qla_buffer_append(writer, buffer, fp, entry), "First entry was not appended");
+    rval += expect(qla_buffer_append(writer, buffer, fp, entry), "Second entry was not appended");
+    rval += expect(!qla_buffer_append(writer, buffer, fp, entry), "Third entry was not dropped");
+    rval += expect(writer->dropped == 1, "Dropped entry was not counted");
+    rval += expect(write(writer, fp) == entry + entry, "Appended entries were not written");
+
+    // The buffer is empty again and the next entries wrap around its end.
+    rval += expect(qla_buffer_append(writer, buffer, fp, entry), "Entry after write was not appended");
+    rval += expect(qla_buffer_append(writer, buffer, fp, entry), "Wrapping entry was not appended");
+    rval += expect(writer->dropped == 1, "Appended entries were counted as dropped");
+    rval += expect(write(writer, fp) == entry + entry, "Wrapped entries were not written intact");
+
+    string large(writer->size, 'x');
+    rval += expect(!qla_buffer_append(writer, buffer, fp, large), "Entry larger than the buffer was not dropped");
+    rval += expect(writer->dropped == 2, "Entry larger than the buffer was not counted");
+    rval += expect(write(writer, fp).empty(), "Dropped entry was written");
+
+    fclose(fp);
+    qla_writer_destroy(writer);
+
+    return rval;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    int rval = 0;
+
+    rval += test_overflow();
+
+    return rval;
+}
@@ -59,7 +59,7 @@ bool recursive_tee_usage(std::set<std::string>& services, SERVICE* service)
     return false;
 }
 
-TeeSession::TeeSession(MXS_SESSION* session, LocalClient* client,
+TeeSession::TeeSession(MXS_SESSION* session, InternalClient* client,
                        pcre2_code* match, pcre2_match_data* md_match,
                        pcre2_code* exclude, pcre2_match_data* md_exclude):
     mxs::FilterSession(session),
@@ -82,7 +82,7 @@ TeeSession* TeeSession::create(Tee* my_instance, MXS_SESSION* session)
         return NULL;
     }
 
-    LocalClient* client = NULL;
+    InternalClient* client = NULL;
     pcre2_code* match = NULL;
     pcre2_code* exclude = NULL;
     pcre2_match_data* md_match = NULL;
@@ -102,13 +102,15 @@ TeeSession* TeeSession::create(Tee* my_instance, MXS_SESSION* session)
             return NULL;
         }
 
-        if ((client = LocalClient::create((MYSQL_session*)session->client_dcb->data,
-                                          (MySQLProtocol*)session->client_dcb->protocol,
-                                          my_instance->get_service())) == NULL)
+        if ((client = InternalClient::create((MYSQL_session*)session->client_dcb->data,
+                                             (MySQLProtocol*)session->client_dcb->protocol,
+                                             session->client_dcb,
+                                             my_instance->get_service())) == NULL)
         {
-            MXS_ERROR("Failed to create local client connection to '%s'%s",
-                      my_instance->get_service()->name,
-                      my_instance->get_service()->ports ? "" : ": Service has no network listeners");
+            pcre2_match_data_free(md_match);
+            pcre2_match_data_free(md_exclude);
+            MXS_ERROR("Failed to create internal client session for '%s'",
+                      my_instance->get_service()->name);
             return NULL;
         }
     }
@@ -136,6 +138,9 @@ TeeSession::~TeeSession()
 
 void TeeSession::close()
 {
+    /** Close the other session together with the client session */
+    delete m_client;
+    m_client = NULL;
 }
 
 int TeeSession::routeQuery(GWBUF* queue)
@@ -37,12 +37,12 @@ public:
     json_t* diagnostics_json() const;
 
 private:
-    TeeSession(MXS_SESSION* session, LocalClient* client,
+    TeeSession(MXS_SESSION* session, InternalClient* client,
                pcre2_code* match, pcre2_match_data* md_match,
                pcre2_code* exclude, pcre2_match_data* md_exclude);
     bool query_matches(GWBUF* buffer);
 
-    LocalClient*      m_client;  /**< The client connection to the local service */
+    InternalClient*   m_client;  /**< The client of the session on the other service */
     pcre2_code*       m_match;
     pcre2_match_data* m_md_match;
     pcre2_code*       m_exclude;
@@ -12,6 +12,9 @@
  */
 
 #include <maxscale/protocol/mariadb_client.hh>
+#include <maxscale/alloc.h>
+#include <maxscale/dcb.h>
+#include <maxscale/session.h>
 #include <maxscale/utils.h>
 
 // TODO: Find a way to cleanly expose this
@@ -289,3 +292,146 @@ LocalClient* LocalClient::create(MYSQL_session* session, MySQLProtocol* proto, S
 {
     return create(session, proto, server->name, server->port);
 }
+
+InternalClient::InternalClient(DCB* dcb, MXS_SESSION* session):
+    m_dcb(dcb),
+    m_session(session)
+{
+}
+
+InternalClient::~InternalClient()
+{
+    if (m_dcb->n_close == 0)
+    {
+        dcb_close(m_dcb);
+    }
+
+    /** The DCB is freed together with the session */
+    session_put_ref(m_session);
+}
+
+InternalClient* InternalClient::create(MYSQL_session* session, MySQLProtocol* proto,
+                                       DCB* client, SERVICE* service)
+{
+    InternalClient* rval = NULL;
+    DCB* dcb = dcb_alloc(DCB_ROLE_INTERNAL, NULL);
+
+    if (dcb == NULL)
+    {
+        return NULL;
+    }
+
+    /** Everything assigned to the DCB is freed when the DCB is closed */
+    MYSQL_session* data = (MYSQL_session*)MXS_MALLOC(sizeof(MYSQL_session));
+    dcb->data = data;
+    dcb->authfunc.free = InternalClient::free_data;
+    dcb->protocol = mysql_protocol_init(dcb, DCBFD_CLOSED);
+    dcb->remote = client->remote ? MXS_STRDUP(client->remote) : NULL;
+    dcb->user = client->user ? MXS_STRDUP(client->user) : NULL;
+
+    if (data && dcb->protocol &&
+        (dcb->remote || !client->remote) &&
+        (dcb->user || !client->user))
+    {
+        *data = *session;
+        /** The token is only needed when authenticating the client */
+        data->auth_token = NULL;
+        data->auth_token_len = 0;
+
+        MySQLProtocol* protocol = (MySQLProtocol*)dcb->protocol;
+        protocol->client_capabilities = proto->client_capabilities;
+        protocol->extra_capabilities = proto->extra_capabilities;
+        protocol->charset = proto->charset;
+        protocol->protocol_auth_state = MXS_AUTH_STATE_COMPLETE;
+
+        dcb->func.write = InternalClient::write;
+        dcb->func.close = InternalClient::close;
+        dcb->func.hangup = InternalClient::hangup;
+        dcb->func.error = InternalClient::hangup;
+        dcb->service = service;
+        /** There is no file descriptor, but the DCB is in use */
+        dcb->state = DCB_STATE_POLLING;
+
+        MXS_SESSION* ses = session_alloc_internal(service, dcb);
+
+        if (ses)
+        {
+            rval = new (std::nothrow) InternalClient(dcb, ses);
+
+            if (rval)
+            {
+                session_get_ref(ses);
+            }
+        }
+    }
+
+    if (rval == NULL)
+    {
+        dcb_close(dcb);
+    }
+
+    return rval;
+}
+
+bool InternalClient::queue_query(GWBUF* buffer)
+{
+    bool rval = false;
+
+    if (m_dcb->n_close == 0 && m_session->state == SESSION_STATE_ROUTER_READY)
+    {
+        /**
+         * The modules of the service may modify the query in place, so it
+         * must not share its data with the buffer that the caller routes
+         * further. The copy is handed to the session as such and is not
+         * copied again.
+         */
+        GWBUF* my_buf = gwbuf_deep_clone(buffer);
+
+        if (my_buf)
+        {
+            MySQLProtocol* proto = (MySQLProtocol*)m_dcb->protocol;
+            proto->current_command = (mxs_mysql_cmd_t)mxs_mysql_get_command(my_buf);
+            rval = MXS_SESSION_ROUTE_QUERY(m_session, my_buf);
+        }
+    }
+
+    return rval;
+}
+
+int32_t InternalClient::write(DCB* dcb, GWBUF* buffer)
+{
+    /** Responses are ignored */
+    gwbuf_free(buffer);
+    return 1;
+}
+
+int32_t InternalClient::close(DCB* dcb)
+{
+    mysql_protocol_done(dcb);
+
+    MXS_SESSION* session = dcb->session;
+
+    if (session &&
+        session->state != SESSION_STATE_TO_BE_FREED &&
+        session->state != SESSION_STATE_DUMMY)
+    {
+        session_close(session);
+    }
+
+    return 1;
+}
+
+int32_t InternalClient::hangup(DCB* dcb)
+{
+    if (dcb->n_close == 0)
+    {
+        dcb_close(dcb);
+    }
+
+    return 1;
+}
+
+void InternalClient::free_data(DCB* dcb)
+{
+    MXS_FREE(dcb->data);
+}
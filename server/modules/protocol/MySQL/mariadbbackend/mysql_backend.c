@@ -688,6 +688,40 @@ static inline bool collecting_resultset(MySQLProtocol *proto, uint64_t capabilit
            proto->collect_result;
 }
 
+/**
+ * Check whether the complete response to a text protocol query has been read.
+ *
+ * The response is tracked incrementally, so that only the data that has
+ * arrived since the previous call is processed. Without that, collecting a
+ * large result set that arrives in many parts would be quadratic.
+ *
+ * @param proto  The backend protocol
+ * @param buffer All data collected so far
+ *
+ * @return True if the complete response is in @c buffer
+ */
+static bool complete_text_result(MySQLProtocol *proto, GWBUF *buffer)
+{
+    MXS_REPLY_TRACKER *tracker = &proto->reply_tracker;
+
+    if (tracker->n_bytes == 0)
+    {
+        modutil_reply_tracker_init(tracker, proto->current_command);
+    }
+
+    modutil_reply_tracker_consume(tracker, buffer, tracker->n_bytes);
+
+    bool rval = modutil_reply_tracker_is_complete(tracker);
+
+    if (rval)
+    {
+        /** The tracker is initialized again for the next response */
+        tracker->n_bytes = 0;
+    }
+
+    return rval;
+}
+
 /**
  * Helpers for checking OK and ERR packets specific to COM_CHANGE_USER
  */
@@ -787,6 +821,16 @@ gw_read_and_write(DCB *dcb)
         proto->collect_result ||
         proto->ignore_replies != 0)
     {
+        if (collecting_resultset(proto, capabilities) &&
+            expecting_text_result(proto) &&
+            !complete_text_result(proto, read_buffer))
+        {
+            /** The data is split into packets and made contiguous only once
+             * the complete result has been read */
+            dcb_readq_set(dcb, read_buffer);
+            return 0;
+        }
+
         GWBUF *tmp = modutil_get_complete_packets(&read_buffer);
         /* Put any residue into the read queue */
 
@@ -818,26 +862,9 @@ gw_read_and_write(DCB *dcb)
 
             if (collecting_resultset(proto, capabilities))
             {
-                if (expecting_text_result(proto))
-                {
-                    if (mxs_mysql_is_result_set(read_buffer))
-                    {
-                        bool more = false;
-                        int eof_cnt = modutil_count_signal_packets(read_buffer, 0, &more, NULL);
-                        if (more || eof_cnt % 2 != 0)
-                        {
-                            dcb_readq_prepend(dcb, read_buffer);
-                            return 0;
-                        }
-                    }
-
-                    // Collected the complete result
-                    proto->collect_result = false;
-                    result_collected = true;
-                }
-                else if (expecting_ps_response(proto) &&
-                         mxs_mysql_is_prep_stmt_ok(read_buffer) &&
-                         !complete_ps_response(read_buffer))
+                if (expecting_ps_response(proto) &&
+                    mxs_mysql_is_prep_stmt_ok(read_buffer) &&
+                    !complete_ps_response(read_buffer))
                 {
                     dcb_readq_prepend(dcb, read_buffer);
                     return 0;
@@ -751,8 +751,6 @@ gw_read_do_authentication(DCB *dcb, GWBUF *read_buffer, int nbytes_read)
             // For the time being only the sql_mode is stored in MXS_SESSION::client_protocol_data.
             session->client_protocol_data = QC_SQL_MODE_DEFAULT;
             protocol->protocol_auth_state = MXS_AUTH_STATE_COMPLETE;
-            ss_debug(bool check = ) mxs_worker_register_session(session);
-            ss_dassert(check);
             mxs_mysql_send_ok(dcb, next_sequence, 0, NULL);
 
             if (dcb->readq)
@@ -1450,8 +1448,6 @@ static int gw_client_close(DCB *dcb)
         {
             ss_dassert(target->state == SESSION_STATE_ROUTER_READY ||
                        target->state == SESSION_STATE_STOPPING);
-            ss_debug(bool removed = ) mxs_worker_deregister_session(target->ses_id);
-            ss_dassert(removed);
             session_close(target);
         }
     }
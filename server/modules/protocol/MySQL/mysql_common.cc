@@ -22,7 +22,6 @@
 #include <map>
 
 #include <maxscale/alloc.h>
-#include <maxscale/hk_heartbeat.h>
 #include <maxscale/log_manager.h>
 #include <maxscale/modutil.h>
 #include <maxscale/mysql_utils.h>
@@ -862,7 +861,7 @@ bool read_complete_packet(DCB *dcb, GWBUF **readbuf)
     if (dcb_read(dcb, &localbuf, 0) >= 0)
     {
         rval = true;
-        dcb->last_read = hkheartbeat;
+        dcb->last_read = mxs_worker_timer_now();
         GWBUF *packets = modutil_get_complete_packets(&localbuf);
 
         if (packets)
@@ -1707,9 +1706,12 @@ void mxs_mysql_execute_kill(MXS_SESSION* issuer, uint64_t target_id, kill_type_t
     std::stringstream ss;
     ss << "KILL " << hard << query;
 
-    for (int i = 0; i < config_threadcount(); i++)
+    // The connections of a session are all handled by the worker of the session.
+    int worker_id = mxs_worker_find_session_owner(target_id);
+
+    if (worker_id != -1)
     {
-        MXS_WORKER* worker = mxs_worker_get(i);
+        MXS_WORKER* worker = mxs_worker_get(worker_id);
         ss_dassert(worker);
         mxs_worker_post_message(worker, MXS_WORKER_MSG_CALL, (intptr_t)worker_func,
                                 (intptr_t)new ConnKillInfo(target_id, ss.str(), issuer));
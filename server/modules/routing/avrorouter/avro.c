@@ -272,6 +272,7 @@ MXS_MODULE* MXS_CREATE_MODULE()
             {"group_trx", MXS_MODULE_PARAM_COUNT, "1"},
             {"start_index", MXS_MODULE_PARAM_COUNT, "1"},
             {"block_size", MXS_MODULE_PARAM_SIZE, "0"},
+            {"block_cache_size", MXS_MODULE_PARAM_SIZE, "10Mi"},
             {"codec", MXS_MODULE_PARAM_ENUM, "null", MXS_MODULE_OPT_ENUM_UNIQUE, codec_values},
             {"match", MXS_MODULE_PARAM_REGEX},
             {"exclude", MXS_MODULE_PARAM_REGEX},
@@ -524,6 +525,15 @@ createInstance(SERVICE *service, char **options)
     inst->codec = config_get_enum(params, "codec", codec_values);
     int first_file = config_get_integer(params, "start_index");
     inst->block_size = config_get_size(params, "block_size");
+
+    uint64_t block_cache_size = config_get_size(params, "block_cache_size");
+
+    if (block_cache_size && (inst->block_cache = avro_block_cache_alloc(block_cache_size)) == NULL)
+    {
+        MXS_WARNING("Failed to allocate the block cache, JSON encoded data blocks "
+                    "will not be shared between clients.");
+    }
+
     inst->match = match;
     inst->exclude = exclude;
     inst->md_match = md_match;
@@ -711,6 +721,7 @@ createInstance(SERVICE *service, char **options)
         hashtable_free(inst->table_maps);
         hashtable_free(inst->open_tables);
         hashtable_free(inst->created_tables);
+        avro_block_cache_free(inst->block_cache);
         MXS_FREE(inst->avrodir);
         MXS_FREE(inst->binlogdir);
         MXS_FREE(inst->fileroot);
@@ -969,6 +980,15 @@ diagnostics(MXS_ROUTER *router, DCB *dcb)
     dcb_printf(dcb, "\tNumber of AVRO clients:              %u\n",
                router_inst->stats.n_clients);
 
+    if (router_inst->block_cache)
+    {
+        uint64_t size, hits, misses;
+        avro_block_cache_get_stats(router_inst->block_cache, &size, &hits, &misses);
+        dcb_printf(dcb, "\tBlock cache size:                    %lu\n", size);
+        dcb_printf(dcb, "\tBlock cache hits:                    %lu\n", hits);
+        dcb_printf(dcb, "\tBlock cache misses:                  %lu\n", misses);
+    }
+
     if (router_inst->clients)
     {
         dcb_printf(dcb, "\tClients:\n");
@@ -1046,6 +1066,18 @@ static json_t* diagnostics_json(const MXS_ROUTER *router)
     json_object_set_new(rval, "gtid_event_number", json_integer(router_inst->gtid.event_num));
     json_object_set_new(rval, "clients", json_integer(router_inst->stats.n_clients));
 
+    if (router_inst->block_cache)
+    {
+        uint64_t size, hits, misses;
+        avro_block_cache_get_stats(router_inst->block_cache, &size, &hits, &misses);
+
+        json_t* cache = json_object();
+        json_object_set_new(cache, "size", json_integer(size));
+        json_object_set_new(cache, "hits", json_integer(hits));
+        json_object_set_new(cache, "misses", json_integer(misses));
+        json_object_set_new(rval, "block_cache", cache);
+    }
+
     if (router_inst->clients)
     {
         json_t* arr = json_array();
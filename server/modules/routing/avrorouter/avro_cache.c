@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file avro_cache.c - Cache of JSON encoded Avro data blocks
+ *
+ * Clients that stream the same Avro file in JSON format all convert the same
+ * data blocks into the same JSON. The first client that converts a complete
+ * data block stores the result in a cache that is shared by all clients of
+ * the router instance. The other clients send a reference to the stored JSON
+ * without decoding the records again.
+ *
+ * The data blocks of an Avro file do not change once they have been written
+ * so the cached blocks never need to be invalidated. When the cache is full,
+ * the least recently used blocks are removed from it.
+ */
+
+#include "avrorouter.h"
+
+#include <maxscale/alloc.h>
+#include <maxscale/debug.h>
+#include <maxscale/hashtable.h>
+
+/** The number of buckets in the hashtable of cached blocks */
+#define AVRO_BLOCK_CACHE_BUCKETS 1000
+
+typedef struct avro_block
+{
+    char               *filename; /*< The Avro file the block is in */
+    long               position;  /*< Offset of the block in the file */
+    uint64_t           records;   /*< Number of records in the block */
+    uint64_t           size;      /*< Size of the block data */
+    GWBUF              *json;     /*< The records as newline separated JSON */
+    gtid_pos_t         gtid;      /*< GTID of the last record in the block */
+    struct avro_block  *newer;    /*< The block that was used after this one */
+    struct avro_block  *older;    /*< The block that was used before this one */
+} AVRO_BLOCK;
+
+struct avro_block_cache
+{
+    SPINLOCK   lock;      /*< Protects the cache */
+    HASHTABLE  *blocks;   /*< The cached blocks */
+    AVRO_BLOCK *newest;   /*< The most recently used block */
+    AVRO_BLOCK *oldest;   /*< The least recently used block */
+    uint64_t   max_size;  /*< Maximum size of the cached JSON */
+    uint64_t   size;      /*< Current size of the cached JSON */
+    uint64_t   hits;      /*< Number of blocks found in the cache */
+    uint64_t   misses;    /*< Number of blocks not found in the cache */
+};
+
+static int block_hash(const void *data)
+{
+    const AVRO_BLOCK *block = (const AVRO_BLOCK*)data;
+    return hashtable_item_strhash(block->filename) + (int)block->position;
+}
+
+static int block_cmp(const void *a, const void *b)
+{
+    const AVRO_BLOCK *lhs = (const AVRO_BLOCK*)a;
+    const AVRO_BLOCK *rhs = (const AVRO_BLOCK*)b;
+
+    return lhs->position != rhs->position ? 1 : strcmp(lhs->filename, rhs->filename);
+}
+
+static void block_unlink(AVRO_BLOCK_CACHE *cache, AVRO_BLOCK *block)
+{
+    if (block->newer)
+    {
+        block->newer->older = block->older;
+    }
+    else
+    {
+        cache->newest = block->older;
+    }
+
+    if (block->older)
+    {
+        block->older->newer = block->newer;
+    }
+    else
+    {
+        cache->oldest = block->newer;
+    }
+
+    block->newer = NULL;
+    block->older = NULL;
+}
+
+static void block_link(AVRO_BLOCK_CACHE *cache, AVRO_BLOCK *block)
+{
+    block->older = cache->newest;
+    block->newer = NULL;
+
+    if (cache->newest)
+    {
+        cache->newest->newer = block;
+    }
+    else
+    {
+        cache->oldest = block;
+    }
+
+    cache->newest = block;
+}
+
+static void block_free(AVRO_BLOCK *block)
+{
+    gwbuf_free(block->json);
+    MXS_FREE(block->filename);
+    MXS_FREE(block);
+}
+
+/**
+ * Remove the least recently used block from the cache. The caller must hold
+ * the lock of the cache.
+ *
+ * @param cache Cache to remove the block from
+ */
+static void block_cache_evict(AVRO_BLOCK_CACHE *cache)
+{
+    AVRO_BLOCK *block = cache->oldest;
+    ss_dassert(block);
+
+    block_unlink(cache, block);
+    hashtable_delete(cache->blocks, block);
+    cache->size -= gwbuf_length(block->json);
+    block_free(block);
+}
+
+AVRO_BLOCK_CACHE* avro_block_cache_alloc(uint64_t max_size)
+{
+    AVRO_BLOCK_CACHE *cache = MXS_CALLOC(1, sizeof(AVRO_BLOCK_CACHE));
+
+    if (cache)
+    {
+        if ((cache->blocks = hashtable_alloc(AVRO_BLOCK_CACHE_BUCKETS, block_hash, block_cmp)))
+        {
+            spinlock_init(&cache->lock);
+            cache->max_size = max_size;
+        }
+        else
+        {
+            MXS_FREE(cache);
+            cache = NULL;
+        }
+    }
+
+    return cache;
+}
+
+void avro_block_cache_free(AVRO_BLOCK_CACHE *cache)
+{
+    if (cache)
+    {
+        while (cache->oldest)
+        {
+            block_cache_evict(cache);
+        }
+
+        hashtable_free(cache->blocks);
+        MXS_FREE(cache);
+    }
+}
+
+GWBUF* avro_block_cache_get(AVRO_BLOCK_CACHE *cache, MAXAVRO_FILE *file, gtid_pos_t *gtid)
+{
+    AVRO_BLOCK key;
+    key.filename = file->filename;
+    key.position = file->block_start_pos;
+    GWBUF *rval = NULL;
+
+    spinlock_acquire(&cache->lock);
+    AVRO_BLOCK *block = hashtable_fetch(cache->blocks, &key);
+
+    /** A file that is created again after a restart of the conversion can
+     * have a different block at the same position */
+    if (block && block->records == file->records_in_block && block->size == file->buffer_size &&
+        (rval = gwbuf_clone(block->json)))
+    {
+        block_unlink(cache, block);
+        block_link(cache, block);
+        gtid->domain = block->gtid.domain;
+        gtid->server_id = block->gtid.server_id;
+        gtid->seq = block->gtid.seq;
+        cache->hits++;
+    }
+    else
+    {
+        cache->misses++;
+    }
+
+    spinlock_release(&cache->lock);
+
+    return rval;
+}
+
+void avro_block_cache_put(AVRO_BLOCK_CACHE *cache, MAXAVRO_FILE *file, GWBUF *json,
+                          const gtid_pos_t *gtid)
+{
+    uint64_t len = gwbuf_length(json);
+
+    if (len > cache->max_size)
+    {
+        return;
+    }
+
+    AVRO_BLOCK *block = MXS_CALLOC(1, sizeof(AVRO_BLOCK));
+    char *filename = MXS_STRDUP(file->filename);
+    GWBUF *clone = gwbuf_clone(json);
+
+    if (block == NULL || filename == NULL || clone == NULL)
+    {
+        MXS_FREE(block);
+        MXS_FREE(filename);
+        gwbuf_free(clone);
+        return;
+    }
+
+    block->filename = filename;
+    block->position = file->block_start_pos;
+    block->records = file->records_in_block;
+    block->size = file->buffer_size;
+    block->json = clone;
+    block->gtid = *gtid;
+
+    spinlock_acquire(&cache->lock);
+    AVRO_BLOCK *old = hashtable_fetch(cache->blocks, block);
+
+    if (old && old->records == block->records && old->size == block->size)
+    {
+        /** Another client stored the block first */
+        spinlock_release(&cache->lock);
+        block_free(block);
+        return;
+    }
+    else if (old)
+    {
+        block_unlink(cache, old);
+        hashtable_delete(cache->blocks, old);
+        cache->size -= gwbuf_length(old->json);
+        block_free(old);
+    }
+
+    while (cache->size + len > cache->max_size)
+    {
+        block_cache_evict(cache);
+    }
+
+    hashtable_add(cache->blocks, block, block);
+    block_link(cache, block);
+    cache->size += len;
+
+    spinlock_release(&cache->lock);
+}
+
+void avro_block_cache_get_stats(AVRO_BLOCK_CACHE *cache, uint64_t *size,
+                                uint64_t *hits, uint64_t *misses)
+{
+    spinlock_acquire(&cache->lock);
+    *size = cache->size;
+    *hits = cache->hits;
+    *misses = cache->misses;
+    spinlock_release(&cache->lock);
+}
@@ -29,6 +29,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
 #include <string.h>
 #include <maxscale/service.h>
 #include <maxscale/server.h>
@@ -577,26 +579,105 @@ static int send_row(DCB *dcb, json_t* row)
     return rc;
 }
 
-static void set_current_gtid(AVRO_CLIENT *client, json_t *row)
+static void set_current_gtid(gtid_pos_t *gtid, json_t *row)
 {
     json_t *obj = json_object_get(row, avro_sequence);
     ss_dassert(json_is_integer(obj));
-    client->gtid.seq = json_integer_value(obj);
+    gtid->seq = json_integer_value(obj);
 
     obj = json_object_get(row, avro_server_id);
     ss_dassert(json_is_integer(obj));
-    client->gtid.server_id = json_integer_value(obj);
+    gtid->server_id = json_integer_value(obj);
 
     obj = json_object_get(row, avro_domain);
     ss_dassert(json_is_integer(obj));
-    client->gtid.domain = json_integer_value(obj);
+    gtid->domain = json_integer_value(obj);
+}
+
+/** Memory where the JSON of a data block is gathered */
+typedef struct
+{
+    char   *data;
+    size_t size;
+    size_t used;
+} json_block_t;
+
+static int append_json(const char *buffer, size_t size, void *data)
+{
+    json_block_t *block = (json_block_t*)data;
+
+    if (block->used + size > block->size)
+    {
+        size_t new_size = block->size ? block->size : 4096;
+
+        while (block->used + size > new_size)
+        {
+            new_size *= 2;
+        }
+
+        char *new_data = MXS_REALLOC(block->data, new_size);
+
+        if (new_data == NULL)
+        {
+            return -1;
+        }
+
+        block->data = new_data;
+        block->size = new_size;
+    }
+
+    memcpy(block->data + block->used, buffer, size);
+    block->used += size;
+    return 0;
+}
+
+/**
+ * @brief Convert the unread records of the current data block into JSON
+ *
+ * All records are gathered into one buffer so that a data block needs only
+ * one write and the result can be stored in the block cache.
+ *
+ * @param file File to read from
+ * @param gtid The GTID of the last record is stored here
+ * @return Buffer with one JSON object per line or NULL if no records were read
+ */
+static GWBUF* read_json_block(MAXAVRO_FILE *file, gtid_pos_t *gtid)
+{
+    json_block_t block = {NULL, 0, 0};
+    GWBUF *rval = NULL;
+    json_t *row;
+
+    while ((row = maxavro_record_read_json(file)))
+    {
+        if (json_dump_callback(row, append_json, &block, JSON_PRESERVE_ORDER) == 0 &&
+            append_json("\n", 1, &block) == 0)
+        {
+            set_current_gtid(gtid, row);
+        }
+        else
+        {
+            MXS_ERROR("Failed to dump JSON value.");
+        }
+
+        json_decref(row);
+    }
+
+    if (block.used && (rval = gwbuf_alloc_and_load(block.used, block.data)) == NULL)
+    {
+        MXS_ERROR("Failed to allocate buffer for JSON data.");
+    }
+
+    MXS_FREE(block.data);
+    return rval;
 }
 
 /**
  * @brief Stream Avro data in JSON format
  *
- * @param file File to stream from
- * @param dcb DCB to stream to
+ * Complete data blocks are looked up from the block cache of the router
+ * before they are converted into JSON.
+ *
+ * @param client Client to stream to
  * @return True if more data is readable, false if all data was sent
  */
 static bool stream_json(AVRO_CLIENT *client)
@@ -604,52 +685,124 @@ static bool stream_json(AVRO_CLIENT *client)
     int bytes = 0;
     MAXAVRO_FILE *file = client->file_handle;
     DCB *dcb = client->dcb;
+    AVRO_BLOCK_CACHE *cache = client->router->block_cache;
+    int rc = 1;
 
     do
     {
-        json_t *row;
-        int rc = 1;
-        while (rc > 0 && (row = maxavro_record_read_json(file)))
+        if (!file->metadata_read && !maxavro_next_block(file))
         {
-            rc = send_row(dcb, row);
-            set_current_gtid(client, row);
-            json_decref(row);
+            break;
+        }
+
+        bool whole_block = file->records_read_from_block == 0;
+        GWBUF *json = NULL;
+
+        if (cache && whole_block &&
+            (json = avro_block_cache_get(cache, file, &client->gtid)))
+        {
+            maxavro_record_skip_block(file);
+        }
+        else if ((json = read_json_block(file, &client->gtid)) && cache && whole_block &&
+                 file->records_read_from_block == file->records_in_block)
+        {
+            avro_block_cache_put(cache, file, json, &client->gtid);
+        }
+
+        if (json)
+        {
+            rc = dcb->func.write(dcb, json);
         }
+
         bytes += file->buffer_size;
     }
-    while (maxavro_next_block(file) && bytes < AVRO_DATA_BURST_SIZE);
+    while (rc > 0 && maxavro_next_block(file) && bytes < AVRO_DATA_BURST_SIZE);
 
     return bytes >= AVRO_DATA_BURST_SIZE;
 }
 
 /**
- * @brief Stream Avro data in native Avro format
+ * @brief Send a range of the Avro file to the client
  *
- * @param file File to stream from
- * @param dcb DCB to stream to
- * @return True if streaming was successful, false if an error occurred
+ * The data is sent directly from the file to the socket with sendfile() for
+ * as long as the socket accepts it. This is only done when nothing is queued
+ * for the client, otherwise the data would be sent out of order. The data
+ * that was not sent is read into a buffer and written normally.
+ *
+ * @param dcb    DCB to send to
+ * @param file   File to send from
+ * @param offset Offset where the data starts
+ * @param len    Length of the data
+ * @return 1 on success, 0 on error
  */
-static bool stream_binary(AVRO_CLIENT *client)
+static int send_file_range(DCB *dcb, MAXAVRO_FILE *file, off_t offset, size_t len)
 {
-    GWBUF *buffer;
-    uint64_t bytes = 0;
+    int fd = fileno(file->file);
     int rc = 1;
-    MAXAVRO_FILE *file = client->file_handle;
-    DCB *dcb = client->dcb;
 
-    while (rc > 0 && bytes < AVRO_DATA_BURST_SIZE)
+    if (dcb->state == DCB_STATE_POLLING && dcb->ssl == NULL && dcb->writeq == NULL)
     {
-        bytes += file->buffer_size;
-        if ((buffer = maxavro_record_read_binary(file)))
+        while (len > 0)
+        {
+            ssize_t n = sendfile(dcb->fd, fd, &offset, len);
+
+            if (n > 0)
+            {
+                len -= n;
+            }
+            else if (n == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            else
+            {
+                /** The socket is full or sendfile() can't be used, the rest
+                 * is written after the queued data */
+                break;
+            }
+        }
+    }
+
+    if (len > 0)
+    {
+        GWBUF *buffer = gwbuf_alloc(len);
+
+        if (buffer && pread(fd, GWBUF_DATA(buffer), len, offset) == (ssize_t)len)
         {
             rc = dcb->func.write(dcb, buffer);
         }
         else
         {
+            MXS_ERROR("Failed to read %lu bytes from '%s': %d, %s", len,
+                      file->filename, errno, mxs_strerror(errno));
+            gwbuf_free(buffer);
             rc = 0;
         }
     }
 
+    return rc;
+}
+
+/**
+ * @brief Stream Avro data in native Avro format
+ *
+ * The complete data blocks are sent as they are stored in the file without
+ * copying them into buffers.
+ *
+ * @param client Client to stream to
+ * @return True if more data is readable, false if all data was sent
+ */
+static bool stream_binary(AVRO_CLIENT *client)
+{
+    MAXAVRO_FILE *file = client->file_handle;
+    long start;
+    long bytes = maxavro_record_pass_blocks(file, AVRO_DATA_BURST_SIZE, &start);
+
+    if (bytes > 0 && !send_file_range(client->dcb, file, start, bytes))
+    {
+        return false;
+    }
+
     return bytes >= AVRO_DATA_BURST_SIZE;
 }
 
@@ -257,6 +257,9 @@ typedef struct avro_client
 #endif
 } AVRO_CLIENT;
 
+/** Shared cache of JSON encoded Avro data blocks, defined in avro_cache.c */
+typedef struct avro_block_cache AVRO_BLOCK_CACHE;
+
 /**
  *  * The per instance data for the AVRO router.
  *   */
@@ -303,6 +306,7 @@ typedef struct avro_instance
                                  * a flush of all tables */
     uint64_t        block_size; /**< Avro datablock size */
     enum mxs_avro_codec_type codec; /**< Avro codec type, defaults to `null` */
+    AVRO_BLOCK_CACHE *block_cache; /**< JSON encoded data blocks, NULL if disabled */
 
     /** Match and exclude patterns for tables */
     pcre2_code*       match;
@@ -363,6 +367,15 @@ extern void avro_flush_all_tables(AVRO_INSTANCE *router, enum avrorouter_file_op
 
 bool table_matches(AVRO_INSTANCE* inst, const char* ident);
 
+/** Cache of JSON encoded data blocks */
+extern AVRO_BLOCK_CACHE* avro_block_cache_alloc(uint64_t max_size);
+extern void avro_block_cache_free(AVRO_BLOCK_CACHE *cache);
+extern GWBUF* avro_block_cache_get(AVRO_BLOCK_CACHE *cache, MAXAVRO_FILE *file, gtid_pos_t *gtid);
+extern void avro_block_cache_put(AVRO_BLOCK_CACHE *cache, MAXAVRO_FILE *file, GWBUF *json,
+                                 const gtid_pos_t *gtid);
+extern void avro_block_cache_get_stats(AVRO_BLOCK_CACHE *cache, uint64_t *size,
+                                       uint64_t *hits, uint64_t *misses);
+
 MXS_END_DECLS
 
 #endif
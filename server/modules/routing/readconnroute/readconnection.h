@@ -35,6 +35,15 @@
 
 MXS_BEGIN_DECLS
 
+/**
+ * How the backend server of a new session is chosen
+ */
+typedef enum
+{
+    LB_CONNECTIONS, /*< The server with the fewest connections */
+    LB_ADAPTIVE     /*< The server expected to respond the fastest */
+} readconn_lb_t;
+
 /**
  * The client session structure used within this router.
  */
@@ -50,6 +59,7 @@ typedef struct router_client_session
     DCB *backend_dcb; /*< DCB Connection to the backend      */
     DCB *client_dcb; /**< Client DCB */
     unsigned int bitvalue; /*< Session specific required value of server->status */
+    uint64_t query_start; /*< When the request waiting for a reply was routed, 0 if none */
     struct router_client_session *next;
 #if defined(SS_DEBUG)
     skygw_chk_t rses_chk_tail;
@@ -74,6 +84,7 @@ typedef struct router_instance
     SPINLOCK lock; /*< Spinlock for the instance data           */
     unsigned int bitmask; /*< Bitmask to apply to server->status       */
     unsigned int bitvalue; /*< Required value of server->status         */
+    readconn_lb_t load_balancing; /*< How the backend server is chosen   */
     ROUTER_STATS stats; /*< Statistics for this router               */
     struct router_instance
         *next;
@@ -26,6 +26,10 @@
  * When two servers have the same number of current connections the one with
  * the least number of connections since startup will be used.
  *
+ * With load_balancing=adaptive, the router instead measures the response time
+ * of each request and chooses the server with the least connections and
+ * requests in progress, weighted by the average response time of the server.
+ *
  * The router may also have options associated to it that will limit the
  * choice of backend server. Currently two options are supported, the "master"
  * option will cause the router to only connect to servers marked as masters
@@ -72,10 +76,12 @@
 
 #include "readconnection.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <time.h>
 #include <maxscale/alloc.h>
 #include <maxscale/server.h>
 #include <maxscale/router.h>
@@ -104,6 +110,19 @@ static bool rses_begin_locked_router_action(ROUTER_CLIENT_SES* rses);
 static void rses_end_locked_router_action(ROUTER_CLIENT_SES* rses);
 static SERVER_REF *get_root_master(SERVER_REF *servers);
 
+/**
+ * The time in milliseconds after which the response time average of a server
+ * that receives no requests is only half as significant as a current one
+ */
+#define RESPONSE_TIME_HALF_LIFE 10000.0
+
+static const MXS_ENUM_VALUE load_balancing_values[] =
+{
+    {"connections", LB_CONNECTIONS},
+    {"adaptive",    LB_ADAPTIVE},
+    {NULL}
+};
+
 /**
  * The module entry point routine. It is this routine that
  * must populate the structure that is referred to as the
@@ -145,6 +164,10 @@ MXS_MODULE* MXS_CREATE_MODULE()
         NULL, /* Thread init. */
         NULL, /* Thread finish. */
         {
+            {
+                "load_balancing", MXS_MODULE_PARAM_ENUM, "connections",
+                MXS_MODULE_OPT_NONE, load_balancing_values
+            },
             {MXS_END_MODULE_PARAMS}
         }
     };
@@ -182,6 +205,8 @@ createInstance(SERVICE *service, char **options)
     }
 
     inst->service = service;
+    inst->load_balancing = config_get_enum(service->svc_config_param, "load_balancing",
+                                           load_balancing_values);
     spinlock_init(&inst->lock);
 
     /*
@@ -253,51 +278,171 @@ createInstance(SERVICE *service, char **options)
 }
 
 /**
- * Associate a new session with this instance of the router.
+ * Get the current monotonic time
  *
- * @param instance  The router instance data
- * @param session   The session itself
- * @return Session specific data for this session
+ * @return The time in microseconds
  */
-static MXS_ROUTER_SESSION *
-newSession(MXS_ROUTER *instance, MXS_SESSION *session)
+static uint64_t time_in_us(void)
 {
-    ROUTER_INSTANCE *inst = (ROUTER_INSTANCE *) instance;
-    ROUTER_CLIENT_SES *client_rses;
-    SERVER_REF *candidate = NULL;
-    int i;
-    SERVER_REF *master_host = NULL;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
 
-    MXS_DEBUG("%lu [newSession] new router session with session "
-              "%p, and inst %p.",
-              pthread_self(),
-              session,
-              inst);
+/**
+ * How the weight of the response time average of a server decays
+ *
+ * @param server The server
+ * @param now    The current time in milliseconds
+ *
+ * @return The weight of the average, from 1 for a current average to 0 for
+ *         an old one
+ */
+static double response_time_weight(SERVER *server, uint64_t now)
+{
+    uint64_t sampled = atomic_load_uint64(&server->stats.response_time_sampled);
+    double age = now > sampled ? now - sampled : 0;
 
-    client_rses = (ROUTER_CLIENT_SES *) MXS_CALLOC(1, sizeof(ROUTER_CLIENT_SES));
+    return pow(0.5, age / RESPONSE_TIME_HALF_LIFE);
+}
 
-    if (client_rses == NULL)
+/**
+ * Calculate the mean response time of the servers of a service
+ *
+ * The averages of the servers are weighted by how current they are.
+ *
+ * @param inst The router instance
+ * @param now  The current time in milliseconds
+ *
+ * @return The mean response time in microseconds, 0 if no server has been measured
+ */
+static uint64_t mean_response_time(ROUTER_INSTANCE *inst, uint64_t now)
+{
+    double sum = 0;
+    double weights = 0;
+
+    for (SERVER_REF *ref = inst->service->dbref; ref; ref = ref->next)
     {
-        return NULL;
+        uint64_t average = atomic_load_uint64(&ref->server->stats.response_time);
+
+        if (SERVER_REF_IS_ACTIVE(ref) && SERVER_IS_RUNNING(ref->server) && average)
+        {
+            double weight = response_time_weight(ref->server, now);
+            sum += weight * average;
+            weights += weight;
+        }
     }
 
-#if defined(SS_DEBUG)
-    client_rses->rses_chk_top = CHK_NUM_ROUTER_SES;
-    client_rses->rses_chk_tail = CHK_NUM_ROUTER_SES;
-#endif
-    client_rses->client_dcb = session->client_dcb;
-    client_rses->bitvalue = inst->bitvalue;
+    return weights > 0 ? sum / weights : 0;
+}
 
-    /**
-     * Find the Master host from available servers
-     */
-    master_host = get_root_master(inst->service->dbref);
+/**
+ * Get the expected response time of a server
+ *
+ * A server that has not been measured is expected to respond in the mean
+ * time. The average of a server that receives no requests is not updated,
+ * so it approaches the mean as it gets older. A server that was once slow
+ * thus gets new sessions again and is measured anew.
+ *
+ * @param server The server
+ * @param mean   The mean response time of the servers
+ * @param now    The current time in milliseconds
+ *
+ * @return The expected response time in microseconds
+ */
+static uint64_t expected_response_time(SERVER *server, uint64_t mean, uint64_t now)
+{
+    uint64_t average = atomic_load_uint64(&server->stats.response_time);
+    uint64_t rval = mean;
 
-    /**
-     * Find a backend server to connect to. This is the extent of the
-     * load balancing algorithm we need to implement for this simple
-     * connection router.
-     */
+    if (average)
+    {
+        double weight = response_time_weight(server, now);
+        rval = weight * average + (1 - weight) * mean;
+    }
+
+    return rval;
+}
+
+/**
+ * Calculate the load of a server, scaled by the weight of the server
+ *
+ * By default the load is the number of connections created by this router.
+ * With adaptive load balancing, the connections and the requests in
+ * progress are weighted by the expected response time of the server, so
+ * that a server that responds slowly receives fewer sessions.
+ *
+ * @param inst  The router instance
+ * @param ref   The server reference, its weight must not be zero
+ * @param mean  The mean response time of the servers
+ * @param now   The current time in milliseconds
+ *
+ * @return The load of the server if a new session is created to it
+ */
+static uint64_t server_load(ROUTER_INSTANCE *inst, SERVER_REF *ref, uint64_t mean, uint64_t now)
+{
+    uint64_t load = ref->connections + 1;
+
+    if (inst->load_balancing == LB_ADAPTIVE)
+    {
+        load = (load + ref->server->stats.n_current_ops) *
+               (expected_response_time(ref->server, mean, now) + 1);
+    }
+
+    return load * 1000 / ref->weight;
+}
+
+/**
+ * Check if the server replies to a command
+ *
+ * @param command The command
+ *
+ * @return True if the server sends a reply
+ */
+static inline bool command_creates_reply(mxs_mysql_cmd_t command)
+{
+    return command != MXS_COM_QUIT &&
+           command != MXS_COM_STMT_SEND_LONG_DATA &&
+           command != MXS_COM_STMT_CLOSE;
+}
+
+/**
+ * Stop measuring the response time of the request waiting for a reply
+ *
+ * @param router_cli_ses The router session
+ * @param replied        True if the server replied to the request
+ */
+static void end_request(ROUTER_CLIENT_SES *router_cli_ses, bool replied)
+{
+    if (router_cli_ses->query_start)
+    {
+        SERVER *server = router_cli_ses->backend->server;
+
+        if (replied)
+        {
+            server_add_response_time(server, time_in_us() - router_cli_ses->query_start);
+        }
+
+        atomic_add(&server->stats.n_current_ops, -1);
+        router_cli_ses->query_start = 0;
+    }
+}
+
+/**
+ * Find a backend server to connect to. This is the extent of the
+ * load balancing algorithm we need to implement for this simple
+ * connection router.
+ *
+ * @param inst        The router instance
+ * @param master_host The root master, NULL if there is none
+ *
+ * @return The server with the lowest load, or NULL if no server is suitable
+ */
+static SERVER_REF *get_candidate(ROUTER_INSTANCE *inst, SERVER_REF *master_host)
+{
+    SERVER_REF *candidate = NULL;
+    uint64_t now = time_in_us() / 1000;
+    uint64_t mean = inst->load_balancing == LB_ADAPTIVE ? mean_response_time(inst, now) : 0;
 
     /*
      * Loop over all the servers and find any that have fewer connections
@@ -319,7 +464,7 @@ newSession(MXS_ROUTER *instance, MXS_SESSION *session)
         }
         else
         {
-            MXS_DEBUG("%lu [newSession] Examine server in port %d with "
+            MXS_DEBUG("%lu [get_candidate] Examine server in port %d with "
                       "%d connections. Status is %s, "
                       "inst->bitvalue is %d",
                       pthread_self(),
@@ -372,14 +517,12 @@ newSession(MXS_ROUTER *instance, MXS_SESSION *session)
             {
                 candidate = ref->weight ? ref : candidate;
             }
-            else if (((ref->connections + 1) * 1000) / ref->weight <
-                     ((candidate->connections + 1) * 1000) / candidate->weight)
+            else if (server_load(inst, ref, mean, now) < server_load(inst, candidate, mean, now))
             {
                 /* This running server has fewer connections, set it as a new candidate */
                 candidate = ref;
             }
-            else if (((ref->connections + 1) * 1000) / ref->weight ==
-                     ((candidate->connections + 1) * 1000) / candidate->weight &&
+            else if (server_load(inst, ref, mean, now) == server_load(inst, candidate, mean, now) &&
                      ref->server->stats.n_connections < candidate->server->stats.n_connections)
             {
                 /* This running server has the same number of connections currently as the candidate
@@ -390,6 +533,55 @@ newSession(MXS_ROUTER *instance, MXS_SESSION *session)
         }
     }
 
+    return candidate;
+}
+
+/**
+ * Associate a new session with this instance of the router.
+ *
+ * @param instance  The router instance data
+ * @param session   The session itself
+ * @return Session specific data for this session
+ */
+static MXS_ROUTER_SESSION *
+newSession(MXS_ROUTER *instance, MXS_SESSION *session)
+{
+    ROUTER_INSTANCE *inst = (ROUTER_INSTANCE *) instance;
+    ROUTER_CLIENT_SES *client_rses;
+    SERVER_REF *candidate = NULL;
+    int i;
+    SERVER_REF *master_host = NULL;
+
+    MXS_DEBUG("%lu [newSession] new router session with session "
+              "%p, and inst %p.",
+              pthread_self(),
+              session,
+              inst);
+
+    client_rses = (ROUTER_CLIENT_SES *) MXS_CALLOC(1, sizeof(ROUTER_CLIENT_SES));
+
+    if (client_rses == NULL)
+    {
+        return NULL;
+    }
+
+#if defined(SS_DEBUG)
+    client_rses->rses_chk_top = CHK_NUM_ROUTER_SES;
+    client_rses->rses_chk_tail = CHK_NUM_ROUTER_SES;
+#endif
+    client_rses->client_dcb = session->client_dcb;
+    client_rses->bitvalue = inst->bitvalue;
+
+    /**
+     * Find the Master host from available servers
+     */
+    master_host = get_root_master(inst->service->dbref);
+
+    /**
+     * Find a backend server to connect to.
+     */
+    candidate = get_candidate(inst, master_host);
+
     /* If we haven't found a proper candidate yet but a master server is available, we'll pick that
      * with the assumption that it is "better" than a slave.
      */
@@ -500,6 +692,7 @@ closeSession(MXS_ROUTER *instance, MXS_ROUTER_SESSION *router_session)
         backend_dcb = router_cli_ses->backend_dcb;
         router_cli_ses->backend_dcb = NULL;
         router_cli_ses->rses_closed = true;
+        end_request(router_cli_ses, false);
         /** Unlock */
         rses_end_locked_router_action(router_cli_ses);
 
@@ -660,6 +853,14 @@ routeQuery(MXS_ROUTER *instance, MXS_ROUTER_SESSION *router_session, GWBUF *queu
         break;
     }
 
+    if (rc && inst->load_balancing == LB_ADAPTIVE &&
+        router_cli_ses->query_start == 0 && command_creates_reply(mysql_command))
+    {
+        /** The response time is measured until the server starts to reply */
+        router_cli_ses->query_start = time_in_us();
+        atomic_add(&router_cli_ses->backend->server->stats.n_current_ops, 1);
+    }
+
     MXS_INFO("Routed [%s] to '%s'%s%s",
              STRPACKETTYPE(mysql_command),
              backend_dcb->server->unique_name,
@@ -705,6 +906,21 @@ diagnostics(MXS_ROUTER *router, DCB *dcb)
                        ref->connections);
         }
     }
+
+    if (router_inst->load_balancing == LB_ADAPTIVE)
+    {
+        dcb_printf(dcb, "\tAdaptive load balancing based on response times.\n");
+        dcb_printf(dcb,
+                   "\t\tServer               Connections Operations Response time\n");
+        for (SERVER_REF *ref = router_inst->service->dbref; ref; ref = ref->next)
+        {
+            dcb_printf(dcb, "\t\t%-20s %-11d %-10d %lu us\n",
+                       ref->server->unique_name,
+                       ref->connections,
+                       ref->server->stats.n_current_ops,
+                       ref->server->stats.response_time);
+        }
+    }
 }
 
 /**
@@ -729,6 +945,26 @@ static json_t* diagnostics_json(const MXS_ROUTER *router)
         json_object_set_new(rval, "weightby", json_string(weightby));
     }
 
+    json_object_set_new(rval, "load_balancing",
+                        json_string(router_inst->load_balancing == LB_ADAPTIVE ?
+                                    "adaptive" : "connections"));
+
+    json_t* servers = json_array();
+
+    for (SERVER_REF *ref = router_inst->service->dbref; ref; ref = ref->next)
+    {
+        json_t* server = json_object();
+        json_object_set_new(server, "name", json_string(ref->server->unique_name));
+        json_object_set_new(server, "connections", json_integer(ref->connections));
+        json_object_set_new(server, "active_operations",
+                            json_integer(ref->server->stats.n_current_ops));
+        json_object_set_new(server, "average_response_time",
+                            json_integer(ref->server->stats.response_time));
+        json_array_append_new(servers, server);
+    }
+
+    json_object_set_new(rval, "servers", servers);
+
     return rval;
 }
 
@@ -746,6 +982,7 @@ static void
 clientReply(MXS_ROUTER *instance, MXS_ROUTER_SESSION *router_session, GWBUF *queue, DCB *backend_dcb)
 {
     ss_dassert(backend_dcb->session->client_dcb != NULL);
+    end_request((ROUTER_CLIENT_SES *) router_session, true);
     MXS_SESSION_ROUTE_REPLY(backend_dcb->session, queue);
 }
 
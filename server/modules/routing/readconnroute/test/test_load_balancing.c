@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "../readconnroute.c"
+
+#define N_SERVERS 3
+
+static SERVICE service;
+static ROUTER_INSTANCE inst;
+static SERVER servers[N_SERVERS];
+static SERVER_REF refs[N_SERVERS];
+
+/**
+ * Reset the servers to running slaves with no connections or measurements
+ *
+ * @param load_balancing The load balancing method to use
+ */
+static void setup(readconn_lb_t load_balancing)
+{
+    memset(&service, 0, sizeof(service));
+    memset(&inst, 0, sizeof(inst));
+    memset(servers, 0, sizeof(servers));
+    memset(refs, 0, sizeof(refs));
+
+    for (int i = 0; i < N_SERVERS; i++)
+    {
+        servers[i].port = 3000 + i;
+        servers[i].is_active = true;
+        servers[i].status = SERVER_RUNNING | SERVER_SLAVE;
+        refs[i].server = &servers[i];
+        refs[i].weight = 1000;
+        refs[i].active = true;
+        refs[i].next = i + 1 < N_SERVERS ? &refs[i + 1] : NULL;
+    }
+
+    service.dbref = &refs[0];
+    inst.service = &service;
+    inst.bitmask = SERVER_MASTER | SERVER_SLAVE;
+    inst.bitvalue = SERVER_SLAVE;
+    inst.load_balancing = load_balancing;
+}
+
+/**
+ * Set the measured response time of a server
+ *
+ * @param i        Index of the server
+ * @param response The response time in microseconds
+ * @param age      How long ago the response time was measured, in milliseconds
+ */
+static void measure(int i, uint64_t response, uint64_t age)
+{
+    servers[i].stats.response_time = response;
+    servers[i].stats.response_time_sampled = time_in_us() / 1000 - age;
+}
+
+static int expect(int expected, const char *what)
+{
+    SERVER_REF *candidate = get_candidate(&inst, NULL);
+    int rval = 0;
+
+    if (candidate != &refs[expected])
+    {
+        printf("%s: expected server %d, got %d\n", what, expected,
+               candidate ? (int)(candidate - refs) : -1);
+        rval = 1;
+    }
+
+    return rval;
+}
+
+static int test_connections()
+{
+    int rval = 0;
+
+    setup(LB_CONNECTIONS);
+    refs[0].connections = 3;
+    refs[1].connections = 1;
+    refs[2].connections = 2;
+    rval += expect(1, "Fewest connections");
+
+    measure(1, 100000, 0);
+    rval += expect(1, "Response time ignored without adaptive load balancing");
+
+    refs[1].weight = 250;
+    rval += expect(2, "Connections scaled by weight");
+
+    servers[2].status = SERVER_RUNNING | SERVER_MAINT;
+    rval += expect(0, "Server in maintenance skipped");
+
+    return rval;
+}
+
+static int test_unmeasured()
+{
+    int rval = 0;
+
+    setup(LB_ADAPTIVE);
+    refs[0].connections = 2;
+    refs[1].connections = 1;
+    refs[2].connections = 3;
+    rval += expect(1, "No measurements, fewest connections");
+
+    setup(LB_ADAPTIVE);
+    measure(0, 1000, 0);
+    measure(1, 1000, 0);
+    refs[2].connections = 5;
+    rval += expect(0, "Unmeasured server with more connections is not the cheapest");
+
+    refs[2].connections = 0;
+    refs[0].connections = 1;
+    refs[1].connections = 1;
+    rval += expect(2, "Unmeasured server is expected to respond in the mean time");
+
+    return rval;
+}
+
+static int test_aging()
+{
+    int rval = 0;
+
+    setup(LB_ADAPTIVE);
+    servers[2].is_active = false;
+    measure(0, 100000, 0);
+    measure(1, 1000, 0);
+    refs[1].connections = 3;
+    rval += expect(1, "Slow server loses");
+
+    measure(0, 100000, 10 * RESPONSE_TIME_HALF_LIFE);
+    rval += expect(0, "Server that was slow long ago is tried again");
+
+    measure(0, 100000, RESPONSE_TIME_HALF_LIFE / 10);
+    rval += expect(1, "Server that was slow recently still loses");
+
+    return rval;
+}
+
+int main(int argc, char **argv)
+{
+    int rval = 0;
+
+    rval += test_connections();
+    rval += test_unmeasured();
+    rval += test_aging();
+
+    return rval;
+}
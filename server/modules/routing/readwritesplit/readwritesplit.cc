@@ -31,6 +31,7 @@
 #include <maxscale/router.h>
 #include <maxscale/spinlock.h>
 #include <maxscale/mysql_utils.h>
+#include <maxscale/worker_timer.h>
 
 #include "rwsplit_internal.hh"
 #include "rwsplitsession.hh"
@@ -300,12 +301,16 @@ static bool reroute_stored_statement(RWSplitSession *rses, const SRWBackend& old
 
     if (!session_trx_is_active(rses->client_dcb->session))
     {
+        /** A read that had to wait for the latest write is retried on the master */
+        bool master_only = rses->wait_gtid == EXPECTING_WAIT_GTID_RESULT;
+        rses->wait_gtid = EXPECTING_NOTHING;
+
         /**
          * Only try to retry the read if autocommit is enabled and we are
          * outside of a transaction
          */
         for (SRWBackendList::iterator it = rses->backends.begin();
-             it != rses->backends.end(); it++)
+             it != rses->backends.end() && !master_only; it++)
         {
             SRWBackend& backend = *it;
 
@@ -374,7 +379,20 @@ static bool handle_error_new_connection(RWSplit *inst,
     bool route_stored = false;
     CHK_SESSION(ses);
 
-    if (backend->is_waiting_result())
+    if (backend->is_waiting_result() && myrses->wait_gtid == EXPECTING_GTID_POSITION &&
+        backend == myrses->current_master)
+    {
+        /** The client is not waiting for the result of the internal @@last_gtid
+         * query, the reads that follow will not wait for the write */
+        ss_dassert(myrses->expected_responses > 0);
+        myrses->expected_responses--;
+        myrses->wait_gtid = EXPECTING_NOTHING;
+        myrses->gtid_pos.clear();
+        gwbuf_free(myrses->gtid_response);
+        myrses->gtid_response = NULL;
+        route_stored = myrses->expected_responses == 0;
+    }
+    else if (backend->is_waiting_result())
     {
         ss_dassert(myrses->expected_responses > 0);
         myrses->expected_responses--;
@@ -396,6 +414,7 @@ static bool handle_error_new_connection(RWSplit *inst,
              * and decrement the expected response count.
              */
             gwbuf_free(stored);
+            myrses->wait_gtid = EXPECTING_NOTHING;
 
             if (backend->session_command_count() == 0)
             {
@@ -749,6 +768,22 @@ bool RWSplit::have_enough_servers() const
     return succp;
 }
 
+/**
+ * Called when the keepalive timer of a session expires. The timer expires
+ * twice per keepalive interval, so that a backend is pinged at most half an
+ * interval later than it should be.
+ *
+ * @param timer The keepalive timer of the session
+ */
+static void keepalive_timer_expired(MXS_WORKER_TIMER* timer)
+{
+    RWSplitSession* rses = static_cast<RWSplitSession*>(timer->data);
+    ss_dassert(!rses->rses_closed);
+
+    handle_connection_keepalive(rses->router, rses);
+    mxs_worker_timer_add(timer, rses->rses_config.connection_keepalive * 500);
+}
+
 RWSplitSession::RWSplitSession(RWSplit* instance, MXS_SESSION* session,
                                const SRWBackendList& backends,
                                const SRWBackend& master):
@@ -769,6 +804,12 @@ RWSplitSession::RWSplitSession(RWSplit* instance, MXS_SESSION* session,
     router(instance),
     sent_sescmd(0),
     recv_sescmd(0),
+    released(false),
+    locks(SESSION_LOCK_NONE),
+    gtid_needed(false),
+    wait_gtid(EXPECTING_NOTHING),
+    next_seq(0),
+    gtid_response(NULL),
     rses_chk_tail(CHK_NUM_ROUTER_SES)
 {
     if (rses_config.rw_max_slave_conn_percent)
@@ -778,6 +819,13 @@ RWSplitSession::RWSplitSession(RWSplit* instance, MXS_SESSION* session,
         n_conn = MXS_MAX(floor((double)rses_nbackends * pct), 1);
         rses_config.max_slave_connections = n_conn;
     }
+
+    mxs_worker_timer_init(&keepalive_timer, keepalive_timer_expired, this);
+
+    if (rses_config.connection_keepalive)
+    {
+        mxs_worker_timer_add(&keepalive_timer, rses_config.connection_keepalive * 500);
+    }
 }
 
 RWSplitSession* RWSplitSession::create(RWSplit* router, MXS_SESSION* session)
@@ -850,6 +898,28 @@ static MXS_ROUTER* createInstance(SERVICE *service, char **options)
         config.max_sescmd_history = 0;
     }
 
+    if (config.transaction_pooling)
+    {
+        if (config.disable_sescmd_history)
+        {
+            MXS_ERROR("Service '%s': 'transaction_pooling' requires the session command "
+                      "history, add 'disable_sescmd_history=false' to the configuration.",
+                      service->name);
+            return NULL;
+        }
+
+        for (SERVER_REF* ref = service->dbref; ref; ref = ref->next)
+        {
+            if (ref->server->persistpoolmax == 0)
+            {
+                MXS_WARNING("Service '%s': server '%s' has no persistent connection pool, "
+                            "connections to it are not released with 'transaction_pooling'. "
+                            "Configure 'persistpoolmax' for the server to enable it.",
+                            service->name, ref->server->unique_name);
+            }
+        }
+    }
+
     return (MXS_ROUTER*)new (std::nothrow) RWSplit(service, config);
 }
 
@@ -898,7 +968,10 @@ static void closeSession(MXS_ROUTER *instance, MXS_ROUTER_SESSION *router_sessio
     if (!router_cli_ses->rses_closed)
     {
         router_cli_ses->rses_closed = true;
+        mxs_worker_timer_cancel(&router_cli_ses->keepalive_timer);
         close_all_connections(router_cli_ses->backends);
+        gwbuf_free(router_cli_ses->gtid_response);
+        router_cli_ses->gtid_response = NULL;
 
         if (MXS_LOG_PRIORITY_IS_ENABLED(LOG_INFO) &&
             router_cli_ses->sescmd_list.size())
@@ -960,6 +1033,15 @@ static int routeQuery(MXS_ROUTER *instance, MXS_ROUTER_SESSION *router_session,
     {
         closed_session_reply(querybuf);
     }
+    else if (rses->released && mxs_mysql_get_command(querybuf) == MXS_COM_QUIT)
+    {
+        /** The connections are already in the pool, nothing needs to be done */
+        rval = 1;
+    }
+    else if (rses->released && !reacquire_connections(rses))
+    {
+        MXS_ERROR("Could not route query, no backend connections are available.");
+    }
     else
     {
         if (rses->query_queue == NULL &&
@@ -1041,6 +1123,12 @@ static void diagnostics(MXS_ROUTER *instance, DCB *dcb)
                router->config().max_sescmd_history);
     dcb_printf(dcb, "\tmaster_accept_reads:       %s\n",
                router->config().master_accept_reads ? "true" : "false");
+    dcb_printf(dcb, "\ttransaction_pooling:       %s\n",
+               router->config().transaction_pooling ? "true" : "false");
+    dcb_printf(dcb, "\tcausal_reads:              %s\n",
+               router->config().causal_reads ? "true" : "false");
+    dcb_printf(dcb, "\tcausal_reads_timeout:      %d\n",
+               router->config().causal_reads_timeout);
     dcb_printf(dcb, "\n");
 
     if (router->stats().n_queries > 0)
@@ -1063,6 +1151,14 @@ static void diagnostics(MXS_ROUTER *instance, DCB *dcb)
     dcb_printf(dcb, "\tNumber of queries forwarded to all:   	%" PRIu64 " (%.2f%%)\n",
                router->stats().n_all, all_pct);
 
+    if (router->config().transaction_pooling)
+    {
+        dcb_printf(dcb, "\tNumber of released idle connections:  	%" PRIu64 "\n",
+                   router->stats().n_released);
+        dcb_printf(dcb, "\tNumber of reacquired connections:     	%" PRIu64 "\n",
+                   router->stats().n_reacquired);
+    }
+
     if (*weightby)
     {
         dcb_printf(dcb, "\tConnection distribution based on %s "
@@ -1113,6 +1209,12 @@ static json_t* diagnostics_json(const MXS_ROUTER *instance)
                         json_integer(router->config().max_sescmd_history));
     json_object_set_new(rval, "master_accept_reads",
                         json_boolean(router->config().master_accept_reads));
+    json_object_set_new(rval, "transaction_pooling",
+                        json_boolean(router->config().transaction_pooling));
+    json_object_set_new(rval, "causal_reads",
+                        json_boolean(router->config().causal_reads));
+    json_object_set_new(rval, "causal_reads_timeout",
+                        json_integer(router->config().causal_reads_timeout));
 
 
     json_object_set_new(rval, "connections", json_integer(router->stats().n_sessions));
@@ -1122,6 +1224,12 @@ static json_t* diagnostics_json(const MXS_ROUTER *instance)
     json_object_set_new(rval, "route_slave", json_integer(router->stats().n_slave));
     json_object_set_new(rval, "route_all", json_integer(router->stats().n_all));
 
+    if (router->config().transaction_pooling)
+    {
+        json_object_set_new(rval, "released_connections", json_integer(router->stats().n_released));
+        json_object_set_new(rval, "reacquired_connections", json_integer(router->stats().n_reacquired));
+    }
+
     const char *weightby = serviceGetWeightingParameter(router->service());
 
     if (*weightby)
@@ -1226,6 +1334,40 @@ static void clientReply(MXS_ROUTER *instance,
         return;
     }
 
+    if (rses->wait_gtid == EXPECTING_GTID_POSITION && backend == rses->current_master)
+    {
+        /** The response to the internal @@last_gtid query is not sent to the client */
+        if (read_gtid_position(rses, backend, writebuf))
+        {
+            if (rses->expected_responses == 0 && rses->query_queue)
+            {
+                route_stored_query(rses);
+            }
+
+            if (rses->rses_config.transaction_pooling)
+            {
+                release_idle_connections(rses);
+            }
+        }
+        return;
+    }
+    else if (rses->wait_gtid == EXPECTING_WAIT_GTID_RESULT &&
+             backend->get_reply_state() == REPLY_STATE_START &&
+             backend->session_command_count() == 0)
+    {
+        if ((writebuf = discard_gtid_wait_result(rses, backend, writebuf)) == NULL)
+        {
+            /** Only the result of MASTER_GTID_WAIT was received or the read
+             * was retried on the master */
+            return;
+        }
+    }
+    else if (rses->wait_gtid == EXPECTING_RENUMBERED_REPLY)
+    {
+        /** The client must not see the gap left by the removed result */
+        renumber_gtid_wait_reply(rses, writebuf);
+    }
+
     if (session_have_stmt(backend_dcb->session))
     {
         /** Statement was successfully executed, free the stored statement */
@@ -1240,6 +1382,20 @@ static void clientReply(MXS_ROUTER *instance,
         ss_dassert(rses->expected_responses >= 0);
         ss_dassert(backend->get_reply_state() == REPLY_STATE_DONE);
         MXS_INFO("Reply complete, last reply from %s", backend->name());
+
+        if (rses->wait_gtid == EXPECTING_RENUMBERED_REPLY)
+        {
+            rses->wait_gtid = EXPECTING_NOTHING;
+        }
+
+        if (rses->gtid_needed && backend == rses->current_master &&
+            (!session_trx_is_active(backend_dcb->session) ||
+             session_trx_is_ending(backend_dcb->session)))
+        {
+            /** The write is committed, the reads that follow it must
+             * wait for its GTID */
+            send_gtid_query(rses);
+        }
     }
     else
     {
@@ -1271,7 +1427,11 @@ static void clientReply(MXS_ROUTER *instance,
 
     bool queue_routed = false;
 
-    if (rses->expected_responses == 0 && rses->query_queue)
+    /** Backends that are restoring the session state must finish it before
+     * the queued queries can be routed */
+    bool replaying = !writebuf && backend->session_command_count();
+
+    if (rses->expected_responses == 0 && rses->query_queue && !replaying)
     {
         queue_routed = true;
         route_stored_query(rses);
@@ -1294,6 +1454,11 @@ static void clientReply(MXS_ROUTER *instance,
             rses->expected_responses++;
         }
     }
+
+    if (rses->rses_config.transaction_pooling)
+    {
+        release_idle_connections(rses);
+    }
 }
 
 
@@ -1491,6 +1656,9 @@ MXS_MODULE *MXS_CREATE_MODULE()
             {"strict_sp_calls",  MXS_MODULE_PARAM_BOOL, "false"},
             {"master_accept_reads", MXS_MODULE_PARAM_BOOL, "false"},
             {"connection_keepalive", MXS_MODULE_PARAM_COUNT, "0"},
+            {"transaction_pooling", MXS_MODULE_PARAM_BOOL, "false"},
+            {"causal_reads", MXS_MODULE_PARAM_BOOL, "false"},
+            {"causal_reads_timeout", MXS_MODULE_PARAM_COUNT, "10"},
             {MXS_END_MODULE_PARAMS}
         }
     };
@@ -164,6 +164,9 @@ struct Config
         strict_sp_calls(config_get_bool(params, "strict_sp_calls")),
         retry_failed_reads(config_get_bool(params, "retry_failed_reads")),
         connection_keepalive(config_get_integer(params, "connection_keepalive")),
+        transaction_pooling(config_get_bool(params, "transaction_pooling")),
+        causal_reads(config_get_bool(params, "causal_reads")),
+        causal_reads_timeout(config_get_integer(params, "causal_reads_timeout")),
         max_slave_replication_lag(config_get_integer(params, "max_slave_replication_lag")),
         rw_max_slave_conn_percent(0),
         max_slave_connections(0)
@@ -183,6 +186,11 @@ struct Config
     bool              retry_failed_reads;        /**< Retry failed reads on other servers */
     int               connection_keepalive;      /**< Send pings to servers that have been idle
                                                   * for too long */
+    bool              transaction_pooling;       /**< Release idle connections into the
+                                                  * persistent connection pool */
+    bool              causal_reads;              /**< Make slaves wait for the latest write
+                                                  * before reading */
+    int               causal_reads_timeout;      /**< How long slaves wait for the write */
     int               max_slave_replication_lag; /**< Maximum replication lag */
     int               rw_max_slave_conn_percent; /**< Maximum percentage of slaves to use for
                                                   * each connection*/
@@ -202,7 +210,9 @@ public:
         n_queries(0),
         n_master(0),
         n_slave(0),
-        n_all(0)
+        n_all(0),
+        n_released(0),
+        n_reacquired(0)
     {
     }
 
@@ -211,6 +221,8 @@ public:
     uint64_t n_master;          /**< Number of stmts sent to master */
     uint64_t n_slave;           /**< Number of stmts sent to slave */
     uint64_t n_all;             /**< Number of stmts sent to all */
+    uint64_t n_released;        /**< Number of times idle connections were released */
+    uint64_t n_reacquired;      /**< Number of times released connections were reacquired */
 };
 
 /**
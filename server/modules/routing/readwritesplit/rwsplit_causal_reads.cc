@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "readwritesplit.hh"
+#include "rwsplit_internal.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include <maxscale/modutil.h>
+#include <maxscale/mysql_utils.h>
+
+/**
+ * Functions for causal reads
+ *
+ * After a write has been done on the master, the GTID of the write is read
+ * with an internal @@last_gtid query. Reads that are routed to a slave are
+ * then prefixed with a MASTER_GTID_WAIT call that makes the slave wait until
+ * it has replicated the write. If the slave does not catch up in time, the
+ * read is retried on the master.
+ */
+
+/** The query that reads the GTID of the latest write */
+static const char gtid_query[] = "SELECT @@last_gtid";
+
+/**
+ * The statement that is prefixed to reads. If the wait times out, the
+ * subquery returns more than one row and the statement fails, which prevents
+ * the execution of the actual read.
+ */
+static const char gtid_wait_stmt[] =
+    "SET @maxscale_secret_variable=(SELECT CASE WHEN MASTER_GTID_WAIT('%s', %d) = 0 "
+    "THEN 1 ELSE (SELECT 1 FROM INFORMATION_SCHEMA.ENGINES) END);";
+
+bool can_wait_for_gtid(RWSplitSession* rses, GWBUF* querybuf, uint8_t command)
+{
+    MySQLProtocol* proto = (MySQLProtocol*)rses->client_dcb->protocol;
+
+    /** The slave connections only accept multi-statements if the client does */
+    return command == MXS_COM_QUERY && !rses->large_query &&
+           (proto->client_capabilities & GW_MYSQL_CAPABILITIES_MULTI_STATEMENTS) &&
+           gwbuf_length(querybuf) < GW_MYSQL_MAX_PACKET_LEN / 2;
+}
+
+GWBUF* add_gtid_wait(const std::string& gtid, int timeout, GWBUF* querybuf)
+{
+    size_t prefix_len = snprintf(NULL, 0, gtid_wait_stmt, gtid.c_str(), timeout);
+    std::vector<char> prefix(prefix_len + 1);
+    snprintf(&prefix[0], prefix.size(), gtid_wait_stmt, gtid.c_str(), timeout);
+
+    size_t sql_len = gwbuf_length(querybuf) - MYSQL_HEADER_LEN - 1;
+    size_t payload_len = 1 + prefix_len + sql_len;
+    GWBUF* rval = gwbuf_alloc(MYSQL_HEADER_LEN + payload_len);
+
+    if (rval)
+    {
+        uint8_t* ptr = GWBUF_DATA(rval);
+        gw_mysql_set_byte3(ptr, payload_len);
+        ptr[3] = 0;
+        ptr[4] = MXS_COM_QUERY;
+        memcpy(ptr + MYSQL_HEADER_LEN + 1, &prefix[0], prefix_len);
+        gwbuf_copy_data(querybuf, MYSQL_HEADER_LEN + 1, sql_len,
+                        ptr + MYSQL_HEADER_LEN + 1 + prefix_len);
+    }
+
+    return rval;
+}
+
+bool send_gtid_query(RWSplitSession* rses)
+{
+    bool rval = false;
+    SRWBackend& master = rses->current_master;
+    GWBUF* query;
+
+    if (master && master->in_use() && (query = modutil_create_query(gtid_query)) &&
+        master->write(query))
+    {
+        MXS_INFO("Reading the GTID of the latest write from '%s'.", master->name());
+        ss_dassert(master->get_reply_state() == REPLY_STATE_DONE);
+        LOG_RS(master, REPLY_STATE_START);
+        master->set_reply_state(REPLY_STATE_START);
+        rses->expected_responses++;
+        rses->wait_gtid = EXPECTING_GTID_POSITION;
+        rval = true;
+    }
+    else
+    {
+        MXS_ERROR("Failed to read the GTID of the latest write, "
+                  "the following reads will not wait for it.");
+        rses->gtid_pos.clear();
+    }
+
+    rses->gtid_needed = false;
+    return rval;
+}
+
+bool extract_gtid(GWBUF* buffer, std::string* gtid)
+{
+    bool rval = false;
+    uint8_t* ptr = GWBUF_DATA(buffer);
+    uint8_t* end = ptr + gwbuf_length(buffer);
+    int n_eof = 0;
+
+    if (mxs_mysql_is_err_packet(buffer))
+    {
+        return false;
+    }
+
+    /** The result has one column and one row: the row is the first
+     * packet after the EOF packet that ends the column definitions */
+    while (ptr + MYSQL_HEADER_LEN < end && n_eof < 2)
+    {
+        uint32_t len = gw_mysql_get_byte3(ptr);
+        uint8_t* payload = ptr + MYSQL_HEADER_LEN;
+
+        if (payload[0] == MYSQL_REPLY_EOF && len < 9)
+        {
+            n_eof++;
+        }
+        else if (n_eof == 1 && payload[0] != 0xfb)
+        {
+            size_t size;
+            char* str = mxs_lestr_consume(&payload, &size);
+            gtid->assign(str, size);
+            rval = true;
+        }
+
+        ptr += MYSQL_HEADER_LEN + len;
+    }
+
+    return rval;
+}
+
+bool read_gtid_position(RWSplitSession* rses, SRWBackend& backend, GWBUF* buffer)
+{
+    bool rval = false;
+    bool complete = reply_is_complete(backend, buffer);
+    rses->gtid_response = gwbuf_append(rses->gtid_response, buffer);
+
+    if (complete)
+    {
+        backend->ack_write();
+        rses->expected_responses--;
+        ss_dassert(rses->expected_responses >= 0);
+        rses->wait_gtid = EXPECTING_NOTHING;
+
+        GWBUF* response = gwbuf_make_contiguous(rses->gtid_response);
+        rses->gtid_response = NULL;
+
+        if (response && extract_gtid(response, &rses->gtid_pos))
+        {
+            MXS_INFO("GTID of the latest write is '%s'.", rses->gtid_pos.c_str());
+        }
+        else
+        {
+            MXS_WARNING("Could not read the GTID of the latest write from '%s', the "
+                        "following reads will not wait for it. The 'causal_reads' "
+                        "parameter requires MariaDB 10.0.9 or newer.", backend->name());
+            rses->gtid_pos.clear();
+        }
+
+        gwbuf_free(response);
+        rval = true;
+    }
+
+    return rval;
+}
+
+GWBUF* discard_gtid_wait_result(RWSplitSession* rses, SRWBackend& backend, GWBUF* buffer)
+{
+    rses->wait_gtid = EXPECTING_NOTHING;
+
+    if (mxs_mysql_is_ok_packet(buffer))
+    {
+        /** The slave has the write, only the reply of the client's query
+         * remains once the OK of the wait is removed */
+        buffer = remove_gtid_wait_ok(buffer, &rses->next_seq);
+        rses->wait_gtid = EXPECTING_RENUMBERED_REPLY;
+    }
+    else if (mxs_mysql_is_err_packet(buffer))
+    {
+        GWBUF* stored = NULL;
+        const SERVER* target = NULL;
+        SRWBackend& master = rses->current_master;
+
+        if (session_take_stmt(rses->client_dcb->session, &stored, &target) &&
+            (target != backend->server() || !master || !master->in_use()))
+        {
+            gwbuf_free(stored);
+            stored = NULL;
+        }
+
+        if (stored && master->write(stored))
+        {
+            /** The slave did not catch up in time, the read is done on the master */
+            MXS_INFO("Slave '%s' did not catch up with the latest write, "
+                     "retrying the read on '%s'.", backend->name(), master->name());
+            gwbuf_free(buffer);
+            buffer = NULL;
+
+            backend->ack_write();
+            LOG_RS(backend, REPLY_STATE_DONE);
+            backend->set_reply_state(REPLY_STATE_DONE);
+
+            ss_dassert(master->get_reply_state() == REPLY_STATE_DONE);
+            LOG_RS(master, REPLY_STATE_START);
+            master->set_reply_state(REPLY_STATE_START);
+        }
+        /** Otherwise the error is returned to the client */
+    }
+
+    return buffer;
+}
+
+void renumber_gtid_wait_reply(RWSplitSession* rses, GWBUF* buffer)
+{
+    renumber_packets(buffer, &rses->next_seq);
+}
+
+GWBUF* remove_gtid_wait_ok(GWBUF* buffer, uint8_t* seq)
+{
+    GWBUF* ok = modutil_get_next_MySQL_packet(&buffer);
+    gwbuf_free(ok);
+
+    /** The reply of the read starts where the OK started */
+    *seq = 1;
+    renumber_packets(buffer, seq);
+
+    return buffer;
+}
+
+void renumber_packets(GWBUF* buffer, uint8_t* seq)
+{
+    size_t len = buffer ? gwbuf_length(buffer) : 0;
+    size_t offset = 0;
+    uint8_t header[MYSQL_HEADER_LEN];
+
+    while (offset + MYSQL_HEADER_LEN <= len)
+    {
+        gwbuf_copy_data(buffer, offset, MYSQL_HEADER_LEN, header);
+
+        /** The header of a packet can be split between the buffers of a chain */
+        size_t seq_offset = offset + MYSQL_HEADER_LEN - 1;
+        GWBUF* part = buffer;
+
+        while (seq_offset >= GWBUF_LENGTH(part))
+        {
+            seq_offset -= GWBUF_LENGTH(part);
+            part = part->next;
+        }
+
+        GWBUF_DATA(part)[seq_offset] = (*seq)++;
+        offset += MYSQL_HEADER_LEN + gw_mysql_get_byte3(header);
+    }
+}
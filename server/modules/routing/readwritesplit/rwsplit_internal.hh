@@ -62,6 +62,7 @@ bool send_readonly_error(DCB *dcb);
  */
 int router_handle_state_switch(DCB *dcb, DCB_REASON reason, void *data);
 int rses_get_max_replication_lag(RWSplitSession *rses);
+bool reply_is_complete(SRWBackend& backend, GWBUF *buffer);
 
 /*
  * The following are implemented in rwsplit_route_stmt.c
@@ -122,6 +123,155 @@ bool check_for_sp_call(GWBUF *buf, uint8_t packet_type);
 
 void close_all_connections(SRWBackendList& backends);
 
+/**
+ * @brief Send keepalive pings to backends that have been idle too long
+ *
+ * @param inst Router instance
+ * @param rses Router client session
+ */
+void handle_connection_keepalive(RWSplit *inst, RWSplitSession *rses);
+
+/*
+ * The following are implemented in rwsplit_pooling.cc
+ */
+
+/**
+ * @brief Track the locks that a statement acquires or releases
+ *
+ * The connections of a session are not released while it holds table locks
+ * or named locks, as the locks would be lost.
+ *
+ * @param locks    The current locks of the session, a bitmask of session_lock_t
+ * @param querybuf The statement being routed
+ * @param command  The command byte of the statement
+ *
+ * @return The locks the session holds after the statement
+ */
+uint32_t update_session_locks(uint32_t locks, GWBUF* querybuf, uint8_t command);
+
+/**
+ * @brief Release the backend connections of an idle session into the pool
+ *
+ * Nothing is done if the session holds state that cannot be restored.
+ *
+ * @param rses Router client session
+ */
+void release_idle_connections(RWSplitSession* rses);
+
+/**
+ * @brief Take new connections into use and restore the session state
+ *
+ * @param rses Router client session whose connections were released
+ *
+ * @return True if the connections were successfully created
+ */
+bool reacquire_connections(RWSplitSession* rses);
+
+/*
+ * The following are implemented in rwsplit_causal_reads.cc
+ */
+
+/**
+ * @brief Check if a read can be made to wait for the latest write on a slave
+ *
+ * @param rses     Router client session
+ * @param querybuf The read
+ * @param command  The command byte of the read
+ *
+ * @return True if the read can be prefixed with a MASTER_GTID_WAIT call,
+ *         false if it must be routed to the master
+ */
+bool can_wait_for_gtid(RWSplitSession* rses, GWBUF* querybuf, uint8_t command);
+
+/**
+ * @brief Prefix a read with a MASTER_GTID_WAIT call
+ *
+ * @param gtid     The GTID to wait for
+ * @param timeout  How many seconds to wait
+ * @param querybuf A COM_QUERY for which can_wait_for_gtid() returned true
+ *
+ * @return A new COM_QUERY that waits for the GTID before the read,
+ *         or NULL if memory allocation failed
+ */
+GWBUF* add_gtid_wait(const std::string& gtid, int timeout, GWBUF* querybuf);
+
+/**
+ * @brief Read the GTID of the latest write from the master
+ *
+ * @param rses Router client session
+ *
+ * @return True if the query was sent
+ */
+bool send_gtid_query(RWSplitSession* rses);
+
+/**
+ * @brief Extract the GTID from the result of the query sent by send_gtid_query()
+ *
+ * @param buffer The complete result, contiguous
+ * @param gtid   Where the GTID is stored
+ *
+ * @return True if the result contained a GTID
+ */
+bool extract_gtid(GWBUF* buffer, std::string* gtid);
+
+/**
+ * @brief Process the response to the query sent by send_gtid_query()
+ *
+ * @param rses    Router client session
+ * @param backend The master
+ * @param buffer  A part of the response, the function takes ownership
+ *
+ * @return True if the response is complete
+ */
+bool read_gtid_position(RWSplitSession* rses, SRWBackend& backend, GWBUF* buffer);
+
+/**
+ * @brief Remove the result of MASTER_GTID_WAIT from the reply of a slave
+ *
+ * If the slave did not catch up in time, the read is retried on the master.
+ * Otherwise the packets of the rest of the reply must be renumbered with
+ * renumber_gtid_wait_reply() until the reply is complete.
+ *
+ * @param rses    Router client session
+ * @param backend The slave
+ * @param buffer  The first part of the reply
+ *
+ * @return The rest of the reply, NULL if nothing remains
+ */
+GWBUF* discard_gtid_wait_result(RWSplitSession* rses, SRWBackend& backend, GWBUF* buffer);
+
+/**
+ * @brief Renumber a part of a slave reply whose MASTER_GTID_WAIT result
+ * was removed
+ *
+ * @param rses    Router client session
+ * @param buffer  The part of the reply, complete packets
+ */
+void renumber_gtid_wait_reply(RWSplitSession* rses, GWBUF* buffer);
+
+/**
+ * @brief Remove the OK packet of a successful MASTER_GTID_WAIT from the
+ * start of a reply
+ *
+ * The packets that follow are renumbered, as if the OK had never been sent.
+ *
+ * @param buffer  The first part of the reply, complete packets
+ * @param seq     On return, the sequence number of the packet that follows
+ *                the returned ones
+ *
+ * @return The rest of the reply, NULL if nothing remains
+ */
+GWBUF* remove_gtid_wait_ok(GWBUF* buffer, uint8_t* seq);
+
+/**
+ * @brief Renumber the packets of a part of a reply
+ *
+ * @param buffer  The part of the reply, complete packets
+ * @param seq     The sequence number of the first packet. On return, the
+ *                sequence number of the packet that follows the last one.
+ */
+void renumber_packets(GWBUF* buffer, uint8_t* seq);
+
 uint32_t determine_query_type(GWBUF *querybuf, int command);
 
 /**
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "readwritesplit.hh"
+#include "rwsplit_internal.hh"
+
+#include <ctype.h>
+#include <strings.h>
+
+#include <maxscale/atomic.h>
+#include <maxscale/modutil.h>
+#include <maxscale/query_classifier.h>
+
+/**
+ * Functions for transaction level connection pooling
+ *
+ * When the session is idle, i.e. there is no open transaction and the session
+ * holds no state that the session command history cannot restore, the backend
+ * connections are released into the persistent connection pools of the
+ * servers. When the next statement arrives, new connections are taken from
+ * the pools and the session state is restored by replaying the session
+ * command history.
+ */
+
+/**
+ * Read the next word of a statement
+ *
+ * @param ptr  Current position, moved past the word
+ * @param end  End of the statement
+ * @param word The start of the word is stored here
+ *
+ * @return Length of the word, 0 at the end of the statement
+ */
+static int next_word(const char** ptr, const char* end, const char** word)
+{
+    const char* p = *ptr;
+
+    while (p < end && !isalnum(*p) && *p != '_')
+    {
+        p++;
+    }
+
+    *word = p;
+
+    while (p < end && (isalnum(*p) || *p == '_'))
+    {
+        p++;
+    }
+
+    *ptr = p;
+    return p - *word;
+}
+
+static bool word_is(const char* word, int len, const char* keyword)
+{
+    return (size_t)len == strlen(keyword) && strncasecmp(word, keyword, len) == 0;
+}
+
+static bool word_is_table(const char* word, int len)
+{
+    return word_is(word, len, "TABLE") || word_is(word, len, "TABLES");
+}
+
+/**
+ * Check how a statement changes the table locks of the session
+ *
+ * Table locks are taken by LOCK TABLES and by FLUSH TABLES that is done
+ * WITH READ LOCK or FOR EXPORT. All of them are released by UNLOCK TABLES.
+ * Other FLUSH statements, e.g. FLUSH PRIVILEGES, do not take locks.
+ *
+ * @param querybuf The statement
+ * @param locks    The current locks of the session
+ *
+ * @return The locks after the statement
+ */
+static uint32_t update_table_locks(GWBUF* querybuf, uint32_t locks)
+{
+    char* sql;
+    int len;
+
+    if (modutil_extract_SQL(querybuf, &sql, &len))
+    {
+        const char* ptr = sql;
+        const char* end = sql + len;
+        const char* word;
+        int n = next_word(&ptr, end, &word);
+
+        if (word_is(word, n, "LOCK"))
+        {
+            n = next_word(&ptr, end, &word);
+
+            if (word_is_table(word, n))
+            {
+                locks |= SESSION_LOCK_TABLES;
+            }
+        }
+        else if (word_is(word, n, "UNLOCK"))
+        {
+            n = next_word(&ptr, end, &word);
+
+            if (word_is_table(word, n))
+            {
+                locks &= ~SESSION_LOCK_TABLES;
+            }
+        }
+        else if (word_is(word, n, "FLUSH"))
+        {
+            n = next_word(&ptr, end, &word);
+
+            if (word_is(word, n, "NO_WRITE_TO_BINLOG") || word_is(word, n, "LOCAL"))
+            {
+                n = next_word(&ptr, end, &word);
+            }
+
+            if (word_is_table(word, n))
+            {
+                const char* prev = NULL;
+                int prev_n = 0;
+
+                /** The table list is followed by the lock clause */
+                while ((n = next_word(&ptr, end, &word)))
+                {
+                    if ((word_is(prev, prev_n, "READ") && word_is(word, n, "LOCK")) ||
+                        (word_is(prev, prev_n, "FOR") && word_is(word, n, "EXPORT")))
+                    {
+                        locks |= SESSION_LOCK_TABLES;
+                        break;
+                    }
+
+                    prev = word;
+                    prev_n = n;
+                }
+            }
+        }
+    }
+
+    return locks;
+}
+
+/**
+ * Check how a statement changes the named locks of the session
+ *
+ * Named locks are taken with GET_LOCK(). As a lock can be taken more than
+ * once and taking it can fail, only RELEASE_ALL_LOCKS() is known to release
+ * all of them.
+ *
+ * @param querybuf The statement
+ * @param locks    The current locks of the session
+ *
+ * @return The locks after the statement
+ */
+static uint32_t update_named_locks(GWBUF* querybuf, uint32_t locks)
+{
+    const QC_FUNCTION_INFO* infos;
+    size_t n_infos;
+    qc_get_function_info(querybuf, &infos, &n_infos);
+
+    bool release = false;
+    bool acquire = false;
+
+    for (size_t i = 0; i < n_infos; i++)
+    {
+        if (strcasecmp(infos[i].name, "get_lock") == 0)
+        {
+            acquire = true;
+        }
+        else if (strcasecmp(infos[i].name, "release_all_locks") == 0)
+        {
+            release = true;
+        }
+    }
+
+    if (acquire)
+    {
+        locks |= SESSION_LOCK_NAMED;
+    }
+    else if (release)
+    {
+        locks &= ~SESSION_LOCK_NAMED;
+    }
+
+    return locks;
+}
+
+uint32_t update_session_locks(uint32_t locks, GWBUF* querybuf, uint8_t command)
+{
+    if (command == MXS_COM_QUERY && GWBUF_IS_CONTIGUOUS(querybuf))
+    {
+        uint32_t new_locks = update_named_locks(querybuf, update_table_locks(querybuf, locks));
+
+        if (new_locks && !locks)
+        {
+            MXS_INFO("Session acquires locks, backend connections will not be "
+                     "released until the locks are released.");
+        }
+        else if (locks && !new_locks)
+        {
+            MXS_INFO("Session released its locks, backend connections can be released.");
+        }
+
+        locks = new_locks;
+    }
+
+    return locks;
+}
+
+/**
+ * Check if the session state can be restored on new connections
+ *
+ * @param rses Router session
+ *
+ * @return True if the connections can be released
+ */
+static bool can_release_connections(RWSplitSession* rses)
+{
+    MXS_SESSION* session = rses->client_dcb->session;
+
+    if (rses->released || rses->locks || rses->rses_closed ||
+        rses->rses_config.disable_sescmd_history ||
+        rses->expected_responses || rses->query_queue || rses->large_query ||
+        rses->load_data_state != LOAD_DATA_INACTIVE ||
+        rses->target_node || !rses->temp_tables.empty() || !rses->ps_handles.empty() ||
+        !session_is_autocommit(session) ||
+        (session_trx_is_active(session) && !session_trx_is_ending(session)))
+    {
+        return false;
+    }
+
+    int n_in_use = 0;
+
+    for (SRWBackendList::iterator it = rses->backends.begin();
+         it != rses->backends.end(); it++)
+    {
+        SRWBackend& backend = *it;
+
+        if (backend->in_use())
+        {
+            if (backend->is_waiting_result() || backend->session_command_count() ||
+                backend->get_reply_state() != REPLY_STATE_DONE ||
+                backend->server()->persistpoolmax == 0)
+            {
+                return false;
+            }
+
+            n_in_use++;
+        }
+    }
+
+    return n_in_use > 0;
+}
+
+void release_idle_connections(RWSplitSession* rses)
+{
+    if (can_release_connections(rses))
+    {
+        for (SRWBackendList::iterator it = rses->backends.begin();
+             it != rses->backends.end(); it++)
+        {
+            SRWBackend& backend = *it;
+
+            if (backend->in_use())
+            {
+                backend->release();
+            }
+        }
+
+        MXS_INFO("Session is idle, released backend connections into the pool.");
+        rses->released = true;
+        atomic_add_uint64(&rses->router->stats().n_released, 1);
+    }
+}
+
+bool reacquire_connections(RWSplitSession* rses)
+{
+    ss_dassert(rses->released);
+    ss_dassert(rses->expected_responses == 0);
+    rses->released = false;
+    rses->current_master.reset();
+    rses->prev_target.reset();
+
+    bool succp = select_connect_backend_servers(rses->rses_nbackends,
+                                                rses->rses_config.max_slave_connections,
+                                                rses->client_dcb->session,
+                                                rses->router->config(), rses->backends,
+                                                rses->current_master, &rses->sescmd_list,
+                                                &rses->expected_responses,
+                                                connection_type::ALL);
+
+    if (succp && rses->current_master && rses->current_master->in_use() &&
+        !rses->sescmd_list.empty())
+    {
+        /** New master connections do not replay the history */
+        rses->current_master->append_session_command(rses->sescmd_list);
+
+        if (rses->current_master->execute_session_command())
+        {
+            rses->expected_responses++;
+        }
+        else
+        {
+            MXS_ERROR("Failed to restore session state on %s", rses->current_master->uri());
+            succp = false;
+        }
+    }
+
+    if (succp)
+    {
+        MXS_INFO("Reacquired backend connections, replaying %lu session commands.",
+                 rses->sescmd_list.size());
+        atomic_add_uint64(&rses->router->stats().n_reacquired, 1);
+    }
+    else
+    {
+        MXS_ERROR("Failed to reacquire backend connections for an idle session.");
+    }
+
+    return succp;
+}
@@ -20,7 +20,6 @@
 #include <strings.h>
 
 #include <maxscale/alloc.h>
-#include <maxscale/hk_heartbeat.h>
 #include <maxscale/modutil.h>
 #include <maxscale/router.h>
 
@@ -62,34 +61,29 @@ static SRWBackend compare_backends(SRWBackend a, SRWBackend b, select_criteria_t
     return p(a, b) <= 0 ? a : b;
 }
 
-void handle_connection_keepalive(RWSplit *inst, RWSplitSession *rses,
-                                 SRWBackend& target)
+void handle_connection_keepalive(RWSplit *inst, RWSplitSession *rses)
 {
-    ss_dassert(target);
-    ss_debug(int nserv = 0);
-    /** Each heartbeat is 1/10th of a second */
-    int keepalive = inst->config().connection_keepalive * 10;
+    /** The last read is in milliseconds, see mxs_worker_timer_now() */
+    int64_t keepalive = inst->config().connection_keepalive * 1000;
+    int64_t now = mxs_worker_timer_now();
 
     for (SRWBackendList::iterator it = rses->backends.begin();
          it != rses->backends.end(); it++)
     {
         SRWBackend backend = *it;
 
-        if (backend->in_use() && backend != target && !backend->is_waiting_result())
+        if (backend->in_use() && !backend->is_waiting_result())
         {
-            ss_debug(nserv++);
-            int diff = hkheartbeat - backend->dcb()->last_read;
+            int64_t diff = now - backend->dcb()->last_read;
 
             if (diff > keepalive)
             {
                 MXS_INFO("Pinging %s, idle for %ld seconds",
-                         backend->name(), HB_TO_SEC(diff));
+                         backend->name(), (long)(diff / 1000));
                 modutil_ignorable_ping(backend->dcb());
             }
         }
     }
-
-    ss_dassert(nserv < rses->rses_nbackends);
 }
 
 route_target_t get_target_type(RWSplitSession *rses, GWBUF *buffer,
@@ -102,6 +96,11 @@ route_target_t get_target_type(RWSplitSession *rses, GWBUF *buffer,
     {
         *command = mxs_mysql_get_command(buffer);
 
+        if (rses->rses_config.transaction_pooling)
+        {
+            rses->locks = update_session_locks(rses->locks, buffer, *command);
+        }
+
         /**
          * If the session is inside a read-only transaction, we trust that the
          * server acts properly even when non-read-only queries are executed.
@@ -208,6 +207,21 @@ bool route_single_stmt(RWSplit *inst, RWSplitSession *rses, GWBUF *querybuf, con
     }
 
     SRWBackend target;
+    bool wait_gtid = false;
+
+    if (rses->rses_config.causal_reads && !rses->gtid_pos.empty() &&
+        !rses->large_query && TARGET_IS_SLAVE(route_target))
+    {
+        if (can_wait_for_gtid(rses, querybuf, command))
+        {
+            wait_gtid = true;
+        }
+        else
+        {
+            /** The read cannot be made to wait for the latest write */
+            route_target = TARGET_MASTER;
+        }
+    }
 
     if (TARGET_IS_ALL(route_target))
     {
@@ -269,7 +283,38 @@ bool route_single_stmt(RWSplit *inst, RWSplitSession *rses, GWBUF *querybuf, con
         if (target && succp) /*< Have DCB of the target backend */
         {
             ss_dassert(!store_stmt || TARGET_IS_SLAVE(route_target));
-            succp = handle_got_target(inst, rses, querybuf, target, store_stmt);
+            GWBUF* waitbuf = NULL;
+
+            if (wait_gtid && !target->is_master() && (waitbuf = add_gtid_wait(rses->gtid_pos, rses->rses_config.causal_reads_timeout, querybuf)))
+            {
+                /** The original read is stored so that it can be retried on
+                 * the master if the slave does not catch up in time */
+                succp = handle_got_target(inst, rses, waitbuf, target, false);
+                gwbuf_free(waitbuf);
+
+                if (succp)
+                {
+                    rses->wait_gtid = EXPECTING_WAIT_GTID_RESULT;
+
+                    if (!session_store_stmt(rses->client_dcb->session, querybuf, target->server()))
+                    {
+                        MXS_ERROR("Failed to store current statement, it won't be retried "
+                                  "if the slave does not catch up.");
+                    }
+                }
+            }
+            else
+            {
+                succp = handle_got_target(inst, rses, querybuf, target, store_stmt);
+            }
+
+            if (succp && rses->rses_config.causal_reads && target == rses->current_master &&
+                (qc_query_is_type(qtype, QUERY_TYPE_WRITE) ||
+                 qc_query_is_type(qtype, QUERY_TYPE_COMMIT)))
+            {
+                /** The GTID of the write is read once the master has replied */
+                rses->gtid_needed = true;
+            }
 
             if (succp && command == MXS_COM_STMT_EXECUTE && not_locked_to_master)
             {
@@ -287,12 +332,6 @@ bool route_single_stmt(RWSplit *inst, RWSplitSession *rses, GWBUF *querybuf, con
         }
     }
 
-    if (succp && inst->config().connection_keepalive &&
-        (TARGET_IS_SLAVE(route_target) || TARGET_IS_MASTER(route_target)))
-    {
-        handle_connection_keepalive(inst, rses, target);
-    }
-
     return succp;
 }
 
@@ -402,7 +441,7 @@ bool route_session_write(RWSplitSession *rses, GWBUF *querybuf,
     }
 
     if (rses->rses_config.max_sescmd_history > 0 &&
-        rses->sescmd_count >= rses->rses_config.max_sescmd_history)
+        rses->sescmd_list.size() >= rses->rses_config.max_sescmd_history)
     {
         MXS_WARNING("Router session exceeded session command history limit. "
                     "Slave recovery is disabled and only slave servers with "
@@ -20,6 +20,8 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include <vector>
+
 #include <maxscale/router.h>
 
 /**
@@ -76,6 +78,50 @@ static bool discard_if_response_differs(SRWBackend backend, uint8_t master_respo
     return rval;
 }
 
+/**
+ * Removes session commands from the history that the given command has made redundant
+ *
+ * @param rses   Router session
+ * @param sescmd The session command that was successfully executed
+ */
+static void compact_sescmd_history(RWSplitSession* rses, const mxs::SSessionCommand& sescmd)
+{
+    std::vector<uint64_t> removed;
+
+    if (mxs::compact_session_commands(rses->sescmd_list, sescmd, &removed))
+    {
+        /** The stored responses are needed until all backends have executed the commands */
+        uint64_t lowest_pos = sescmd->get_position();
+
+        for (SRWBackendList::iterator it = rses->backends.begin();
+             it != rses->backends.end(); it++)
+        {
+            SRWBackend& backend = *it;
+
+            if (backend->in_use() && backend->session_command_count())
+            {
+                uint64_t current_pos = backend->next_session_command()->get_position();
+
+                if (current_pos < lowest_pos)
+                {
+                    lowest_pos = current_pos;
+                }
+            }
+        }
+
+        for (std::vector<uint64_t>::iterator it = removed.begin(); it != removed.end(); it++)
+        {
+            if (*it < lowest_pos)
+            {
+                rses->sescmd_responses.erase(*it);
+            }
+        }
+
+        MXS_INFO("Removed %lu redundant session commands from the history, %lu commands remain",
+                 removed.size(), rses->sescmd_list.size());
+    }
+}
+
 void process_sescmd_response(RWSplitSession* rses, SRWBackend& backend,
                              GWBUF** ppPacket, bool* pReconnect)
 {
@@ -124,6 +170,10 @@ void process_sescmd_response(RWSplitSession* rses, SRWBackend& backend,
                         MXS_INFO("PS ID %u maps to internal ID %lu", resp.id, id);
                         rses->ps_handles[resp.id] = id;
                     }
+                    else if (!rses->rses_config.disable_sescmd_history)
+                    {
+                        compact_sescmd_history(rses, sescmd);
+                    }
 
                     // Discard any slave connections that did not return the same result
                     for (SlaveResponseList::iterator it = rses->slave_responses.begin();
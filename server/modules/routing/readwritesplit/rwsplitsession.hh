@@ -27,6 +27,23 @@ enum reply_state_t
     REPLY_STATE_RSET_ROWS       /**< Resultset response, waiting for rows */
 };
 
+/** Internal responses expected by causal_reads */
+enum wait_gtid_state_t
+{
+    EXPECTING_NOTHING,          /**< No internal response is expected */
+    EXPECTING_WAIT_GTID_RESULT, /**< MASTER_GTID_WAIT result preceding the reply of a slave */
+    EXPECTING_RENUMBERED_REPLY, /**< Rest of a slave reply whose MASTER_GTID_WAIT result was removed */
+    EXPECTING_GTID_POSITION     /**< Result of the @@last_gtid query sent to the master */
+};
+
+/** Locks that prevent the release of connections by transaction_pooling */
+enum session_lock_t
+{
+    SESSION_LOCK_NONE   = 0,
+    SESSION_LOCK_TABLES = 1 << 0, /**< LOCK TABLES or FLUSH TABLES WITH READ LOCK */
+    SESSION_LOCK_NAMED  = 1 << 1  /**< GET_LOCK() */
+};
+
 /** Reply state change debug logging */
 #define LOG_RS(a, b) MXS_DEBUG("%s %s -> %s", (a)->uri(), \
     rstostr((a)->get_reply_state()), rstostr(b));
@@ -155,6 +172,14 @@ public:
     PSManager               ps_manager;  /**< Prepared statement manager*/
     ClientHandleMap         ps_handles;  /**< Client PS handle to internal ID mapping */
     ExecMap                 exec_map; /**< Map of COM_STMT_EXECUTE statement IDs to Backends */
+    bool                    released; /**< Backend connections are released into the pool */
+    uint32_t                locks; /**< Locks held by the session, a bitmask of session_lock_t */
+    MXS_WORKER_TIMER        keepalive_timer; /**< Sends the keepalive pings */
+    bool                    gtid_needed; /**< A write was done, its GTID must be read */
+    std::string             gtid_pos; /**< GTID of the latest write, used by causal_reads */
+    wait_gtid_state_t       wait_gtid; /**< Internal response expected by causal_reads */
+    uint8_t                 next_seq; /**< Sequence number of the next packet of a renumbered reply */
+    GWBUF*                  gtid_response; /**< Partial response to the @@last_gtid query */
     skygw_chk_t             rses_chk_tail;
 
 private:
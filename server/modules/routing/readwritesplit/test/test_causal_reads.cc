@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "../readwritesplit.hh"
+#include "../rwsplit_internal.hh"
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <maxscale/alloc.h>
+#include <maxscale/log_manager.h>
+#include <maxscale/modutil.h>
+#include <maxscale/mysql_utils.h>
+
+using namespace std;
+
+namespace
+{
+
+typedef vector<uint8_t> Packet;
+
+Packet create_packet(uint8_t seq, const uint8_t* pPayload, size_t len)
+{
+    Packet packet(MYSQL_HEADER_LEN + len);
+    gw_mysql_set_byte3(&packet[0], len);
+    packet[3] = seq;
+    memcpy(&packet[MYSQL_HEADER_LEN], pPayload, len);
+    return packet;
+}
+
+Packet create_packet(uint8_t seq, const string& payload)
+{
+    return create_packet(seq, (const uint8_t*)payload.data(), payload.length());
+}
+
+Packet create_ok(uint8_t seq)
+{
+    const uint8_t payload[] = { 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00 };
+    return create_packet(seq, payload, sizeof(payload));
+}
+
+Packet create_err(uint8_t seq)
+{
+    const uint8_t payload[] = { 0xff, 0x15, 0x04, '#', 'H', 'Y', '0', '0', '0', 'x' };
+    return create_packet(seq, payload, sizeof(payload));
+}
+
+Packet create_eof(uint8_t seq)
+{
+    const uint8_t payload[] = { 0xfe, 0x00, 0x00, 0x02, 0x00 };
+    return create_packet(seq, payload, sizeof(payload));
+}
+
+/**
+ * Create a result set with one column and one row
+ *
+ * @param seq    The sequence number of the first packet
+ * @param pValue The value of the row, NULL for an SQL NULL
+ *
+ * @return The packets of the result set
+ */
+vector<Packet> create_resultset(uint8_t seq, const char* pValue)
+{
+    vector<Packet> packets;
+
+    packets.push_back(create_packet(seq++, string(1, '\x01')));
+    string coldef("\x03" "def" "\x00" "\x00" "\x00" "\x01" "a" "\x00" "\x0c", 11);
+    coldef.append("\x21\x00\x00\x01\x00\x00\xfd\x00\x00\x00\x00\x00", 12);
+    packets.push_back(create_packet(seq++, coldef));
+    packets.push_back(create_eof(seq++));
+
+    if (pValue)
+    {
+        string row(1, (char)strlen(pValue));
+        row += pValue;
+        packets.push_back(create_packet(seq++, row));
+    }
+    else
+    {
+        packets.push_back(create_packet(seq++, string(1, '\xfb')));
+    }
+
+    packets.push_back(create_eof(seq++));
+
+    return packets;
+}
+
+Packet concatenate(const vector<Packet>& packets)
+{
+    Packet data;
+
+    for (vector<Packet>::const_iterator it = packets.begin(); it != packets.end(); ++it)
+    {
+        data.insert(data.end(), it->begin(), it->end());
+    }
+
+    return data;
+}
+
+/**
+ * Create a chain of buffers with the given data
+ *
+ * @param data  The data
+ * @param begin The offset of the first byte
+ * @param end   The offset one past the last byte
+ * @param split The size of each buffer in the chain
+ */
+GWBUF* create_chain(const Packet& data, size_t begin, size_t end, size_t split)
+{
+    GWBUF* pChain = NULL;
+
+    for (size_t i = begin; i < end; i += split)
+    {
+        size_t len = min(split, end - i);
+        pChain = gwbuf_append(pChain, gwbuf_alloc_and_load(len, &data[i]));
+    }
+
+    return pChain;
+}
+
+Packet get_data(GWBUF* pBuffer)
+{
+    Packet data(gwbuf_length(pBuffer));
+    gwbuf_copy_data(pBuffer, 0, data.size(), &data[0]);
+    return data;
+}
+
+int test_add_gtid_wait()
+{
+    int rv = EXIT_SUCCESS;
+    const char zSql[] = "SELECT * FROM t1";
+
+    cout << "add_gtid_wait" << endl;
+
+    GWBUF* pQuery = modutil_create_query(zSql);
+    GWBUF* pWait = add_gtid_wait("0-3000-42", 10, pQuery);
+
+    char* zStmt = modutil_get_SQL(pWait);
+    string stmt(zStmt);
+    MXS_FREE(zStmt);
+
+    const char zPrefix[] = "SET @maxscale_secret_variable=(SELECT CASE WHEN "
+        "MASTER_GTID_WAIT('0-3000-42', 10) = 0 THEN 1 ELSE "
+        "(SELECT 1 FROM INFORMATION_SCHEMA.ENGINES) END);";
+
+    if (stmt != string(zPrefix) + zSql)
+    {
+        cout << "ERROR: Unexpected statement: " << stmt << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    uint8_t header[MYSQL_HEADER_LEN + 1];
+    gwbuf_copy_data(pWait, 0, sizeof(header), header);
+
+    if (gw_mysql_get_byte3(header) != gwbuf_length(pWait) - MYSQL_HEADER_LEN ||
+        header[3] != 0 || header[4] != MXS_COM_QUERY)
+    {
+        cout << "ERROR: The header of the statement is invalid." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    gwbuf_free(pWait);
+    gwbuf_free(pQuery);
+
+    return rv;
+}
+
+int test_extract_gtid(const char* zName, const Packet& data, bool expected, const string& gtid)
+{
+    int rv = EXIT_SUCCESS;
+    GWBUF* pBuffer = gwbuf_alloc_and_load(data.size(), &data[0]);
+    string result;
+
+    if (extract_gtid(pBuffer, &result) != expected || result != gtid)
+    {
+        cout << "ERROR: " << zName << ": got '" << result << "'" << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    gwbuf_free(pBuffer);
+
+    return rv;
+}
+
+int test_extract_gtid()
+{
+    int rv = EXIT_SUCCESS;
+
+    cout << "extract_gtid" << endl;
+
+    if (test_extract_gtid("GTID", concatenate(create_resultset(1, "0-1-42")), true, "0-1-42") ||
+        test_extract_gtid("NULL", concatenate(create_resultset(1, NULL)), false, "") ||
+        test_extract_gtid("ERR", create_err(1), false, ""))
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+/**
+ * Remove the OK of MASTER_GTID_WAIT from a reply delivered in several buffers
+ *
+ * @param split_at The packet boundaries at which the reply is split into buffers
+ * @param segment  The size of the buffers in each chain, a packet can be split
+ *                 between the buffers of a chain
+ */
+int test_remove_gtid_wait_ok(const vector<size_t>& split_at, size_t segment)
+{
+    int rv = EXIT_SUCCESS;
+
+    vector<Packet> packets = create_resultset(2, "hello");
+    packets.insert(packets.begin(), create_ok(1));
+    Packet reply = concatenate(packets);
+
+    // The expected reply is the result set alone, numbered from 1
+    Packet expected = concatenate(create_resultset(1, "hello"));
+    Packet result;
+
+    uint8_t seq = 0;
+    size_t begin = 0;
+
+    for (size_t i = 0; i <= split_at.size(); i++)
+    {
+        size_t end = i < split_at.size() ? split_at[i] : reply.size();
+        GWBUF* pBuffer = create_chain(reply, begin, end, segment);
+
+        if (i == 0)
+        {
+            pBuffer = remove_gtid_wait_ok(pBuffer, &seq);
+        }
+        else
+        {
+            renumber_packets(pBuffer, &seq);
+        }
+
+        if (pBuffer)
+        {
+            Packet data = get_data(pBuffer);
+            result.insert(result.end(), data.begin(), data.end());
+            gwbuf_free(pBuffer);
+        }
+
+        begin = end;
+    }
+
+    if (result != expected)
+    {
+        cout << "ERROR: The reply was not renumbered correctly when split at";
+
+        for (size_t i = 0; i < split_at.size(); i++)
+        {
+            cout << " " << split_at[i];
+        }
+
+        cout << " into buffers of " << segment << " bytes." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+int test_remove_gtid_wait_ok()
+{
+    int rv = EXIT_SUCCESS;
+
+    cout << "remove_gtid_wait_ok" << endl;
+
+    vector<Packet> packets = create_resultset(2, "hello");
+    packets.insert(packets.begin(), create_ok(1));
+
+    // The offsets of the packets that follow the OK
+    vector<size_t> boundaries;
+    size_t offset = 0;
+
+    for (size_t i = 0; i < packets.size() - 1; i++)
+    {
+        offset += packets[i].size();
+        boundaries.push_back(offset);
+    }
+
+    const size_t segments[] = { 1, 2, 3, 5, 1000 };
+
+    for (size_t i = 0; i < sizeof(segments) / sizeof(segments[0]); i++)
+    {
+        // Every combination of buffers, from one for the whole reply
+        // to one for each packet
+        for (size_t mask = 0; mask < (1u << boundaries.size()); mask++)
+        {
+            vector<size_t> split_at;
+
+            for (size_t j = 0; j < boundaries.size(); j++)
+            {
+                if (mask & (1u << j))
+                {
+                    split_at.push_back(boundaries[j]);
+                }
+            }
+
+            if (test_remove_gtid_wait_ok(split_at, segments[i]) != EXIT_SUCCESS)
+            {
+                rv = EXIT_FAILURE;
+            }
+        }
+    }
+
+    return rv;
+}
+
+int test()
+{
+    int rv = EXIT_SUCCESS;
+
+    if (test_add_gtid_wait() != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    if (test_extract_gtid() != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    if (test_remove_gtid_wait_ok() != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+}
+
+int main()
+{
+    int rv = EXIT_FAILURE;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+    {
+        rv = test();
+        mxs_log_finish();
+    }
+    else
+    {
+        cout << "error: Could not initialize log." << endl;
+    }
+
+    return rv;
+}
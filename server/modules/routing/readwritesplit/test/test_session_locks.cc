@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "../readwritesplit.hh"
+#include "../rwsplit_internal.hh"
+
+#include <stdlib.h>
+#include <iostream>
+
+#include <maxscale/alloc.h>
+#include <maxscale/config.h>
+#include <maxscale/log_manager.h>
+#include <maxscale/modutil.h>
+#include <maxscale/paths.h>
+#include <maxscale/query_classifier.h>
+
+using namespace std;
+
+namespace
+{
+
+struct TEST_CASE
+{
+    const char* zStmt;
+    uint32_t    locks; // The locks after the statement
+};
+
+// The statements of each test are executed in the same session.
+
+const TEST_CASE table_locks[] =
+{
+    { "LOCK TABLES t1 WRITE",                      SESSION_LOCK_TABLES },
+    { "SELECT * FROM t1",                          SESSION_LOCK_TABLES },
+    { "UNLOCK TABLES",                             SESSION_LOCK_NONE },
+    { "SELECT * FROM t1",                          SESSION_LOCK_NONE },
+    { "lock table t1 read, t2 write",              SESSION_LOCK_TABLES },
+    { "unlock tables",                             SESSION_LOCK_NONE },
+    { NULL }
+};
+
+const TEST_CASE flush[] =
+{
+    { "FLUSH PRIVILEGES",                          SESSION_LOCK_NONE },
+    { "FLUSH LOGS",                                SESSION_LOCK_NONE },
+    { "FLUSH TABLES",                              SESSION_LOCK_NONE },
+    { "FLUSH TABLES t1, t2",                       SESSION_LOCK_NONE },
+    { "FLUSH TABLES WITH READ LOCK",               SESSION_LOCK_TABLES },
+    { "UNLOCK TABLES",                             SESSION_LOCK_NONE },
+    { "FLUSH NO_WRITE_TO_BINLOG TABLES t1 WITH READ LOCK", SESSION_LOCK_TABLES },
+    { "UNLOCK TABLES",                             SESSION_LOCK_NONE },
+    { "flush local table t1 for export",           SESSION_LOCK_TABLES },
+    { "UNLOCK TABLES",                             SESSION_LOCK_NONE },
+    { NULL }
+};
+
+const TEST_CASE named_locks[] =
+{
+    { "SELECT GET_LOCK('a', 10)",                  SESSION_LOCK_NAMED },
+    { "SELECT RELEASE_LOCK('a')",                  SESSION_LOCK_NAMED },
+    { "SELECT RELEASE_ALL_LOCKS()",                SESSION_LOCK_NONE },
+    { "SELECT GET_LOCK('b', 10)",                  SESSION_LOCK_NAMED },
+    { "LOCK TABLES t1 WRITE",                      SESSION_LOCK_NAMED | SESSION_LOCK_TABLES },
+    { "UNLOCK TABLES",                             SESSION_LOCK_NAMED },
+    { "SELECT RELEASE_ALL_LOCKS()",                SESSION_LOCK_NONE },
+    { NULL }
+};
+
+int test(const char* zName, const TEST_CASE* pTests)
+{
+    int rv = EXIT_SUCCESS;
+    uint32_t locks = SESSION_LOCK_NONE;
+
+    cout << zName << endl;
+
+    for (const TEST_CASE* pTest = pTests; pTest->zStmt; ++pTest)
+    {
+        GWBUF* pStmt = modutil_create_query(pTest->zStmt);
+        locks = update_session_locks(locks, pStmt, MXS_COM_QUERY);
+        gwbuf_free(pStmt);
+
+        if (locks != pTest->locks)
+        {
+            cout << "ERROR: After \"" << pTest->zStmt << "\" the locks are "
+                 << locks << " instead of " << pTest->locks << "." << endl;
+            rv = EXIT_FAILURE;
+        }
+    }
+
+    return rv;
+}
+
+int test()
+{
+    int rv = EXIT_SUCCESS;
+
+    if (test("Table locks", table_locks) != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    if (test("FLUSH", flush) != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    if (test("Named locks", named_locks) != EXIT_SUCCESS)
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+}
+
+int main()
+{
+    int rv = EXIT_FAILURE;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+    {
+        MXS_CONFIG* pConfig = config_get_global_options();
+        pConfig->n_threads = 1;
+
+        set_libdir(MXS_STRDUP_A("../../../../../query_classifier/qc_sqlite/"));
+
+        if (qc_setup("qc_sqlite", QC_SQL_MODE_DEFAULT, "") &&
+            qc_process_init(QC_INIT_BOTH) &&
+            qc_thread_init(QC_INIT_BOTH))
+        {
+            rv = test();
+            qc_process_end(QC_INIT_BOTH);
+        }
+        else
+        {
+            cout << "error: Could not initialize query classifier." << endl;
+        }
+
+        mxs_log_finish();
+    }
+    else
+    {
+        cout << "error: Could not initialize log." << endl;
+    }
+
+    return rv;
+}
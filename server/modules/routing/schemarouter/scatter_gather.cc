@@ -0,0 +1,1589 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "scatter_gather.hh"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+#include <new>
+
+#include <maxscale/debug.h>
+#include <maxscale/modutil.h>
+#include <maxscale/mysql_utils.h>
+#include <maxscale/protocol/mysql.h>
+
+namespace
+{
+
+using schemarouter::ResultMerger;
+
+/**
+ * The largest LIMIT of an ordered merge. The rows of a shard are kept in memory
+ * until the other shards have returned rows that sort before them. As each shard
+ * returns at most LIMIT rows, this bounds the number of rows kept per shard.
+ */
+const uint64_t MAX_ORDERED_LIMIT = 10000;
+
+enum token_type
+{
+    TOK_WORD,
+    TOK_NUMBER,
+    TOK_STRING,
+    TOK_PUNCT
+};
+
+struct Token
+{
+    token_type  type;
+    std::string text;   /**< Lowercase text of words, the character of punctuation */
+    bool        quoted; /**< Whether a word is a quoted identifier */
+    int         depth;  /**< Parenthesis nesting depth */
+};
+
+typedef std::vector<Token> Tokens;
+
+bool is_word_char(char c)
+{
+    return isalnum(c) || c == '_' || c == '$' || (unsigned char)c >= 0x80;
+}
+
+void add_token(Tokens& tokens, token_type type, const std::string& text, bool quoted, int depth)
+{
+    Token token;
+    token.type = type;
+    token.text = text;
+    token.quoted = quoted;
+    token.depth = depth;
+    tokens.push_back(token);
+}
+
+/**
+ * Split an SQL statement into tokens
+ *
+ * Comments are skipped. Statements with executable comments or that are not
+ * well-formed are rejected.
+ */
+bool tokenize(const char* zSql, size_t len, Tokens& tokens)
+{
+    const char* ptr = zSql;
+    const char* end = zSql + len;
+    int depth = 0;
+
+    while (ptr < end)
+    {
+        char c = *ptr;
+
+        if (isspace(c))
+        {
+            ++ptr;
+        }
+        else if (c == '#' || (c == '-' && ptr + 1 < end && ptr[1] == '-' &&
+                              (ptr + 2 == end || isspace(ptr[2]))))
+        {
+            while (ptr < end && *ptr != '\n')
+            {
+                ++ptr;
+            }
+        }
+        else if (c == '/' && ptr + 1 < end && ptr[1] == '*')
+        {
+            if (ptr + 2 < end && (ptr[2] == '!' || ptr[2] == 'M'))
+            {
+                // Executable comments are a part of the statement
+                return false;
+            }
+
+            const char* comment_end = NULL;
+
+            for (const char* p = ptr + 2; p + 1 < end; ++p)
+            {
+                if (p[0] == '*' && p[1] == '/')
+                {
+                    comment_end = p + 2;
+                    break;
+                }
+            }
+
+            if (comment_end == NULL)
+            {
+                return false;
+            }
+
+            ptr = comment_end;
+        }
+        else if (c == '\'' || c == '"' || c == '`')
+        {
+            std::string text;
+            bool closed = false;
+            ++ptr;
+
+            while (ptr < end)
+            {
+                if (*ptr == '\\' && c != '`' && ptr + 1 < end)
+                {
+                    text += ptr[1];
+                    ptr += 2;
+                }
+                else if (*ptr == c)
+                {
+                    if (ptr + 1 < end && ptr[1] == c)
+                    {
+                        text += c;
+                        ptr += 2;
+                    }
+                    else
+                    {
+                        ++ptr;
+                        closed = true;
+                        break;
+                    }
+                }
+                else
+                {
+                    text += *ptr++;
+                }
+            }
+
+            if (!closed)
+            {
+                return false;
+            }
+
+            if (c == '`')
+            {
+                std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+                add_token(tokens, TOK_WORD, text, true, depth);
+            }
+            else
+            {
+                add_token(tokens, TOK_STRING, text, false, depth);
+            }
+        }
+        else if (is_word_char(c))
+        {
+            const char* start = ptr;
+            bool number = true;
+
+            while (ptr < end && is_word_char(*ptr))
+            {
+                number = number && isdigit(*ptr);
+                ++ptr;
+            }
+
+            if (number && ptr + 1 < end && *ptr == '.' && isdigit(ptr[1]))
+            {
+                ++ptr;
+
+                while (ptr < end && isdigit(*ptr))
+                {
+                    ++ptr;
+                }
+            }
+
+            std::string text(start, ptr);
+            std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+            add_token(tokens, number ? TOK_NUMBER : TOK_WORD, text, false, depth);
+        }
+        else
+        {
+            if (c == ')' && --depth < 0)
+            {
+                return false;
+            }
+
+            add_token(tokens, TOK_PUNCT, std::string(1, c), false, depth);
+
+            if (c == '(')
+            {
+                ++depth;
+            }
+
+            ++ptr;
+        }
+    }
+
+    // A terminating semicolon is allowed but multi-statements are not
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+        if (tokens[i].type == TOK_PUNCT && tokens[i].text == ";")
+        {
+            if (i + 1 != tokens.size())
+            {
+                return false;
+            }
+
+            tokens.pop_back();
+        }
+    }
+
+    return depth == 0;
+}
+
+bool is_keyword(const Token& token, const char* zKeyword)
+{
+    return token.type == TOK_WORD && !token.quoted && token.text == zKeyword;
+}
+
+bool is_punct(const Token& token, char c)
+{
+    return token.type == TOK_PUNCT && token.text[0] == c;
+}
+
+bool is_one_of(const Token& token, const char* const* azWords)
+{
+    for (const char* const* pzWord = azWords; *pzWord; ++pzWord)
+    {
+        if (is_keyword(token, *pzWord))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* select_modifiers[] =
+{
+    "all", "high_priority", "straight_join", "sql_small_result", "sql_big_result",
+    "sql_buffer_result", "sql_cache", "sql_no_cache", NULL
+};
+
+/** Clauses that end the select list */
+const char* select_clauses[] =
+{
+    "from", "where", "group", "having", "order", "limit", "union", "into", "for",
+    "lock", "procedure", "window", NULL
+};
+
+/** Clauses whose result can't be merged */
+const char* unmergeable_clauses[] =
+{
+    "group", "having", "union", "into", "for", "lock", "procedure", "window", NULL
+};
+
+const char* unsupported_aggregates[] =
+{
+    "avg", "bit_and", "bit_or", "bit_xor", "group_concat", "json_arrayagg", "json_objectagg",
+    "std", "stddev", "stddev_pop", "stddev_samp", "var_pop", "var_samp", "variance", NULL
+};
+
+struct SelectItem
+{
+    bool                         aggregate;
+    ResultMerger::aggregate_type type;
+    bool                         star;
+    std::string                  name;  /**< Name of a plain column reference */
+    std::string                  alias;
+};
+
+bool get_aggregate(const Token& token, ResultMerger::aggregate_type* pType)
+{
+    static const struct
+    {
+        const char*                  zName;
+        ResultMerger::aggregate_type type;
+    } aggregates[] =
+    {
+        { "count", ResultMerger::AGG_COUNT },
+        { "sum", ResultMerger::AGG_SUM },
+        { "min", ResultMerger::AGG_MIN },
+        { "max", ResultMerger::AGG_MAX },
+    };
+
+    for (size_t i = 0; i < sizeof(aggregates) / sizeof(aggregates[0]); i++)
+    {
+        if (is_keyword(token, aggregates[i].zName))
+        {
+            *pType = aggregates[i].type;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool is_function_call(const Tokens& tokens, size_t i, size_t end)
+{
+    return tokens[i].type == TOK_WORD && !tokens[i].quoted && i + 1 < end && is_punct(tokens[i + 1], '(');
+}
+
+/**
+ * Parse the optional alias of a select item
+ */
+bool parse_alias(const Tokens& tokens, size_t begin, size_t end, SelectItem* pItem)
+{
+    if (begin < end && is_keyword(tokens[begin], "as"))
+    {
+        ++begin;
+
+        if (begin == end)
+        {
+            return false;
+        }
+    }
+
+    if (begin == end)
+    {
+        return true;
+    }
+
+    if (begin + 1 == end && (tokens[begin].type == TOK_WORD || tokens[begin].type == TOK_STRING))
+    {
+        pItem->alias = tokens[begin].text;
+        std::transform(pItem->alias.begin(), pItem->alias.end(), pItem->alias.begin(), ::tolower);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Analyze one expression of the select list
+ */
+bool parse_select_item(const Tokens& tokens, size_t begin, size_t end, SelectItem* pItem)
+{
+    pItem->aggregate = false;
+    pItem->type = ResultMerger::AGG_COUNT;
+    pItem->star = false;
+
+    if (begin == end)
+    {
+        return false;
+    }
+
+    ResultMerger::aggregate_type type;
+
+    if (is_function_call(tokens, begin, end) && get_aggregate(tokens[begin], &type))
+    {
+        size_t close = begin + 2;
+
+        while (close < end && !(is_punct(tokens[close], ')') && tokens[close].depth == tokens[begin].depth))
+        {
+            ++close;
+        }
+
+        if (close == end || close == begin + 2)
+        {
+            return false;
+        }
+
+        if ((type == ResultMerger::AGG_COUNT || type == ResultMerger::AGG_SUM) &&
+            is_keyword(tokens[begin + 2], "distinct"))
+        {
+            // The sum of distinct values on each shard is not the sum of distinct values
+            return false;
+        }
+
+        pItem->aggregate = true;
+        pItem->type = type;
+
+        // A lone aggregate is merged, an expression using an aggregate is not
+        return parse_alias(tokens, close + 1, end, pItem);
+    }
+
+    for (size_t i = begin; i < end; i++)
+    {
+        ResultMerger::aggregate_type unused;
+
+        if (is_keyword(tokens[i], "over") ||
+            (is_function_call(tokens, i, end) &&
+             (get_aggregate(tokens[i], &unused) || is_one_of(tokens[i], unsupported_aggregates))))
+        {
+            return false;
+        }
+    }
+
+    // Check whether the expression is a plain column reference: [[db.]table.]column
+    size_t i = begin;
+
+    while (i < end)
+    {
+        if (tokens[i].type == TOK_WORD)
+        {
+            pItem->name = tokens[i].text;
+        }
+        else if (is_punct(tokens[i], '*'))
+        {
+            pItem->star = true;
+        }
+        else
+        {
+            break;
+        }
+
+        ++i;
+
+        if (pItem->star || i == end || !is_punct(tokens[i], '.'))
+        {
+            break;
+        }
+
+        ++i;
+    }
+
+    if (i < end && (pItem->star || pItem->name.length()) && parse_alias(tokens, i, end, pItem))
+    {
+        return true;
+    }
+    else if (i == end)
+    {
+        return true;
+    }
+
+    // Some other expression, it can only be referred to by its alias
+    pItem->name.clear();
+    pItem->star = false;
+    pItem->alias.clear();
+
+    if (end - begin >= 2 && is_keyword(tokens[end - 2], "as"))
+    {
+        return parse_alias(tokens, end - 2, end, pItem);
+    }
+
+    return true;
+}
+
+/**
+ * Find the select list column an ORDER BY expression refers to
+ */
+bool parse_sort_key(const Tokens& tokens, size_t begin, size_t end,
+                    const std::vector<SelectItem>& items, ResultMerger::SortKey* pKey)
+{
+    pKey->descending = false;
+
+    if (end > begin && (is_keyword(tokens[end - 1], "asc") || is_keyword(tokens[end - 1], "desc")))
+    {
+        pKey->descending = is_keyword(tokens[end - 1], "desc");
+        --end;
+    }
+
+    if (begin + 1 == end && tokens[begin].type == TOK_NUMBER)
+    {
+        char* endptr;
+        unsigned long position = strtoul(tokens[begin].text.c_str(), &endptr, 10);
+
+        if (*endptr || position == 0 || position > items.size())
+        {
+            return false;
+        }
+
+        pKey->column = position - 1;
+        return true;
+    }
+
+    // A column reference: [[db.]table.]column or an alias
+    std::string name;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        if ((i - begin) % 2 == 0 ? tokens[i].type != TOK_WORD : !is_punct(tokens[i], '.'))
+        {
+            return false;
+        }
+
+        name = tokens[i].text;
+    }
+
+    if (name.empty() || is_punct(tokens[end - 1], '.'))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        if (items[i].alias == name)
+        {
+            pKey->column = i;
+            return true;
+        }
+    }
+
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        if (items[i].alias.empty() && items[i].name == name)
+        {
+            pKey->column = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * A decimal number
+ */
+struct Decimal
+{
+    bool        negative;
+    std::string integer;
+    std::string fraction;
+};
+
+bool parse_decimal(const std::string& str, Decimal* pDec)
+{
+    size_t i = 0;
+    pDec->negative = false;
+
+    if (i < str.length() && (str[i] == '-' || str[i] == '+'))
+    {
+        pDec->negative = str[i] == '-';
+        ++i;
+    }
+
+    size_t start = i;
+
+    while (i < str.length() && isdigit(str[i]))
+    {
+        ++i;
+    }
+
+    pDec->integer = str.substr(start, i - start);
+    pDec->fraction.clear();
+
+    if (i < str.length() && str[i] == '.')
+    {
+        start = ++i;
+
+        while (i < str.length() && isdigit(str[i]))
+        {
+            ++i;
+        }
+
+        pDec->fraction = str.substr(start, i - start);
+    }
+
+    pDec->integer.erase(0, pDec->integer.find_first_not_of('0'));
+
+    return i == str.length() && i > 0 && (start < i || pDec->integer.length());
+}
+
+/**
+ * Convert the absolute value of a decimal into digits with the given scale
+ */
+std::string decimal_digits(const Decimal& dec, size_t scale, size_t length)
+{
+    std::string digits = dec.integer + dec.fraction + std::string(scale - dec.fraction.length(), '0');
+    return std::string(length - std::min(length, digits.length()), '0') + digits;
+}
+
+int compare_decimal(const Decimal& lhs, const Decimal& rhs)
+{
+    size_t scale = std::max(lhs.fraction.length(), rhs.fraction.length());
+    size_t length = std::max(lhs.integer.length(), rhs.integer.length()) + scale;
+    std::string l = decimal_digits(lhs, scale, length);
+    std::string r = decimal_digits(rhs, scale, length);
+    bool l_zero = l.find_first_not_of('0') == std::string::npos;
+    bool r_zero = r.find_first_not_of('0') == std::string::npos;
+    bool l_neg = lhs.negative && !l_zero;
+    bool r_neg = rhs.negative && !r_zero;
+
+    if (l_neg != r_neg)
+    {
+        return l_neg ? -1 : 1;
+    }
+
+    int rval = l.compare(r);
+    rval = rval < 0 ? -1 : (rval > 0 ? 1 : 0);
+
+    return l_neg ? -rval : rval;
+}
+
+std::string add_decimal(const Decimal& lhs, const Decimal& rhs)
+{
+    size_t scale = std::max(lhs.fraction.length(), rhs.fraction.length());
+    size_t length = std::max(lhs.integer.length(), rhs.integer.length()) + scale + 1;
+    std::string l = decimal_digits(lhs, scale, length);
+    std::string r = decimal_digits(rhs, scale, length);
+    std::string result(length, '0');
+    bool negative = lhs.negative;
+
+    if (lhs.negative == rhs.negative)
+    {
+        int carry = 0;
+
+        for (size_t i = length; i-- > 0;)
+        {
+            int sum = (l[i] - '0') + (r[i] - '0') + carry;
+            result[i] = '0' + sum % 10;
+            carry = sum / 10;
+        }
+    }
+    else
+    {
+        if (l.compare(r) < 0)
+        {
+            std::swap(l, r);
+            negative = rhs.negative;
+        }
+
+        int borrow = 0;
+
+        for (size_t i = length; i-- > 0;)
+        {
+            int diff = (l[i] - '0') - (r[i] - '0') - borrow;
+            borrow = diff < 0;
+            result[i] = '0' + (diff + 10) % 10;
+        }
+    }
+
+    std::string integer = result.substr(0, length - scale);
+    integer.erase(0, std::min(integer.find_first_not_of('0'), integer.length() - 1));
+
+    if (result.find_first_not_of('0') == std::string::npos)
+    {
+        negative = false;
+    }
+
+    std::string rval = negative ? "-" : "";
+    rval += integer;
+
+    if (scale)
+    {
+        rval += ".";
+        rval += result.substr(length - scale);
+    }
+
+    return rval;
+}
+
+std::string format_double(double value)
+{
+    char buf[64];
+
+    // Use the shortest representation that is read back as the same value
+    for (int precision = 15; precision <= 17; precision++)
+    {
+        snprintf(buf, sizeof(buf), "%.*g", precision, value);
+
+        if (strtod(buf, NULL) == value)
+        {
+            break;
+        }
+    }
+
+    return buf;
+}
+
+bool is_floating_point(uint8_t type)
+{
+    return type == MYSQL_TYPE_FLOAT || type == MYSQL_TYPE_DOUBLE;
+}
+
+bool is_exact_numeric(uint8_t type)
+{
+    switch (type)
+    {
+    case MYSQL_TYPE_DECIMAL:
+    case MYSQL_TYPE_NEWDECIMAL:
+    case MYSQL_TYPE_TINY:
+    case MYSQL_TYPE_SHORT:
+    case MYSQL_TYPE_LONG:
+    case MYSQL_TYPE_INT24:
+    case MYSQL_TYPE_LONGLONG:
+    case MYSQL_TYPE_YEAR:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/** The character set number of binary strings */
+const uint16_t BINARY_CHARSET = 63;
+
+int compare_strings(const std::string& lhs, const std::string& rhs, bool binary)
+{
+    size_t len = std::min(lhs.length(), rhs.length());
+
+    for (size_t i = 0; i < len; i++)
+    {
+        int l = (unsigned char)lhs[i];
+        int r = (unsigned char)rhs[i];
+
+        if (!binary)
+        {
+            // Approximates the case-insensitive default collations
+            l = tolower(l);
+            r = tolower(r);
+        }
+
+        if (l != r)
+        {
+            return l < r ? -1 : 1;
+        }
+    }
+
+    return lhs.length() < rhs.length() ? -1 : (lhs.length() > rhs.length() ? 1 : 0);
+}
+
+int compare_values(const ResultMerger::Value& lhs, const ResultMerger::Value& rhs,
+                   uint8_t type, uint16_t charset)
+{
+    if (lhs.null || rhs.null)
+    {
+        // NULL is smaller than any other value
+        return lhs.null == rhs.null ? 0 : (lhs.null ? -1 : 1);
+    }
+
+    Decimal l;
+    Decimal r;
+
+    if (is_exact_numeric(type) && parse_decimal(lhs.data, &l) && parse_decimal(rhs.data, &r))
+    {
+        return compare_decimal(l, r);
+    }
+    else if (is_exact_numeric(type) || is_floating_point(type))
+    {
+        double l = strtod(lhs.data.c_str(), NULL);
+        double r = strtod(rhs.data.c_str(), NULL);
+        return l < r ? -1 : (l > r ? 1 : 0);
+    }
+
+    return compare_strings(lhs.data, rhs.data, charset == BINARY_CHARSET);
+}
+
+std::string add_values(const std::string& lhs, const std::string& rhs, uint8_t type)
+{
+    Decimal l;
+    Decimal r;
+
+    if (!is_floating_point(type) && parse_decimal(lhs, &l) && parse_decimal(rhs, &r))
+    {
+        return add_decimal(l, r);
+    }
+
+    return format_double(strtod(lhs.c_str(), NULL) + strtod(rhs.c_str(), NULL));
+}
+
+size_t lenenc_length(uint64_t value)
+{
+    return value < 0xfb ? 1 : (value <= 0xffff ? 3 : (value <= 0xffffff ? 4 : 9));
+}
+
+uint8_t* write_lenenc(uint8_t* ptr, uint64_t value)
+{
+    if (value < 0xfb)
+    {
+        *ptr++ = value;
+    }
+    else if (value <= 0xffff)
+    {
+        *ptr++ = 0xfc;
+        gw_mysql_set_byte2(ptr, value);
+        ptr += 2;
+    }
+    else if (value <= 0xffffff)
+    {
+        *ptr++ = 0xfd;
+        gw_mysql_set_byte3(ptr, value);
+        ptr += 3;
+    }
+    else
+    {
+        *ptr++ = 0xfe;
+
+        for (int i = 0; i < 8; i++)
+        {
+            *ptr++ = value >> (i * 8);
+        }
+    }
+
+    return ptr;
+}
+
+GWBUF* create_row(const ResultMerger::Values& values)
+{
+    size_t len = 0;
+
+    for (ResultMerger::Values::const_iterator it = values.begin(); it != values.end(); it++)
+    {
+        len += it->null ? 1 : lenenc_length(it->data.length()) + it->data.length();
+    }
+
+    GWBUF* pRow = gwbuf_alloc(MYSQL_HEADER_LEN + len);
+
+    if (pRow)
+    {
+        uint8_t* ptr = GWBUF_DATA(pRow);
+        gw_mysql_set_byte3(ptr, len);
+        ptr += 3;
+        *ptr++ = 0;
+
+        for (ResultMerger::Values::const_iterator it = values.begin(); it != values.end(); it++)
+        {
+            if (it->null)
+            {
+                *ptr++ = 0xfb;
+            }
+            else
+            {
+                ptr = write_lenenc(ptr, it->data.length());
+                memcpy(ptr, it->data.c_str(), it->data.length());
+                ptr += it->data.length();
+            }
+        }
+    }
+
+    return pRow;
+}
+
+GWBUF* create_eof(uint16_t warnings, uint16_t status)
+{
+    GWBUF* pEof = gwbuf_alloc(MYSQL_EOF_PACKET_LEN);
+
+    if (pEof)
+    {
+        uint8_t* ptr = GWBUF_DATA(pEof);
+        gw_mysql_set_byte3(ptr, MYSQL_EOF_PACKET_LEN - MYSQL_HEADER_LEN);
+        ptr[3] = 0;
+        ptr[4] = MYSQL_REPLY_EOF;
+        gw_mysql_set_byte2(ptr + 5, warnings);
+        gw_mysql_set_byte2(ptr + 7, status);
+    }
+
+    return pEof;
+}
+
+bool is_eof(const uint8_t* pPacket)
+{
+    return pPacket[MYSQL_HEADER_LEN] == MYSQL_REPLY_EOF &&
+           MYSQL_GET_PAYLOAD_LEN(pPacket) + MYSQL_HEADER_LEN == MYSQL_EOF_PACKET_LEN;
+}
+
+}
+
+namespace schemarouter
+{
+
+bool ResultMerger::parse(const char* zSql, size_t len, MergeInfo* info)
+{
+    Tokens tokens;
+
+    if (!tokenize(zSql, len, tokens) || tokens.empty() || !is_keyword(tokens[0], "select"))
+    {
+        return false;
+    }
+
+    size_t n = tokens.size();
+    size_t i = 1;
+
+    while (i < n && is_one_of(tokens[i], select_modifiers))
+    {
+        ++i;
+    }
+
+    if (i < n && (is_keyword(tokens[i], "distinct") || is_keyword(tokens[i], "distinctrow") ||
+                  is_keyword(tokens[i], "sql_calc_found_rows")))
+    {
+        // Duplicates and the number of found rows are not known for the merged result
+        return false;
+    }
+
+    // Find the end of the select list
+    size_t list_begin = i;
+
+    while (i < n && !(tokens[i].depth == 0 && is_one_of(tokens[i], select_clauses)))
+    {
+        ++i;
+    }
+
+    size_t list_end = i;
+    size_t order_begin = n;
+    size_t limit_begin = n;
+
+    for (; i < n; i++)
+    {
+        const Token& token = tokens[i];
+
+        if (token.depth != 0)
+        {
+            continue;
+        }
+
+        if (is_one_of(token, unmergeable_clauses))
+        {
+            return false;
+        }
+        else if (is_keyword(token, "order"))
+        {
+            if (order_begin != n || limit_begin != n || i + 1 == n || !is_keyword(tokens[i + 1], "by"))
+            {
+                return false;
+            }
+
+            order_begin = i + 2;
+            ++i;
+        }
+        else if (is_keyword(token, "limit"))
+        {
+            if (limit_begin != n)
+            {
+                return false;
+            }
+
+            limit_begin = i + 1;
+        }
+        else if ((is_keyword(token, "from") || is_keyword(token, "where")) &&
+                 (order_begin != n || limit_begin != n))
+        {
+            return false;
+        }
+    }
+
+    // Analyze the select list
+    std::vector<SelectItem> items;
+    size_t n_aggregates = 0;
+    bool star = false;
+    size_t item_begin = list_begin;
+
+    for (i = list_begin; i <= list_end; i++)
+    {
+        if (i == list_end || (tokens[i].depth == 0 && is_punct(tokens[i], ',')))
+        {
+            SelectItem item;
+
+            if (!parse_select_item(tokens, item_begin, i, &item))
+            {
+                return false;
+            }
+
+            n_aggregates += item.aggregate;
+            star = star || item.star;
+            items.push_back(item);
+            item_begin = i + 1;
+        }
+    }
+
+    info->aggregates.clear();
+    info->keys.clear();
+    info->limit = std::numeric_limits<uint64_t>::max();
+
+    if (limit_begin != n)
+    {
+        char* endptr;
+
+        if (limit_begin + 1 != n || tokens[limit_begin].type != TOK_NUMBER)
+        {
+            // LIMIT with an offset can't be applied on the shards
+            return false;
+        }
+
+        info->limit = strtoull(tokens[limit_begin].text.c_str(), &endptr, 10);
+
+        if (*endptr)
+        {
+            return false;
+        }
+    }
+
+    if (n_aggregates)
+    {
+        if (n_aggregates != items.size() || info->limit == 0)
+        {
+            // Without GROUP BY the other columns would come from an arbitrary shard
+            return false;
+        }
+
+        for (std::vector<SelectItem>::iterator it = items.begin(); it != items.end(); it++)
+        {
+            info->aggregates.push_back(it->type);
+        }
+
+        info->mode = MERGE_AGGREGATE;
+    }
+    else if (order_begin != n)
+    {
+        if (star)
+        {
+            // The position of the columns in the result is not known
+            return false;
+        }
+
+        if (limit_begin == n || info->limit > MAX_ORDERED_LIMIT)
+        {
+            // Without a small LIMIT, a whole result could end up being buffered
+            return false;
+        }
+
+        size_t order_end = limit_begin != n ? limit_begin - 1 : n;
+        size_t key_begin = order_begin;
+
+        for (i = order_begin; i <= order_end; i++)
+        {
+            if (i == order_end || (tokens[i].depth == 0 && is_punct(tokens[i], ',')))
+            {
+                SortKey key;
+
+                if (!parse_sort_key(tokens, key_begin, i, items, &key))
+                {
+                    return false;
+                }
+
+                info->keys.push_back(key);
+                key_begin = i + 1;
+            }
+        }
+
+        info->mode = MERGE_ORDERED;
+    }
+    else
+    {
+        info->mode = MERGE_CONCAT;
+    }
+
+    return true;
+}
+
+ResultMerger::ResultMerger(const MergeInfo& info, size_t n_shards):
+    m_info(info),
+    m_shards(n_shards),
+    m_pOutput(NULL),
+    m_pError(NULL),
+    m_rows_sent(0),
+    m_warnings(0),
+    m_status(0),
+    m_seq(1),
+    m_header_sent(false),
+    m_complete(false)
+{
+    for (std::vector<aggregate_type>::iterator it = m_info.aggregates.begin();
+         it != m_info.aggregates.end(); it++)
+    {
+        Value value;
+        value.null = *it != AGG_COUNT;
+        value.data = *it == AGG_COUNT ? "0" : "";
+        m_aggregates.push_back(value);
+    }
+}
+
+ResultMerger::~ResultMerger()
+{
+    for (std::vector<ShardResult>::iterator it = m_shards.begin(); it != m_shards.end(); it++)
+    {
+        gwbuf_free(it->pPending);
+        gwbuf_free(it->pHeader);
+        gwbuf_free(it->pLarge);
+
+        for (std::deque<Row>::iterator row = it->rows.begin(); row != it->rows.end(); row++)
+        {
+            gwbuf_free(row->pBuffer);
+        }
+    }
+
+    gwbuf_free(m_pOutput);
+    gwbuf_free(m_pError);
+}
+
+ResultMerger* ResultMerger::create(GWBUF* pStmt, size_t n_shards)
+{
+    ResultMerger* rval = NULL;
+    MergeInfo info;
+    char* zSql;
+    int len;
+
+    if (n_shards > 0 && modutil_extract_SQL(pStmt, &zSql, &len) && parse(zSql, len, &info))
+    {
+        rval = new (std::nothrow) ResultMerger(info, n_shards);
+    }
+
+    return rval;
+}
+
+GWBUF* ResultMerger::process(size_t shard, GWBUF* pReply)
+{
+    ss_dassert(shard < m_shards.size());
+    ShardResult& result = m_shards[shard];
+    result.pPending = gwbuf_append(result.pPending, pReply);
+    GWBUF* pPacket;
+
+    while (result.state != SHARD_DONE &&
+           (pPacket = modutil_get_next_MySQL_packet(&result.pPending)))
+    {
+        process_packet(result, gwbuf_make_contiguous(pPacket));
+    }
+
+    if (result.state == SHARD_DONE)
+    {
+        gwbuf_free(result.pPending);
+        result.pPending = NULL;
+    }
+
+    return flush();
+}
+
+GWBUF* ResultMerger::fail(size_t shard, const char* zMessage)
+{
+    ss_dassert(shard < m_shards.size());
+    ShardResult& result = m_shards[shard];
+
+    if (result.state != SHARD_DONE)
+    {
+        process_error(result, modutil_create_mysql_err_msg(1, 0, 2013, "HY000", zMessage));
+    }
+
+    return flush();
+}
+
+bool ResultMerger::shard_complete(size_t shard) const
+{
+    ss_dassert(shard < m_shards.size());
+    return m_shards[shard].state == SHARD_DONE;
+}
+
+bool ResultMerger::complete() const
+{
+    return m_complete;
+}
+
+void ResultMerger::process_packet(ShardResult& result, GWBUF* pPacket)
+{
+    uint8_t* data = GWBUF_DATA(pPacket);
+    uint8_t cmd = MYSQL_GET_PAYLOAD_LEN(data) ? data[MYSQL_HEADER_LEN] : 0;
+
+    switch (result.state)
+    {
+    case SHARD_COLUMN_COUNT:
+        if (cmd == MYSQL_REPLY_ERR)
+        {
+            process_error(result, pPacket);
+        }
+        else if (cmd == MYSQL_REPLY_OK)
+        {
+            gwbuf_free(pPacket);
+            process_error(result, modutil_create_mysql_err_msg(1, 0, 1105, "HY000",
+                                                               "Shard did not return a result set"));
+        }
+        else
+        {
+            result.pHeader = pPacket;
+            result.state = SHARD_COLUMNS;
+        }
+        break;
+
+    case SHARD_COLUMNS:
+        result.pHeader = gwbuf_append(result.pHeader, pPacket);
+
+        if (is_eof(data))
+        {
+            result.state = SHARD_ROWS;
+
+            if (m_header_sent)
+            {
+                gwbuf_free(result.pHeader);
+            }
+            else
+            {
+                send_header(result.pHeader);
+            }
+
+            result.pHeader = NULL;
+        }
+        break;
+
+    case SHARD_ROWS:
+        if (result.pLarge == NULL && is_eof(data))
+        {
+            process_eof(result, pPacket);
+        }
+        else if (result.pLarge == NULL && cmd == MYSQL_REPLY_ERR)
+        {
+            process_error(result, pPacket);
+        }
+        else if (MYSQL_GET_PAYLOAD_LEN(data) == GW_MYSQL_MAX_PACKET_LEN)
+        {
+            // The row continues in the next packet
+            result.pLarge = gwbuf_append(result.pLarge, pPacket);
+        }
+        else
+        {
+            GWBUF* pRow = gwbuf_append(result.pLarge, pPacket);
+            result.pLarge = NULL;
+            process_row(result, pRow);
+        }
+        break;
+
+    default:
+        ss_dassert(!true);
+        gwbuf_free(pPacket);
+        break;
+    }
+}
+
+void ResultMerger::process_row(ShardResult& result, GWBUF* pRow)
+{
+    switch (m_info.mode)
+    {
+    case MERGE_CONCAT:
+        if (m_rows_sent < m_info.limit)
+        {
+            ++m_rows_sent;
+            send(pRow);
+        }
+        else
+        {
+            gwbuf_free(pRow);
+        }
+        break;
+
+    case MERGE_ORDERED:
+        if (m_rows_sent < m_info.limit)
+        {
+            Row row;
+            row.pBuffer = pRow;
+
+            if (!read_values(pRow, row.keys, true))
+            {
+                MXS_ERROR("Malformed row in a result set.");
+            }
+
+            result.rows.push_back(row);
+        }
+        else
+        {
+            gwbuf_free(pRow);
+        }
+        break;
+
+    case MERGE_AGGREGATE:
+        {
+            Values values;
+
+            if (read_values(pRow, values, false))
+            {
+                aggregate(values);
+            }
+            else
+            {
+                MXS_ERROR("Malformed row in a result set.");
+            }
+
+            gwbuf_free(pRow);
+        }
+        break;
+    }
+}
+
+void ResultMerger::process_error(ShardResult& result, GWBUF* pError)
+{
+    if (m_pError == NULL)
+    {
+        m_pError = pError;
+    }
+    else
+    {
+        gwbuf_free(pError);
+    }
+
+    for (std::deque<Row>::iterator it = result.rows.begin(); it != result.rows.end(); it++)
+    {
+        gwbuf_free(it->pBuffer);
+    }
+
+    result.rows.clear();
+    gwbuf_free(result.pHeader);
+    gwbuf_free(result.pLarge);
+    result.pHeader = NULL;
+    result.pLarge = NULL;
+    result.state = SHARD_DONE;
+}
+
+void ResultMerger::process_eof(ShardResult& result, GWBUF* pEof)
+{
+    uint8_t* data = GWBUF_DATA(pEof) + MYSQL_HEADER_LEN + 1;
+    m_warnings += gw_mysql_get_byte2(data);
+    m_status = gw_mysql_get_byte2(data + 2);
+    gwbuf_free(pEof);
+    result.state = SHARD_DONE;
+}
+
+void ResultMerger::send_header(GWBUF* pHeader)
+{
+    // The first buffer is the column count, then come the column definitions and an EOF
+    for (GWBUF* pCol = pHeader->next; pCol && pCol->next; pCol = pCol->next)
+    {
+        uint8_t* ptr = GWBUF_DATA(pCol) + MYSQL_HEADER_LEN;
+        uint8_t* end = GWBUF_DATA(pCol) + GWBUF_LENGTH(pCol);
+        Column column = {MYSQL_TYPE_STRING, 0};
+
+        // Skip catalog, schema, table, org_table, name and org_name
+        for (int i = 0; i < 6 && ptr < end; i++)
+        {
+            ptr += mxs_leint_bytes(ptr) + mxs_leint_value(ptr);
+        }
+
+        if (ptr < end)
+        {
+            // Skip the length of the fixed length fields
+            ptr += mxs_leint_bytes(ptr);
+        }
+
+        if (ptr + 7 <= end)
+        {
+            column.charset = gw_mysql_get_byte2(ptr);
+            column.type = ptr[6];
+        }
+
+        m_columns.push_back(column);
+    }
+
+    m_header_sent = true;
+    send(pHeader);
+}
+
+void ResultMerger::send_rows()
+{
+    if (m_info.mode != MERGE_ORDERED || !m_header_sent)
+    {
+        return;
+    }
+
+    while (true)
+    {
+        ShardResult* pMin = NULL;
+
+        for (std::vector<ShardResult>::iterator it = m_shards.begin(); it != m_shards.end(); it++)
+        {
+            if (it->rows.empty())
+            {
+                if (it->state != SHARD_DONE)
+                {
+                    // The next row of this shard is needed before anything can be sent
+                    return;
+                }
+            }
+            else if (pMin == NULL || compare(it->rows.front(), pMin->rows.front()) < 0)
+            {
+                pMin = &(*it);
+            }
+        }
+
+        if (pMin == NULL)
+        {
+            break;
+        }
+
+        GWBUF* pRow = pMin->rows.front().pBuffer;
+        pMin->rows.pop_front();
+
+        if (m_rows_sent < m_info.limit)
+        {
+            ++m_rows_sent;
+            send(pRow);
+        }
+        else
+        {
+            gwbuf_free(pRow);
+        }
+    }
+}
+
+void ResultMerger::send(GWBUF* pPacket)
+{
+    // Each buffer in the chain is one packet
+    for (GWBUF* pBuf = pPacket; pBuf; pBuf = pBuf->next)
+    {
+        GWBUF_DATA(pBuf)[MYSQL_HEADER_LEN - 1] = m_seq++;
+    }
+
+    m_pOutput = gwbuf_append(m_pOutput, pPacket);
+}
+
+void ResultMerger::finish()
+{
+    if (m_complete)
+    {
+        return;
+    }
+
+    for (std::vector<ShardResult>::iterator it = m_shards.begin(); it != m_shards.end(); it++)
+    {
+        if (it->state != SHARD_DONE)
+        {
+            return;
+        }
+    }
+
+    if (m_pError)
+    {
+        send(m_pError);
+        m_pError = NULL;
+    }
+    else
+    {
+        ss_dassert(m_header_sent);
+
+        if (m_info.mode == MERGE_AGGREGATE)
+        {
+            send(create_row(m_aggregates));
+        }
+
+        send(create_eof(m_warnings, m_status & ~SERVER_MORE_RESULTS_EXIST));
+    }
+
+    m_complete = true;
+}
+
+GWBUF* ResultMerger::flush()
+{
+    send_rows();
+    finish();
+
+    GWBUF* rval = m_pOutput;
+    m_pOutput = NULL;
+    return rval;
+}
+
+void ResultMerger::aggregate(const Values& values)
+{
+    size_t n = std::min(values.size(), m_aggregates.size());
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const Value& value = values[i];
+        Value& current = m_aggregates[i];
+        const Column& column = m_columns[i];
+
+        if (value.null)
+        {
+            continue;
+        }
+
+        if (current.null)
+        {
+            current = value;
+            continue;
+        }
+
+        switch (m_info.aggregates[i])
+        {
+        case AGG_COUNT:
+        case AGG_SUM:
+            current.data = add_values(current.data, value.data, column.type);
+            break;
+
+        case AGG_MIN:
+            if (compare_values(value, current, column.type, column.charset) < 0)
+            {
+                current = value;
+            }
+            break;
+
+        case AGG_MAX:
+            if (compare_values(value, current, column.type, column.charset) > 0)
+            {
+                current = value;
+            }
+            break;
+        }
+    }
+}
+
+int ResultMerger::compare(const Row& lhs, const Row& rhs) const
+{
+    for (size_t i = 0; i < m_info.keys.size() && i < lhs.keys.size() && i < rhs.keys.size(); i++)
+    {
+        const Column& column = m_columns[m_info.keys[i].column];
+        int rval = compare_values(lhs.keys[i], rhs.keys[i], column.type, column.charset);
+
+        if (rval != 0)
+        {
+            return m_info.keys[i].descending ? -rval : rval;
+        }
+    }
+
+    return 0;
+}
+
+bool ResultMerger::read_values(GWBUF* pRow, Values& values, bool keys_only) const
+{
+    std::string payload;
+    const uint8_t* ptr;
+    const uint8_t* end;
+
+    if (pRow->next == NULL)
+    {
+        ptr = GWBUF_DATA(pRow) + MYSQL_HEADER_LEN;
+        end = GWBUF_DATA(pRow) + GWBUF_LENGTH(pRow);
+    }
+    else
+    {
+        // A row that spans multiple packets
+        for (GWBUF* pBuf = pRow; pBuf; pBuf = pBuf->next)
+        {
+            payload.append((char*)GWBUF_DATA(pBuf) + MYSQL_HEADER_LEN,
+                           GWBUF_LENGTH(pBuf) - MYSQL_HEADER_LEN);
+        }
+
+        ptr = (const uint8_t*)payload.data();
+        end = ptr + payload.length();
+    }
+
+    Values row;
+
+    for (size_t i = 0; i < m_columns.size(); i++)
+    {
+        Value value;
+
+        if (ptr >= end)
+        {
+            return false;
+        }
+        else if (*ptr == 0xfb)
+        {
+            value.null = true;
+            ++ptr;
+        }
+        else
+        {
+            size_t bytes = mxs_leint_bytes(ptr);
+            uint64_t len = mxs_leint_value(ptr);
+
+            if (ptr + bytes + len > end)
+            {
+                return false;
+            }
+
+            value.null = false;
+            value.data.assign((const char*)ptr + bytes, len);
+            ptr += bytes + len;
+        }
+
+        row.push_back(value);
+    }
+
+    if (keys_only)
+    {
+        for (std::vector<SortKey>::const_iterator it = m_info.keys.begin(); it != m_info.keys.end(); it++)
+        {
+            if (it->column >= row.size())
+            {
+                return false;
+            }
+
+            values.push_back(row[it->column]);
+        }
+    }
+    else
+    {
+        values.swap(row);
+    }
+
+    return true;
+}
+
+}
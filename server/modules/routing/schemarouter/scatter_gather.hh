@@ -0,0 +1,209 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/cppdefs.hh>
+
+#include <deque>
+#include <string>
+#include <tr1/memory>
+#include <vector>
+
+#include <maxscale/buffer.h>
+
+namespace schemarouter
+{
+
+/**
+ * Merges the results of a SELECT that is executed on multiple shards
+ *
+ * The replies are processed one packet at a time as they arrive from the
+ * shards and only the rows that can't be sent yet are kept in memory. Plain
+ * results are concatenated, ordered results are merged according to the
+ * ORDER BY clause and COUNT, SUM, MIN and MAX aggregates are combined into
+ * a single row. A LIMIT clause is applied to the merged result.
+ */
+class ResultMerger
+{
+public:
+    ~ResultMerger();
+
+    /**
+     * @brief Create a merger for a statement
+     *
+     * @param pStmt    The statement that is executed on the shards
+     * @param n_shards Number of shards the statement is executed on
+     *
+     * @return A new merger or NULL if the results of the statement can't be merged
+     */
+    static ResultMerger* create(GWBUF* pStmt, size_t n_shards);
+
+    /**
+     * @brief Process a reply from a shard
+     *
+     * @param shard  Index of the shard
+     * @param pReply The reply, does not need to consist of complete packets
+     *
+     * @return The data that can be sent to the client or NULL if there is none
+     */
+    GWBUF* process(size_t shard, GWBUF* pReply);
+
+    /**
+     * @brief Fail a shard that can't return its result
+     *
+     * The client receives the error once the other shards have completed.
+     *
+     * @param shard    Index of the shard
+     * @param zMessage The error message
+     *
+     * @return The data that can be sent to the client or NULL if there is none
+     */
+    GWBUF* fail(size_t shard, const char* zMessage);
+
+    /**
+     * @brief Check if a shard has returned its whole result
+     *
+     * @param shard Index of the shard
+     *
+     * @return True if no more data is expected from the shard
+     */
+    bool shard_complete(size_t shard) const;
+
+    /**
+     * @brief Check if the whole result has been sent to the client
+     *
+     * @return True if the merged result is complete
+     */
+    bool complete() const;
+
+    enum merge_mode
+    {
+        MERGE_CONCAT,
+        MERGE_ORDERED,
+        MERGE_AGGREGATE
+    };
+
+    enum aggregate_type
+    {
+        AGG_COUNT,
+        AGG_SUM,
+        AGG_MIN,
+        AGG_MAX
+    };
+
+    struct SortKey
+    {
+        size_t column;
+        bool   descending;
+    };
+
+    struct Value
+    {
+        bool        null;
+        std::string data;
+    };
+
+    typedef std::vector<Value> Values;
+
+    /** How the results of a statement are merged */
+    struct MergeInfo
+    {
+        merge_mode                  mode;
+        std::vector<aggregate_type> aggregates; /**< Aggregate of each column */
+        std::vector<SortKey>        keys;       /**< ORDER BY columns */
+        uint64_t                    limit;      /**< Maximum number of rows */
+    };
+
+    /**
+     * @brief Find out how the results of a statement can be merged
+     *
+     * @param zSql The SQL statement
+     * @param len  Length of the statement
+     * @param info The merge information
+     *
+     * @return True if the results of the statement can be merged
+     */
+    static bool parse(const char* zSql, size_t len, MergeInfo* info);
+
+private:
+    enum shard_state
+    {
+        SHARD_COLUMN_COUNT,
+        SHARD_COLUMNS,
+        SHARD_ROWS,
+        SHARD_DONE
+    };
+
+    struct Row
+    {
+        GWBUF* pBuffer;
+        Values keys;
+    };
+
+    struct ShardResult
+    {
+        ShardResult():
+            state(SHARD_COLUMN_COUNT),
+            pPending(NULL),
+            pHeader(NULL),
+            pLarge(NULL)
+        {
+        }
+
+        shard_state     state;
+        GWBUF*          pPending; /**< Data that does not form a complete packet */
+        GWBUF*          pHeader;  /**< The column count and column definitions */
+        GWBUF*          pLarge;   /**< Packets of a row that spans multiple packets */
+        std::deque<Row> rows;     /**< Rows waiting to be merged */
+    };
+
+    struct Column
+    {
+        uint8_t  type;
+        uint16_t charset;
+    };
+
+    ResultMerger(const MergeInfo& info, size_t n_shards);
+    ResultMerger(const ResultMerger&);
+    ResultMerger& operator=(const ResultMerger&);
+
+    void process_packet(ShardResult& shard, GWBUF* pPacket);
+    void process_row(ShardResult& shard, GWBUF* pRow);
+    void process_error(ShardResult& shard, GWBUF* pError);
+    void process_eof(ShardResult& shard, GWBUF* pEof);
+    void send_header(GWBUF* pHeader);
+    void send_rows();
+    void send(GWBUF* pPacket);
+    void finish();
+    GWBUF* flush();
+    void aggregate(const Values& values);
+    int  compare(const Row& lhs, const Row& rhs) const;
+    bool read_values(GWBUF* pRow, Values& values, bool keys_only) const;
+
+    MergeInfo                m_info;
+    std::vector<ShardResult> m_shards;
+    std::vector<Column>      m_columns;     /**< Types of the result columns */
+    Values                   m_aggregates;  /**< Current values of the aggregates */
+    GWBUF*                   m_pOutput;     /**< Data to send to the client */
+    GWBUF*                   m_pError;      /**< The first error returned by a shard */
+    uint64_t                 m_rows_sent;   /**< Number of rows sent to the client */
+    uint16_t                 m_warnings;    /**< Number of warnings on all shards */
+    uint16_t                 m_status;      /**< Server status of the last shard to complete */
+    uint8_t                  m_seq;         /**< Next sequence number */
+    bool                     m_header_sent; /**< Whether the column definitions were sent */
+    bool                     m_complete;    /**< Whether the whole result was sent */
+};
+
+typedef std::tr1::shared_ptr<ResultMerger> SResultMerger;
+
+}
@@ -72,6 +72,7 @@ struct Stats
     int    sessions;         /*< Number of sessions */
     int    shmap_cache_hit;  /*< Shard map was found from the cache */
     int    shmap_cache_miss; /*< No shard map found from the cache */
+    int    n_scatter_gather; /*< Number of scatter-gather queries */
     double ses_longest;      /*< Longest session */
     double ses_shortest;     /*< Shortest session */
     double ses_average;      /*< Average session length */
@@ -84,6 +85,7 @@ struct Stats
         sessions(0),
         shmap_cache_hit(0),
         shmap_cache_miss(0),
+        n_scatter_gather(0),
         ses_longest(0.0),
         ses_shortest(std::numeric_limits<double>::max()),
         ses_average(0.0)
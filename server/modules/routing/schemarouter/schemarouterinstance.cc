@@ -333,6 +333,7 @@ void SchemaRouter::diagnostics(DCB* dcb)
     }
     dcb_printf(dcb, "Shard map cache hits: %d\n", m_stats.shmap_cache_hit);
     dcb_printf(dcb, "Shard map cache misses: %d\n", m_stats.shmap_cache_miss);
+    dcb_printf(dcb, "Scatter-gather queries: %d\n", m_stats.n_scatter_gather);
     dcb_printf(dcb, "\n");
 }
 
@@ -358,6 +359,7 @@ json_t* SchemaRouter::diagnostics_json() const
 
     json_object_set_new(rval, "shard_map_hits", json_integer(m_stats.shmap_cache_hit));
     json_object_set_new(rval, "shard_map_misses", json_integer(m_stats.shmap_cache_miss));
+    json_object_set_new(rval, "scatter_gather_queries", json_integer(m_stats.n_scatter_gather));
 
     return rval;
 }
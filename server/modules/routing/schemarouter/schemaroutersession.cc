@@ -17,6 +17,8 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include <maxscale/alloc.h>
 #include <maxscale/modutil.h>
 #include <maxscale/poll.h>
@@ -28,11 +30,14 @@ namespace schemarouter
 bool connect_backend_servers(SSRBackendList& backends, MXS_SESSION* session);
 
 enum route_target get_shard_route_target(uint32_t qtype);
-bool change_current_db(std::string& dest, Shard& shard, GWBUF* buf);
+bool change_current_db(std::string& dest, const Shard& shard, GWBUF* buf);
 bool extract_database(GWBUF* buf, char* str);
 bool detect_show_shards(GWBUF* query);
 void write_error_to_client(DCB* dcb, int errnum, const char* mysqlstate, const char* errmsg);
 
+/** How often a session waiting for the first shard map checks for it, in milliseconds */
+static const uint32_t SHARD_WAIT_INTERVAL = 10;
+
 SchemaRouterSession::SchemaRouterSession(MXS_SESSION* session, SchemaRouter* router,
                                          SSRBackendList& backends):
     mxs::RouterSession(session),
@@ -42,7 +47,10 @@ SchemaRouterSession::SchemaRouterSession(MXS_SESSION* session, SchemaRouter* rou
     m_backends(backends),
     m_config(&router->m_config),
     m_router(router),
-    m_shard(m_router->m_shard_manager.get_shard(m_client->user, m_config->refresh_min_interval)),
+    m_map_databases(false),
+    m_update(0),
+    m_shard(m_router->m_shard_manager.get_shard(m_client->user, m_config->refresh_min_interval,
+                                                &m_update)),
     m_state(0),
     m_sent_sescmd(0),
     m_replied_sescmd(0),
@@ -72,12 +80,26 @@ SchemaRouterSession::SchemaRouterSession(MXS_SESSION* session, SchemaRouter* rou
         m_state |= INIT_USE_DB;
     }
 
+    m_map_databases = m_update != 0;
+    mxs_worker_timer_init(&m_wait_timer, wait_for_shard_cb, this);
+
+    if (!m_shard)
+    {
+        /** Another session is building the first shard map */
+        m_state |= INIT_WAITING;
+    }
+
     if (db[0])
     {
         /* Store the database the client is connecting to */
         m_connect_db = db;
     }
 
+    if (!m_map_databases)
+    {
+        atomic_add(&m_router->m_stats.shmap_cache_hit, 1);
+    }
+
     atomic_add(&m_router->m_stats.sessions, 1);
 }
 
@@ -95,6 +117,8 @@ void SchemaRouterSession::close()
     if (!m_closed)
     {
         m_closed = true;
+        mxs_worker_timer_cancel(&m_wait_timer);
+        cancel_mapping();
 
         for (SSRBackendList::iterator it = m_backends.begin(); it != m_backends.end(); it++)
         {
@@ -276,9 +300,10 @@ int32_t SchemaRouterSession::routeQuery(GWBUF* pPacket)
         return 0;
     }
 
-    if (m_shard.empty())
+    if (m_map_databases)
     {
         /* Generate database list */
+        m_map_databases = false;
         query_databases();
     }
 
@@ -290,11 +315,16 @@ int32_t SchemaRouterSession::routeQuery(GWBUF* pPacket)
      * to store the query. Once the databases have been mapped and/or the
      * default database is taken into use we can send the query forward.
      */
-    if (m_state & (INIT_MAPPING | INIT_USE_DB))
+    if (m_state & (INIT_MAPPING | INIT_USE_DB | INIT_WAITING))
     {
         m_queue.push_back(pPacket);
         ret = 1;
 
+        if ((m_state & INIT_WAITING) && !mxs_worker_timer_is_active(&m_wait_timer))
+        {
+            mxs_worker_timer_add(&m_wait_timer, SHARD_WAIT_INTERVAL);
+        }
+
         if (m_state  == (INIT_READY | INIT_USE_DB))
         {
             /**
@@ -309,6 +339,17 @@ int32_t SchemaRouterSession::routeQuery(GWBUF* pPacket)
         return ret;
     }
 
+    if (m_merger)
+    {
+        /**
+         * The replies to a scatter-gather query are still being merged. The
+         * query is stored and routed once the merged result is complete so
+         * that the replies of the shards are not mixed.
+         */
+        m_queue.push_back(pPacket);
+        return 1;
+    }
+
     uint8_t command = 0;
     SERVER* target = NULL;
     uint32_t type = QUERY_TYPE_UNKNOWN;
@@ -354,7 +395,7 @@ int32_t SchemaRouterSession::routeQuery(GWBUF* pPacket)
         /** The default database changes must be routed to a specific server */
         if (command == MXS_COM_INIT_DB || op == QUERY_OP_CHANGE_DB)
         {
-            if (!change_current_db(m_current_db, m_shard, pPacket))
+            if (!change_current_db(m_current_db, *m_shard, pPacket))
             {
                 char db[MYSQL_DATABASE_MAXLEN + 1];
                 extract_database(pPacket, db);
@@ -378,7 +419,7 @@ int32_t SchemaRouterSession::routeQuery(GWBUF* pPacket)
             }
 
             route_target = TARGET_UNDEFINED;
-            target = m_shard.get_location(m_current_db);
+            target = m_shard->get_location(m_current_db);
 
             if (target)
             {
@@ -410,6 +451,11 @@ int32_t SchemaRouterSession::routeQuery(GWBUF* pPacket)
                 ret = 1;
             }
         }
+        else if (is_scatter_gather(pPacket, type, op, command) && route_scatter_gather(pPacket))
+        {
+            pPacket = NULL;
+            ret = 1;
+        }
         else if (target == NULL)
         {
             target = resolve_query_target(pPacket, type, command, route_target);
@@ -485,6 +531,7 @@ void SchemaRouterSession::handle_mapping_reply(SSRBackend& bref, GWBUF** pPacket
 
     if (rc == -1)
     {
+        cancel_mapping();
         poll_fake_hangup_event(m_client);
     }
 }
@@ -550,7 +597,13 @@ void SchemaRouterSession::clientReply(GWBUF* pPacket, DCB* pDcb)
         }
     }
 
-    else if (m_queue.size())
+    else if (m_merger && bref->session_command_count() == 0 &&
+             get_scatter_gather_shard(bref) != -1)
+    {
+        process_scatter_gather_reply(bref, pPacket);
+        pPacket = NULL;
+    }
+    else if (m_queue.size() && !m_merger)
     {
         ss_dassert(m_state == INIT_READY);
         route_queued_query();
@@ -597,10 +650,16 @@ void SchemaRouterSession::handleError(GWBUF* pMessage,
         return;
     }
 
+    if (m_merger && get_scatter_gather_shard(bref) != -1)
+    {
+        /** The error is sent to the client as a part of the merged result */
+        fail_scatter_gather_shard(bref);
+    }
+
     switch (action)
     {
     case ERRACT_NEW_CONNECTION:
-        if (bref->is_waiting_result())
+        if (bref->is_waiting_result() && !m_merger)
         {
             /** If the client is waiting for a reply, send an error. */
             m_client->func.write(m_client, gwbuf_clone(pMessage));
@@ -631,22 +690,319 @@ void SchemaRouterSession::handleError(GWBUF* pMessage,
  * Private functions
  */
 
+/**
+ * Check if a query should be executed on all shards and the results merged
+ *
+ * Only plain SELECT statements with a `route to all` hint are executed on
+ * all shards.
+ *
+ * @param pPacket The query
+ * @param type    Query type
+ * @param op      Query operation
+ * @param command The command byte
+ *
+ * @return True if the query is a candidate for scatter-gather execution
+ */
+bool SchemaRouterSession::is_scatter_gather(GWBUF* pPacket, uint32_t type,
+                                            qc_query_op_t op, uint8_t command)
+{
+    return command == MXS_COM_QUERY && op == QUERY_OP_SELECT &&
+           !qc_query_is_type(type, QUERY_TYPE_WRITE) &&
+           pPacket->hint && hint_exists(&pPacket->hint, HINT_ROUTE_TO_ALL);
+}
+
+/**
+ * Find the shards a scatter-gather query is executed on
+ *
+ * These are the shards on which the databases of all the tables the query
+ * refers to were found when the databases were mapped.
+ *
+ * @param pPacket  The query
+ * @param pTargets On return, the servers of the shards
+ *
+ * @return True if the shards are known, false if the query refers to no
+ * mapped database and must be executed on all shards
+ */
+bool SchemaRouterSession::get_scatter_gather_targets(GWBUF* pPacket, std::vector<SERVER*>* pTargets)
+{
+    bool restricted = false;
+    int n_tables = 0;
+    char** tables = qc_get_table_names(pPacket, &n_tables, true);
+
+    for (int i = 0; i < n_tables; i++)
+    {
+        const char* dot = strchr(tables[i], '.');
+        std::string db = dot ? std::string(tables[i], dot - tables[i]) : m_current_db;
+        std::vector<SERVER*> servers = m_shard->get_all_locations(db);
+
+        if (servers.empty())
+        {
+            // Not a mapped database, e.g. information_schema
+        }
+        else if (restricted)
+        {
+            /** Only the shards that have all of the databases */
+            std::vector<SERVER*> common;
+
+            for (std::vector<SERVER*>::iterator it = pTargets->begin(); it != pTargets->end(); it++)
+            {
+                if (std::find(servers.begin(), servers.end(), *it) != servers.end())
+                {
+                    common.push_back(*it);
+                }
+            }
+
+            pTargets->swap(common);
+        }
+        else
+        {
+            pTargets->swap(servers);
+            restricted = true;
+        }
+
+        MXS_FREE(tables[i]);
+    }
+
+    MXS_FREE(tables);
+
+    return restricted;
+}
+
+/**
+ * Execute a query on the shards that have its databases in parallel
+ *
+ * The replies are merged by a ResultMerger as they arrive.
+ *
+ * @param pPacket The query
+ *
+ * @return True if the query was routed, false if the results of the query
+ * can't be merged and the query should be routed normally
+ */
+bool SchemaRouterSession::route_scatter_gather(GWBUF* pPacket)
+{
+    std::vector<SSRBackend> shards;
+    std::vector<SERVER*> targets;
+    bool restricted = get_scatter_gather_targets(pPacket, &targets);
+
+    for (SSRBackendList::iterator it = m_backends.begin(); it != m_backends.end(); it++)
+    {
+        SERVER* server = (*it)->backend()->server;
+
+        if ((*it)->in_use() && SERVER_IS_RUNNING(server) &&
+            (!restricted || std::find(targets.begin(), targets.end(), server) != targets.end()))
+        {
+            if ((*it)->is_waiting_result() && (*it)->session_command_count() == 0)
+            {
+                /** The reply to an earlier query would be merged into the result */
+                return false;
+            }
+
+            shards.push_back(*it);
+        }
+    }
+
+    if (shards.empty() || (shards.size() < 2 && !restricted))
+    {
+        /** If the databases are on only one shard, the query is still
+         * routed here as normal routing could pick another shard */
+        return false;
+    }
+
+    ResultMerger* pMerger = ResultMerger::create(pPacket, shards.size());
+
+    if (pMerger == NULL)
+    {
+        MXS_INFO("The results of the query can't be merged, routing it to one shard.");
+        return false;
+    }
+
+    m_merger.reset(pMerger);
+    m_sg_shards = shards;
+
+    MXS_INFO("Scatter-gather query, routing to %lu shards.", shards.size());
+
+    for (std::vector<SSRBackend>::iterator it = shards.begin(); it != shards.end(); it++)
+    {
+        SSRBackend& bref = *it;
+        GWBUF* pClone = gwbuf_clone(pPacket);
+        MXS_ABORT_IF_NULL(pClone);
+
+        if (bref->session_command_count())
+        {
+            /** Execute the query after the session commands are complete */
+            bref->store_command(pClone);
+        }
+        else if (bref->write(pClone))
+        {
+            atomic_add_uint64(&bref->server()->stats.packets, 1);
+        }
+        else
+        {
+            MXS_ERROR("Routing scatter-gather query to '%s' failed.",
+                      bref->backend()->server->unique_name);
+            gwbuf_free(pClone);
+            fail_scatter_gather_shard(bref);
+        }
+    }
+
+    gwbuf_free(pPacket);
+    atomic_add(&m_router->m_stats.n_queries, 1);
+    atomic_add(&m_router->m_stats.n_scatter_gather, 1);
+
+    return true;
+}
+
+/**
+ * Get the index of a backend in the scatter-gather query
+ *
+ * @param bref Backend reference
+ *
+ * @return Index of the shard or -1 if the backend isn't executing the query
+ */
+int SchemaRouterSession::get_scatter_gather_shard(SSRBackend& bref)
+{
+    for (size_t i = 0; i < m_sg_shards.size(); i++)
+    {
+        if (m_sg_shards[i] == bref)
+        {
+            return m_merger->shard_complete(i) ? -1 : i;
+        }
+    }
+
+    return -1;
+}
+
+void SchemaRouterSession::process_scatter_gather_reply(SSRBackend& bref, GWBUF* pPacket)
+{
+    int shard = get_scatter_gather_shard(bref);
+    ss_dassert(shard != -1);
+
+    GWBUF* pResult = m_merger->process(shard, pPacket);
+
+    if (m_merger->shard_complete(shard))
+    {
+        ss_dassert(bref->is_waiting_result());
+        bref->ack_write();
+    }
+
+    send_merged_result(pResult);
+}
+
+void SchemaRouterSession::fail_scatter_gather_shard(SSRBackend& bref)
+{
+    int shard = get_scatter_gather_shard(bref);
+
+    if (shard != -1)
+    {
+        char msg[512];
+        snprintf(msg, sizeof(msg), "Lost connection to shard '%s' during query",
+                 bref->backend()->server->unique_name);
+        send_merged_result(m_merger->fail(shard, msg));
+    }
+}
 
 /**
- * Synchronize the router client session shard map with the global shard map for
- * this user.
+ * Send a part of the merged result to the client
  *
- * If the router doesn't have a shard map for this user then the current shard map
- * of the client session is added to the m_router-> If the shard map in the router is
- * out of date, its contents are replaced with the contents of the current client
- * session. If the router has a usable shard map, the current shard map of the client
- * is discarded and the router's shard map is used.
- * @param client Router session
+ * @param pResult The result to send, may be NULL
+ */
+void SchemaRouterSession::send_merged_result(GWBUF* pResult)
+{
+    if (pResult)
+    {
+        MXS_SESSION_ROUTE_REPLY(m_client->session, pResult);
+    }
+
+    if (m_merger->complete())
+    {
+        m_merger.reset();
+        m_sg_shards.clear();
+
+        /** Route the queries that were received during the scatter-gather query */
+        while (m_queue.size())
+        {
+            route_queued_query();
+        }
+    }
+}
+
+
+/**
+ * Publish the shard map built by this session.
+ *
+ * The new shard map replaces the one in use by this session and it is given
+ * to the router which shares it with the other sessions of this user. The
+ * published shard map is not modified after this.
  */
 void SchemaRouterSession::synchronize_shards()
 {
-    m_router->m_stats.shmap_cache_miss++;
+    atomic_add(&m_router->m_stats.shmap_cache_miss, 1);
+    m_shard = m_new_shard;
+    m_new_shard.reset();
     m_router->m_shard_manager.update_shard(m_shard, m_client->user);
+    m_update = 0;
+}
+
+/**
+ * Abandon the database mapping of this session so that another session can
+ * refresh the shard map. This is also done if the session was made
+ * responsible for the refresh but has not started it yet.
+ */
+void SchemaRouterSession::cancel_mapping()
+{
+    if (m_update)
+    {
+        m_router->m_shard_manager.cancel_update(m_client->user, m_update);
+        m_update = 0;
+    }
+
+    m_map_databases = false;
+    m_new_shard.reset();
+}
+
+/**
+ * Check whether the first shard map, built by another session, has been
+ * published. Once it has, the queued queries are routed. If the other
+ * session gave up, this session maps the databases itself.
+ */
+void SchemaRouterSession::wait_for_shard()
+{
+    ss_dassert(m_state & INIT_WAITING);
+
+    SShard shard = m_router->m_shard_manager.get_shard(m_client->user,
+                                                       m_config->refresh_min_interval,
+                                                       &m_update);
+
+    if (!shard)
+    {
+        mxs_worker_timer_add(&m_wait_timer, SHARD_WAIT_INTERVAL);
+    }
+    else
+    {
+        m_shard = shard;
+        m_state &= ~INIT_WAITING;
+
+        if (m_update)
+        {
+            query_databases();
+        }
+        else if (m_state & INIT_USE_DB)
+        {
+            if (!handle_default_db())
+            {
+                poll_fake_hangup_event(m_client);
+            }
+        }
+        else if (m_queue.size())
+        {
+            route_queued_query();
+        }
+    }
+}
+
+void SchemaRouterSession::wait_for_shard_cb(MXS_WORKER_TIMER* pTimer)
+{
+    static_cast<SchemaRouterSession*>(pTimer->data)->wait_for_shard();
 }
 
 /**
@@ -884,7 +1240,7 @@ bool SchemaRouterSession::send_shards()
     bool rval = false;
 
     ServerMap pContent;
-    m_shard.get_content(pContent);
+    m_shard->get_content(pContent);
     RESULTSET* rset = resultset_create(shard_list_cb, &pContent);
 
     if (rset)
@@ -930,7 +1286,7 @@ void write_error_to_client(DCB* dcb, int errnum, const char* mysqlstate, const c
 bool SchemaRouterSession::handle_default_db()
 {
     bool rval = false;
-    SERVER* target = m_shard.get_location(m_connect_db);
+    SERVER* target = m_shard->get_location(m_connect_db);
 
     if (target)
     {
@@ -1122,7 +1478,7 @@ void create_error_reply(char* fail_str, DCB* dcb)
  * @return true if new database is set, false if non-existent database was tried
  * to be set
  */
-bool change_current_db(std::string& dest, Shard& shard, GWBUF* buf)
+bool change_current_db(std::string& dest, const Shard& shard, GWBUF* buf)
 {
     bool succp = false;
     char db[MYSQL_DATABASE_MAXLEN + 1];
@@ -1314,7 +1670,7 @@ enum showdb_response SchemaRouterSession::parse_mapping_response(SSRBackend& bre
 
         if (data)
         {
-            if (m_shard.add_location(data, target))
+            if (m_new_shard->add_location(data, target))
             {
                 MXS_INFO("<%s, %s>", target->unique_name, data);
             }
@@ -1323,7 +1679,7 @@ enum showdb_response SchemaRouterSession::parse_mapping_response(SSRBackend& bre
                 if (!ignore_duplicate_database(data))
                 {
                     duplicate_found = true;
-                    SERVER *duplicate = m_shard.get_location(data);
+                    SERVER *duplicate = m_new_shard->get_location(data);
 
                     MXS_ERROR("Database '%s' found on servers '%s' and '%s' for user %s@%s.",
                               data, target->unique_name, duplicate->unique_name,
@@ -1333,9 +1689,9 @@ enum showdb_response SchemaRouterSession::parse_mapping_response(SSRBackend& bre
                 {
                     /** In conflict situations, use the preferred server */
                     MXS_INFO("Forcing location of '%s' from '%s' to '%s'",
-                             data, m_shard.get_location(data)->unique_name,
+                             data, m_new_shard->get_location(data)->unique_name,
                              target->unique_name);
-                    m_shard.replace_location(data, target);
+                    m_new_shard->replace_location(data, target);
                 }
             }
             MXS_FREE(data);
@@ -1388,6 +1744,7 @@ void SchemaRouterSession::query_databases()
 
     m_state |= INIT_MAPPING;
     m_state &= ~INIT_UNINT;
+    m_new_shard.reset(new Shard);
 
     GWBUF *buffer = modutil_create_query("SHOW DATABASES");
     gwbuf_set_type(buffer, GWBUF_TYPE_COLLECT_RESULT);
@@ -1443,7 +1800,7 @@ SERVER* SchemaRouterSession::get_shard_target(GWBUF* buffer, uint32_t qtype)
         if (uses_current_database)
         {
             MXS_INFO("Query uses current database");
-            return m_shard.get_location(m_current_db);
+            return m_shard->get_location(m_current_db);
         }
 
         int n_databases = 0;
@@ -1457,7 +1814,7 @@ SERVER* SchemaRouterSession::get_shard_target(GWBUF* buffer, uint32_t qtype)
             }
             else
             {
-                SERVER* target = m_shard.get_location(databases[i]);
+                SERVER* target = m_shard->get_location(databases[i]);
 
                 if (target)
                 {
@@ -1497,7 +1854,7 @@ SERVER* SchemaRouterSession::get_shard_target(GWBUF* buffer, uint32_t qtype)
 
             if (tok)
             {
-                rval = m_shard.get_location(tok);
+                rval = m_shard->get_location(tok);
 
                 if (rval)
                 {
@@ -1509,7 +1866,7 @@ SERVER* SchemaRouterSession::get_shard_target(GWBUF* buffer, uint32_t qtype)
 
         if (rval == NULL)
         {
-            rval = m_shard.get_location(m_current_db);
+            rval = m_shard->get_location(m_current_db);
 
             if (rval)
             {
@@ -1543,7 +1900,7 @@ SERVER* SchemaRouterSession::get_shard_target(GWBUF* buffer, uint32_t qtype)
          * active database, set is as the target
          */
 
-        rval = m_shard.get_location(m_current_db);
+        rval = m_shard->get_location(m_current_db);
 
         if (rval)
         {
@@ -1674,7 +2031,7 @@ bool SchemaRouterSession::send_databases()
     bool rval = false;
 
     ServerMap dblist;
-    m_shard.get_content(dblist);
+    m_shard->get_content(dblist);
 
     RESULTSET* resultset = resultset_create(result_set_cb, &dblist);
 
@@ -20,7 +20,9 @@
 #include <maxscale/protocol/mysql.h>
 #include <maxscale/router.hh>
 #include <maxscale/session_command.hh>
+#include <maxscale/worker_timer.h>
 
+#include "scatter_gather.hh"
 #include "shard_map.hh"
 
 namespace schemarouter
@@ -35,7 +37,8 @@ enum init_mask
     INIT_MAPPING = 0x01,
     INIT_USE_DB  = 0x02,
     INIT_UNINT   = 0x04,
-    INIT_FAILED  = 0x08
+    INIT_FAILED  = 0x08,
+    INIT_WAITING = 0x10  /**< Waiting for another session to map the databases */
 };
 
 enum showdb_response
@@ -137,6 +140,15 @@ private:
     SERVER* resolve_query_target(GWBUF* pPacket, uint32_t type, uint8_t command,
                                  enum route_target& route_target);
 
+    /** Scatter-gather functions */
+    bool    is_scatter_gather(GWBUF* pPacket, uint32_t type, qc_query_op_t op, uint8_t command);
+    bool    get_scatter_gather_targets(GWBUF* pPacket, std::vector<SERVER*>* pTargets);
+    bool    route_scatter_gather(GWBUF* pPacket);
+    int     get_scatter_gather_shard(SSRBackend& bref);
+    void    process_scatter_gather_reply(SSRBackend& bref, GWBUF* pPacket);
+    void    fail_scatter_gather_shard(SSRBackend& bref);
+    void    send_merged_result(GWBUF* pResult);
+
     /** Shard mapping functions */
     bool                 send_databases();
     bool                 send_shards();
@@ -145,7 +157,10 @@ private:
     enum showdb_response parse_mapping_response(SSRBackend& bref, GWBUF** buffer);
     void                 route_queued_query();
     void                 synchronize_shards();
+    void                 cancel_mapping();
     void                 handle_mapping_reply(SSRBackend& bref, GWBUF** pPacket);
+    void                 wait_for_shard();
+    static void          wait_for_shard_cb(MXS_WORKER_TIMER* pTimer);
 
     /** Member variables */
     bool                   m_closed;         /**< True if session closed */
@@ -154,7 +169,10 @@ private:
     SSRBackendList         m_backends;       /**< Backend references */
     Config*                m_config;         /**< Pointer to router config */
     SchemaRouter*          m_router;         /**< The router instance */
-    Shard                  m_shard;          /**< Database to server mapping */
+    bool                   m_map_databases;  /**< Whether this session must map the databases */
+    uint64_t               m_update;         /**< The shard map refresh this session owns, 0 if none */
+    SShard                 m_shard;          /**< Database to server mapping */
+    std::tr1::shared_ptr<Shard> m_new_shard; /**< The shard being built by the database mapping */
     std::string            m_connect_db;     /**< Database the user was trying to connect to */
     std::string            m_current_db;     /**< Current active database */
     int                    m_state;          /**< Initialization state bitmask */
@@ -163,5 +181,8 @@ private:
     uint64_t               m_sent_sescmd;    /**< The latest session command being executed */
     uint64_t               m_replied_sescmd; /**< The last session command reply that was sent to the client */
     SERVER*                m_load_target;    /**< Target for LOAD DATA LOCAL INFILE */
+    SResultMerger          m_merger;         /**< Merges the results of a scatter-gather query */
+    std::vector<SSRBackend> m_sg_shards;     /**< Shards executing the scatter-gather query */
+    MXS_WORKER_TIMER       m_wait_timer;     /**< Checks whether the awaited shard map is ready */
 };
 }
\ No newline at end of file
@@ -29,7 +29,24 @@ Shard::~Shard()
 bool Shard::add_location(std::string db, SERVER* target)
 {
     std::transform(db.begin(), db.end(), db.begin(), ::tolower);
-    return m_map.insert(std::make_pair(db, target)).second;
+    bool added = m_map.insert(std::make_pair(db, target)).second;
+
+    if (!added)
+    {
+        std::vector<SERVER*>& servers = m_all[db];
+
+        if (servers.empty())
+        {
+            servers.push_back(m_map[db]);
+        }
+
+        if (std::find(servers.begin(), servers.end(), target) == servers.end())
+        {
+            servers.push_back(target);
+        }
+    }
+
+    return added;
 }
 
 void Shard::replace_location(std::string db, SERVER* target)
@@ -38,11 +55,11 @@ void Shard::replace_location(std::string db, SERVER* target)
     m_map[db] = target;
 }
 
-SERVER* Shard::get_location(std::string db)
+SERVER* Shard::get_location(std::string db) const
 {
     SERVER* rval = NULL;
     std::transform(db.begin(), db.end(), db.begin(), ::tolower);
-    ServerMap::iterator iter = m_map.find(db);
+    ServerMap::const_iterator iter = m_map.find(db);
 
     if (iter != m_map.end())
     {
@@ -52,6 +69,29 @@ SERVER* Shard::get_location(std::string db)
     return rval;
 }
 
+std::vector<SERVER*> Shard::get_all_locations(std::string db) const
+{
+    std::vector<SERVER*> rval;
+    std::transform(db.begin(), db.end(), db.begin(), ::tolower);
+    ServerListMap::const_iterator iter = m_all.find(db);
+
+    if (iter != m_all.end())
+    {
+        rval = iter->second;
+    }
+    else
+    {
+        ServerMap::const_iterator loc = m_map.find(db);
+
+        if (loc != m_map.end())
+        {
+            rval.push_back(loc->second);
+        }
+    }
+
+    return rval;
+}
+
 bool Shard::stale(double max_interval) const
 {
     time_t now = time(NULL);
@@ -64,9 +104,9 @@ bool Shard::empty() const
     return m_map.size() == 0;
 }
 
-void Shard::get_content(ServerMap& dest)
+void Shard::get_content(ServerMap& dest) const
 {
-    for (ServerMap::iterator it = m_map.begin(); it != m_map.end(); it++)
+    for (ServerMap::const_iterator it = m_map.begin(); it != m_map.end(); it++)
     {
         dest.insert(*it);
     }
@@ -77,7 +117,8 @@ bool Shard::newer_than(const Shard& shard) const
     return m_last_updated > shard.m_last_updated;
 }
 
-ShardManager::ShardManager()
+ShardManager::ShardManager():
+    m_updates(0)
 {
     spinlock_init(&m_lock);
 }
@@ -86,35 +127,53 @@ ShardManager::~ShardManager()
 {
 }
 
-Shard ShardManager::get_shard(std::string user, double max_interval)
+SShard ShardManager::get_shard(std::string user, double max_interval, uint64_t* pUpdate)
 {
     mxs::SpinLockGuard guard(m_lock);
 
-    ShardMap::iterator iter = m_maps.find(user);
+    ShardEntry& entry = m_maps[user];
+    *pUpdate = 0;
 
-    if (iter == m_maps.end() || iter->second.stale(max_interval))
+    if ((!entry.shard || entry.shard->stale(max_interval)) &&
+        (!entry.updating || difftime(time(NULL), entry.update_started) > max_interval))
     {
-        // No previous shard or a stale shard, construct a new one
-
-        if (iter != m_maps.end())
+        // Only one session refreshes the shard, the others use the stale one
+        // or, if there is none yet, wait for the first one to be published
+        entry.updating = true;
+        entry.update_started = time(NULL);
+        entry.update = ++m_updates;
+        *pUpdate = entry.update;
+
+        if (!entry.shard)
         {
-            m_maps.erase(iter);
+            return SShard(new Shard);
         }
+    }
+
+    // Only the reference count is updated, the shard itself is not copied
+    return entry.shard;
+}
 
-        return Shard();
+void ShardManager::update_shard(SShard shard, std::string user)
+{
+    mxs::SpinLockGuard guard(m_lock);
+    ShardEntry& entry = m_maps[user];
+
+    if (!entry.shard || !entry.shard->newer_than(*shard))
+    {
+        entry.shard = shard;
     }
 
-    // Found valid shard
-    return iter->second;
+    entry.updating = false;
 }
 
-void ShardManager::update_shard(Shard& shard, std::string user)
+void ShardManager::cancel_update(std::string user, uint64_t update)
 {
     mxs::SpinLockGuard guard(m_lock);
     ShardMap::iterator iter = m_maps.find(user);
 
-    if (iter == m_maps.end() || shard.newer_than(iter->second))
+    if (iter != m_maps.end() && iter->second.update == update)
     {
-        m_maps[user] = shard;
+        iter->second.updating = false;
     }
 }
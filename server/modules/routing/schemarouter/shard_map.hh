@@ -14,9 +14,11 @@
 
 #include <maxscale/cppdefs.hh>
 
+#include <tr1/memory>
 #include <tr1/unordered_map>
 #include <string>
 #include <list>
+#include <vector>
 
 #include <maxscale/service.h>
 #include <maxscale/hashtable.h>
@@ -27,6 +29,9 @@ using namespace maxscale;
 /** This contains the database to server mapping */
 typedef std::tr1::unordered_map<std::string, SERVER*> ServerMap;
 
+/** This contains the database to servers mapping of databases found on several servers */
+typedef std::tr1::unordered_map<std::string, std::vector<SERVER*> > ServerListMap;
+
 class Shard
 {
 public:
@@ -36,10 +41,14 @@ public:
     /**
      * @brief Add a database location
      *
+     * All the servers a database is found on are recorded, but only the first
+     * one is its location.
+     *
      * @param db     Database to add
      * @param target Target where database is located
      *
-     * @return True if location was added
+     * @return True if location was added, false if the database already has
+     * a location
      */
     bool add_location(std::string db, SERVER* target);
 
@@ -50,7 +59,16 @@ public:
      *
      * @return The database or NULL if no server contains the database
      */
-    SERVER* get_location(std::string db);
+    SERVER* get_location(std::string db) const;
+
+    /**
+     * @brief Retrieve all servers a database was found on
+     *
+     * @param db Database to locate
+     *
+     * @return The servers, empty if no server contains the database
+     */
+    std::vector<SERVER*> get_all_locations(std::string db) const;
 
     /**
      * @brief Change the location of a database
@@ -81,7 +99,7 @@ public:
      *
      * @param keys A map where the database to server mappings are added
      */
-    void get_content(ServerMap& dest);
+    void get_content(ServerMap& dest) const;
 
     /**
      * @brief Check if this shard is newer than the other shard
@@ -93,11 +111,16 @@ public:
     bool newer_than(const Shard& shard) const;
 
 private:
-    ServerMap m_map;
-    time_t    m_last_updated;
+    ServerMap     m_map;
+    ServerListMap m_all;
+    time_t        m_last_updated;
 };
 
-typedef std::tr1::unordered_map<std::string, Shard> ShardMap;
+/**
+ * A published shard is never modified. The sessions share the same instance
+ * and a refresh replaces it with a new one.
+ */
+typedef std::tr1::shared_ptr<const Shard> SShard;
 
 class ShardManager
 {
@@ -106,28 +129,72 @@ public:
     ~ShardManager();
 
     /**
-     * @brief Retrieve or create a shard
+     * @brief Retrieve the shard of a user
+     *
+     * If the shard is stale or does not exist and no other session is
+     * refreshing it, the caller is made responsible for the refresh and
+     * @c pUpdate is set to an identifier of the refresh. The other sessions
+     * keep using the stale shard until the refreshed one is published with
+     * update_shard(). If no shard exists, only the refreshing session gets an
+     * empty one to build, the others must wait for it to be published.
+     *
+     * A refresh that has taken longer than @c max_lifetime is considered
+     * abandoned and is taken over by the next caller.
      *
      * @param user         User whose shard to retrieve
      * @param max_lifetime The maximum lifetime of a shard
+     * @param pUpdate      Set to the identifier of the refresh the caller must
+     *                     make, or to 0 if the caller must not refresh the shard
      *
-     * @return The latest version of the shard or a newly created shard if no
-     * old version is available
+     * @return The latest version of the shard, an empty shard if the caller
+     * must build the first version or NULL if another session is building it
      */
-    Shard get_shard(std::string user, double max_lifetime);
+    SShard get_shard(std::string user, double max_lifetime, uint64_t* pUpdate);
 
     /**
      * @brief Update the shard information
      *
      * The shard information is updated if the new shard contains more up to date
-     * information than the one stored in the shard manager.
+     * information than the one stored in the shard manager. This also completes
+     * any refresh of the shard that is in progress.
      *
      * @param shard New version of the shard
      * @param user  The user whose shard this is
      */
-    void update_shard(Shard& shard, std::string user);
+    void update_shard(SShard shard, std::string user);
+
+    /**
+     * @brief Abandon a refresh of a shard
+     *
+     * Called when the session that was refreshing the shard fails to do so
+     * or closes before it is done. The next session that finds the shard
+     * stale or missing will refresh it. If the refresh has already been
+     * taken over by another session, nothing is done.
+     *
+     * @param user   The user whose shard was being refreshed
+     * @param update The identifier of the refresh, as returned by get_shard()
+     */
+    void cancel_update(std::string user, uint64_t update);
 
 private:
+    struct ShardEntry
+    {
+        ShardEntry():
+            updating(false),
+            update_started(0),
+            update(0)
+        {
+        }
+
+        SShard   shard;          /**< The latest published shard */
+        bool     updating;       /**< Whether a session is refreshing the shard */
+        time_t   update_started; /**< When the refresh was started */
+        uint64_t update;         /**< The identifier of the latest refresh */
+    };
+
+    typedef std::tr1::unordered_map<std::string, ShardEntry> ShardMap;
+
     SPINLOCK m_lock;
     ShardMap m_maps;
+    uint64_t m_updates; /**< The number of refreshes started */
 };
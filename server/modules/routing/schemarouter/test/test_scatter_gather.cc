@@ -0,0 +1,790 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "../scatter_gather.hh"
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <maxscale/debug.h>
+#include <maxscale/log_manager.h>
+#include <maxscale/modutil.h>
+#include <maxscale/mysql_utils.h>
+#include <maxscale/protocol/mysql.h>
+
+using namespace std;
+using schemarouter::ResultMerger;
+
+namespace
+{
+
+typedef vector<uint8_t> Data;
+typedef vector<string> Row;
+typedef vector<Row> Rows;
+
+/** The text that the rows of the merged result contain for NULL values */
+const char NULL_VALUE[] = "NULL";
+
+void add_packet(Data& data, uint8_t seq, const Data& payload)
+{
+    uint32_t len = payload.size();
+    data.push_back(len);
+    data.push_back(len >> 8);
+    data.push_back(len >> 16);
+    data.push_back(seq);
+    data.insert(data.end(), payload.begin(), payload.end());
+}
+
+void add_lenenc_str(Data& payload, const char* zValue)
+{
+    size_t len = strlen(zValue);
+    ss_dassert(len < 251);
+    payload.push_back(len);
+    payload.insert(payload.end(), zValue, zValue + len);
+}
+
+void add_column_def(Data& data, uint8_t seq, const char* zName, uint8_t type)
+{
+    Data payload;
+    add_lenenc_str(payload, "def");
+    add_lenenc_str(payload, "db");
+    add_lenenc_str(payload, "t");
+    add_lenenc_str(payload, "t");
+    add_lenenc_str(payload, zName);
+    add_lenenc_str(payload, zName);
+    payload.push_back(0x0c);                 // Length of the fixed fields
+    payload.push_back(0x21);                 // Character set
+    payload.push_back(0x00);
+    payload.insert(payload.end(), 4, 0xff);  // Column length
+    payload.push_back(type);
+    payload.insert(payload.end(), 2, 0x00);  // Flags
+    payload.push_back(0x00);                 // Decimals
+    payload.insert(payload.end(), 2, 0x00);  // Filler
+
+    add_packet(data, seq, payload);
+}
+
+void add_eof(Data& data, uint8_t seq, uint16_t warnings, uint16_t status)
+{
+    Data payload;
+    payload.push_back(0xfe);
+    payload.push_back(warnings);
+    payload.push_back(warnings >> 8);
+    payload.push_back(status);
+    payload.push_back(status >> 8);
+
+    add_packet(data, seq, payload);
+}
+
+void add_row(Data& data, uint8_t seq, const Row& row)
+{
+    Data payload;
+
+    for (Row::const_iterator it = row.begin(); it != row.end(); it++)
+    {
+        if (*it == NULL_VALUE)
+        {
+            payload.push_back(0xfb);
+        }
+        else
+        {
+            add_lenenc_str(payload, it->c_str());
+        }
+    }
+
+    add_packet(data, seq, payload);
+}
+
+void add_error(Data& data, uint8_t seq, uint16_t code, const char* zMessage)
+{
+    Data payload;
+    payload.push_back(0xff);
+    payload.push_back(code);
+    payload.push_back(code >> 8);
+    const char state[] = "#HY000";
+    payload.insert(payload.end(), state, state + strlen(state));
+    payload.insert(payload.end(), zMessage, zMessage + strlen(zMessage));
+
+    add_packet(data, seq, payload);
+}
+
+/** A column of a canned result */
+struct Column
+{
+    const char* zName;
+    uint8_t     type;
+};
+
+typedef vector<Column> Columns;
+
+/**
+ * Create the result set that a shard returns.
+ */
+Data create_resultset(const Columns& columns, const Rows& rows, uint16_t warnings, uint16_t status)
+{
+    Data data;
+    uint8_t seq = 1;
+
+    add_packet(data, seq++, Data(1, columns.size()));
+
+    for (Columns::const_iterator it = columns.begin(); it != columns.end(); it++)
+    {
+        add_column_def(data, seq++, it->zName, it->type);
+    }
+
+    add_eof(data, seq++, 0, status);
+
+    for (Rows::const_iterator it = rows.begin(); it != rows.end(); it++)
+    {
+        add_row(data, seq++, *it);
+    }
+
+    add_eof(data, seq++, warnings, status);
+
+    return data;
+}
+
+Data create_error(uint16_t code, const char* zMessage)
+{
+    Data data;
+    add_error(data, 1, code, zMessage);
+    return data;
+}
+
+Data create_ok()
+{
+    static const uint8_t ok[] = { 0x07, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00 };
+    return Data(ok, ok + sizeof(ok));
+}
+
+Data buffer_data(GWBUF* pBuffer)
+{
+    Data data(gwbuf_length(pBuffer));
+
+    if (data.size())
+    {
+        gwbuf_copy_data(pBuffer, 0, data.size(), &data[0]);
+    }
+
+    return data;
+}
+
+/** What the client receives */
+struct Result
+{
+    Result():
+        valid(false),
+        error(0),
+        n_columns(0),
+        warnings(0),
+        status(0)
+    {
+    }
+
+    bool     valid;     /**< Whether the packets formed a complete, correctly numbered result */
+    uint16_t error;     /**< The error code if the result ends with an error */
+    size_t   n_columns;
+    Rows     rows;
+    uint16_t warnings;
+    uint16_t status;
+};
+
+bool is_eof_packet(const Data& packet)
+{
+    return packet.size() == MYSQL_EOF_PACKET_LEN && packet[MYSQL_HEADER_LEN] == MYSQL_REPLY_EOF;
+}
+
+bool is_err_packet(const Data& packet)
+{
+    return packet.size() > MYSQL_HEADER_LEN + 2 && packet[MYSQL_HEADER_LEN] == MYSQL_REPLY_ERR;
+}
+
+Row read_row(const Data& packet)
+{
+    Row row;
+    size_t i = MYSQL_HEADER_LEN;
+
+    while (i < packet.size())
+    {
+        if (packet[i] == 0xfb)
+        {
+            row.push_back(NULL_VALUE);
+            ++i;
+        }
+        else
+        {
+            size_t len = packet[i++];
+            row.push_back(string(packet.begin() + i, packet.begin() + i + len));
+            i += len;
+        }
+    }
+
+    return row;
+}
+
+/**
+ * Split the data that the merger returned into packets and check that it is
+ * a complete result set or an error.
+ */
+Result read_result(const Data& data)
+{
+    Result result;
+    vector<Data> packets;
+    size_t i = 0;
+
+    while (i + MYSQL_HEADER_LEN <= data.size())
+    {
+        size_t len = MYSQL_HEADER_LEN + (data[i] | (data[i + 1] << 8) | (data[i + 2] << 16));
+
+        if (i + len > data.size() || data[i + 3] != (uint8_t)(packets.size() + 1))
+        {
+            return result;
+        }
+
+        packets.push_back(Data(data.begin() + i, data.begin() + i + len));
+        i += len;
+    }
+
+    if (i != data.size() || packets.empty())
+    {
+        return result;
+    }
+
+    const Data& last = packets.back();
+
+    if (is_err_packet(last))
+    {
+        result.error = last[MYSQL_HEADER_LEN + 1] | (last[MYSQL_HEADER_LEN + 2] << 8);
+        result.valid = true;
+        return result;
+    }
+
+    result.n_columns = packets[0][MYSQL_HEADER_LEN];
+
+    if (packets.size() < result.n_columns + 3 || !is_eof_packet(packets[result.n_columns + 1]) ||
+        !is_eof_packet(last))
+    {
+        return result;
+    }
+
+    for (size_t j = result.n_columns + 2; j < packets.size() - 1; j++)
+    {
+        if (is_eof_packet(packets[j]))
+        {
+            return result;
+        }
+
+        result.rows.push_back(read_row(packets[j]));
+    }
+
+    result.warnings = last[MYSQL_HEADER_LEN + 1] | (last[MYSQL_HEADER_LEN + 2] << 8);
+    result.status = last[MYSQL_HEADER_LEN + 3] | (last[MYSQL_HEADER_LEN + 4] << 8);
+    result.valid = true;
+
+    return result;
+}
+
+ResultMerger* create_merger(const char* zSql, size_t n_shards)
+{
+    GWBUF* pStmt = modutil_create_query(zSql);
+    ResultMerger* pMerger = ResultMerger::create(pStmt, n_shards);
+    gwbuf_free(pStmt);
+    return pMerger;
+}
+
+/**
+ * Feed the replies of the shards to a merger in segments of the given size,
+ * taking turns between the shards.
+ *
+ * @param zSql         The statement
+ * @param replies      The reply of each shard, an empty reply fails the shard
+ * @param segment_size The size of the buffers that are fed to the merger
+ * @param pResult      The merged result
+ *
+ * @return True if the merger accepted the statement and completed the result
+ */
+bool merge(const char* zSql, const vector<Data>& replies, size_t segment_size, Result* pResult)
+{
+    ResultMerger* pMerger = create_merger(zSql, replies.size());
+
+    if (pMerger == NULL)
+    {
+        cout << "ERROR: The results of '" << zSql << "' can't be merged." << endl;
+        return false;
+    }
+
+    Data output;
+    vector<size_t> offsets(replies.size(), 0);
+    bool more = true;
+
+    while (more)
+    {
+        more = false;
+
+        for (size_t i = 0; i < replies.size(); i++)
+        {
+            GWBUF* pOut = NULL;
+
+            if (replies[i].empty())
+            {
+                if (!pMerger->shard_complete(i))
+                {
+                    pOut = pMerger->fail(i, "Lost connection to the shard");
+                }
+            }
+            else if (offsets[i] < replies[i].size())
+            {
+                size_t len = min(segment_size, replies[i].size() - offsets[i]);
+                pOut = pMerger->process(i, gwbuf_alloc_and_load(len, &replies[i][offsets[i]]));
+                offsets[i] += len;
+                more = more || offsets[i] < replies[i].size();
+            }
+
+            Data data = buffer_data(pOut);
+            output.insert(output.end(), data.begin(), data.end());
+            gwbuf_free(pOut);
+        }
+    }
+
+    bool complete = pMerger->complete();
+    delete pMerger;
+
+    if (!complete)
+    {
+        cout << "ERROR: The result of '" << zSql << "' was not completed." << endl;
+        return false;
+    }
+
+    *pResult = read_result(output);
+
+    if (!pResult->valid)
+    {
+        cout << "ERROR: The result of '" << zSql << "' is malformed." << endl;
+        return false;
+    }
+
+    return true;
+}
+
+string row_to_string(const Row& row)
+{
+    string rval = "(";
+
+    for (Row::const_iterator it = row.begin(); it != row.end(); it++)
+    {
+        rval += (it == row.begin() ? "" : ", ") + *it;
+    }
+
+    return rval + ")";
+}
+
+/**
+ * Merge the replies with different segment sizes and check the rows of the result.
+ */
+int check_rows(const char* zSql, const vector<Data>& replies, const Rows& expected)
+{
+    int rv = EXIT_SUCCESS;
+    size_t segment_sizes[] = { 1, 3, 7, 1024 };
+
+    for (size_t i = 0; i < sizeof(segment_sizes) / sizeof(segment_sizes[0]); i++)
+    {
+        Result result;
+
+        if (!merge(zSql, replies, segment_sizes[i], &result))
+        {
+            rv = EXIT_FAILURE;
+        }
+        else if (result.error)
+        {
+            cout << "ERROR: '" << zSql << "' returned the error " << result.error << "." << endl;
+            rv = EXIT_FAILURE;
+        }
+        else if (result.rows != expected)
+        {
+            cout << "ERROR: '" << zSql << "' returned " << result.rows.size() << " rows"
+                 << " with segments of " << segment_sizes[i] << " bytes:" << endl;
+
+            for (Rows::iterator it = result.rows.begin(); it != result.rows.end(); it++)
+            {
+                cout << "  " << row_to_string(*it) << endl;
+            }
+
+            cout << "Expected " << expected.size() << " rows:" << endl;
+
+            for (Rows::const_iterator it = expected.begin(); it != expected.end(); it++)
+            {
+                cout << "  " << row_to_string(*it) << endl;
+            }
+
+            rv = EXIT_FAILURE;
+        }
+    }
+
+    return rv;
+}
+
+int check_error(const char* zSql, const vector<Data>& replies, uint16_t expected)
+{
+    Result result;
+
+    if (!merge(zSql, replies, 1024, &result))
+    {
+        return EXIT_FAILURE;
+    }
+    else if (result.error != expected)
+    {
+        cout << "ERROR: '" << zSql << "' returned the error " << result.error
+             << " instead of " << expected << "." << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+Row make_row(const char* z1, const char* z2 = NULL, const char* z3 = NULL)
+{
+    Row row;
+    const char* values[] = { z1, z2, z3 };
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]) && values[i]; i++)
+    {
+        row.push_back(values[i]);
+    }
+
+    return row;
+}
+
+Columns make_columns(const Column* pColumns, size_t n_columns)
+{
+    return Columns(pColumns, pColumns + n_columns);
+}
+
+int test_aggregates()
+{
+    int rv = EXIT_SUCCESS;
+
+    {
+        const Column columns[] = { { "COUNT(*)", MYSQL_TYPE_LONGLONG } };
+        Columns cols = make_columns(columns, 1);
+        vector<Data> replies;
+        replies.push_back(create_resultset(cols, Rows(1, make_row("3")), 0, 0));
+        replies.push_back(create_resultset(cols, Rows(1, make_row("0")), 0, 0));
+        replies.push_back(create_resultset(cols, Rows(1, make_row("250")), 0, 0));
+
+        rv |= check_rows("SELECT COUNT(*) FROM t", replies, Rows(1, make_row("253")));
+    }
+
+    {
+        const Column columns[] =
+        {
+            { "SUM(a)", MYSQL_TYPE_NEWDECIMAL },
+            { "MIN(a)", MYSQL_TYPE_LONG },
+            { "MAX(a)", MYSQL_TYPE_LONG }
+        };
+        Columns cols = make_columns(columns, 3);
+        vector<Data> replies;
+        replies.push_back(create_resultset(cols, Rows(1, make_row("10.5", "9", "12")), 0, 0));
+        replies.push_back(create_resultset(cols, Rows(1, make_row(NULL_VALUE, NULL_VALUE, NULL_VALUE)),
+                                           0, 0));
+        replies.push_back(create_resultset(cols, Rows(1, make_row("-0.75", "10", "100")), 0, 0));
+
+        // The values are compared as numbers, not as strings
+        rv |= check_rows("SELECT SUM(a), MIN(a), MAX(a) FROM t", replies,
+                         Rows(1, make_row("9.75", "9", "100")));
+    }
+
+    {
+        const Column columns[] =
+        {
+            { "MIN(b)", MYSQL_TYPE_VAR_STRING },
+            { "MAX(b)", MYSQL_TYPE_VAR_STRING }
+        };
+        Columns cols = make_columns(columns, 2);
+        vector<Data> replies;
+        replies.push_back(create_resultset(cols, Rows(1, make_row("b", "B")), 0, 0));
+        replies.push_back(create_resultset(cols, Rows(1, make_row("A", "c")), 0, 0));
+
+        rv |= check_rows("SELECT MIN(b), MAX(b) FROM t", replies, Rows(1, make_row("A", "c")));
+    }
+
+    {
+        const Column columns[] = { { "SUM(a)", MYSQL_TYPE_NEWDECIMAL } };
+        Columns cols = make_columns(columns, 1);
+        vector<Data> replies;
+        replies.push_back(create_resultset(cols, Rows(1, make_row(NULL_VALUE)), 0, 0));
+        replies.push_back(create_resultset(cols, Rows(1, make_row(NULL_VALUE)), 0, 0));
+
+        // The sum of empty tables is NULL
+        rv |= check_rows("SELECT SUM(a) FROM t", replies, Rows(1, make_row(NULL_VALUE)));
+    }
+
+    return rv;
+}
+
+int test_ordered()
+{
+    int rv = EXIT_SUCCESS;
+    const Column columns[] =
+    {
+        { "a", MYSQL_TYPE_LONG },
+        { "b", MYSQL_TYPE_VAR_STRING }
+    };
+    Columns cols = make_columns(columns, 2);
+
+    Rows shard1;
+    shard1.push_back(make_row("1", "x"));
+    shard1.push_back(make_row("5", "y"));
+    shard1.push_back(make_row("20", "z"));
+
+    Rows shard2;
+    shard2.push_back(make_row(NULL_VALUE, "w"));
+    shard2.push_back(make_row("3", "x"));
+    shard2.push_back(make_row("4", "y"));
+    shard2.push_back(make_row("100", "z"));
+
+    vector<Data> replies;
+    replies.push_back(create_resultset(cols, shard1, 0, 0));
+    replies.push_back(create_resultset(cols, shard2, 0, 0));
+    replies.push_back(create_resultset(cols, Rows(), 0, 0));
+
+    Rows expected;
+    expected.push_back(make_row(NULL_VALUE, "w"));
+    expected.push_back(make_row("1", "x"));
+    expected.push_back(make_row("3", "x"));
+    expected.push_back(make_row("4", "y"));
+
+    rv |= check_rows("SELECT a, b FROM t ORDER BY a LIMIT 4", replies, expected);
+
+    // Descending order by an alias, each shard returns its rows in that order
+    Rows desc1(shard1.rbegin(), shard1.rend());
+    Rows desc2(shard2.rbegin(), shard2.rend());
+    replies.clear();
+    replies.push_back(create_resultset(cols, desc1, 0, 0));
+    replies.push_back(create_resultset(cols, desc2, 0, 0));
+
+    expected.clear();
+    expected.push_back(make_row("100", "z"));
+    expected.push_back(make_row("20", "z"));
+    expected.push_back(make_row("5", "y"));
+
+    rv |= check_rows("SELECT a AS c, b FROM t ORDER BY c DESC LIMIT 3", replies, expected);
+
+    // Rows of the second key break the ties of the first one
+    Rows ties1;
+    ties1.push_back(make_row("z", "1"));
+    ties1.push_back(make_row("x", "2"));
+    Rows ties2;
+    ties2.push_back(make_row("y", "1"));
+    ties2.push_back(make_row("w", "2"));
+
+    const Column tie_columns[] =
+    {
+        { "b", MYSQL_TYPE_VAR_STRING },
+        { "a", MYSQL_TYPE_LONG }
+    };
+    Columns tie_cols = make_columns(tie_columns, 2);
+    replies.clear();
+    replies.push_back(create_resultset(tie_cols, ties1, 0, 0));
+    replies.push_back(create_resultset(tie_cols, ties2, 0, 0));
+
+    expected.clear();
+    expected.push_back(make_row("z", "1"));
+    expected.push_back(make_row("y", "1"));
+    expected.push_back(make_row("x", "2"));
+
+    rv |= check_rows("SELECT b, a FROM t ORDER BY a, b DESC LIMIT 3", replies, expected);
+
+    return rv;
+}
+
+int test_concat()
+{
+    int rv = EXIT_SUCCESS;
+    const Column columns[] = { { "a", MYSQL_TYPE_LONG } };
+    Columns cols = make_columns(columns, 1);
+
+    vector<Data> replies;
+    replies.push_back(create_resultset(cols, Rows(3, make_row("1")), 1, SERVER_STATUS_AUTOCOMMIT));
+    replies.push_back(create_resultset(cols, Rows(2, make_row("2")), 2,
+                                       SERVER_STATUS_AUTOCOMMIT | SERVER_MORE_RESULTS_EXIST));
+
+    Result result;
+
+    if (merge("SELECT a FROM t LIMIT 4", replies, 5, &result))
+    {
+        if (result.rows.size() != 4 || result.n_columns != 1)
+        {
+            cout << "ERROR: LIMIT 4 returned " << result.rows.size() << " rows." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        if (result.warnings != 3)
+        {
+            cout << "ERROR: The warnings of the shards were not summed." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        if (result.status != SERVER_STATUS_AUTOCOMMIT)
+        {
+            cout << "ERROR: The final EOF has the status " << result.status << "." << endl;
+            rv = EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+int test_errors()
+{
+    int rv = EXIT_SUCCESS;
+    const Column columns[] = { { "COUNT(*)", MYSQL_TYPE_LONGLONG } };
+    Columns cols = make_columns(columns, 1);
+    const char* zSql = "SELECT COUNT(*) FROM t";
+
+    vector<Data> replies;
+    replies.push_back(create_resultset(cols, Rows(1, make_row("1")), 0, 0));
+    replies.push_back(create_error(1146, "Table 't' doesn't exist"));
+    replies.push_back(create_error(1045, "Access denied"));
+    rv |= check_error(zSql, replies, 1146);
+
+    // An error in the middle of the rows of a shard
+    replies.clear();
+    Data data = create_resultset(cols, Rows(), 0, 0);
+    data.resize(data.size() - MYSQL_EOF_PACKET_LEN);
+    add_error(data, 4, 1317, "Query execution was interrupted");
+    replies.push_back(create_resultset(cols, Rows(1, make_row("1")), 0, 0));
+    replies.push_back(data);
+    rv |= check_error(zSql, replies, 1317);
+
+    // A shard that can't return its result
+    replies.clear();
+    replies.push_back(create_resultset(cols, Rows(1, make_row("1")), 0, 0));
+    replies.push_back(Data());
+    rv |= check_error(zSql, replies, 2013);
+
+    // A shard that does not return a result set
+    replies.clear();
+    replies.push_back(create_ok());
+    replies.push_back(create_resultset(cols, Rows(1, make_row("1")), 0, 0));
+    rv |= check_error(zSql, replies, 1105);
+
+    return rv;
+}
+
+int test_parse()
+{
+    int rv = EXIT_SUCCESS;
+
+    const char* accepted[] =
+    {
+        "SELECT a FROM t",
+        "SELECT a, b FROM t WHERE a > 1 LIMIT 10",
+        "SELECT COUNT(*), SUM(a), MIN(b), MAX(c) FROM t WHERE d = 'ORDER BY'",
+        "SELECT a FROM t ORDER BY a DESC LIMIT 10",
+        "SELECT t.a, b AS c FROM t ORDER BY c, t.a LIMIT 10000",
+        "SELECT HIGH_PRIORITY a FROM t ORDER BY 1 LIMIT 5",
+        "SELECT a FROM t WHERE b IN (SELECT DISTINCT b FROM u GROUP BY b)",
+    };
+
+    ResultMerger::MergeInfo info;
+
+    for (size_t i = 0; i < sizeof(accepted) / sizeof(accepted[0]); i++)
+    {
+        if (!ResultMerger::parse(accepted[i], strlen(accepted[i]), &info))
+        {
+            cout << "ERROR: '" << accepted[i] << "' was rejected." << endl;
+            rv = EXIT_FAILURE;
+        }
+    }
+
+    const char* rejected[] =
+    {
+        "SELECT DISTINCT a FROM t",
+        "SELECT SQL_CALC_FOUND_ROWS a FROM t LIMIT 10",
+        "SELECT a, COUNT(*) FROM t GROUP BY a",
+        "SELECT COUNT(*) FROM t HAVING COUNT(*) > 1",
+        "SELECT a FROM t UNION SELECT a FROM u",
+        "SELECT AVG(a) FROM t",
+        "SELECT GROUP_CONCAT(a) FROM t",
+        "SELECT COUNT(DISTINCT a) FROM t",
+        "SELECT a, COUNT(*) FROM t",
+        "SELECT COUNT(*) FROM t LIMIT 0",
+        "SELECT a FROM t LIMIT 10, 20",
+        "SELECT a FROM t LIMIT 20 OFFSET 10",
+        "SELECT a FROM t ORDER BY a",
+        "SELECT a FROM t ORDER BY a LIMIT 10001",
+        "SELECT a FROM t ORDER BY b LIMIT 10",
+        "SELECT * FROM t ORDER BY a LIMIT 10",
+        "SELECT a FROM t FOR UPDATE",
+        "INSERT INTO t VALUES (1)",
+        "SHOW DATABASES",
+    };
+
+    for (size_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); i++)
+    {
+        if (ResultMerger::parse(rejected[i], strlen(rejected[i]), &info))
+        {
+            cout << "ERROR: '" << rejected[i] << "' was accepted." << endl;
+            rv = EXIT_FAILURE;
+        }
+    }
+
+    const char* zSql = "SELECT a, b FROM t ORDER BY b DESC, a LIMIT 7";
+
+    if (!ResultMerger::parse(zSql, strlen(zSql), &info) ||
+        info.mode != ResultMerger::MERGE_ORDERED || info.limit != 7 || info.keys.size() != 2 ||
+        info.keys[0].column != 1 || !info.keys[0].descending ||
+        info.keys[1].column != 0 || info.keys[1].descending)
+    {
+        cout << "ERROR: The sort keys of '" << zSql << "' are wrong." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    zSql = "SELECT MAX(a), COUNT(*) FROM t";
+
+    if (!ResultMerger::parse(zSql, strlen(zSql), &info) ||
+        info.mode != ResultMerger::MERGE_AGGREGATE || info.aggregates.size() != 2 ||
+        info.aggregates[0] != ResultMerger::AGG_MAX || info.aggregates[1] != ResultMerger::AGG_COUNT)
+    {
+        cout << "ERROR: The aggregates of '" << zSql << "' are wrong." << endl;
+        rv = EXIT_FAILURE;
+    }
+
+    return rv;
+}
+
+}
+
+int main()
+{
+    int rc = EXIT_FAILURE;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_STDOUT))
+    {
+        rc = EXIT_SUCCESS;
+        rc |= test_parse();
+        rc |= test_aggregates();
+        rc |= test_ordered();
+        rc |= test_concat();
+        rc |= test_errors();
+
+        mxs_log_finish();
+    }
+
+    return rc;
+}
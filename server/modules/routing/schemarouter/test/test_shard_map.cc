@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2020-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "../shard_map.hh"
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+#include <maxscale/log_manager.h>
+
+using namespace std;
+
+namespace
+{
+
+/** A lifetime after which a shard is never stale */
+const double FRESH = 1000;
+
+/** A lifetime after which a shard is always stale */
+const double EXPIRED = -1;
+
+int check(bool condition, const char* zWhat)
+{
+    if (!condition)
+    {
+        cout << "ERROR: " << zWhat << endl;
+    }
+
+    return condition ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int test_cold_start()
+{
+    int rv = EXIT_SUCCESS;
+    ShardManager manager;
+    uint64_t first;
+    uint64_t second;
+
+    cout << "Cold start" << endl;
+
+    SShard shard = manager.get_shard("user", FRESH, &first);
+    rv |= check(shard && shard->empty() && first != 0, "The first session does not build the shard.");
+
+    shard = manager.get_shard("user", FRESH, &second);
+    rv |= check(!shard && second == 0, "The second session does not wait for the shard.");
+
+    // The first session closes before it has built the shard
+    manager.cancel_update("user", first);
+
+    shard = manager.get_shard("user", FRESH, &second);
+    rv |= check(shard && second != 0 && second != first, "The refresh was not handed over.");
+
+    // A late cancellation of the first refresh must not affect the second
+    manager.cancel_update("user", first);
+
+    uint64_t third;
+    shard = manager.get_shard("user", FRESH, &third);
+    rv |= check(!shard && third == 0, "The refresh was cancelled by a session that did not own it.");
+
+    Shard* pNew = new Shard;
+    pNew->add_location("db", NULL);
+    manager.update_shard(SShard(pNew), "user");
+
+    shard = manager.get_shard("user", FRESH, &third);
+    rv |= check(shard.get() == pNew && third == 0, "The published shard is not used.");
+
+    return rv;
+}
+
+int test_refresh()
+{
+    int rv = EXIT_SUCCESS;
+    ShardManager manager;
+    uint64_t update;
+
+    cout << "Refresh" << endl;
+
+    manager.get_shard("user", FRESH, &update);
+    manager.update_shard(SShard(new Shard), "user");
+
+    SShard shard = manager.get_shard("user", FRESH, &update);
+    rv |= check(shard && update == 0, "A fresh shard is refreshed.");
+
+    SShard stale = manager.get_shard("user", EXPIRED, &update);
+    rv |= check(stale == shard && update != 0, "A stale shard is not refreshed.");
+
+    uint64_t other;
+    SShard current = manager.get_shard("other", FRESH, &other);
+    rv |= check(current && current != shard && other != 0, "The shards of users are not separate.");
+
+    return rv;
+}
+
+int test_locations()
+{
+    int rv = EXIT_SUCCESS;
+    SERVER* pServer1 = reinterpret_cast<SERVER*>(1);
+    SERVER* pServer2 = reinterpret_cast<SERVER*>(2);
+    SERVER* pServer3 = reinterpret_cast<SERVER*>(3);
+    Shard shard;
+
+    cout << "Locations" << endl;
+
+    rv |= check(shard.add_location("sharded", pServer1), "The first location was not added.");
+    rv |= check(shard.add_location("Common", pServer1), "The first location was not added.");
+    rv |= check(!shard.add_location("common", pServer2), "The second location was added.");
+    rv |= check(!shard.add_location("common", pServer3), "The third location was added.");
+    // The same server is listed only once
+    shard.add_location("common", pServer3);
+
+    rv |= check(shard.get_location("common") == pServer1, "The location is not the first server.");
+
+    vector<SERVER*> servers = shard.get_all_locations("COMMON");
+    rv |= check(servers.size() == 3 && servers[0] == pServer1 &&
+                servers[1] == pServer2 && servers[2] == pServer3,
+                "Not all servers of a database were found.");
+
+    servers = shard.get_all_locations("sharded");
+    rv |= check(servers.size() == 1 && servers[0] == pServer1,
+                "The server of a database on one server was not found.");
+
+    rv |= check(shard.get_all_locations("unknown").empty(), "An unknown database was found.");
+
+    return rv;
+}
+
+}
+
+int main()
+{
+    int rc = EXIT_FAILURE;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_STDOUT))
+    {
+        rc = EXIT_SUCCESS;
+        rc |= test_cold_start();
+        rc |= test_refresh();
+        rc |= test_locations();
+
+        mxs_log_finish();
+    }
+
+    return rc;
+}